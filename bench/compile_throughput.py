@@ -0,0 +1,190 @@
+#!/usr/bin/env python3
+"""Measures how fast each phase of vslc is, on synthetic programs of growing size.
+
+Each series makes one dimension of the program larger (more functions, longer function bodies,
+more global identifiers) and compiles it with -ftime-report=json. The throughput of each phase
+is reported in the unit of work it does: tokens for the parser, syntax tree nodes for the tree
+passes and symbol tables, and instructions for code generation.
+
+Doubling the input should double the time. For every phase, the growth of its time against its
+work is fitted on a log-log scale. An exponent well above 1 is flagged as superlinear, as is an
+average hashmap probe length that grows with the input. Either points at things like realloc on
+every append, or clustering in the symbol hashmaps.
+
+Usage: compile_throughput.py --vslc path/to/vslc [options]
+"""
+
+import argparse
+import json
+import math
+import os
+import subprocess
+import sys
+import tempfile
+
+import generate_vsl
+
+# Phase key in the JSON report, the counters that add up to its work, and the unit of that work
+PHASES = [
+    ("parse", ["tokens"], "tok"),
+    ("constant_folding", ["nodes_created"], "node"),
+    ("unreachable_code", ["nodes_created"], "node"),
+    ("symbol_tables", ["nodes_created", "symbols"], "item"),
+    ("code_generation", ["instructions"], "instr"),
+]
+
+# Each series scales one generator option, starting from the defaults of the generator
+SERIES = {
+    "functions": lambda n: ["--functions", str(250 * n)],
+    "statements": lambda n: ["--functions", "8", "--statements", str(2000 * n)],
+    "identifiers": lambda n: [
+        "--functions", "200", "--statements", "5",
+        "--identifiers", str(100 * n), "--globals", str(1000 * n)],
+}
+
+# Phases faster than this are mostly clock noise, and are left out of the scaling check,
+# as are phases whose work grows too little over the series to tell the exponent apart
+MIN_FIT_SECONDS = 0.005
+MIN_FIT_WORK_RATIO = 2
+
+
+def compile_once(vslc, source):
+    """Compiles the program once, and returns the parsed time report"""
+    result = subprocess.run(
+        [vslc, "-c", "-ftime-report=json", source, "-o", os.devnull],
+        stdout=subprocess.DEVNULL,
+        stderr=subprocess.PIPE,
+        text=True,
+        check=False,
+    )
+    if result.returncode != 0:
+        sys.exit(f"{vslc} failed on {source}:\n{result.stderr}")
+    return json.loads(result.stderr.strip().splitlines()[-1])
+
+
+def measure(vslc, source, repeat):
+    """Compiles the program several times, keeping the fastest CPU time of every phase"""
+    reports = [compile_once(vslc, source) for _ in range(repeat)]
+    best = reports[0]
+    for phase, _, _ in PHASES:
+        best["phases"][phase]["cpu_ms"] = min(r["phases"][phase]["cpu_ms"] for r in reports)
+    best["total"]["cpu_ms"] = min(r["total"]["cpu_ms"] for r in reports)
+    return best
+
+
+def work(report, counters):
+    return sum(report[counter] for counter in counters)
+
+
+def probes_per_operation(report):
+    operations = report["hashmap_inserts"] + report["hashmap_lookups"]
+    return report["hashmap_probes"] / operations if operations else 0.0
+
+
+def scaling_exponent(points):
+    """The least squares slope of log(time) against log(work)"""
+    xs = [math.log(work) for work, _ in points]
+    ys = [math.log(seconds) for _, seconds in points]
+    mean_x = sum(xs) / len(xs)
+    mean_y = sum(ys) / len(ys)
+    variance = sum((x - mean_x) ** 2 for x in xs)
+    if variance == 0:
+        return None
+    return sum((x - mean_x) * (y - mean_y) for x, y in zip(xs, ys)) / variance
+
+
+def run_series(name, args, workdir):
+    """Measures one series, prints its table, and returns the list of problems found"""
+    print(f"== {name} ==")
+    header = f"{'size':>6} {'tokens':>10} {'nodes':>10} {'instrs':>10}"
+    for phase, _, unit in PHASES:
+        header += f" {phase[:14] + ' M' + unit + '/s':>24}"
+    header += f" {'probes/op':>10} {'total ms':>10}"
+    print(header)
+
+    reports = []
+    for size in args.sizes:
+        source = os.path.join(workdir, f"{name}_{size}.vsl")
+        generate_vsl.main(SERIES[name](size) + ["--seed", str(args.seed), "-o", source])
+        report = measure(args.vslc, source, args.repeat)
+        reports.append(report)
+
+        row = (
+            f"{size:>6} {report['tokens']:>10} {report['nodes_created']:>10} "
+            f"{report['instructions']:>10}"
+        )
+        for phase, counters, _ in PHASES:
+            seconds = report["phases"][phase]["cpu_ms"] / 1e3
+            rate = work(report, counters) / seconds / 1e6 if seconds > 0 else float("inf")
+            row += f" {rate:>24.2f}"
+        row += f" {probes_per_operation(report):>10.3f} {report['total']['cpu_ms']:>10.1f}"
+        print(row)
+
+    problems = []
+    for phase, counters, _ in PHASES:
+        points = [
+            (work(r, counters), r["phases"][phase]["cpu_ms"] / 1e3)
+            for r in reports
+            if work(r, counters) > 0 and r["phases"][phase]["cpu_ms"] > 0
+        ]
+        if len(points) < 2 or points[-1][1] < MIN_FIT_SECONDS:
+            continue
+        if points[-1][0] < points[0][0] * MIN_FIT_WORK_RATIO:
+            continue
+        exponent = scaling_exponent(points)
+        if exponent is not None and exponent > args.max_exponent:
+            problems.append(f"{name}: {phase} grows as {'+'.join(counters)}^{exponent:.2f}")
+
+    first, last = probes_per_operation(reports[0]), probes_per_operation(reports[-1])
+    if first > 0 and last > first * args.max_probe_growth:
+        problems.append(
+            f"{name}: average hashmap probes per operation went from {first:.3f} to {last:.3f}"
+        )
+
+    print()
+    return problems
+
+
+def parse_arguments():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("--vslc", required=True, help="the compiler to measure")
+    parser.add_argument(
+        "--series", nargs="+", choices=sorted(SERIES), default=list(SERIES),
+        help="which series to run, all of them by default")
+    parser.add_argument(
+        "--sizes", type=int, nargs="+", default=[1, 2, 4, 8],
+        help="scale factors of each series")
+    parser.add_argument("--repeat", type=int, default=3, help="compilations per program")
+    parser.add_argument(
+        "--max-exponent", type=float, default=1.25,
+        help="flag phases whose time grows faster than work to this power")
+    parser.add_argument(
+        "--max-probe-growth", type=float, default=1.5,
+        help="flag series where the probes per hashmap operation grow by this factor")
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument(
+        "--workdir", help="where to keep the programs, a temporary directory by default")
+    return parser.parse_args()
+
+
+def main():
+    args = parse_arguments()
+    args.sizes.sort()
+
+    with tempfile.TemporaryDirectory() as temporary:
+        workdir = args.workdir or temporary
+        os.makedirs(workdir, exist_ok=True)
+        problems = []
+        for name in args.series:
+            problems += run_series(name, args, workdir)
+
+    if problems:
+        print("Superlinear behaviour:")
+        for problem in problems:
+            print("  " + problem)
+        sys.exit(1)
+    print("All phases scale linearly")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,205 @@
+#!/usr/bin/env python3
+"""Generates large, valid VSL programs for benchmarking the compiler.
+
+The shape of the program is controlled by a few knobs, so each phase of the compiler can be
+stressed on its own: many functions, long statement lists, deep nesting, many identifiers,
+many string literals, and many array accesses. The same seed always gives the same program.
+
+Usage: generate_vsl.py [options] [-o output.vsl]
+"""
+
+import argparse
+import random
+import sys
+
+COMPARISONS = ["<", ">", "<=", ">=", "==", "!="]
+ARITHMETIC = ["+", "-", "*", "/"]
+
+
+class Generator:
+    def __init__(self, args):
+        self.args = args
+        self.random = random.Random(args.seed)
+        self.out = []
+
+        self.globals = [f"g{i}" for i in range(args.globals)]
+        self.arrays = [f"arr{i}" for i in range(args.arrays)]
+        self.array_size = 16
+        # Every function gets 0 to 3 parameters. Calls must match the count
+        self.parameter_counts = [self.random.randint(0, 3) for _ in range(args.functions)]
+        self.string_counter = 0
+
+    def emit(self, depth, line):
+        self.out.append("    " * depth + line)
+
+    # Expressions
+
+    def leaf(self, scope):
+        r = self.random.random()
+        if r < 0.3:
+            return str(self.random.randint(0, 1000))
+        if r < 0.4 and self.arrays and self.args.array_use > 0:
+            array = self.random.choice(self.arrays)
+            return f"{array}[{self.random.randint(0, self.array_size - 1)}]"
+        if r < 0.5 and self.globals:
+            return self.random.choice(self.globals)
+        return self.random.choice(scope)
+
+    def expression(self, scope, depth, callee_limit):
+        if depth <= 0 or self.random.random() < 0.3:
+            return self.leaf(scope)
+
+        r = self.random.random()
+        if r < 0.08 and callee_limit > 0:
+            return self.call(scope, callee_limit)
+        if r < 0.15:
+            return "-" + self.leaf(scope)
+
+        op = self.random.choice(ARITHMETIC)
+        left = self.expression(scope, depth - 1, callee_limit)
+        # Only divide by literals that are not 0, so constant folding never divides by zero
+        if op == "/":
+            right = str(self.random.randint(1, 9))
+        else:
+            right = self.expression(scope, depth - 1, callee_limit)
+        return f"({left} {op} {right})"
+
+    def condition(self, scope, callee_limit):
+        left = self.expression(scope, 1, callee_limit)
+        right = self.expression(scope, 1, callee_limit)
+        return f"{left} {self.random.choice(COMPARISONS)} {right}"
+
+    def call(self, scope, callee_limit):
+        # Only call functions defined earlier, so the call graph has no cycles
+        callee = self.random.randrange(callee_limit)
+        arguments = [self.leaf(scope) for _ in range(self.parameter_counts[callee])]
+        return f"f{callee}({', '.join(arguments)})"
+
+    # Statements
+
+    def string(self):
+        self.string_counter += 1
+        return f'"string {self.string_counter} of the benchmark program"'
+
+    def statement(self, scope, depth, nesting, in_loop, callee_limit):
+        """Emits one statement. Nesting is how many more levels of if, while and blocks to allow"""
+        choices = ["assign", "assign", "print"]
+        if self.arrays and self.random.random() < self.args.array_use:
+            choices.append("array")
+        if nesting > 0:
+            choices += ["if", "while", "block"]
+        if in_loop:
+            choices.append("break")
+        kind = self.random.choice(choices)
+
+        if kind == "assign":
+            target = self.random.choice(scope + self.globals)
+            self.emit(depth, f"{target} = {self.expression(scope, 3, callee_limit)}")
+        elif kind == "array":
+            array = self.random.choice(self.arrays)
+            index = self.random.randint(0, self.array_size - 1)
+            self.emit(depth, f"{array}[{index}] = {self.expression(scope, 2, callee_limit)}")
+        elif kind == "print":
+            items = [self.expression(scope, 2, callee_limit)]
+            if self.random.random() < self.args.strings:
+                items.insert(0, self.string())
+            self.emit(depth, "print " + ", ".join(items))
+        elif kind == "break":
+            self.emit(depth, "break")
+        elif kind == "if":
+            self.emit(depth, f"if {self.condition(scope, callee_limit)} then")
+            self.statement(scope, depth + 1, nesting - 1, in_loop, callee_limit)
+            if self.random.random() < 0.5:
+                self.emit(depth, "else")
+                self.statement(scope, depth + 1, nesting - 1, in_loop, callee_limit)
+        elif kind == "while":
+            self.emit(depth, f"while {self.condition(scope, callee_limit)} do")
+            self.block(scope, depth, nesting - 1, True, callee_limit, 3)
+        else:
+            self.block(scope, depth, nesting - 1, in_loop, callee_limit, 3)
+
+    def block(self, scope, depth, nesting, in_loop, callee_limit, n_statements):
+        """Emits a block with a few declarations of its own, which may shadow outer names"""
+        self.emit(depth, "{")
+        n_locals = self.random.randint(0, 2)
+        names = [f"v{self.random.randrange(self.args.identifiers)}" for _ in range(n_locals)]
+        names = list(dict.fromkeys(names))
+        if names:
+            self.emit(depth + 1, "var " + ", ".join(names))
+        for _ in range(n_statements):
+            self.statement(scope + names, depth + 1, nesting, in_loop, callee_limit)
+        self.emit(depth, "}")
+
+    # Program
+
+    def function(self, index):
+        parameters = [f"p{i}" for i in range(self.parameter_counts[index])]
+        self.emit(0, f"func f{index}({', '.join(parameters)}) {{")
+
+        locals_ = [f"v{i}" for i in range(self.args.identifiers)]
+        if locals_:
+            self.emit(1, "var " + ", ".join(locals_))
+        scope = parameters + locals_ or self.globals or ["0"]
+
+        for _ in range(self.args.statements):
+            self.statement(scope, 1, self.args.depth, False, index)
+        self.emit(1, f"return {self.expression(scope, 2, index)}")
+        self.emit(0, "}")
+        self.emit(0, "")
+
+    def program(self):
+        declarations = self.globals + [f"{a}[{self.array_size}]" for a in self.arrays]
+        if declarations:
+            self.emit(0, "var " + ", ".join(declarations))
+            self.emit(0, "")
+
+        # The first function is the entry point of a VSL program
+        self.emit(0, "func main() {")
+        if self.args.functions > 0:
+            self.emit(1, f"print {self.call(['0'], self.args.functions)}")
+        self.emit(1, "return 0")
+        self.emit(0, "}")
+        self.emit(0, "")
+
+        for i in range(self.args.functions):
+            self.function(i)
+        return "\n".join(self.out) + "\n"
+
+
+def parse_arguments(argv):
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("--functions", type=int, default=100, help="number of functions")
+    parser.add_argument(
+        "--statements", type=int, default=20, help="top level statements per function"
+    )
+    parser.add_argument(
+        "--depth", type=int, default=3, help="how deep if, while and blocks may nest"
+    )
+    parser.add_argument(
+        "--identifiers", type=int, default=8, help="local variables declared per function"
+    )
+    parser.add_argument("--globals", type=int, default=16, help="global variables")
+    parser.add_argument("--arrays", type=int, default=4, help="global arrays")
+    parser.add_argument(
+        "--array-use", type=float, default=0.2, help="chance of a statement using an array"
+    )
+    parser.add_argument(
+        "--strings", type=float, default=0.3, help="chance of a print having a string literal"
+    )
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("-o", "--output", help="output file, stdout if not given")
+    return parser.parse_args(argv)
+
+
+def main(argv):
+    args = parse_arguments(argv)
+    program = Generator(args).program()
+    if args.output:
+        with open(args.output, "w") as f:
+            f.write(program)
+    else:
+        sys.stdout.write(program)
+
+
+if __name__ == "__main__":
+    main(sys.argv[1:])
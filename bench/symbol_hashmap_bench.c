@@ -0,0 +1,325 @@
+// Microbenchmark for the symbol hashmap.
+//
+// Compares the current hashmap (interned names, mixed hash, power-of-two masking)
+// against the original implementation (multiply-by-257 hash, modulo bucket selection,
+// strcmp on every probe), which is reproduced at the bottom of this file.
+//
+// Usage: symbol_hashmap_bench [number of names] [lookups per name]
+
+#include "compilation.h"
+#include "intern.h"
+#include "symbol_table.h"
+#include "symbols.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// The original hashmap, kept here as a point of comparison
+typedef struct legacy_hashmap
+{
+  symbol_t** buckets;
+  size_t n_buckets;
+  size_t n_entries;
+  size_t n_operations;
+  size_t n_probes;
+  size_t max_probe_length;
+} legacy_hashmap_t;
+
+static void legacy_insert(legacy_hashmap_t* hashmap, symbol_t* symbol);
+static symbol_t* legacy_lookup(legacy_hashmap_t* hashmap, const char* name);
+static void legacy_destroy(legacy_hashmap_t* hashmap);
+
+// The different kinds of identifier sets we benchmark with
+typedef enum
+{
+  NAMES_GENERATED, // v000001, v000002, ... like the output of code generators
+  NAMES_WORDS,     // random lowercase words between 3 and 10 letters long
+  NAMES_SHORT,     // i, j, x1, ab, ... as written by hand
+} name_kind_t;
+
+static const char* NAME_KIND_NAMES[] = {"generated", "words", "short"};
+
+// Returns the current time in seconds
+static double now(void)
+{
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+// Makes n_names distinct names of the given kind. Every name is its own heap allocation
+static char** make_names(name_kind_t kind, size_t n_names)
+{
+  char** names = malloc(n_names * sizeof(char*));
+  char buffer[32];
+  for (size_t i = 0; i < n_names; i++)
+  {
+    switch (kind)
+    {
+    case NAMES_GENERATED:
+      snprintf(buffer, sizeof(buffer), "v%06zu", i);
+      break;
+    case NAMES_WORDS:
+    {
+      // The index is appended to keep the words distinct
+      int length = 3 + rand() % 8;
+      for (int c = 0; c < length; c++)
+        buffer[c] = 'a' + rand() % 26;
+      snprintf(buffer + length, sizeof(buffer) - length, "%zu", i);
+      break;
+    }
+    case NAMES_SHORT:
+    {
+      // Spell out i in base 26, using the letters a to z as digits
+      size_t n = i;
+      int length = 0;
+      do
+      {
+        buffer[length++] = 'a' + n % 26;
+        n /= 26;
+      } while (n > 0);
+      buffer[length] = '\0';
+      break;
+    }
+    }
+    names[i] = strdup(buffer);
+  }
+  return names;
+}
+
+// Makes an order of lookups, where every name is looked up n_repeats times
+static size_t* make_lookup_order(size_t n_names, size_t n_repeats)
+{
+  size_t n_lookups = n_names * n_repeats;
+  size_t* order = malloc(n_lookups * sizeof(size_t));
+  for (size_t i = 0; i < n_lookups; i++)
+    order[i] = i % n_names;
+  for (size_t i = n_lookups - 1; i > 0; i--)
+  {
+    size_t j = rand() % (i + 1);
+    size_t swap = order[i];
+    order[i] = order[j];
+    order[j] = swap;
+  }
+  return order;
+}
+
+// Benchmarks the current hashmap. Every lookup first interns a fresh copy of the name,
+// since that is the work the scanner does for every identifier token.
+static void bench_current(char** names, size_t n_names, size_t* order, size_t n_lookups)
+{
+  compilation->hashmap_statistics = (symbol_hashmap_statistics_t){0};
+  symbol_table_t* table = symbol_table_init();
+
+  double start = now();
+  for (size_t i = 0; i < n_names; i++)
+  {
+    symbol_t* symbol = malloc(sizeof(symbol_t));
+    *symbol = (symbol_t){.name = intern_identifier(names[i], strlen(names[i]))};
+    symbol_table_insert(table, symbol);
+  }
+  double inserted = now();
+
+  // The scanner interns text from its own buffer, so give every lookup its own copy of the name
+  char** copies = malloc(n_lookups * sizeof(char*));
+  for (size_t i = 0; i < n_lookups; i++)
+    copies[i] = strdup(names[order[i]]);
+
+  double start_lookups = now();
+  size_t found = 0;
+  for (size_t i = 0; i < n_lookups; i++)
+  {
+    const char* name = intern_identifier(copies[i], strlen(copies[i]));
+    found += symbol_hashmap_lookup(table->hashmap, name) != NULL;
+  }
+  double looked_up = now();
+
+  for (size_t i = 0; i < n_lookups; i++)
+    free(copies[i]);
+  free(copies);
+
+  // Lookups of already interned names, which is what bind_names does
+  const char** interned = malloc(n_lookups * sizeof(char*));
+  for (size_t i = 0; i < n_lookups; i++)
+    interned[i] = table->symbols[order[i]]->name;
+  double start_interned = now();
+  for (size_t i = 0; i < n_lookups; i++)
+    found += symbol_hashmap_lookup(table->hashmap, interned[i]) != NULL;
+  double looked_up_interned = now();
+  free(interned);
+
+  symbol_hashmap_statistics_t* statistics = &compilation->hashmap_statistics;
+  size_t n_operations = statistics->n_inserts + statistics->n_lookups;
+  printf(
+      "  current: insert %7.1f ns  intern+lookup %7.1f ns  lookup %7.1f ns"
+      "  avg probe %.3f  max probe %zu\n",
+      (inserted - start) * 1e9 / n_names,
+      (looked_up - start_lookups) * 1e9 / n_lookups,
+      (looked_up_interned - start_interned) * 1e9 / n_lookups,
+      (double)statistics->n_probes / n_operations,
+      statistics->max_probe_length);
+
+  if (found != 2 * n_lookups)
+    fprintf(stderr, "error: current hashmap lost entries\n");
+
+  symbol_table_destroy(table);
+  destroy_intern_table();
+}
+
+// Benchmarks the original hashmap. Every lookup uses a fresh copy of the name,
+// like the strdup-ed identifiers of the original parser
+static void bench_legacy(char** names, size_t n_names, size_t* order, size_t n_lookups)
+{
+  legacy_hashmap_t hashmap = {0};
+  symbol_t* symbols = malloc(n_names * sizeof(symbol_t));
+
+  double start = now();
+  for (size_t i = 0; i < n_names; i++)
+  {
+    symbols[i] = (symbol_t){.name = names[i]};
+    legacy_insert(&hashmap, &symbols[i]);
+  }
+  double inserted = now();
+
+  char** copies = malloc(n_lookups * sizeof(char*));
+  for (size_t i = 0; i < n_lookups; i++)
+    copies[i] = strdup(names[order[i]]);
+
+  double start_lookups = now();
+  size_t found = 0;
+  for (size_t i = 0; i < n_lookups; i++)
+    found += legacy_lookup(&hashmap, copies[i]) != NULL;
+  double looked_up = now();
+
+  printf(
+      "  legacy:  insert %7.1f ns  hash+lookup   %7.1f ns                   "
+      "  avg probe %.3f  max probe %zu\n",
+      (inserted - start) * 1e9 / n_names,
+      (looked_up - start_lookups) * 1e9 / n_lookups,
+      (double)hashmap.n_probes / hashmap.n_operations,
+      hashmap.max_probe_length);
+
+  if (found != n_lookups)
+    fprintf(stderr, "error: legacy hashmap lost entries\n");
+
+  for (size_t i = 0; i < n_lookups; i++)
+    free(copies[i]);
+  free(copies);
+  free(symbols);
+  legacy_destroy(&hashmap);
+}
+
+int main(int argc, char** argv)
+{
+  size_t n_names = argc > 1 ? strtoul(argv[1], NULL, 10) : 100000;
+  size_t n_repeats = argc > 2 ? strtoul(argv[2], NULL, 10) : 20;
+  srand(1);
+
+  // The intern table and the statistics belong to the active compilation
+  static compilation_t bench_compilation;
+  compilation = &bench_compilation;
+
+  for (name_kind_t kind = NAMES_GENERATED; kind <= NAMES_SHORT; kind++)
+  {
+    printf("%s names: %zu names, %zu lookups each\n", NAME_KIND_NAMES[kind], n_names, n_repeats);
+
+    char** names = make_names(kind, n_names);
+    size_t* order = make_lookup_order(n_names, n_repeats);
+
+    bench_current(names, n_names, order, n_names * n_repeats);
+    bench_legacy(names, n_names, order, n_names * n_repeats);
+
+    for (size_t i = 0; i < n_names; i++)
+      free(names[i]);
+    free(names);
+    free(order);
+  }
+}
+
+// ============ The original hashmap implementation ============
+
+static uint64_t legacy_hash_string(const char* string)
+{
+  uint64_t hash = 31;
+  for (const char* c = string; *c != '\0'; c++)
+    hash = hash * 257 + *c;
+  return hash;
+}
+
+static void legacy_record(legacy_hashmap_t* hashmap, size_t probe_length)
+{
+  hashmap->n_operations++;
+  hashmap->n_probes += probe_length;
+  if (probe_length > hashmap->max_probe_length)
+    hashmap->max_probe_length = probe_length;
+}
+
+static void legacy_resize(legacy_hashmap_t* hashmap, size_t new_capacity)
+{
+  symbol_t** old_buckets = hashmap->buckets;
+  size_t old_capacity = hashmap->n_buckets;
+
+  hashmap->buckets = calloc(new_capacity, sizeof(symbol_t*));
+  hashmap->n_buckets = new_capacity;
+  hashmap->n_entries = 0;
+
+  for (size_t i = 0; i < old_capacity; i++)
+  {
+    if (old_buckets[i] == NULL)
+      continue;
+    size_t bucket = legacy_hash_string(old_buckets[i]->name) % hashmap->n_buckets;
+    while (hashmap->buckets[bucket] != NULL)
+      bucket = (bucket + 1) % hashmap->n_buckets;
+    hashmap->buckets[bucket] = old_buckets[i];
+    hashmap->n_entries++;
+  }
+
+  free(old_buckets);
+}
+
+static void legacy_insert(legacy_hashmap_t* hashmap, symbol_t* symbol)
+{
+  if ((hashmap->n_entries + 1) * 2 > hashmap->n_buckets)
+    legacy_resize(hashmap, hashmap->n_buckets * 2 + 8);
+
+  size_t bucket = legacy_hash_string(symbol->name) % hashmap->n_buckets;
+  size_t probe_length = 1;
+  while (hashmap->buckets[bucket] != NULL)
+  {
+    if (strcmp(hashmap->buckets[bucket]->name, symbol->name) == 0)
+      break;
+    bucket = (bucket + 1) % hashmap->n_buckets;
+    probe_length++;
+  }
+  legacy_record(hashmap, probe_length);
+
+  if (hashmap->buckets[bucket] == NULL)
+  {
+    hashmap->buckets[bucket] = symbol;
+    hashmap->n_entries++;
+  }
+}
+
+static symbol_t* legacy_lookup(legacy_hashmap_t* hashmap, const char* name)
+{
+  size_t bucket = legacy_hash_string(name) % hashmap->n_buckets;
+  size_t probe_length = 1;
+  while (hashmap->buckets[bucket] != NULL)
+  {
+    if (strcmp(hashmap->buckets[bucket]->name, name) == 0)
+    {
+      legacy_record(hashmap, probe_length);
+      return hashmap->buckets[bucket];
+    }
+    bucket = (bucket + 1) % hashmap->n_buckets;
+    probe_length++;
+  }
+  legacy_record(hashmap, probe_length);
+  return NULL;
+}
+
+static void legacy_destroy(legacy_hashmap_t* hashmap)
+{
+  free(hashmap->buckets);
+}
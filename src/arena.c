@@ -0,0 +1,58 @@
+#include "arena.h"
+#include <stdlib.h>
+#include <string.h>
+
+// The size of a normal chunk. Allocations larger than this get a chunk of their own
+#define ARENA_CHUNK_SIZE (64 * 1024)
+
+// Every allocation is rounded up to a multiple of this, to keep the next allocation aligned
+#define ARENA_ALIGNMENT (sizeof(max_align_t))
+
+// Allocates a new chunk with room for at least min_capacity bytes, and makes it the head
+static void arena_grow(arena_t* arena, size_t min_capacity)
+{
+  size_t capacity = ARENA_CHUNK_SIZE;
+  if (capacity < min_capacity)
+    capacity = min_capacity;
+
+  arena_chunk_t* chunk = malloc(sizeof(arena_chunk_t) + capacity);
+  chunk->previous = arena->head;
+  chunk->capacity = capacity;
+  chunk->used = 0;
+  arena->head = chunk;
+}
+
+// Hands out the next size bytes of the head chunk, making a new chunk if there is no room
+void* arena_alloc(arena_t* arena, size_t size)
+{
+  size = (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+
+  if (arena->head == NULL || arena->head->capacity - arena->head->used < size)
+    arena_grow(arena, size);
+
+  void* result = (char*)arena->head->data + arena->head->used;
+  arena->head->used += size;
+  return result;
+}
+
+// Allocates a copy of the given string in the arena
+char* arena_strdup(arena_t* arena, const char* string)
+{
+  size_t length = strlen(string) + 1;
+  char* result = arena_alloc(arena, length);
+  memcpy(result, string, length);
+  return result;
+}
+
+// Frees all chunks owned by the arena
+void arena_release(arena_t* arena)
+{
+  arena_chunk_t* chunk = arena->head;
+  while (chunk != NULL)
+  {
+    arena_chunk_t* previous = chunk->previous;
+    free(chunk);
+    chunk = previous;
+  }
+  arena->head = NULL;
+}
@@ -0,0 +1,31 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// A chunk of memory owned by an arena. Chunks are linked together, newest first.
+typedef struct arena_chunk
+{
+  struct arena_chunk* previous;
+  size_t capacity; // The number of usable bytes in data
+  size_t used;     // The number of bytes already handed out from data
+  max_align_t data[];
+} arena_chunk_t;
+
+// A bump allocator. Allocations are carved out of large chunks, and can not be freed one by one.
+// Instead, all memory handed out by the arena is freed at once by arena_release.
+typedef struct arena
+{
+  arena_chunk_t* head; // The chunk currently being allocated from, or NULL
+} arena_t;
+
+// Allocates size bytes from the arena, aligned for any type
+void* arena_alloc(arena_t* arena, size_t size);
+
+// Allocates a copy of the given string in the arena
+char* arena_strdup(arena_t* arena, const char* string);
+
+// Frees every allocation made from the arena. The arena can be used again afterwards
+void arena_release(arena_t* arena);
+
+#endif // ARENA_H
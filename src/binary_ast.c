@@ -0,0 +1,619 @@
+#include "vslc.h"
+
+// Starts every binary syntax tree, including its NUL byte. No VSL program starts with 0x7f
+#define BINARY_AST_MAGIC "\177VSLAST"
+
+// Change it whenever nodetypes.h, operators.h or the way the file is encoded change,
+// so that files written by other versions of the compiler are rejected
+#define BINARY_AST_VERSION 2
+
+// The numbers of the header, in the order they follow the magic
+typedef struct binary_ast_header
+{
+  uint64_t version;
+  uint64_t root;
+  uint64_t n_nodes; // Including the unused node at position 0, which is not written
+  uint64_t n_list_children;
+  uint64_t n_symbols;
+  uint64_t n_names;
+  uint64_t n_strings;
+  uint64_t nodes_length;   // The length of the node section, in bytes
+  uint64_t symbols_length; // The length of the symbol section, in bytes
+  uint64_t text_length;    // The length of all names and strings, including their NUL bytes
+} binary_ast_header_t;
+
+// Where each section starts in the file, and where the file ends
+typedef struct binary_ast_layout
+{
+  uint64_t nodes;
+  uint64_t symbols;
+  uint64_t text;
+  uint64_t end;
+} binary_ast_layout_t;
+
+// Reads the numbers of one section of a binary syntax tree, one after the other
+typedef struct binary_ast_reader
+{
+  const uint8_t* position;
+  const uint8_t* end;
+} binary_ast_reader_t;
+
+// A hashmap from pointers to their positions in the file, used while writing it.
+// Open addressing with linear probing, kept at most half full
+typedef struct position_entry
+{
+  const void* key; // NULL if the bucket is empty
+  uint32_t position;
+} position_entry_t;
+
+typedef struct position_map
+{
+  position_entry_t* buckets;
+  size_t n_buckets; // Always 0 or a power of two
+  size_t n_entries;
+} position_map_t;
+
+static binary_ast_layout_t read_header(binary_ast_header_t* header);
+static void read_node(binary_ast_reader_t* reader, node_id_t id, const binary_ast_header_t* header,
+                      node_t* node, node_id_t* list_children, uint64_t* list_start);
+static uint64_t read_number(binary_ast_reader_t* reader);
+static void write_number(sink_t* sink, uint64_t value);
+static void write_child(sink_t* sink, node_id_t parent, node_id_t child);
+static uint32_t position_map_get(position_map_t* map, const void* key, uint32_t position);
+static const char* defined_name(node_t* node, symtype_t type);
+static _Noreturn void damaged(void);
+
+/* External interface */
+
+// Only the magic is looked at here. The rest of the file is checked as it is loaded
+bool is_binary_ast(const char* data, size_t length)
+{
+  return length >= sizeof(BINARY_AST_MAGIC)
+         && memcmp(data, BINARY_AST_MAGIC, sizeof(BINARY_AST_MAGIC)) == 0;
+}
+
+// Nodes detached from the tree, and room left over at the end of LIST nodes, are left out.
+// The reachable nodes are numbered in the order they appear, and written in that order
+void write_binary_ast(void)
+{
+  compilation_t* c = compilation;
+
+  // Number the nodes. new_ids maps positions in the node pool to positions in the file
+  node_id_t* new_ids = calloc(c->n_nodes, sizeof(node_id_t));
+  node_t** order = malloc(c->n_nodes * sizeof(node_t*));
+  size_t n_nodes = 1;
+  size_t n_list_children = 0;
+
+  tree_walk_stack_t* stack = &c->tree_walk;
+  size_t stack_base = stack->length;
+  tree_walk_push(stack, node_at(c->root), 0);
+  while (stack->length > stack_base)
+  {
+    node_t* node = tree_walk_top(stack)->node;
+    tree_walk_pop(stack);
+    if (node == NULL)
+      continue;
+
+    new_ids[node_id(node)] = n_nodes;
+    order[n_nodes++] = node;
+    if (node->type == LIST)
+      n_list_children += node->n_children;
+
+    // IDENTIFIER nodes use the space of their children for the symbol
+    if (node->type == IDENTIFIER)
+      continue;
+    node_id_t* children = node_children(node);
+    for (size_t i = node->n_children; i > 0; i--)
+      tree_walk_push(stack, node_at(children[i - 1]), 0);
+  }
+
+  // Number the symbols. Every function is followed by the symbols of its own symbol table
+  position_map_t symbols = {0};
+  size_t n_symbols = 0;
+  sink_t symbol_section;
+  sink_init(&symbol_section, NULL);
+  symbol_table_t* global_symbols = c->global_symbols;
+  for (size_t i = 0; i < global_symbols->n_symbols; i++)
+  {
+    symbol_t* symbol = global_symbols->symbols[i];
+    size_t n_local_symbols = 0;
+    if (symbol->type == SYMBOL_FUNCTION)
+      n_local_symbols = symbol->function_symtable->n_symbols;
+
+    for (size_t j = 0; j <= n_local_symbols; j++)
+    {
+      symbol_t* member = j == 0 ? symbol : symbol->function_symtable->symbols[j - 1];
+      position_map_get(&symbols, member, n_symbols++);
+      write_number(&symbol_section, new_ids[node_id(member->node)]);
+      write_number(&symbol_section, member->type);
+    }
+  }
+
+  // The names are kept in the order they are first used, followed by the strings
+  position_map_t names = {0};
+  size_t n_names = 0;
+  sink_t text;
+  sink_init(&text, NULL);
+  for (size_t i = 1; i < n_nodes; i++)
+  {
+    if (order[i]->type != IDENTIFIER)
+      continue;
+    const char* name = order[i]->data.identifier;
+    if (position_map_get(&names, name, n_names) == n_names)
+    {
+      n_names++;
+      sink_write(&text, name, strlen(name) + 1);
+    }
+  }
+  for (size_t i = 0; i < c->string_list_len; i++)
+    sink_write(&text, c->string_list[i], strlen(c->string_list[i]) + 1);
+
+  // The children of LIST nodes are written right after them. Every child comes after its parent,
+  // and is written as how far after it comes, which is usually close
+  sink_t node_section;
+  sink_init(&node_section, NULL);
+  for (node_id_t i = 1; i < n_nodes; i++)
+  {
+    node_t* node = order[i];
+    uint32_t symbol;
+    write_number(&node_section, node->type);
+    write_number(&node_section, node->n_children);
+    switch (node->type)
+    {
+    case LIST:
+      for (size_t j = 0; j < node->n_children; j++)
+        write_child(&node_section, i, new_ids[node_children(node)[j]]);
+      break;
+    case IDENTIFIER:
+      write_number(&node_section, position_map_get(&names, node->data.identifier, 0));
+      symbol = node->symbol == NULL ? 0 : position_map_get(&symbols, node->symbol, 0) + 1;
+      write_number(&node_section, symbol);
+      break;
+    default:
+      for (size_t j = 0; j < node->n_children; j++)
+        write_child(&node_section, i, new_ids[node->inline_children[j]]);
+      break;
+    }
+
+    int64_t number;
+    switch (node->type)
+    {
+    case OPERATOR:
+      write_number(&node_section, node->data.operator);
+      break;
+    case NUMBER_LITERAL:
+      // Negative numbers are folded in between the positive ones, so small numbers stay short
+      number = node->data.number_literal;
+      write_number(&node_section, number < 0 ? ~((uint64_t)number << 1) : (uint64_t)number << 1);
+      break;
+    case STRING_LIST_REFERENCE:
+      write_number(&node_section, node->data.string_list_index);
+      break;
+    default:
+      break;
+    }
+  }
+
+  sink_t* output = &c->output;
+  sink_write(output, BINARY_AST_MAGIC, sizeof(BINARY_AST_MAGIC));
+  write_number(output, BINARY_AST_VERSION);
+  write_number(output, new_ids[c->root]);
+  write_number(output, n_nodes);
+  write_number(output, n_list_children);
+  write_number(output, n_symbols);
+  write_number(output, n_names);
+  write_number(output, c->string_list_len);
+  write_number(output, node_section.length);
+  write_number(output, symbol_section.length);
+  write_number(output, text.length);
+  sink_write(output, node_section.buffer, node_section.length);
+  sink_write(output, symbol_section.buffer, symbol_section.length);
+  sink_write(output, text.buffer, text.length);
+
+  free(new_ids);
+  free(order);
+  free(symbols.buckets);
+  free(names.buckets);
+  sink_destroy(&node_section);
+  sink_destroy(&symbol_section);
+  sink_destroy(&text);
+}
+
+// Everything is allocated by the compilation as soon as it is made, so nothing is left behind
+// when a damaged file is reported halfway through
+void load_binary_ast(void)
+{
+  compilation_t* c = compilation;
+  const char* data = c->binary_ast;
+  binary_ast_header_t header;
+  binary_ast_layout_t layout = read_header(&header);
+
+  // The nodes and list children are decoded into the pools
+  c->nodes = malloc(header.n_nodes * sizeof(node_t));
+  c->n_nodes = c->nodes_capacity = header.n_nodes;
+  memset(&c->nodes[NO_NODE], 0, sizeof(node_t));
+  c->list_children = malloc(header.n_list_children * sizeof(node_id_t));
+  c->list_children_capacity = header.n_list_children;
+  binary_ast_reader_t reader = {
+      .position = (const uint8_t*)data + layout.nodes,
+      .end = (const uint8_t*)data + layout.symbols};
+  uint64_t list_start = 0;
+  for (node_id_t i = 1; i < c->n_nodes; i++)
+    read_node(&reader, i, &header, &c->nodes[i], c->list_children, &list_start);
+  if (reader.position != reader.end || list_start != header.n_list_children)
+    damaged();
+  c->list_children_length = header.n_list_children;
+  c->root = header.root;
+
+  // Every name is interned once. The strings are copied into the arena of the tree
+  const char* text = data + layout.text;
+  const char* text_end = data + layout.end;
+  const char** names = arena_alloc(&c->tree_arena, (header.n_names + 1) * sizeof(char*));
+  for (size_t i = 0; i < header.n_names; i++)
+  {
+    const char* end = memchr(text, '\0', text_end - text);
+    if (end == NULL)
+      damaged();
+    names[i] = intern_identifier(text, end - text);
+    text = end + 1;
+  }
+
+  char* strings = arena_alloc(&c->tree_arena, text_end - text);
+  memcpy(strings, text, text_end - text);
+  char* strings_end = strings + (text_end - text);
+  c->string_list = malloc((header.n_strings + 1) * sizeof(char*));
+  c->string_list_capacity = header.n_strings + 1;
+  for (size_t i = 0; i < header.n_strings; i++)
+  {
+    char* end = memchr(strings, '\0', strings_end - strings);
+    if (end == NULL)
+      damaged();
+    c->string_list[c->string_list_len++] = strings;
+    strings = end + 1;
+  }
+
+  // Children always come after their parents, so following them always ends
+  for (size_t i = 1; i < c->n_nodes; i++)
+  {
+    node_t* node = &c->nodes[i];
+    if (node->type >= NODE_TYPE_COUNT)
+      damaged();
+
+    if (node->type == LIST)
+    {
+      if ((uint64_t)node->list.start + node->n_children > c->list_children_length)
+        damaged();
+      node->list.capacity = node->n_children;
+    }
+    else if (node->n_children > NODE_INLINE_CHILDREN
+             || (node->type == IDENTIFIER && node->n_children != 0))
+      damaged();
+
+    node_id_t* children = node_children(node);
+    for (size_t j = 0; j < node->n_children; j++)
+      if (children[j] != NO_NODE && (children[j] <= i || children[j] >= c->n_nodes))
+        damaged();
+
+    switch (node->type)
+    {
+    case IDENTIFIER:
+      if (node->data.string_list_index >= header.n_names)
+        damaged();
+      node->data.identifier = names[node->data.string_list_index];
+      node->symbol = NULL;
+      break;
+    case STRING_LITERAL:
+      damaged();
+    case STRING_LIST_REFERENCE:
+      if (node->data.string_list_index >= c->string_list_len)
+        damaged();
+      node->type = STRING_LITERAL;
+      node->data.string_literal = c->string_list[node->data.string_list_index];
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+// The symbols of the file are inserted into the symbol tables in order, so they get the same
+// sequence numbers they had when the file was written
+void bind_binary_ast(void)
+{
+  compilation_t* c = compilation;
+  const uint8_t* data = (const uint8_t*)c->binary_ast;
+  binary_ast_header_t header;
+  binary_ast_layout_t layout = read_header(&header);
+  binary_ast_reader_t reader = {.position = data + layout.symbols, .end = data + layout.text};
+
+  symbol_t** symbols = arena_alloc(&c->tree_arena, (header.n_symbols + 1) * sizeof(symbol_t*));
+  c->global_symbols = symbol_table_init();
+  symbol_table_t* function_symbols = NULL;
+  for (size_t i = 0; i < header.n_symbols; i++)
+  {
+    uint64_t node = read_number(&reader);
+    uint64_t type = read_number(&reader);
+    if (node == NO_NODE || node >= c->n_nodes || type > SYMBOL_LOCAL_VAR)
+      damaged();
+    const char* name = defined_name(node_at(node), type);
+    if (name == NULL || (type >= SYMBOL_PARAMETER && function_symbols == NULL))
+      damaged();
+
+    symbol_t* symbol = malloc(sizeof(symbol_t));
+    *symbol = (symbol_t){
+        .name = name,
+        .type = type,
+        .node = node_at(node),
+        .function_symtable = NULL};
+    symbols[i] = symbol;
+
+    // Local variables are not in the hashmap of their table, just like after create_tables
+    if (type == SYMBOL_LOCAL_VAR)
+    {
+      symbol->function_symtable = function_symbols;
+      symbol_table_append(function_symbols, symbol);
+      continue;
+    }
+
+    symbol_table_t* table = type == SYMBOL_PARAMETER ? function_symbols : c->global_symbols;
+    if (symbol_table_insert(table, symbol) == INSERT_COLLISION)
+    {
+      free(symbol);
+      damaged();
+    }
+
+    if (type == SYMBOL_FUNCTION)
+    {
+      function_symbols = symbol_table_init();
+      symbol->function_symtable = function_symbols;
+      function_symbols->hashmap->backup = c->global_symbols->hashmap;
+    }
+  }
+
+  if (reader.position != reader.end)
+    damaged();
+
+  // The positions of symbols and strings are read from the file again
+  reader = (binary_ast_reader_t){.position = data + layout.nodes, .end = data + layout.symbols};
+  uint64_t list_start = 0;
+  for (node_id_t i = 1; i < c->n_nodes; i++)
+  {
+    node_t stored;
+    read_node(&reader, i, &header, &stored, NULL, &list_start);
+    node_t* node = &c->nodes[i];
+    if (node->type != IDENTIFIER && node->type != STRING_LITERAL)
+      continue;
+    if (node->type == IDENTIFIER)
+    {
+      uint32_t symbol = stored.inline_children[0];
+      node->symbol = symbol == 0 ? NULL : symbols[symbol - 1];
+    }
+    else
+    {
+      node->type = STRING_LIST_REFERENCE;
+      node->data.string_list_index = stored.data.string_list_index;
+    }
+  }
+}
+
+/* Internal matters */
+
+// Reads the header, which follows the magic, and finds where the sections start. Every node and
+// symbol takes at least two bytes, so their counts are checked against the lengths of their
+// sections before anything is allocated for them
+static binary_ast_layout_t read_header(binary_ast_header_t* header)
+{
+  compilation_t* c = compilation;
+  const uint8_t* data = (const uint8_t*)c->binary_ast;
+  if (!is_binary_ast(c->binary_ast, c->binary_ast_length))
+    damaged();
+  binary_ast_reader_t reader = {
+      .position = data + sizeof(BINARY_AST_MAGIC), .end = data + c->binary_ast_length};
+  header->version = read_number(&reader);
+  if (header->version != BINARY_AST_VERSION)
+  {
+    compilation_error(
+        VSLC_ERROR_BINARY_AST, 0, "the binary syntax tree was written by another version of vslc");
+  }
+  header->root = read_number(&reader);
+  header->n_nodes = read_number(&reader);
+  header->n_list_children = read_number(&reader);
+  header->n_symbols = read_number(&reader);
+  header->n_names = read_number(&reader);
+  header->n_strings = read_number(&reader);
+  header->nodes_length = read_number(&reader);
+  header->symbols_length = read_number(&reader);
+  header->text_length = read_number(&reader);
+
+  binary_ast_layout_t layout;
+  layout.nodes = reader.position - data;
+  layout.end = c->binary_ast_length;
+  uint64_t rest = layout.end - layout.nodes;
+  if (header->nodes_length > rest || header->symbols_length > rest - header->nodes_length
+      || header->text_length != rest - header->nodes_length - header->symbols_length)
+    damaged();
+  layout.symbols = layout.nodes + header->nodes_length;
+  layout.text = layout.symbols + header->symbols_length;
+
+  // Every name and string takes at least its NUL byte
+  if (header->n_nodes == 0 || header->n_nodes > UINT32_MAX
+      || header->n_nodes - 1 > header->nodes_length / 2
+      || header->n_list_children > header->nodes_length
+      || header->n_symbols > header->symbols_length / 2 || header->root == NO_NODE
+      || header->root >= header->n_nodes || header->n_names > header->text_length
+      || header->n_strings > header->text_length - header->n_names)
+    damaged();
+  return layout;
+}
+
+// Reads node id of the file, as it was written, into node. The children of a LIST node are read
+// into list_children from list_start, unless list_children is NULL, and list_start moves past them.
+// Numbers that do not fit where they go are reported as damage here, and the rest is checked by
+// load_binary_ast
+static void read_node(binary_ast_reader_t* reader, node_id_t id, const binary_ast_header_t* header,
+                      node_t* node, node_id_t* list_children, uint64_t* list_start)
+{
+  memset(node, 0, sizeof(node_t));
+  uint64_t type = read_number(reader);
+  uint64_t n_children = read_number(reader);
+  if (type >= NODE_TYPE_COUNT
+      || (type == LIST ? n_children > header->n_list_children - *list_start
+                       : n_children > NODE_INLINE_CHILDREN))
+    damaged();
+  node->type = type;
+  node->n_children = n_children;
+
+  node_id_t* children = node->inline_children;
+  if (type == LIST)
+  {
+    node->list.start = *list_start;
+    node->list.capacity = n_children;
+    children = list_children == NULL ? NULL : &list_children[*list_start];
+    *list_start += n_children;
+  }
+  if (type == IDENTIFIER)
+  {
+    node->data.string_list_index = read_number(reader);
+    uint64_t symbol = read_number(reader);
+    if (symbol > header->n_symbols)
+      damaged();
+    node->inline_children[0] = symbol;
+  }
+  else
+  {
+    for (size_t i = 0; i < n_children; i++)
+    {
+      uint64_t distance = read_number(reader);
+      if (distance >= header->n_nodes - id)
+        damaged();
+      if (children != NULL)
+        children[i] = distance == 0 ? NO_NODE : id + distance;
+    }
+  }
+
+  uint64_t number;
+  switch (type)
+  {
+  case OPERATOR:
+    number = read_number(reader);
+    if (number >= OPERATOR_TYPE_COUNT)
+      damaged();
+    node->data.operator = number;
+    break;
+  case NUMBER_LITERAL:
+    number = read_number(reader);
+    node->data.number_literal = (int64_t)((number >> 1) ^ (0 - (number & 1)));
+    break;
+  case STRING_LIST_REFERENCE:
+    node->data.string_list_index = read_number(reader);
+    break;
+  default:
+    break;
+  }
+}
+
+// Reads a number written by write_number, and reports it as damage if it goes past the end of
+// the section, or does not fit in 64 bits
+static uint64_t read_number(binary_ast_reader_t* reader)
+{
+  uint64_t value = 0;
+  for (unsigned shift = 0; shift < 64; shift += 7)
+  {
+    if (reader->position == reader->end)
+      damaged();
+    uint8_t byte = *reader->position++;
+    if (shift == 63 && byte > 1)
+      damaged();
+    value |= (uint64_t)(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0)
+      return value;
+  }
+  damaged();
+}
+
+// Writes the number 7 bits at a time, lowest first, in bytes whose top bit says if more follow.
+// The file reads the same on every machine, and small numbers take a single byte
+static void write_number(sink_t* sink, uint64_t value)
+{
+  char bytes[10];
+  size_t length = 0;
+  do
+  {
+    bytes[length] = value & 0x7f;
+    value >>= 7;
+    if (value != 0)
+      bytes[length] |= 0x80;
+    length++;
+  } while (value != 0);
+  sink_write(sink, bytes, length);
+}
+
+// Writes a child of the parent as how far after the parent it comes, or 0 if it is missing
+static void write_child(sink_t* sink, node_id_t parent, node_id_t child)
+{
+  write_number(sink, child == NO_NODE ? 0 : child - parent);
+}
+
+// Doubles the number of buckets, and moves every entry to its bucket in the new array
+static void position_map_grow(position_map_t* map)
+{
+  position_entry_t* old_buckets = map->buckets;
+  size_t old_n_buckets = map->n_buckets;
+  map->n_buckets = old_n_buckets == 0 ? 64 : old_n_buckets * 2;
+  map->buckets = calloc(map->n_buckets, sizeof(position_entry_t));
+
+  size_t mask = map->n_buckets - 1;
+  for (size_t i = 0; i < old_n_buckets; i++)
+  {
+    if (old_buckets[i].key == NULL)
+      continue;
+    const void* key = old_buckets[i].key;
+    size_t bucket = hash_string((const char*)&key, sizeof(key)) & mask;
+    while (map->buckets[bucket].key != NULL)
+      bucket = (bucket + 1) & mask;
+    map->buckets[bucket] = old_buckets[i];
+  }
+  free(old_buckets);
+}
+
+// Returns the position of the key. If the key is not in the map, it is added with the given
+// position, which is returned
+static uint32_t position_map_get(position_map_t* map, const void* key, uint32_t position)
+{
+  if ((map->n_entries + 1) * 2 > map->n_buckets)
+    position_map_grow(map);
+
+  size_t mask = map->n_buckets - 1;
+  size_t bucket = hash_string((const char*)&key, sizeof(key)) & mask;
+  for (; map->buckets[bucket].key != NULL; bucket = (bucket + 1) & mask)
+    if (map->buckets[bucket].key == key)
+      return map->buckets[bucket].position;
+
+  map->buckets[bucket] = (position_entry_t){.key = key, .position = position};
+  map->n_entries++;
+  return position;
+}
+
+// Returns the name of the symbol of the given type defined by the node, like find_globals and
+// bind_names find it. Returns NULL if such a symbol can not be defined by the node
+static const char* defined_name(node_t* node, symtype_t type)
+{
+  node_t* identifier = node;
+  if (type == SYMBOL_FUNCTION || type == SYMBOL_GLOBAL_ARRAY)
+  {
+    node_type_t defining_type = type == SYMBOL_FUNCTION ? FUNCTION : ARRAY_INDEXING;
+    if (node->type != defining_type || node->n_children == 0)
+      return NULL;
+    identifier = node_child(node, 0);
+  }
+
+  if (identifier == NULL || identifier->type != IDENTIFIER)
+    return NULL;
+  return identifier->data.identifier;
+}
+
+// Reports a binary syntax tree that does not hold what its header says
+static _Noreturn void damaged(void)
+{
+  compilation_error(VSLC_ERROR_BINARY_AST, 0, "the binary syntax tree is damaged");
+}
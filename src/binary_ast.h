@@ -0,0 +1,44 @@
+#ifndef BINARY_AST_H
+#define BINARY_AST_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// A binary syntax tree holds a program after constant folding, removing unreachable code and
+// binding names: its nodes, identifiers, string list and symbol tables. A compilation can load it
+// instead of parsing the program again, and go straight to printing tables or generating code.
+//
+// The file starts with a magic, followed by a header and these sections. Every number is written
+// 7 bits at a time, lowest first, in bytes whose top bit says if more follow, so the file reads
+// the same on every machine, whatever the layout of node_t, and small numbers take one byte:
+//  - The nodes, numbered from 1 in the order they appear in the program, each as its type, its
+//    number of children, then its children and data. A child always comes after its parent, and
+//    is written as how far after it comes, or 0 if it is missing, so the tree can not have cycles.
+//    IDENTIFIER nodes have the position of their name among the names in the text instead of
+//    children, and one more than the position of their symbol among the symbols, or 0.
+//  - The symbols, with the node that defines them and their type. Every function is followed by
+//    the symbols of its own symbol table, and all symbols are in order of sequence number.
+//  - The names, followed by the strings of the string list, each ending with a NUL byte.
+//
+// The header holds the counts of everything, and the length of each section. Loading decodes the
+// nodes and list children into the pools of the compilation, and every name is interned only once.
+// Every position and count in the file is checked, so a damaged file is reported as an error,
+// instead of being read out of bounds.
+
+// Returns true if the data starts like a binary syntax tree, and not like a VSL program
+bool is_binary_ast(const char* data, size_t length);
+
+// Writes the syntax tree, string list and symbol tables of the active compilation to its output,
+// as a binary syntax tree. Names must have been bound, by create_tables or bind_binary_ast
+void write_binary_ast(void);
+
+// Loads the syntax tree from compilation->binary_ast, as it was before names were bound.
+// STRING_LIST_REFERENCE nodes are turned back into STRING_LITERAL nodes, and IDENTIFIER nodes
+// have no symbols, so the tree prints like it did before it was written
+void load_binary_ast(void);
+
+// Restores the symbol tables of the binary syntax tree loaded by load_binary_ast, and binds the
+// nodes to them and to the string list, like create_tables does for a parsed program
+void bind_binary_ast(void);
+
+#endif // BINARY_AST_H
@@ -0,0 +1,127 @@
+#include "vslc.h"
+
+// Each thread has its own active compilation
+_Thread_local compilation_t* compilation = NULL;
+
+// Runs one phase of the compiler, and adds the time it took to the statistics of the compilation
+static void run_phase(compiler_phase_t phase, void (*function)(void))
+{
+  phase_timer_t timer = phase_start(phase);
+  function();
+  phase_stop(&timer);
+}
+
+static void produce_bound_outputs(int outputs);
+
+// Runs every phase of the compiler on the program read by the scanner
+void compile_program(yyscan_t scanner, int outputs)
+{
+  // Generated from grammar/bison, constructs syntax tree.
+  // yyerror only records syntax errors, so that bison can clean up before yyparse returns
+  phase_timer_t parse_timer = phase_start(PHASE_PARSE);
+  int parse_result = yyparse(scanner);
+  phase_stop(&parse_timer);
+  if (parse_result != 0)
+  {
+    vslc_error_t error = compilation->error;
+    compilation_error(error.kind, error.line, "%s", error.message);
+  }
+
+  // Operations in tree.c
+  if (outputs & VSLC_OUTPUT_AST)
+    run_phase(PHASE_PRINT, print_syntax_tree);
+
+  run_phase(PHASE_CONSTANT_FOLDING, constant_fold_syntax_tree);
+  run_phase(PHASE_UNREACHABLE_CODE, remove_unreachable_code_syntax_tree);
+
+  if (outputs & VSLC_OUTPUT_SIMPLIFIED_AST)
+    run_phase(PHASE_PRINT, print_syntax_tree);
+
+  // Operations in symbols.c
+  run_phase(PHASE_SYMBOL_TABLES, create_tables);
+  produce_bound_outputs(outputs);
+}
+
+// The binary syntax tree was simplified before it was written, so loading it takes the place of
+// parsing and simplifying. Binding it is only needed for the outputs that come after
+void compile_binary_ast(const char* data, size_t length, int outputs)
+{
+  if (outputs & VSLC_OUTPUT_AST)
+  {
+    compilation_error(
+        VSLC_ERROR_BINARY_AST, 0, "a binary syntax tree only holds the simplified syntax tree");
+  }
+
+  // Operations in binary_ast.c
+  compilation->binary_ast = data;
+  compilation->binary_ast_length = length;
+  run_phase(PHASE_LOAD_BINARY_AST, load_binary_ast);
+
+  if (outputs & VSLC_OUTPUT_SIMPLIFIED_AST)
+    run_phase(PHASE_PRINT, print_syntax_tree);
+  if ((outputs & ~VSLC_OUTPUT_SIMPLIFIED_AST) == 0)
+    return;
+
+  run_phase(PHASE_SYMBOL_TABLES, bind_binary_ast);
+  produce_bound_outputs(outputs);
+}
+
+// Produces the outputs that need the symbol tables, once names are bound
+static void produce_bound_outputs(int outputs)
+{
+  // Operations in symbols.c
+  if (outputs & VSLC_OUTPUT_SYMBOLS)
+    run_phase(PHASE_PRINT, print_tables);
+
+  // Operations in binary_ast.c
+  if (outputs & VSLC_OUTPUT_BINARY_AST)
+    run_phase(PHASE_PRINT, write_binary_ast);
+
+  // Operations in ir.c
+  if (outputs & VSLC_OUTPUT_IR)
+    run_phase(PHASE_PRINT, print_ir);
+
+  // Operations in generator.c
+  if (outputs & VSLC_OUTPUT_ASSEMBLY)
+    run_phase(PHASE_CODE_GENERATION, generate_program);
+}
+
+// Frees everything the phases of the compiler have allocated so far
+void destroy_compilation(void)
+{
+  destroy_tables();       // In symbols.c
+  destroy_syntax_tree();  // In tree.c
+  destroy_intern_table(); // In intern.c
+
+  destroy_function_cache(); // In function_cache.c
+
+  // Scratch space of generator.c
+  free(compilation->operand_buffer);
+  compilation->operand_buffer = NULL;
+  compilation->operand_buffer_capacity = 0;
+  destroy_ir();                  // In ir.c
+  destroy_ssa();                 // In ssa.c
+  destroy_register_allocation(); // In register_allocation.c
+  destroy_peephole();            // In peephole.c
+}
+
+// Records the error in the active compilation, and leaves the compilation
+void compilation_error(vslc_error_kind_t kind, int line, const char* format, ...)
+{
+  vslc_error_t* error = &compilation->error;
+  error->kind = kind;
+  error->line = line;
+
+  va_list arguments;
+  va_start(arguments, format);
+  vsnprintf(error->message, sizeof(error->message), format, arguments);
+  va_end(arguments);
+
+  if (compilation->error_handler != NULL)
+    longjmp(*compilation->error_handler, 1);
+
+  // Output produced before the error is still written, like it was when printing through stdio
+  sink_flush(&compilation->output);
+  fprintf(stderr, "error: %s\n", error->message);
+  exit(EXIT_FAILURE);
+}
@@ -0,0 +1,155 @@
+#ifndef COMPILATION_H
+#define COMPILATION_H
+
+#include "arena.h"
+#include "function_cache.h"
+#include "intern.h"
+#include "ir.h"
+#include "libvslc.h"
+#include "peephole.h"
+#include "register_allocation.h"
+#include "sink.h"
+#include "ssa.h"
+#include "symbol_table.h"
+#include "time_report.h"
+#include <setjmp.h>
+#include <stddef.h>
+#include <stdio.h>
+
+// All state belonging to the compilation of a single VSL program.
+// Every phase of the compiler works on the compilation that is active on the current thread,
+// so different threads can compile different programs at the same time.
+// A zero-initialized compilation_t is ready to use, once its output has been set.
+typedef struct compilation
+{
+  // All output of the compilation, be it syntax trees, symbol tables or assembly, goes here
+  sink_t output;
+
+  // The first error of the compilation, filled in by compilation_error.
+  // If error_handler is set, compilation_error jumps to it, otherwise the process exits
+  vslc_error_t error;
+  jmp_buf* error_handler;
+
+  // The syntax tree. All of its nodes are kept next to each other in one pool, and the children
+  // of LIST nodes in another. Strings in the tree are allocated from the arena. Used by tree.c
+  node_id_t root;
+  node_t* nodes;
+  size_t n_nodes; // Including the unused node at position 0
+  size_t nodes_capacity;
+  node_id_t* list_children;
+  size_t list_children_length;
+  size_t list_children_capacity;
+  arena_t tree_arena;
+
+  // The binary syntax tree the program is loaded from, if it is not parsed. Not owned.
+  // Used by binary_ast.c
+  const char* binary_ast;
+  size_t binary_ast_length;
+
+  // The stack used by all passes over the syntax tree, instead of recursion. See tree.h
+  tree_walk_stack_t tree_walk;
+
+  // Canonical copies of all identifiers in the program. Used by intern.c
+  intern_table_t intern_table;
+
+  // The global symbol table, which owns all other symbol tables. Used by symbols.c
+  struct symbol_table* global_symbols;
+
+  // The list of all distinct strings in the program, and a hashmap from each string to its
+  // position in the list. Used by symbols.c
+  char** string_list;
+  size_t string_list_len;
+  size_t string_list_capacity;
+  struct string_pool_bucket* string_pool;
+  size_t string_pool_n_buckets;
+  // Set when two strings have the same hash, so their labels are numbered instead.
+  // Used by generator.c
+  bool string_labels_by_position;
+
+  // Bindings shadowed by the scopes bind_names is currently inside of. Used by symbols.c
+  struct shadowed_binding* scope_log;
+  size_t scope_log_length;
+  size_t scope_log_capacity;
+
+  // Counters for the work done by all symbol hashmaps. Used by symbol_table.c
+  symbol_hashmap_statistics_t hashmap_statistics;
+
+  // Time spent in each phase, and counters for the work done. See time_report.h
+  compilation_statistics_t statistics;
+
+  // The function currently being generated, its IR, and where its virtual registers are kept.
+  // Used by generator.c
+  struct symbol* current_function;
+  ir_function_t ir;
+  ssa_t ssa; // Scratch space for numbering the values of the IR
+  char* operand_buffer; // Room for formatting an operand or label
+  size_t operand_buffer_capacity;
+  register_allocation_t register_allocation;
+  peephole_t peephole; // The code of the function, while it is collected and rewritten
+  size_t n_threads; // Functions simplified or generated at once, on as many threads. 0 means 1
+
+  // Code of functions kept from earlier compilations. See function_cache.h
+  function_cache_t function_cache;
+} compilation_t;
+
+// The compilation that is active on this thread, or NULL
+extern _Thread_local compilation_t* compilation;
+
+// Returns the node with the given id in the syntax tree of the active compilation,
+// or NULL for NO_NODE. Only valid until the next node is created, since the pool may move
+static inline node_t* node_at(node_id_t id)
+{
+  return id == NO_NODE ? NULL : &compilation->nodes[id];
+}
+
+// Returns the id of the given node, or NO_NODE for NULL
+static inline node_id_t node_id(const node_t* node)
+{
+  return node == NULL ? NO_NODE : (node_id_t)(node - compilation->nodes);
+}
+
+// Returns the ids of the children of the given node, wherever they are kept
+static inline node_id_t* node_children(node_t* node)
+{
+  if (node->type == LIST)
+    return &compilation->list_children[node->list.start];
+  return node->inline_children;
+}
+
+// Returns child number i of the given node, or NULL if the child is missing
+static inline node_t* node_child(node_t* node, size_t i)
+{
+  return node_at(node_children(node)[i]);
+}
+
+// Replaces child number i of the given node. The child may be NULL
+static inline void node_set_child(node_t* node, size_t i, node_t* child)
+{
+  node_children(node)[i] = node_id(child);
+}
+
+// The state of a reentrant flex scanner. Each compilation uses its own
+#ifndef YY_TYPEDEF_YY_SCANNER_T
+#define YY_TYPEDEF_YY_SCANNER_T
+typedef void* yyscan_t;
+#endif
+
+// Parses the program read by the scanner, and produces the given combination of vslc_output_t
+// outputs in the active compilation. Errors are reported with compilation_error
+void compile_program(yyscan_t scanner, int outputs);
+
+// Loads the program from the given binary syntax tree, see binary_ast.h, and produces the given
+// combination of vslc_output_t outputs like compile_program. The data is not used after it returns
+void compile_binary_ast(const char* data, size_t length, int outputs);
+
+// Frees the syntax tree, symbol tables and intern table of the active compilation.
+// Safe to call after any error, no matter how far the compilation got
+void destroy_compilation(void);
+
+// Reports an error in the program being compiled, formatted like printf.
+// Fills in the error of the active compilation, and jumps to its error handler.
+// Without an error handler, the message is printed to stderr, and the process exits.
+_Noreturn void compilation_error(vslc_error_kind_t kind, int line, const char* format, ...)
+    __attribute__((format(printf, 3, 4)));
+
+#endif // COMPILATION_H
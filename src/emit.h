@@ -21,28 +21,56 @@
 #define R15 "%r15" // callee saved
 #define RIP "%rip"
 
+// The lowest byte of each register, as set by the SETcc-family of instructions
+#define BL "%bl"
+#define CL "%cl"
+#define DL "%dl"
+#define SIL "%sil"
+#define DIL "%dil"
+#define R8B "%r8b"
+#define R9B "%r9b"
+#define R10B "%r10b"
+#define R11B "%r11b"
+#define R12B "%r12b"
+#define R13B "%r13b"
+#define R14B "%r14b"
+#define R15B "%r15b"
+
 #define MEM(reg) "(" reg ")"
 #define ARRAY_MEM(array, index, stride) "(" array "," index "," stride ")"
 
-#define DIRECTIVE(fmt, ...) printf(fmt "\n" __VA_OPT__(, ) __VA_ARGS__)
-#define LABEL(name, ...) printf(name ":\n" __VA_OPT__(, ) __VA_ARGS__)
-#define EMIT(fmt, ...) printf("\t" fmt "\n" __VA_OPT__(, ) __VA_ARGS__)
+// All assembly is written to the output sink of the active compilation, see sink.h.
+// DIRECTIVE, LABEL and EMIT take a format string, which may only use the conversions
+// understood by sink_printf. EMIT and EMITn count the instructions for the time report
+#define DIRECTIVE(fmt, ...) sink_printf(&compilation->output, fmt "\n" __VA_OPT__(, ) __VA_ARGS__)
+#define LABEL(name, ...) sink_printf(&compilation->output, name ":\n" __VA_OPT__(, ) __VA_ARGS__)
+#define EMIT(fmt, ...)                      \
+  (compilation->statistics.n_instructions++, \
+   sink_printf(&compilation->output, "\t" fmt "\n" __VA_OPT__(, ) __VA_ARGS__))
+
+// Instructions with up to two string operands are written piece by piece, without a format string
+#define EMIT2(mnemonic, op1, op2)           \
+  (compilation->statistics.n_instructions++, \
+   sink_instruction(&compilation->output, (mnemonic), (op1), (op2)))
+#define EMIT1(mnemonic, op) EMIT2(mnemonic, op, NULL)
+#define EMIT0(mnemonic) EMIT2(mnemonic, NULL, NULL)
 
-#define MOVQ(src, dst) EMIT("movq %s, %s", (src), (dst))
-#define PUSHQ(src) EMIT("pushq %s", (src))
-#define POPQ(src) EMIT("popq %s", (src))
+#define MOVQ(src, dst) EMIT2("movq", (src), (dst))
+#define PUSHQ(src) EMIT1("pushq", (src))
+#define POPQ(src) EMIT1("popq", (src))
 
-#define ADDQ(src, dst) EMIT("addq %s, %s", (src), (dst))
-#define SUBQ(src, dst) EMIT("subq %s, %s", (src), (dst))
-#define NEGQ(reg) EMIT("negq %s", (reg))
+#define ADDQ(src, dst) EMIT2("addq", (src), (dst))
+#define SUBQ(src, dst) EMIT2("subq", (src), (dst))
+#define NEGQ(reg) EMIT1("negq", (reg))
+#define XCHGQ(op1, op2) EMIT2("xchgq", (op1), (op2))
 
-#define IMULQ(src, dst) EMIT("imulq %s, %s", (src), (dst))
-#define CQO EMIT("cqo");                 // Sign extend RAX -> RDX:RAX
-#define IDIVQ(by) EMIT("idivq %s", (by)) // Divide RDX:RAX by "by", store result in RAX
+#define IMULQ(src, dst) EMIT2("imulq", (src), (dst))
+#define CQO EMIT0("cqo");              // Sign extend RAX -> RDX:RAX
+#define IDIVQ(by) EMIT1("idivq", (by)) // Divide RDX:RAX by "by", store result in RAX
 
-#define RET EMIT("ret")
+#define RET EMIT0("ret")
 
-#define CMPQ(op1, op2) EMIT("cmpq %s, %s", (op1), (op2)) // Compare the two operands
+#define CMPQ(op1, op2) EMIT2("cmpq", (op1), (op2)) // Compare the two operands
 
 // The SETcc-family of instructions assigns either 0 or 1 to a byte register, based on a comparison.
 // The instruction immediately before the SETcc should be a
@@ -50,25 +78,25 @@
 // The suffix given to SET, the "cc" part of "setcc", is the "condition code".
 // It determines the kind of comparison being done.
 // If the comparison is true, 1 is stored into "byte_reg". Otherwise 0 is stored.
-#define SETE(byte_reg) EMIT("sete %s", (byte_reg))   // Store result of op1 == op2
-#define SETNE(byte_reg) EMIT("setne %s", (byte_reg)) // Store result of op1 != op2
+#define SETE(byte_reg) EMIT1("sete", (byte_reg))   // Store result of op1 == op2
+#define SETNE(byte_reg) EMIT1("setne", (byte_reg)) // Store result of op1 != op2
 // NOTE: for inequality checks, the order of CMPQ's operands is the opposite of what you expect
 // The following inequalities are all for signed integer operands
-#define SETG(byte_reg) EMIT("setg %s", (byte_reg))   // Store result of op2 > op1
-#define SETGE(byte_reg) EMIT("setge %s", (byte_reg)) // Store result of op2 >= op1
-#define SETL(byte_reg) EMIT("setl %s", (byte_reg))   // Store result of op2 < op1
-#define SETLE(byte_reg) EMIT("setle %s", (byte_reg)) // Store result of op2 <= op1
+#define SETG(byte_reg) EMIT1("setg", (byte_reg))   // Store result of op2 > op1
+#define SETGE(byte_reg) EMIT1("setge", (byte_reg)) // Store result of op2 >= op1
+#define SETL(byte_reg) EMIT1("setl", (byte_reg))   // Store result of op2 < op1
+#define SETLE(byte_reg) EMIT1("setle", (byte_reg)) // Store result of op2 <= op1
 
 // Since set*-instructions assign to a byte register, we must extend the byte to fill
 // an entire 64-bit register, using movzbq (move Zero-extend Byte to Quadword).
 #define MOVZBQ(byte_reg, full_reg) \
-  EMIT("movzbq %s, %s", (byte_reg), (full_reg)) // full_reg <- byte_reg
+  EMIT2("movzbq", (byte_reg), (full_reg)) // full_reg <- byte_reg
 
-#define JNE(label) EMIT("jne %s", (label)) // Conditional jump (not equal)
-#define JMP(label) EMIT("jmp %s", (label)) // Unconditional jump
+#define JNE(label) EMIT1("jne", (label)) // Conditional jump (not equal)
+#define JMP(label) EMIT1("jmp", (label)) // Unconditional jump
 
 // Bitwise and
-#define ANDQ(src, dst) EMIT("andq %s, %s", (src), (dst))
+#define ANDQ(src, dst) EMIT2("andq", (src), (dst))
 
 // These directives are set based on platform,
 // allowing the compiler to work on macOS as well.
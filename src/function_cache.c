@@ -0,0 +1,288 @@
+#include "vslc.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Starts every key. Change it whenever the code generated for a function changes,
+// so that entries made by older versions of the compiler are never used
+#define FUNCTION_CACHE_FORMAT "vslc function cache 8"
+
+// Ends every key, before the code in an entry
+#define FUNCTION_CACHE_KEY_END "\nCODE\n"
+
+// Looking up a function costs a few system calls. Functions with fewer nodes than this are
+// cheaper to generate again, and are left out of the cache
+#define FUNCTION_CACHE_MIN_NODES 128
+
+// Room for the path of an entry, or of its temporary file, after the directory
+#define ENTRY_NAME_CAPACITY 32
+
+static size_t write_function_key(sink_t* key, symbol_t* function);
+static void stop_collecting(void);
+static char* entry_path(const char* suffix);
+static char* read_entry(const char* path, size_t* length);
+static void write_entry(const char* path);
+static bool write_all(int fd, const char* data, size_t length);
+
+/* External interface */
+
+// The entry is only used if it starts with exactly the key of the function,
+// so functions whose keys have the same hash are never mixed up
+bool function_cache_lookup(symbol_t* function)
+{
+  function_cache_t* cache = &compilation->function_cache;
+  cache->key.length = 0;
+  cache->collecting = false;
+  if (write_function_key(&cache->key, function) < FUNCTION_CACHE_MIN_NODES)
+    return false;
+  cache->key_hash = hash_string(cache->key.buffer, cache->key.length);
+
+  char* path = entry_path("");
+  size_t entry_length;
+  char* entry = read_entry(path, &entry_length);
+  free(path);
+
+  if (entry != NULL && entry_length >= cache->key.length
+      && memcmp(entry, cache->key.buffer, cache->key.length) == 0)
+  {
+    sink_write(&compilation->output, entry + cache->key.length, entry_length - cache->key.length);
+    free(entry);
+    compilation->statistics.n_cache_hits++;
+    return true;
+  }
+  free(entry);
+
+  // Collect the code of the function, by swapping the output with the code sink of the cache
+  sink_t output = compilation->output;
+  compilation->output = cache->code;
+  cache->code = output;
+  cache->collecting = true;
+  compilation->statistics.n_cache_misses++;
+  return false;
+}
+
+// Writes the collected code to both the output and the cache
+void function_cache_store(void)
+{
+  function_cache_t* cache = &compilation->function_cache;
+  if (!cache->collecting)
+    return;
+  stop_collecting();
+
+  char* path = entry_path("");
+  write_entry(path);
+  free(path);
+  cache->code.length = 0;
+}
+
+// The code collected before the error is still written to the output, like it is without a cache
+void function_cache_abort(void)
+{
+  if (!compilation->function_cache.collecting)
+    return;
+  stop_collecting();
+  compilation->function_cache.code.length = 0;
+}
+
+// If an error happened while code was collected, the code sink holds the output of the
+// compilation, which is freed here along with the rest
+void destroy_function_cache(void)
+{
+  function_cache_t* cache = &compilation->function_cache;
+  sink_destroy(&cache->key);
+  sink_destroy(&cache->code);
+}
+
+/* Internal matters */
+
+// Swaps the output back, and writes the collected code to it
+static void stop_collecting(void)
+{
+  function_cache_t* cache = &compilation->function_cache;
+  sink_t code = compilation->output;
+  compilation->output = cache->code;
+  cache->code = code;
+  cache->collecting = false;
+
+  sink_write(&compilation->output, cache->code.buffer, cache->code.length);
+}
+
+// Appends a value to the key, as its bytes in memory
+#define KEY_WRITE(key, type, value)                                \
+  do                                                               \
+  {                                                                \
+    type key_value = (value);                                      \
+    sink_write((key), (const char*)&key_value, sizeof(key_value)); \
+  } while (false)
+
+// Appends a string to the key, including its NUL-terminator
+static void key_write_string(sink_t* key, const char* string)
+{
+  sink_write(key, string, strlen(string) + 1);
+}
+
+// Describes first the function itself, and then every node of its body in the order they appear
+// in the program, along with the number of children each node has. Identifiers are described by
+// the symbol they reference, and strings by their contents. Returns the number of nodes in the body
+static size_t write_function_key(sink_t* key, symbol_t* function)
+{
+  size_t n_locals = 0;
+  for (size_t i = 0; i < function->function_symtable->n_symbols; i++)
+    if (function->function_symtable->symbols[i]->type == SYMBOL_LOCAL_VAR)
+      n_locals++;
+
+  key_write_string(key, FUNCTION_CACHE_FORMAT);
+  key_write_string(key, function->name);
+  KEY_WRITE(key, uint32_t, node_child(function->node, 1)->n_children);
+  KEY_WRITE(key, uint64_t, n_locals);
+
+  tree_walk_stack_t* stack = &compilation->tree_walk;
+  size_t stack_base = stack->length;
+  size_t n_nodes = 0;
+
+  tree_walk_push(stack, node_child(function->node, 2), 0);
+  while (stack->length > stack_base)
+  {
+    node_t* node = tree_walk_top(stack)->node;
+    tree_walk_pop(stack);
+    n_nodes++;
+
+    // Statements removed by constant folding are left as NULL
+    if (node == NULL)
+    {
+      KEY_WRITE(key, uint8_t, NODE_TYPE_COUNT);
+      continue;
+    }
+
+    KEY_WRITE(key, uint8_t, node->type);
+    KEY_WRITE(key, uint32_t, node->n_children);
+    switch (node->type)
+    {
+    case OPERATOR:
+      KEY_WRITE(key, uint8_t, node->data.operator);
+      break;
+    case NUMBER_LITERAL:
+      KEY_WRITE(key, int64_t, node->data.number_literal);
+      break;
+    case STRING_LIST_REFERENCE:
+      key_write_string(key, compilation->string_list[node->data.string_list_index]);
+      break;
+    case IDENTIFIER:
+    {
+      // Declarations of local variables are not bound to their symbols
+      symbol_t* symbol = node->symbol;
+      key_write_string(key, node->data.identifier);
+      KEY_WRITE(key, uint8_t, symbol != NULL ? symbol->type : SYMBOL_LOCAL_VAR + 1);
+      if (symbol == NULL)
+        break;
+      KEY_WRITE(key, uint64_t, symbol->sequence_number);
+      if (symbol->type == SYMBOL_FUNCTION)
+        KEY_WRITE(key, uint32_t, node_child(symbol->node, 1)->n_children);
+      break;
+    }
+    default:
+      break;
+    }
+
+    // IDENTIFIER nodes use the space of their children for the symbol
+    if (node->type == IDENTIFIER)
+      continue;
+
+    // The children are pushed in reverse, so the first child is described first
+    node_id_t* children = node_children(node);
+    for (size_t i = node->n_children; i > 0; i--)
+      tree_walk_push(stack, node_at(children[i - 1]), 0);
+  }
+
+  sink_write(key, FUNCTION_CACHE_KEY_END, strlen(FUNCTION_CACHE_KEY_END));
+  return n_nodes;
+}
+
+// Returns the path of the entry with the hash of the current key, followed by the given suffix.
+// The path must be freed by the caller
+static char* entry_path(const char* suffix)
+{
+  function_cache_t* cache = &compilation->function_cache;
+  size_t capacity = strlen(cache->directory) + ENTRY_NAME_CAPACITY + strlen(suffix);
+  char* path = malloc(capacity);
+  snprintf(
+      path,
+      capacity,
+      "%s/%016llx.s%s",
+      cache->directory,
+      (unsigned long long)cache->key_hash,
+      suffix);
+  return path;
+}
+
+// Reads the whole entry at the given path, or returns NULL if there is none.
+// The entry must be freed by the caller
+static char* read_entry(const char* path, size_t* length)
+{
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0)
+  {
+    close(fd);
+    return NULL;
+  }
+
+  *length = file_stat.st_size;
+  char* entry = malloc(*length + 1);
+  size_t position = 0;
+  while (position < *length)
+  {
+    ssize_t n_read = read(fd, entry + position, *length - position);
+    if (n_read <= 0)
+    {
+      close(fd);
+      free(entry);
+      return NULL;
+    }
+    position += n_read;
+  }
+
+  close(fd);
+  return entry;
+}
+
+// Writes the current key and the collected code to a temporary file, which is then renamed to
+// the given path. If anything fails, the entry is not made
+static void write_entry(const char* path)
+{
+  function_cache_t* cache = &compilation->function_cache;
+  char* temporary_path = entry_path(".XXXXXX");
+  int fd = mkstemp(temporary_path);
+  if (fd < 0)
+  {
+    free(temporary_path);
+    return;
+  }
+
+  bool written = write_all(fd, cache->key.buffer, cache->key.length)
+                 && write_all(fd, cache->code.buffer, cache->code.length);
+  if (close(fd) != 0 || !written || rename(temporary_path, path) != 0)
+    unlink(temporary_path);
+  free(temporary_path);
+}
+
+// Writes all of the data to the file. Returns false if a write fails
+static bool write_all(int fd, const char* data, size_t length)
+{
+  while (length > 0)
+  {
+    ssize_t n_written = write(fd, data, length);
+    if (n_written < 0 && errno == EINTR)
+      continue;
+    if (n_written <= 0)
+      return false;
+    data += n_written;
+    length -= n_written;
+  }
+  return true;
+}
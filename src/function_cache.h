@@ -0,0 +1,54 @@
+#ifndef FUNCTION_CACHE_H
+#define FUNCTION_CACHE_H
+
+#include "sink.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// The function cache keeps the assembly of every function it has seen in a directory on disk,
+// so that unchanged functions are not generated again when a program is recompiled.
+//
+// A function is looked up by its key: a description of the simplified and bound function body,
+// together with everything its code depends on outside of it, such as the kinds and sequence
+// numbers of the symbols it references, and the parameter counts of the functions it calls.
+// Labels are numbered from 0 in every function, and strings are named after their text, so a
+// function keeps its key, and its code, when other functions change.
+//
+// Functions too small to be worth the lookup are not cached.
+// Entries are files named after the hash of the key, holding the key followed by the code.
+// They are written to a temporary file first, and renamed into place, so compilations running
+// at the same time never see half an entry. A directory that can not be read or written only
+// makes every lookup miss.
+
+// The function cache of one compilation. It is only used if the directory is set
+typedef struct function_cache
+{
+  const char* directory; // Not owned
+  sink_t key;            // The key of the function being generated
+  uint64_t key_hash;
+  // While the code of a missed function is collected, it is written to the output of the
+  // compilation as usual, and the real output is kept here instead
+  sink_t code;
+  bool collecting;
+} function_cache_t;
+
+struct symbol;
+
+// Looks up the code of the given function in the cache of the active compilation.
+// On a hit, the cached code is written to the output, and true is returned.
+// On a miss, the output is collected by the cache until function_cache_store is called.
+// Small functions are never cached, and always miss
+bool function_cache_lookup(struct symbol* function);
+
+// Adds the code generated since the last missed lookup to the cache, and writes it to the output.
+// Does nothing after a lookup of a small function
+void function_cache_store(void);
+
+// Stops collecting code after an error in a function that missed, without adding it to the cache
+void function_cache_abort(void);
+
+// Frees the buffers of the function cache of the active compilation
+void destroy_function_cache(void);
+
+#endif // FUNCTION_CACHE_H
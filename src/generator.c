@@ -1,25 +1,31 @@
 #include "vslc.h"
+#include <ctype.h>
 
-// This header defines a bunch of macros we can use to emit assembly to stdout
+// This header defines a bunch of macros we can use to emit assembly to the compilation's output
 #include "emit.h"
 
-// In the System V calling convention, the first 6 integer parameters are passed in registers
-#define NUM_REGISTER_PARAMS 6
-static const char *REGISTER_PARAMS[6] = {RDI, RSI, RDX, RCX, R8, R9};
+// In the System V calling convention, the first 6 integer parameters are passed in these registers
+static const char *REGISTER_PARAMS[NUM_REGISTER_PARAMS] = {RDI, RSI, RDX, RCX, R8, R9};
 
-// Takes in a symbol of type SYMBOL_FUNCTION, and returns how many parameters the function takes
-#define FUNC_PARAM_COUNT(func) ((func)->node->children[1]->n_children)
-
-// global counters for generating unique labels
-static size_t if_counter = 0;
-static size_t while_counter = 0;
-static size_t innermost_loop = 0;
+// The counters for generating unique labels are kept in the IR of the function, see ir.h.
+// Labels are numbered within each function, and named after it, such as .f.WHILE0, and strings
+// are named after a hash of their text, such as .string0123456789abcdef. This way, the code of a
+// function does not change when other functions do. See function_cache.h and string_label.
+// Every function is lowered to IR, and its instructions are selected from the IR once its virtual
+// registers have been given places by allocate_registers. %rax, %rdx and %r11 are scratch
+// registers, which no virtual register is kept in
 
 static void generate_stringtable(void);
+static bool string_hashes_collide(void);
+static const char *string_label(size_t position);
 static void generate_global_variables(void);
+static void generate_functions(size_t n_functions);
 static void generate_function(symbol_t *function);
-static void generate_expression(node_t *expression);
-static void generate_statement(node_t *node);
+static void generate_function_code(symbol_t *function);
+static void generate_parameters(ir_instruction_t *parameters, size_t n_parameters);
+static bool branches_on_result(ir_instruction_t *instruction, size_t block);
+static void generate_compare_and_branch(ir_instruction_t *instruction, size_t block);
+static void generate_instruction(ir_instruction_t *instruction, size_t block);
 static void generate_main(symbol_t *first);
 
 // Entry point for code generation
@@ -29,26 +35,123 @@ void generate_program(void)
   generate_global_variables();
 
   DIRECTIVE(".text");
+  symbol_table_t *global_symbols = compilation->global_symbols;
   symbol_t *first_function = NULL;
+  size_t n_functions = 0;
   for (size_t i = 0; i < global_symbols->n_symbols; i++)
   {
-    symbol_t *symbol = global_symbols->symbols[i];
-    if (symbol->type != SYMBOL_FUNCTION)
+    if (global_symbols->symbols[i]->type != SYMBOL_FUNCTION)
       continue;
-    if (!first_function)
-      first_function = symbol;
-    generate_function(symbol);
+    if (first_function == NULL)
+      first_function = global_symbols->symbols[i];
+    n_functions++;
   }
 
+  generate_functions(n_functions);
+
   if (first_function == NULL)
+    compilation_error(VSLC_ERROR_SEMANTIC, 0, "program contained no functions");
+  generate_main(first_function);
+}
+
+// A string of the program, as the sequence of characters it stands for in the assembly.
+// A character is either written as itself, or as an escape sequence such as \n, \" or \101
+typedef struct string_characters
+{
+  size_t position;     // In the string list
+  const char *text;    // Without the surrounding quotation marks
+  size_t *starts;      // Where each character starts in the text, followed by the end of the text
+  size_t n_characters;
+} string_characters_t;
+
+// Returns the length of the character at the start of the text, as the assembler reads it.
+// Escape sequences are a backslash followed by one character, up to three octal digits,
+// or an x and any number of hexadecimal digits
+static size_t character_length(const char *text, size_t length)
+{
+  if (text[0] != '\\' || length < 2)
+    return 1;
+  size_t character = 2;
+  if (text[1] >= '0' && text[1] <= '7')
+    while (character < 4 && character < length && text[character] >= '0' && text[character] <= '7')
+      character++;
+  else if (text[1] == 'x' || text[1] == 'X')
+    while (character < length && isxdigit((unsigned char)text[character]))
+      character++;
+  return character;
+}
+
+// Compares character i of string a with character j of string b, like strcmp
+static int compare_characters(
+    const string_characters_t *a, size_t i, const string_characters_t *b, size_t j)
+{
+  size_t a_length = a->starts[i + 1] - a->starts[i];
+  size_t b_length = b->starts[j + 1] - b->starts[j];
+  int order = memcmp(
+      a->text + a->starts[i], b->text + b->starts[j], a_length < b_length ? a_length : b_length);
+  if (order != 0)
+    return order;
+  return (a_length > b_length) - (a_length < b_length);
+}
+
+// Orders strings by their characters from the last to the first, for qsort.
+// Every string then comes right before the strings it is a suffix of, if there are any
+static int compare_reversed_strings(const void *a, const void *b)
+{
+  const string_characters_t *x = a, *y = b;
+  for (size_t i = 1; i <= x->n_characters && i <= y->n_characters; i++)
   {
-    fprintf(stderr, "error: program contained no functions\n");
-    exit(EXIT_FAILURE);
+    int order = compare_characters(x, x->n_characters - i, y, y->n_characters - i);
+    if (order != 0)
+      return order;
   }
-  generate_main(first_function);
+  return (x->n_characters > y->n_characters) - (x->n_characters < y->n_characters);
+}
+
+// Returns true if the characters of suffix are the last characters of string
+static bool is_suffix(const string_characters_t *suffix, const string_characters_t *string)
+{
+  if (suffix->n_characters > string->n_characters)
+    return false;
+  size_t offset = string->n_characters - suffix->n_characters;
+  for (size_t i = 0; i < suffix->n_characters; i++)
+    if (compare_characters(suffix, i, string, offset + i) != 0)
+      return false;
+  return true;
+}
+
+// Prints part of the text of a string, with the given directive
+static void generate_string_part(const char *directive, const char *text, size_t length)
+{
+  sink_printf(&compilation->output, "\t%s \"", directive);
+  sink_write(&compilation->output, text, length);
+  sink_puts(&compilation->output, "\"\n");
 }
 
-// Prints one .asciz entry for each string in the global string_list
+// Prints the last of the given strings, where each of the others is a suffix of the next.
+// Their labels are placed inside it, where their characters start
+static void generate_merged_strings(string_characters_t *strings, size_t n_strings)
+{
+  string_characters_t *longest = &strings[n_strings - 1];
+  size_t printed = 0;
+  for (size_t i = n_strings; i > 0; i--)
+  {
+    string_characters_t *string = &strings[i - 1];
+    size_t start = longest->starts[longest->n_characters - string->n_characters];
+    if (start > printed)
+    {
+      generate_string_part(".ascii", longest->text + printed, start - printed);
+      printed = start;
+    }
+    LABEL("%s", string_label(string->position));
+  }
+  generate_string_part(
+      ".asciz", longest->text + printed, longest->starts[longest->n_characters] - printed);
+}
+
+// Prints the strings used by printf and main, followed by all strings of the program.
+// The string list holds every string once. A string that is the end of a longer string is not
+// printed on its own, instead its label points into the longer string, like linkers merge tails
 static void generate_stringtable(void)
 {
   DIRECTIVE(".section %s", ASM_STRING_SECTION);
@@ -58,8 +161,50 @@ static void generate_stringtable(void)
   // This string is used by the entry point-wrapper
   DIRECTIVE("errout: .asciz \"%s\"", "Wrong number of arguments");
 
-  for (size_t i = 0; i < string_list_len; i++)
-    DIRECTIVE("string%ld: \t.asciz %s", i, string_list[i]);
+  // Code with hashed labels is neither reused from the cache nor kept in it, see string_label
+  if (string_hashes_collide())
+  {
+    compilation->string_labels_by_position = true;
+    compilation->function_cache.directory = NULL;
+  }
+
+  size_t n_strings = compilation->string_list_len;
+  size_t total_length = 0;
+  for (size_t i = 0; i < n_strings; i++)
+    total_length += strlen(compilation->string_list[i]);
+
+  // Split every string into characters. There is at most one per character of the text,
+  // plus one for the end of each string
+  string_characters_t *strings = malloc(n_strings * sizeof(string_characters_t));
+  size_t *starts = malloc((total_length + n_strings) * sizeof(size_t));
+  size_t *next_start = starts;
+  for (size_t i = 0; i < n_strings; i++)
+  {
+    const char *text = compilation->string_list[i] + 1;
+    size_t length = strlen(text) - 1;
+    string_characters_t *string = &strings[i];
+    *string = (string_characters_t){.position = i, .text = text, .starts = next_start};
+    for (size_t start = 0; start < length; start += character_length(text + start, length - start))
+      string->starts[string->n_characters++] = start;
+    string->starts[string->n_characters] = length;
+    next_start += string->n_characters + 1;
+  }
+
+  qsort(strings, n_strings, sizeof(string_characters_t), compare_reversed_strings);
+
+  // Strings that are a suffix of the next one are printed along with the first string after them
+  // that is not
+  size_t first = 0;
+  for (size_t i = 0; i < n_strings; i++)
+  {
+    if (i + 1 < n_strings && is_suffix(&strings[i], &strings[i + 1]))
+      continue;
+    generate_merged_strings(&strings[first], i + 1 - first);
+    first = i + 1;
+  }
+
+  free(strings);
+  free(starts);
 }
 
 // Prints .zero entries in the .bss section to allocate room for global variables and arrays
@@ -67,491 +212,821 @@ static void generate_global_variables(void)
 {
   DIRECTIVE(".section %s", ASM_BSS_SECTION);
   DIRECTIVE(".align 8");
-  for (size_t i = 0; i < global_symbols->n_symbols; i++)
+  for (size_t i = 0; i < compilation->global_symbols->n_symbols; i++)
   {
-    symbol_t *symbol = global_symbols->symbols[i];
+    symbol_t *symbol = compilation->global_symbols->symbols[i];
     if (symbol->type == SYMBOL_GLOBAL_VAR)
     {
       DIRECTIVE(".%s: \t.zero 8", symbol->name);
     }
     else if (symbol->type == SYMBOL_GLOBAL_ARRAY)
     {
-      if (symbol->node->children[1]->type != NUMBER_LITERAL)
-      {
-        fprintf(stderr, "error: length of array '%s' is not compile time known", symbol->name);
-        exit(EXIT_FAILURE);
-      }
-      int64_t length = symbol->node->children[1]->data.number_literal;
+      node_t *length_node = node_child(symbol->node, 1);
+      if (length_node->type != NUMBER_LITERAL)
+        compilation_error(
+            VSLC_ERROR_SEMANTIC, 0, "length of array '%s' is not compile time known", symbol->name);
+      int64_t length = length_node->data.number_literal;
       DIRECTIVE(".%s: \t.zero %ld", symbol->name, length * 8);
     }
   }
 }
 
-// Global variable used to make the functon currently being generated accessible from anywhere
-static symbol_t *current_function;
+// Functions are generated on several threads at once, if the compilation has more than one.
+// Each worker thread activates a compilation of its own, which shares the syntax tree, symbol
+// tables and strings of the program, but has its own output, tree walk stack, generator state and
+// statistics. The code of every function is kept in memory, and added to the output in the order
+// of the functions, so the output is the same no matter how many threads are used.
+typedef struct function_task
+{
+  symbol_t *function;
+  char *code; // Up to the error, if the function had one
+  size_t code_length;
+  vslc_error_t error; // error.kind is VSLC_OK if the function was generated
+} function_task_t;
+
+typedef struct function_tasks
+{
+  compilation_t *program;
+  function_task_t *tasks;
+  compilation_statistics_t *worker_statistics; // One for each worker
+} function_tasks_t;
+
+// Takes tasks from the pool, and generates their functions, until there are none left
+static void generate_function_tasks(work_pool_t *pool, size_t worker_index, void *argument)
+{
+  function_tasks_t *shared = argument;
+  compilation_t *program = shared->program;
+  jmp_buf error_handler;
+
+  // Everything generating a function changes is replaced with state of the worker's own
+  compilation_t state = *program;
+  sink_init(&state.output, NULL);
+  state.error = (vslc_error_t){.kind = VSLC_OK};
+  state.error_handler = &error_handler;
+  state.tree_walk = (tree_walk_stack_t){.frames = NULL, .length = 0, .capacity = 0};
+  state.operand_buffer = NULL;
+  state.operand_buffer_capacity = 0;
+  state.ir = (ir_function_t){.instructions = NULL};
+  state.ssa = (ssa_t){.order = NULL};
+  state.register_allocation = (register_allocation_t){.locations = NULL};
+  state.peephole = (peephole_t){.lines = NULL};
+  state.statistics = (compilation_statistics_t){0};
+  state.function_cache = (function_cache_t){.directory = program->function_cache.directory};
+
+  // Worker 0 runs on the thread of the program, whose compilation is active again afterwards
+  compilation_t *outer_compilation = compilation;
+  compilation = &state;
+  phase_timer_t timer = phase_start(PHASE_CODE_GENERATION);
+
+  size_t index;
+  while (work_pool_next(pool, worker_index, &index))
+  {
+    function_task_t *task = &shared->tasks[index];
+    if (setjmp(error_handler) == 0)
+      generate_function(task->function);
+    else
+    {
+      function_cache_abort();
+      task->error = state.error;
+    }
+    task->code = sink_take_buffer(&state.output, &task->code_length);
+  }
+
+  phase_stop(&timer);
+  shared->worker_statistics[worker_index] = state.statistics;
+
+  free(state.tree_walk.frames);
+  free(state.operand_buffer);
+  destroy_ir();
+  destroy_ssa();
+  destroy_register_allocation();
+  destroy_peephole();
+  destroy_function_cache();
+  sink_destroy(&state.output);
+  compilation = outer_compilation;
+}
+
+// Generates the n_functions functions of the global symbol table, in order, on up to
+// compilation->n_threads threads. If several functions have errors, the error of the first one
+// is reported, after the code of the functions before it.
+// Nothing allocated here may be left when an error leaves the compilation, which is why the
+// functions are not collected into a list of their own
+static void generate_functions(size_t n_functions)
+{
+  symbol_table_t *global_symbols = compilation->global_symbols;
+  size_t n_workers = compilation->n_threads < n_functions ? compilation->n_threads : n_functions;
+  if (n_workers <= 1)
+  {
+    for (size_t i = 0; i < global_symbols->n_symbols; i++)
+      if (global_symbols->symbols[i]->type == SYMBOL_FUNCTION)
+        generate_function(global_symbols->symbols[i]);
+    return;
+  }
+
+  function_tasks_t shared = {
+      .program = compilation,
+      .tasks = calloc(n_functions, sizeof(function_task_t)),
+      .worker_statistics = calloc(n_workers, sizeof(compilation_statistics_t))};
+  size_t n_tasks = 0;
+  for (size_t i = 0; i < global_symbols->n_symbols; i++)
+    if (global_symbols->symbols[i]->type == SYMBOL_FUNCTION)
+      shared.tasks[n_tasks++].function = global_symbols->symbols[i];
 
-// Prints the entry point. preamble, statements and epilouge of the given function
+  work_pool_run(n_functions, n_workers, generate_function_tasks, &shared);
+
+  // The time of worker 0 is already part of the phase, since it ran on this thread
+  compilation_statistics_t *statistics = &compilation->statistics;
+  for (size_t i = 0; i < n_workers; i++)
+  {
+    compilation_statistics_t *worker = &shared.worker_statistics[i];
+    statistics->n_ir_instructions += worker->n_ir_instructions;
+    statistics->n_values_reused += worker->n_values_reused;
+    statistics->n_instructions += worker->n_instructions;
+    for (size_t rule = 0; rule < PEEPHOLE_RULE_COUNT; rule++)
+      statistics->n_peephole_rewrites[rule] += worker->n_peephole_rewrites[rule];
+    statistics->n_cache_hits += worker->n_cache_hits;
+    statistics->n_cache_misses += worker->n_cache_misses;
+    if (i > 0)
+      statistics->phases[PHASE_CODE_GENERATION].cpu += worker->phases[PHASE_CODE_GENERATION].cpu;
+  }
+
+  vslc_error_t error = {.kind = VSLC_OK};
+  for (size_t i = 0; i < n_functions; i++)
+  {
+    function_task_t *task = &shared.tasks[i];
+    if (error.kind == VSLC_OK)
+    {
+      sink_write(&compilation->output, task->code, task->code_length);
+      error = task->error;
+    }
+    free(task->code);
+  }
+  free(shared.tasks);
+  free(shared.worker_statistics);
+
+  if (error.kind != VSLC_OK)
+    compilation_error(error.kind, error.line, "%s", error.message);
+}
+
+// Prints the code of the given function, or takes it from the function cache if there is one
 static void generate_function(symbol_t *function)
 {
+  bool use_cache = compilation->function_cache.directory != NULL;
+  if (use_cache && function_cache_lookup(function))
+    return;
+
+  generate_function_code(function);
+
+  if (use_cache)
+    function_cache_store();
+}
+
+// Prints the entry point, prologue, blocks and epilogue of the given function, from its IR.
+// The blocks are laid out in order, and a block jumping to the next one falls through to it.
+// A comparison only read by the branch after it jumps on its flags, without storing its result.
+// The code is collected and rewritten by the peephole optimizer before it is printed
+static void generate_function_code(symbol_t *function)
+{
+  compilation->current_function = function;
+  ir_lower_function(function);
+  allocate_registers();
+  ir_function_t *ir = &compilation->ir;
+  register_allocation_t *allocation = &compilation->register_allocation;
+
+  peephole_begin();
   LABEL(".%s", function->name);
-  current_function = function;
 
   PUSHQ(RBP);
   MOVQ(RSP, RBP);
 
-  // Up to 6 prameters have been passed in registers. Place them on the stack instead
-  for (size_t i = 0; i < FUNC_PARAM_COUNT(function) && i < NUM_REGISTER_PARAMS; i++)
-    PUSHQ(REGISTER_PARAMS[i]);
+  // Save the callee saved registers the function uses, and make room for its slots below them
+  for (size_t i = 0; i < allocation->n_saved_registers; i++)
+    PUSHQ(allocation->saved_registers[i]);
+  if (allocation->n_frame_slots > 0)
+    EMIT("subq $%zu, %s", allocation->n_frame_slots * 8, RSP);
 
-  // Now, for each local variable, push 8-byte 0 values to the stack
-  for (size_t i = 0; i < function->function_symtable->n_symbols; i++)
-    if (function->function_symtable->symbols[i]->type == SYMBOL_LOCAL_VAR)
-      PUSHQ("$0");
+  for (size_t b = 0; b < ir->n_blocks; b++)
+  {
+    ir_block_t *block = &ir->blocks[b];
+    // Nothing jumps to the entry block
+    if (b > 0)
+      LABEL(".%s.%s%zu", function->name, IR_BLOCK_NAMES[block->kind], (size_t)block->number);
 
-  generate_statement(function->node->children[2]);
+    size_t end = block->first_instruction + block->n_instructions;
+    for (size_t i = block->first_instruction; i < end; i++)
+    {
+      ir_instruction_t *instruction = &ir->instructions[i];
+      if (i + 1 < end && branches_on_result(instruction, b))
+      {
+        generate_compare_and_branch(instruction, b);
+        i++;
+        continue;
+      }
+      if (instruction->opcode != IR_PARAMETER)
+      {
+        generate_instruction(instruction, b);
+        continue;
+      }
+
+      // The entry block starts by reading the parameters, which is done all at once
+      size_t n_parameters = 1;
+      while (i + n_parameters < end && instruction[n_parameters].opcode == IR_PARAMETER)
+        n_parameters++;
+      generate_parameters(instruction, n_parameters);
+      i += n_parameters - 1;
+    }
+  }
 
   LABEL(".%s.epilogue", function->name);
-  // leaveq is written out manually, to increase clarity of what happens
-  MOVQ(RBP, RSP);
+  if (allocation->n_saved_registers == 0)
+    // leaveq is written out manually, to increase clarity of what happens
+    MOVQ(RBP, RSP);
+  else
+  {
+    // Restore the saved registers, which are right below %rbp
+    EMIT("leaq %d(%s), %s", -(int)allocation->n_saved_registers * 8, RBP, RSP);
+    for (size_t i = allocation->n_saved_registers; i > 0; i--)
+      POPQ(allocation->saved_registers[i - 1]);
+  }
   POPQ(RBP);
   RET;
+  peephole_end();
 }
 
-// Generates code for a function call, which can either be a statement or an expression
-static void generate_function_call(node_t *call)
+// Returns a buffer with room for an operand of the given length, plus its NUL-terminator.
+// The buffer belongs to the active compilation, and is reused for every operand
+static char *operand_buffer(size_t length)
 {
-  symbol_t *symbol = call->children[0]->symbol;
-  if (symbol->type != SYMBOL_FUNCTION)
+  compilation_t *c = compilation;
+  if (length + 1 > c->operand_buffer_capacity)
   {
-    fprintf(stderr, "error: '%s' is not a function\n", symbol->name);
-    exit(EXIT_FAILURE);
+    c->operand_buffer_capacity = (length + 1) * 2;
+    c->operand_buffer = realloc(c->operand_buffer, c->operand_buffer_capacity);
   }
+  return c->operand_buffer;
+}
 
-  node_t *argument_list = call->children[1];
+// Compares two hashes, for qsort
+static int compare_hashes(const void *a, const void *b)
+{
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+  return (x > y) - (x < y);
+}
 
-  size_t parameter_count = FUNC_PARAM_COUNT(symbol);
-  if (parameter_count != argument_list->n_children)
+// Returns true if two strings of the string list have the same hash.
+// The list holds every string once, so equal hashes always belong to different strings
+static bool string_hashes_collide(void)
+{
+  size_t n_strings = compilation->string_list_len;
+  uint64_t *hashes = malloc(n_strings * sizeof(uint64_t));
+  for (size_t i = 0; i < n_strings; i++)
   {
-    fprintf(
-        stderr,
-        "error: function '%s' expects '%zu' arguments, but '%zu' were given\n",
-        symbol->name,
-        parameter_count,
-        argument_list->n_children);
-    exit(EXIT_FAILURE);
+    const char *string = compilation->string_list[i];
+    hashes[i] = hash_string(string, strlen(string));
   }
+  qsort(hashes, n_strings, sizeof(uint64_t), compare_hashes);
 
-  // We evaluate all parameters from right to left, pushing them to the stack
-  for (int i = parameter_count - 1; i >= 0; i--)
-  {
-    generate_expression(argument_list->children[i]);
-    PUSHQ(RAX);
-  }
+  bool collide = false;
+  for (size_t i = 1; i < n_strings && !collide; i++)
+    collide = hashes[i] == hashes[i - 1];
+  free(hashes);
+  return collide;
+}
 
-  // Up to 6 parameters should be passed through registers instead. Pop them off the stack
-  for (size_t i = 0; i < parameter_count && i < NUM_REGISTER_PARAMS; i++)
+// Returns the label of the string at the given position in the string list.
+// The label is named after a hash of the text, not the position, since positions depend on the
+// strings of every function before it: a function keeps its code, and its entry in the function
+// cache, when strings are added elsewhere. The hash only depends on the text, so the labels are
+// the same in every compilation and for any number of threads. Should two strings of the program
+// have the same hash, generate_stringtable finds it first, and every label is numbered by its
+// position instead, such as .string3. Positions are unique, and the same for the same program,
+// but not across programs, so the function cache is not used for that program
+static const char *string_label(size_t position)
+{
+  static const char prefix[] = ".string";
+  char *label;
+  if (compilation->string_labels_by_position)
   {
-    POPQ(REGISTER_PARAMS[i]);
+    size_t length = sizeof(prefix) - 1 + 20;
+    label = operand_buffer(length);
+    snprintf(label, length + 1, "%s%zu", prefix, position);
+    return label;
   }
 
-  EMIT("call .%s", symbol->name);
-
-  // Now pop away any stack passed parameters still left on the stack, by moving %rsp upwards
-  if (parameter_count > NUM_REGISTER_PARAMS)
-  {
-    EMIT("addq $%zu, %s", (parameter_count - NUM_REGISTER_PARAMS) * 8, RSP);
-  }
+  const char *string = compilation->string_list[position];
+  size_t length = sizeof(prefix) - 1 + 16;
+  label = operand_buffer(length);
+  snprintf(
+      label,
+      length + 1,
+      "%s%016llx",
+      prefix,
+      (unsigned long long)hash_string(string, strlen(string)));
+  return label;
 }
 
-// Returns a string for accessing the quadword referenced by node
-static const char *generate_variable_access(node_t *node)
+// Returns the operand of the global variable, .name(%rip)
+static const char *global_operand(symbol_t *symbol)
 {
-  static char result[100];
+  static const char suffix[] = "(" RIP ")";
+  size_t name_length = strlen(symbol->name);
+  char *result = operand_buffer(1 + name_length + sizeof(suffix));
+  result[0] = '.';
+  memcpy(result + 1, symbol->name, name_length);
+  memcpy(result + 1 + name_length, suffix, sizeof(suffix));
+  return result;
+}
 
-  assert(node->type == IDENTIFIER);
+// Returns where the virtual register is kept, see register_allocation.h
+static const char *vreg_operand(ir_vreg_t vreg)
+{
+  return compilation->register_allocation.locations[vreg].operand;
+}
 
-  symbol_t *symbol = node->symbol;
-  switch (symbol->type)
-  {
-  case SYMBOL_GLOBAL_VAR:
-    snprintf(result, sizeof(result), ".%s(%s)", symbol->name, RIP);
-    return result;
-  case SYMBOL_LOCAL_VAR:
-  {
-    // If we have more than 6 parameters, subtract away the hole in the sequence numbers
-    int call_frame_offset = symbol->sequence_number;
-    if (FUNC_PARAM_COUNT(current_function) > NUM_REGISTER_PARAMS)
-      call_frame_offset -= FUNC_PARAM_COUNT(current_function) - NUM_REGISTER_PARAMS;
-    // The stack grows down, in multiples of 8, and sequence number 0 corresponds to -8
-    call_frame_offset = (-call_frame_offset - 1) * 8;
+// Returns true if the operand is a register, and not a quadword in memory
+static bool is_register(const char *operand)
+{
+  return operand[0] == '%';
+}
 
-    snprintf(result, sizeof(result), "%d(%s)", call_frame_offset, RBP);
-    return result;
-  }
-  case SYMBOL_PARAMETER:
-  {
-    int call_frame_offset;
-    // Handle the first 6 parameters differently
-    if (symbol->sequence_number < NUM_REGISTER_PARAMS)
-      // Move along down the stack, with parameter 0 at position -8(%rbp)
-      call_frame_offset = -(symbol->sequence_number + 1) * 8;
-    else
-      // Parameter 6 is at 16(%rbp), with further parameters moving up from there
-      call_frame_offset = 16 + (symbol->sequence_number - NUM_REGISTER_PARAMS) * 8;
+// Returns true if the value is the virtual register kept in the operand
+static bool value_in(ir_value_t value, const char *operand)
+{
+  return value.vreg != IR_NO_VREG && strcmp(vreg_operand(value.vreg), operand) == 0;
+}
 
-    snprintf(result, sizeof(result), "%d(%s)", call_frame_offset, RBP);
-    return result;
-  }
-  case SYMBOL_FUNCTION:
-    fprintf(stderr, "error: symbol '%s' is a function, not a variable\n", symbol->name);
-    exit(EXIT_FAILURE);
-  case SYMBOL_GLOBAL_ARRAY:
-    fprintf(stderr, "error: symbol '%s' is an array, not a variable\n", symbol->name);
-    exit(EXIT_FAILURE);
-  default:
-    assert(false && "Unknown variable symbol type");
-  }
+// Returns true if the constant fits in the 32-bit immediate operand of most instructions
+static bool fits_immediate(int64_t constant)
+{
+  return constant >= INT32_MIN && constant <= INT32_MAX;
 }
 
-/**
- * Takes in an ARRAY_INDEXING node, such as array[x]
- * The function emits code to evaluate x, which may clobber all registers.
- * Once x is evaluated, the address of array[x] is calculated, and stored in the RCX register.
- * The return value is the string "(%rcx)", the assembly for using RCX as an address.
- */
-static const char *generate_array_access(node_t *node)
+// Returns the register an instruction computes its result in: its dest if that is a register,
+// and %rax otherwise
+static const char *result_register(const char *dest)
 {
-  assert(node->type == ARRAY_INDEXING);
+  return is_register(dest) ? dest : RAX;
+}
 
-  symbol_t *symbol = node->children[0]->symbol;
-  if (symbol->type != SYMBOL_GLOBAL_ARRAY)
+// Moves a quadword between two operands, through %r11 if both are in memory
+static void move_operand(const char *source, const char *dest)
+{
+  if (strcmp(source, dest) == 0)
+    return;
+  if (!is_register(source) && !is_register(dest))
   {
-    fprintf(stderr, "error: symbol '%s' is not an array\n", symbol->name);
-    exit(EXIT_FAILURE);
+    MOVQ(source, R11);
+    source = R11;
   }
+  MOVQ(source, dest);
+}
 
-  // Calculate the index of the array into %rax
-  generate_expression(node->children[1]);
+// Moves the value into the operand
+static void move_value(ir_value_t value, const char *dest)
+{
+  if (value.vreg != IR_NO_VREG)
+    move_operand(vreg_operand(value.vreg), dest);
+  else if (is_register(dest) || fits_immediate(value.constant))
+    EMIT("movq $%ld, %s", value.constant, dest);
+  else
+  {
+    EMIT("movq $%ld, %s", value.constant, R11);
+    MOVQ(R11, dest);
+  }
+}
 
-  // Place the base of the array into %rcx
-  EMIT("leaq .%s(%s), %s", symbol->name, RIP, RCX);
+// Emits "mnemonic value, dest". The dest may only be in memory if the instruction allows it
+static void emit_with_value(const char *mnemonic, ir_value_t value, const char *dest)
+{
+  if (value.vreg == IR_NO_VREG && fits_immediate(value.constant))
+  {
+    EMIT("%s $%ld, %s", mnemonic, value.constant, dest);
+    return;
+  }
 
-  // Place the exact position of the element we wish to access, into %rcx
-  EMIT("leaq (%s, %s, 8), %s", RCX, RAX, RCX);
+  const char *source = value.vreg == IR_NO_VREG ? R11 : vreg_operand(value.vreg);
+  if (value.vreg == IR_NO_VREG || (!is_register(source) && !is_register(dest)))
+  {
+    move_value(value, R11);
+    source = R11;
+  }
+  EMIT2(mnemonic, source, dest);
+}
 
-  // Now, the address of the element is stored at %rcx, so just use MEM() to reference it
-  return MEM(RCX);
+// Returns an operand holding the value that is not a constant. Constants are moved to %rax
+static const char *non_constant_operand(ir_value_t value)
+{
+  if (value.vreg != IR_NO_VREG)
+    return vreg_operand(value.vreg);
+  move_value(value, RAX);
+  return RAX;
 }
 
-// Generates code to evaluate the expression, and place the result in %rax
-static void generate_expression(node_t *expression)
+// A move from a register, memory or constant to another register or memory
+typedef struct pending_move
 {
-  switch (expression->type)
-  {
-  case NUMBER_LITERAL:
-    // Simply place the number into %rax
-    EMIT("movq $%ld, %s", expression->data.number_literal, RAX);
-    break;
-  case IDENTIFIER:
-    // Load the variable, and put the result in RAX
-    MOVQ(generate_variable_access(expression), RAX);
-    break;
-  case ARRAY_INDEXING:
-    // Load the value pointed to by array[idx], and put the result in RAX
-    MOVQ(generate_array_access(expression), RAX);
-    break;
-  case OPERATOR:
+  const char *source; // NULL if the source is the constant
+  int64_t constant;
+  const char *dest;
+} pending_move_t;
+
+// Makes every move at once, as if every source was read before any dest is written.
+// A move waits while its dest is the source of another move. When every move waits, they form
+// cycles, and one of them is broken by moving the dest of a move to %rax before it is written
+static void move_in_parallel(pending_move_t *moves, size_t n_moves)
+{
+  while (n_moves > 0)
   {
-    const char *op = expression->data.operator;
-    if (strcmp(op, "+") == 0)
+    bool moved = false;
+    for (size_t i = 0; i < n_moves;)
     {
-      generate_expression(expression->children[0]);
-      PUSHQ(RAX);
-      generate_expression(expression->children[1]);
-      POPQ(RCX);
-      ADDQ(RCX, RAX);
-    }
-    else if (strcmp(op, "-") == 0)
-    {
-      if (expression->n_children == 1)
+      bool waits = false;
+      for (size_t j = 0; j < n_moves && !waits; j++)
+        waits = j != i && moves[j].source != NULL && strcmp(moves[j].source, moves[i].dest) == 0;
+      if (waits)
       {
-        // Unary minus
-        generate_expression(expression->children[0]);
-        NEGQ(RAX);
+        i++;
+        continue;
       }
+
+      if (moves[i].source == NULL)
+        move_value((ir_value_t){.vreg = IR_NO_VREG, .constant = moves[i].constant}, moves[i].dest);
       else
-      {
-        // Binary minus. Evaluate RHS first, to get the result in RAX easier
-        generate_expression(expression->children[1]);
-        PUSHQ(RAX);
-        generate_expression(expression->children[0]);
-        POPQ(RCX);
-        SUBQ(RCX, RAX);
-      }
-    }
-    else if (strcmp(op, "*") == 0)
-    {
-      // Multiplication does not need to do sign extend
-      generate_expression(expression->children[0]);
-      PUSHQ(RAX);
-      generate_expression(expression->children[1]);
-      POPQ(RCX);
-      IMULQ(RCX, RAX);
-    }
-    else if (strcmp(op, "/") == 0)
-    {
-      generate_expression(expression->children[1]);
-      PUSHQ(RAX);
-      generate_expression(expression->children[0]);
-      CQO; // Sign extend RAX -> RDX:RAX
-      POPQ(RCX);
-      IDIVQ(RCX); // Didivde RDX:RAX by RCX, placing the result in RAX
-    }
-    else if (strcmp(op, "==") == 0)
-    {
-      generate_expression(expression->children[0]);
-      PUSHQ(RAX);
-      generate_expression(expression->children[1]);
-      POPQ(RCX);
-      CMPQ(RAX, RCX);
-      SETE(AL);        // Store lhs == rhs into %al
-      MOVZBQ(AL, RAX); // Zero extend to all of %rax
-    }
-    else if (strcmp(op, "!=") == 0)
-    {
-      generate_expression(expression->children[0]);
-      PUSHQ(RAX);
-      generate_expression(expression->children[1]);
-      POPQ(RCX);
-      CMPQ(RAX, RCX);
-      SETNE(AL);       // Store lhs != rhs into %al
-      MOVZBQ(AL, RAX); // Zero extend to all of %rax
-    }
-    else if (strcmp(op, "<") == 0)
-    {
-      generate_expression(expression->children[0]);
-      PUSHQ(RAX);
-      generate_expression(expression->children[1]);
-      POPQ(RCX);
-      CMPQ(RAX, RCX);
-      SETL(AL);        // Store lhs < rhs into %al
-      MOVZBQ(AL, RAX); // Zero extend to all of %rax
-    }
-    else if (strcmp(op, "<=") == 0)
-    {
-      generate_expression(expression->children[0]);
-      PUSHQ(RAX);
-      generate_expression(expression->children[1]);
-      POPQ(RCX);
-      CMPQ(RAX, RCX);
-      SETLE(AL);       // Store lhs <= rhs into %al
-      MOVZBQ(AL, RAX); // Zero extend to all of %rax
-    }
-    else if (strcmp(op, ">") == 0)
-    {
-      generate_expression(expression->children[0]);
-      PUSHQ(RAX);
-      generate_expression(expression->children[1]);
-      POPQ(RCX);
-      CMPQ(RAX, RCX);
-      SETG(AL);        // Store lhs > rhs into %al
-      MOVZBQ(AL, RAX); // Zero extend to all of %rax
+        move_operand(moves[i].source, moves[i].dest);
+      moves[i] = moves[--n_moves];
+      moved = true;
     }
-    else if (strcmp(op, ">=") == 0)
-    {
-      generate_expression(expression->children[0]);
-      PUSHQ(RAX);
-      generate_expression(expression->children[1]);
-      POPQ(RCX);
-      CMPQ(RAX, RCX);
-      SETGE(AL);       // Store lhs >= rhs into %al
-      MOVZBQ(AL, RAX); // Zero extend to all of %rax
-    }
-    else if (strcmp(op, "!") == 0)
+
+    if (!moved)
     {
-      generate_expression(expression->children[0]);
-      CMPQ("$0", RAX);
-      SETE(AL);        // Store %rax == 0 into %al
-      MOVZBQ(AL, RAX); // Zero extend to all of %rax
+      const char *dest = moves[0].dest;
+      MOVQ(dest, RAX);
+      for (size_t j = 0; j < n_moves; j++)
+        if (moves[j].source != NULL && strcmp(moves[j].source, dest) == 0)
+          moves[j].source = RAX;
     }
-    else
-      assert(false && "Unknown expression operation");
-    break;
-  }
-  case FUNCTION_CALL:
-    generate_function_call(expression);
-    break;
-  default:
-    assert(false && "Unknown expression type");
   }
 }
 
-static void generate_assignment_statement(node_t *statement)
+// Returns the move of the value into the operand
+static pending_move_t move_of_value(ir_value_t value, const char *dest)
 {
-  node_t *dest = statement->children[0];
-  node_t *expression = statement->children[1];
+  if (value.vreg == IR_NO_VREG)
+    return (pending_move_t){.source = NULL, .constant = value.constant, .dest = dest};
+  return (pending_move_t){.source = vreg_operand(value.vreg), .dest = dest};
+}
 
-  // First the right hand side of the assignment is evaluated
-  generate_expression(expression);
+// Reads the given PARAMETER instructions. Up to 6 parameters are passed in registers, which may
+// be where other parameters are kept, so they are moved to their places at once. Parameters passed
+// on the stack are moved after them, unless they are kept where the caller put them
+static void generate_parameters(ir_instruction_t *parameters, size_t n_parameters)
+{
+  register_allocation_t *allocation = &compilation->register_allocation;
+  pending_move_t moves[NUM_REGISTER_PARAMS];
+  size_t n_moves = 0;
+  for (size_t i = 0; i < n_parameters; i++)
+  {
+    size_t parameter = parameters[i].parameter;
+    if (parameter < NUM_REGISTER_PARAMS)
+      moves[n_moves++] = (pending_move_t){
+          .source = REGISTER_PARAMS[parameter], .dest = vreg_operand(parameters[i].dest)};
+  }
+  move_in_parallel(moves, n_moves);
 
-  if (dest->type == IDENTIFIER)
-    // Store rax into the memory location corresponding to the variable
-    MOVQ(RAX, generate_variable_access(dest));
-  else
+  for (size_t i = 0; i < n_parameters; i++)
   {
-    assert(dest->type == ARRAY_INDEXING);
-    // Store rax until the final address of the array element is found,
-    // since array index calculation can potentially modify all registers
-    PUSHQ(RAX);
-    const char *dest_mem = generate_array_access(dest);
-    POPQ(RAX);
-    MOVQ(RAX, dest_mem);
+    size_t parameter = parameters[i].parameter;
+    if (parameter >= NUM_REGISTER_PARAMS)
+      move_operand(
+          allocation->frame_operands[parameter - NUM_REGISTER_PARAMS].text,
+          vreg_operand(parameters[i].dest));
   }
 }
 
-static void generate_print_statement(node_t *statement)
+// Pushes the value to the stack
+static void push_value(ir_value_t value)
 {
-  node_t *print_items = statement->children[0];
-  for (size_t i = 0; i < print_items->n_children; i++)
+  if (value.vreg == IR_NO_VREG && fits_immediate(value.constant))
+    EMIT("pushq $%ld", value.constant);
+  else if (value.vreg == IR_NO_VREG)
   {
-    node_t *item = print_items->children[i];
-    if (item->type == STRING_LIST_REFERENCE)
-    {
-      EMIT("leaq strout(%s), %s", RIP, RDI);
-      EMIT("leaq string%zu(%s), %s", (size_t)item->data.string_list_index, RIP, RSI);
-    }
-    else
-    {
-      generate_expression(item);
-      MOVQ(RAX, RSI);
-      EMIT("leaq intout(%s), %s", RIP, RDI);
-    }
-    EMIT("call safe_printf");
+    move_value(value, R11);
+    PUSHQ(R11);
   }
-
-  MOVQ("$'\\n'", RDI);
-  EMIT("call safe_putchar");
+  else
+    PUSHQ(vreg_operand(value.vreg));
 }
 
-static void generate_return_statement(node_t *statement)
+// Calls the function with the arguments of the instruction. Arguments after the sixth are pushed
+// to the stack, from the right, and the first 6 are moved to their registers at once
+static void generate_call(ir_instruction_t *instruction)
 {
-  generate_expression(statement->children[0]);
-  EMIT("jmp .%s.epilogue", current_function->name);
+  ir_function_t *ir = &compilation->ir;
+  size_t n_arguments = instruction->n_arguments;
+  ir_value_t *arguments = &ir->arguments[instruction->first_argument];
+
+  for (size_t i = n_arguments; i > NUM_REGISTER_PARAMS; i--)
+    push_value(arguments[i - 1]);
+
+  pending_move_t moves[NUM_REGISTER_PARAMS];
+  size_t n_moves = 0;
+  for (size_t i = 0; i < n_arguments && i < NUM_REGISTER_PARAMS; i++)
+    moves[n_moves++] = move_of_value(arguments[i], REGISTER_PARAMS[i]);
+  move_in_parallel(moves, n_moves);
+
+  EMIT("call .%s", instruction->symbol->name);
+
+  // Now pop away any stack passed parameters still left on the stack, by moving %rsp upwards
+  if (n_arguments > NUM_REGISTER_PARAMS)
+    EMIT("addq $%zu, %s", (n_arguments - NUM_REGISTER_PARAMS) * 8, RSP);
+
+  if (instruction->dest != IR_NO_VREG)
+    MOVQ(RAX, vreg_operand(instruction->dest));
 }
 
-static void generate_if_statement(node_t *statement)
+// The instruction of each arithmetic opcode other than division. For comparisons, it is the
+// instruction storing whether the comparison holds
+static const char *const OPCODE_INSTRUCTIONS[IR_OPCODE_COUNT] = {
+  [IR_ADD] = "addq",
+  [IR_SUBTRACT] = "subq",
+  [IR_MULTIPLY] = "imulq", // Multiplication does not need to do sign extend
+  [IR_EQUAL] = "sete",
+  [IR_NOT_EQUAL] = "setne",
+  [IR_LESS] = "setl",
+  [IR_LESS_EQUAL] = "setle",
+  [IR_GREATER] = "setg",
+  [IR_GREATER_EQUAL] = "setge",
+};
+
+// Adds, subtracts or multiplies. The result is computed in the dest, unless that is in memory, or
+// the rhs is kept there. Addition and multiplication then swap their operands instead
+static void generate_arithmetic(ir_instruction_t *instruction)
 {
-  // (2.1):
-  // Generate code for emitting both if-then statements, and if-then-else statements.
-  // Check the number of children to determine which.
-
-  // You will need to define your own unique labels for this if statement,
-  // so consider using a global variable as a counter to give each label a suffix unique to this if.
+  ir_value_t lhs = instruction->operands[0];
+  ir_value_t rhs = instruction->operands[1];
+  const char *dest = vreg_operand(instruction->dest);
+  if (instruction->opcode != IR_SUBTRACT && value_in(rhs, dest))
+  {
+    rhs = lhs;
+    lhs = instruction->operands[1];
+  }
 
-  size_t current_if_counter = if_counter++;
-  node_t *expression = statement->children[0];
-  node_t *then_statement = statement->children[1];
+  const char *result = value_in(rhs, dest) ? RAX : result_register(dest);
+  move_value(lhs, result);
+  emit_with_value(OPCODE_INSTRUCTIONS[instruction->opcode], rhs, result);
+  move_operand(result, dest);
+}
 
-  // if
-  generate_expression(expression);
-  CMPQ("$0", RAX);
-  EMIT("je .ELSE%zu", current_if_counter);
+// Divides the lhs by the rhs. idivq divides %rdx:%rax, and leaves the result in %rax
+static void generate_division(ir_instruction_t *instruction)
+{
+  ir_value_t divisor = instruction->operands[1];
+  move_value(instruction->operands[0], RAX);
+  CQO; // Sign extend RAX -> RDX:RAX
+  if (divisor.vreg == IR_NO_VREG)
+  {
+    move_value(divisor, R11);
+    IDIVQ(R11);
+  }
+  else
+    IDIVQ(vreg_operand(divisor.vreg));
+  move_operand(RAX, vreg_operand(instruction->dest));
+}
 
-  // then
-  generate_statement(then_statement);
-  EMIT("jmp .ENDIF%zu", current_if_counter);
+// Stores whether the comparison before holds into the dest, as 1 or 0, with the given SETcc
+static void store_condition(const char *setcc, ir_vreg_t dest)
+{
+  vreg_location_t *location = &compilation->register_allocation.locations[dest];
+  const char *byte_register = location->byte_register != NULL ? location->byte_register : AL;
+  const char *result = result_register(location->operand);
+  EMIT1(setcc, byte_register);
+  MOVZBQ(byte_register, result); // Zero extend to all of the register
+  move_operand(result, location->operand);
+}
 
-  // else
-  LABEL(".ELSE%zu", current_if_counter);
+// Returns the operand for the element of the array at the index. A constant index is added to
+// the address of the array. Otherwise, the address is placed in %r11, and the index is moved to
+// %rdx, unless it is kept in a register
+static const char *element_operand(symbol_t *array, ir_value_t index)
+{
+  if (index.vreg == IR_NO_VREG && index.constant >= 0 && index.constant <= INT32_MAX / 8)
+  {
+    size_t length = strlen(array->name) + 32;
+    char *result = operand_buffer(length);
+    snprintf(result, length + 1, ".%s+%ld(%s)", array->name, (long)index.constant * 8, RIP);
+    return result;
+  }
 
-  if (statement->n_children == 3)
+  const char *index_register = index.vreg == IR_NO_VREG ? RDX : vreg_operand(index.vreg);
+  if (!is_register(index_register) || index.vreg == IR_NO_VREG)
   {
-    node_t *else_statement = statement->children[2];
-    generate_statement(else_statement);
+    move_value(index, RDX);
+    index_register = RDX;
   }
+  EMIT("leaq .%s(%s), %s", array->name, RIP, R11);
 
-  // end
-  LABEL(".ENDIF%zu", current_if_counter);
+  size_t length = strlen(R11) + strlen(index_register) + 8;
+  char *result = operand_buffer(length);
+  snprintf(result, length + 1, "(%s, %s, 8)", R11, index_register);
+  return result;
 }
 
-static void generate_while_statement(node_t *statement)
+// Stores the value into the element of the array at the index
+static void generate_element_store(ir_instruction_t *instruction)
 {
-  // (2.2):
-  // Implement while loops, similarily to the way if statements were generated.
-  // Remember to make label names unique, and to handle nested while loops.
+  ir_value_t value = instruction->operands[1];
+  bool immediate = value.vreg == IR_NO_VREG && fits_immediate(value.constant);
+  const char *source = immediate ? NULL : non_constant_operand(value);
+  if (source != NULL && !is_register(source))
+  {
+    MOVQ(source, RAX);
+    source = RAX;
+  }
 
-  size_t current_while_counter = while_counter++;
-  node_t *expression = statement->children[0];
-  node_t *while_statement = statement->children[1];
+  const char *element = element_operand(instruction->symbol, instruction->operands[0]);
+  if (immediate)
+    EMIT("movq $%ld, %s", value.constant, element);
+  else
+    MOVQ(source, element);
+}
 
-  innermost_loop = current_while_counter;
+// Jumps to the block with the given conditional or unconditional jump instruction
+static void jump_to_block(const char *mnemonic, uint32_t target)
+{
+  ir_block_t *block = &compilation->ir.blocks[target];
+  EMIT(
+      "%s .%s.%s%zu",
+      mnemonic,
+      compilation->current_function->name,
+      IR_BLOCK_NAMES[block->kind],
+      (size_t)block->number);
+}
 
-  // while
-  LABEL(".WHILE%zu", current_while_counter);
-  generate_expression(expression);
-  CMPQ("$0", RAX);
-  EMIT("je .ENDWHILE%zu", current_while_counter);
+// The conditional jumps taken after the cmpq of each comparison, when the comparison holds and
+// when it does not. NOT and BRANCH compare their operand with 0, and hold when it is 0 and not 0
+static const char *const CONDITIONAL_JUMPS[IR_OPCODE_COUNT][2] = {
+  [IR_NOT] = {"je", "jne"},
+  [IR_EQUAL] = {"je", "jne"},
+  [IR_NOT_EQUAL] = {"jne", "je"},
+  [IR_LESS] = {"jl", "jge"},
+  [IR_LESS_EQUAL] = {"jle", "jg"},
+  [IR_GREATER] = {"jg", "jle"},
+  [IR_GREATER_EQUAL] = {"jge", "jl"},
+  [IR_BRANCH] = {"jne", "je"},
+};
+
+// Jumps to if_true if the flags say the comparison of the given opcode holds, and to if_false
+// otherwise. The block after this one is reached by falling through to it
+static void branch_on_flags(
+    ir_opcode_t comparison, uint32_t if_true, uint32_t if_false, uint32_t next_block)
+{
+  if (if_true == next_block)
+    jump_to_block(CONDITIONAL_JUMPS[comparison][1], if_false);
+  else
+  {
+    jump_to_block(CONDITIONAL_JUMPS[comparison][0], if_true);
+    if (if_false != next_block)
+      jump_to_block("jmp", if_false);
+  }
+}
 
-  // body
-  generate_statement(while_statement);
-  EMIT("jmp .WHILE%zu", current_while_counter);
+// Jumps to the first target if the condition is not 0, and to the second otherwise
+static void generate_branch(ir_instruction_t *instruction, uint32_t next_block)
+{
+  ir_value_t condition = instruction->operands[0];
+  uint32_t if_true = instruction->targets[0];
+  uint32_t if_false = instruction->targets[1];
+  if (condition.vreg == IR_NO_VREG)
+  {
+    uint32_t target = condition.constant != 0 ? if_true : if_false;
+    if (target != next_block)
+      jump_to_block("jmp", target);
+    return;
+  }
 
-  // end
-  LABEL(".ENDWHILE%zu", current_while_counter);
+  CMPQ("$0", vreg_operand(condition.vreg));
+  branch_on_flags(IR_BRANCH, if_true, if_false, next_block);
+}
 
-  innermost_loop--;
+// Returns true if the instruction is a comparison or NOT, whose result is only read by the branch
+// right after it, which ends the block. A result not live out of the block is read nowhere else
+static bool branches_on_result(ir_instruction_t *instruction, size_t block)
+{
+  ir_function_t *ir = &compilation->ir;
+  ir_instruction_t *branch = instruction + 1;
+  if (CONDITIONAL_JUMPS[instruction->opcode][0] == NULL || instruction->opcode == IR_BRANCH
+      || branch->opcode != IR_BRANCH || branch->operands[0].vreg != instruction->dest)
+    return false;
+
+  uint32_t number = ir->global_numbers[instruction->dest];
+  return number == IR_NO_VREG
+         || !ir_set_contains(&ir->live_out[block * ir->words_per_set], number);
 }
 
-// Leaves the currently innermost while loop using its end-label
-static void generate_break_statement()
+// Makes the comparison, and the branch after it jumps on its flags, instead of on its result
+static void generate_compare_and_branch(ir_instruction_t *instruction, size_t block)
 {
-  // (2.3):
-  // Generate the break statement, jumping out past the end of the current innermost while loop.
-  // You can use a global variable to keep track of the current innermost call to
-  // generate_while_statement().
-  EMIT("jmp .ENDWHILE%zu", innermost_loop);
+  ir_instruction_t *branch = instruction + 1;
+  const char *lhs = non_constant_operand(instruction->operands[0]);
+  if (instruction->opcode == IR_NOT)
+    CMPQ("$0", lhs);
+  else
+    // Compares the lhs with the rhs, which is the other way around in AT&T syntax
+    emit_with_value("cmpq", instruction->operands[1], lhs);
+  branch_on_flags(instruction->opcode, branch->targets[0], branch->targets[1], block + 1);
 }
 
-// Recursively generate the given statement node, and all sub-statements.
-static void generate_statement(node_t *node)
+// Selects the x86-64 instructions for one IR instruction of the given block
+static void generate_instruction(ir_instruction_t *instruction, size_t block)
 {
-  if (node == NULL)
-    return;
+  ir_function_t *ir = &compilation->ir;
+  ir_value_t a = instruction->operands[0];
+  uint32_t next_block = block + 1;
 
-  switch (node->type)
+  switch (instruction->opcode)
+  {
+  case IR_COPY:
+    move_value(a, vreg_operand(instruction->dest));
+    break;
+  case IR_NEGATE:
   {
-  case BLOCK:
+    const char *dest = vreg_operand(instruction->dest);
+    const char *result = result_register(dest);
+    move_value(a, result);
+    NEGQ(result);
+    move_operand(result, dest);
+    break;
+  }
+  case IR_NOT:
+    CMPQ("$0", non_constant_operand(a));
+    store_condition("sete", instruction->dest);
+    break;
+  case IR_ADD:
+  case IR_SUBTRACT:
+  case IR_MULTIPLY:
+    generate_arithmetic(instruction);
+    break;
+  case IR_DIVIDE:
+    generate_division(instruction);
+    break;
+  case IR_EQUAL:
+  case IR_NOT_EQUAL:
+  case IR_LESS:
+  case IR_LESS_EQUAL:
+  case IR_GREATER:
+  case IR_GREATER_EQUAL:
+    // Compares the lhs with the rhs, which is the other way around in AT&T syntax
+    emit_with_value("cmpq", instruction->operands[1], non_constant_operand(a));
+    store_condition(OPCODE_INSTRUCTIONS[instruction->opcode], instruction->dest);
+    break;
+  case IR_LOAD_GLOBAL:
+    move_operand(global_operand(instruction->symbol), vreg_operand(instruction->dest));
+    break;
+  case IR_STORE_GLOBAL:
+    move_value(a, global_operand(instruction->symbol));
+    break;
+  case IR_LOAD_ELEMENT:
   {
-    // All handling of pushing and popping scopes has already been done
-    // Just generate the statements that make up the statement body, one by one
-    node_t *statement_list = node->children[node->n_children - 1];
-    for (size_t i = 0; i < statement_list->n_children; i++)
-      generate_statement(statement_list->children[i]);
+    const char *dest = vreg_operand(instruction->dest);
+    MOVQ(element_operand(instruction->symbol, a), result_register(dest));
+    move_operand(result_register(dest), dest);
     break;
   }
-  case ASSIGNMENT_STATEMENT:
-    generate_assignment_statement(node);
+  case IR_STORE_ELEMENT:
+    generate_element_store(instruction);
     break;
-  case PRINT_STATEMENT:
-    generate_print_statement(node);
+  case IR_CALL:
+    generate_call(instruction);
     break;
-  case RETURN_STATEMENT:
-    generate_return_statement(node);
+  case IR_PRINT_STRING:
+    EMIT("leaq strout(%s), %s", RIP, RDI);
+    EMIT("leaq %s(%s), %s", string_label(instruction->string), RIP, RSI);
+    EMIT("call safe_printf");
+    break;
+  case IR_PRINT_NUMBER:
+    move_value(a, RSI);
+    EMIT("leaq intout(%s), %s", RIP, RDI);
+    EMIT("call safe_printf");
     break;
-  case FUNCTION_CALL:
-    generate_function_call(node);
+  case IR_PRINT_NEWLINE:
+    MOVQ("$'\\n'", RDI);
+    EMIT("call safe_putchar");
     break;
-  case IF_STATEMENT:
-    generate_if_statement(node);
+  case IR_JUMP:
+    if (instruction->targets[0] != next_block)
+      jump_to_block("jmp", instruction->targets[0]);
     break;
-  case WHILE_STATEMENT:
-    generate_while_statement(node);
+  case IR_BRANCH:
+    generate_branch(instruction, next_block);
     break;
-  case BREAK_STATEMENT:
-    generate_break_statement();
+  case IR_RETURN:
+    move_value(a, RAX);
+    // The epilogue comes right after the last block
+    if (next_block < ir->n_blocks)
+      EMIT("jmp .%s.epilogue", compilation->current_function->name);
     break;
   default:
-    assert(false && "Unknown statement type");
+    assert(false && "Unknown IR instruction");
   }
 }
 
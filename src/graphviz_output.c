@@ -3,69 +3,96 @@
 // Helper function for escaping special characters when printing GraphViz strings
 static void print_escaped_string(char* str)
 {
+  sink_t* output = &compilation->output;
   for (char* c = str; *c != '\0'; c++)
   {
     switch (*c)
     {
     case '\\':
-      printf("\\\\");
+      sink_puts(output, "\\\\");
       break;
     case '"':
-      printf("\\\"");
+      sink_puts(output, "\\\"");
       break;
     case '\n':
-      printf("\\\\n");
+      sink_puts(output, "\\\\n");
       break;
     default:
-      putchar(*c);
+      sink_putc(output, *c);
       break;
     }
   }
 }
 
-// A recursive function for printing a node as GraphViz, and all its children
-static void graphviz_node_print_internal(node_t* node)
+// Prints the label of a node as GraphViz
+static void graphviz_node_print_label(node_t* node)
 {
-  printf("node%p [label=\"%s", node, NODE_TYPE_NAMES[node->type]);
+  sink_t* output = &compilation->output;
+  sink_printf(output, "node%p [label=\"%s", node, NODE_TYPE_NAMES[node->type]);
   switch (node->type)
   {
   case OPERATOR:
-    printf("\\n%s", node->data.operator);
+    sink_printf(output, "\\n%s", OPERATOR_NAMES[node->data.operator]);
     break;
   case IDENTIFIER:
-    printf("\\n%s", node->data.identifier);
+    sink_printf(output, "\\n%s", node->data.identifier);
     break;
   case NUMBER_LITERAL:
-    printf("\\n%ld", node->data.number_literal);
+    sink_printf(output, "\\n%ld", node->data.number_literal);
     break;
   case STRING_LITERAL:
-    printf("\\n");
+    sink_puts(output, "\\n");
     print_escaped_string(node->data.string_literal);
     break;
   case STRING_LIST_REFERENCE:
-    printf("\\n%zu", node->data.string_list_index);
+    sink_printf(output, "\\n%zu", node->data.string_list_index);
     break;
   default:
     break;
   }
 
-  printf("\"];\n");
-  for (size_t i = 0; i < node->n_children; i++)
+  sink_puts(output, "\"];\n");
+}
+
+// Prints a node as GraphViz, and all its children.
+// Each node is printed with its label first, followed by each edge to a child and its subtree.
+// The step of a node's frame is the number of its edges printed so far
+static void graphviz_node_print_internal(node_t* root)
+{
+  sink_t* output = &compilation->output;
+  tree_walk_stack_t* stack = &compilation->tree_walk;
+  size_t stack_base = stack->length;
+
+  tree_walk_push(stack, root, 0);
+  while (stack->length > stack_base)
   {
-    node_t* child = node->children[i];
+    tree_walk_frame_t* frame = tree_walk_top(stack);
+    node_t* node = frame->node;
+    if (frame->step == 0)
+      graphviz_node_print_label(node);
+
+    if (frame->step == node->n_children)
+    {
+      tree_walk_pop(stack);
+      continue;
+    }
+
+    size_t i = frame->step++;
+    node_t* child = node_child(node, i);
     if (child == NULL)
-      printf("node%p -- node%pNULL%zu ;\n", node, node, i);
+      sink_printf(output, "node%p -- node%pNULL%zu ;\n", node, node, i);
     else
     {
-      printf("node%p -- node%p ;\n", node, child);
-      graphviz_node_print_internal(child);
+      sink_printf(output, "node%p -- node%p ;\n", node, child);
+      tree_walk_push(stack, child, 0);
     }
   }
 }
 
 void graphviz_node_print(node_t* root)
 {
-  printf("graph \"\" {\n node[shape=box];\n");
+  sink_t* output = &compilation->output;
+  sink_puts(output, "graph \"\" {\n node[shape=box];\n");
   graphviz_node_print_internal(root);
-  printf("}\n");
+  sink_puts(output, "}\n");
 }
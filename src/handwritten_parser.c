@@ -0,0 +1,699 @@
+#include "vslc.h"
+
+#include <setjmp.h>
+
+// The tokens defined in parser.y
+#include "parser.h"
+
+// A hand-written replacement for the parser generated from parser.y, used instead of it when vslc
+// is built with the CMake option VSLC_HANDWRITTEN_PARSER. It accepts the same programs, builds the
+// same syntax tree, and reports syntax errors at the same tokens.
+//
+// Globals are parsed by plain recursive descent. Statements are parsed by recursive descent too,
+// and expressions by precedence climbing, but instead of calling itself for a nested construct,
+// the parser pushes a frame saying how to continue once the nested construct is finished. Like
+// the passes over the syntax tree, the nesting depth of a program is then only limited by memory.
+
+// The scanner places the node of NUMBER, IDENTIFIER and STRING tokens in *yylval
+int yylex(YYSTYPE* yylval, yyscan_t scanner);
+
+// The precedence of binary operators, from the declarations in parser.y
+typedef enum
+{
+  PRECEDENCE_NONE,
+  PRECEDENCE_EQUALITY,       // '=' '!'
+  PRECEDENCE_RELATIONAL,     // '<' '>'
+  PRECEDENCE_ADDITIVE,       // '+' '-'
+  PRECEDENCE_MULTIPLICATIVE, // '*' '/'
+} precedence_t;
+
+// What to do once the construct started after a frame is finished, with its node as the result
+typedef enum
+{
+  AFTER_ASSIGNED_VALUE,  // first is the identifier or array indexing assigned to
+  AFTER_ASSIGNED_INDEX,  // first is the identifier of the array assigned to
+  AFTER_RETURN_VALUE,
+  AFTER_PRINT_ITEM,      // first is the list of earlier items, if any
+  AFTER_IF_CONDITION,
+  AFTER_IF_THEN,         // first is the condition
+  AFTER_IF_ELSE,         // first is the condition, second the then statement
+  AFTER_WHILE_CONDITION,
+  AFTER_WHILE_BODY,      // first is the condition
+  AFTER_BLOCK_STATEMENT, // first is the declarations, if any, second the earlier statements
+  AFTER_ARGUMENT,        // first is the identifier of the function, second the earlier arguments
+  AFTER_INDEX,           // first is the identifier of the array
+  AFTER_PARENTHESES,
+  AFTER_UNARY_OPERAND,   // operator is the unary operator
+  AFTER_LEFT_OPERAND,    // precedence is that of the operator to the left of the expression
+  AFTER_RIGHT_OPERAND,   // first is the left operand, operator the binary operator
+} continuation_t;
+
+typedef struct frame
+{
+  uint8_t continuation; // A continuation_t
+  uint8_t operator;     // An operator_type_t
+  uint8_t precedence;   // A precedence_t
+  node_id_t first;
+  node_id_t second;
+} frame_t;
+
+// What the parser does next, while parsing a nested statement or expression
+typedef enum
+{
+  NEXT_STATEMENT, // Start parsing a statement
+  NEXT_OPERAND,   // Start parsing an operand of an expression
+  NEXT_CONTINUE,  // Continue from the frame on top of the stack, with the result
+} next_t;
+
+typedef struct parser
+{
+  yyscan_t scanner;
+  int token;       // The next token, which has not been used yet. 0 at the end of the input
+  node_id_t value; // The leaf node of the next token, if it has one
+
+  frame_t* frames;
+  size_t n_frames;
+  size_t capacity;
+  next_t next;
+  node_id_t result; // The node of the construct that was just finished
+
+  jmp_buf syntax_error; // Where to go when a syntax error is found
+} parser_t;
+
+static bool parse(parser_t* parser);
+static node_id_t parse_program(parser_t* parser);
+static node_id_t run_parser(parser_t* parser);
+static void start_expression(parser_t* parser, precedence_t precedence);
+static void start_statement(parser_t* parser);
+static void start_operand(parser_t* parser);
+static void continue_frame(parser_t* parser);
+
+/* External interface */
+
+// Parses the whole program read by the scanner into compilation->root, like the yyparse made by
+// bison from parser.y. Syntax errors are recorded in compilation->error, and 1 is returned
+int yyparse(yyscan_t scanner)
+{
+  parser_t parser = {.scanner = scanner};
+  bool parsed = parse(&parser);
+  free(parser.frames);
+  return parsed ? 0 : 1;
+}
+
+/* Internal matters */
+
+// Parses the program, or returns false when a syntax error is found
+static bool parse(parser_t* parser)
+{
+  if (setjmp(parser->syntax_error) != 0)
+    return false;
+
+  compilation->root = parse_program(parser);
+  return true;
+}
+
+// Reads the next token. Like the parser made by bison, every token that is 0 or below ends the
+// input, and every token read is counted for the time report, except the 0 token
+static void advance(parser_t* parser)
+{
+  parser->value = NO_NODE;
+  parser->token = yylex(&parser->value, parser->scanner);
+  if (parser->token != 0)
+    compilation->statistics.n_tokens++;
+  if (parser->token < 0)
+    parser->token = 0;
+}
+
+// Records a syntax error at the next token, the way yyerror in parser.y does, and stops parsing
+static void syntax_error(parser_t* parser)
+{
+  int line = yyget_lineno(parser->scanner);
+  compilation->error = (vslc_error_t){.kind = VSLC_ERROR_SYNTAX, .line = line};
+  snprintf(
+      compilation->error.message,
+      sizeof(compilation->error.message),
+      "syntax error on line %d",
+      line);
+  longjmp(parser->syntax_error, 1);
+}
+
+// Reads past the next token, which must be the given one
+static void expect(parser_t* parser, int token)
+{
+  if (parser->token != token)
+    syntax_error(parser);
+  advance(parser);
+}
+
+// Reads past the next token, which must be an identifier, and returns its node
+static node_id_t expect_identifier(parser_t* parser)
+{
+  node_id_t identifier = parser->value;
+  expect(parser, IDENTIFIER_TOKEN);
+  return identifier;
+}
+
+// Makes a node with up to three children, without the va_list of node_create
+static node_id_t node_0(node_type_t type)
+{
+  return node_create_from(type, 0, NULL);
+}
+
+static node_id_t node_1(node_type_t type, node_id_t child0)
+{
+  return node_create_from(type, 1, &child0);
+}
+
+static node_id_t node_2(node_type_t type, node_id_t child0, node_id_t child1)
+{
+  return node_create_from(type, 2, (node_id_t[]){child0, child1});
+}
+
+static node_id_t node_3(node_type_t type, node_id_t child0, node_id_t child1, node_id_t child2)
+{
+  return node_create_from(type, 3, (node_id_t[]){child0, child1, child2});
+}
+
+// Makes a LIST node with the element, or appends the element to the list if there is one
+static node_id_t list_append(node_id_t list, node_id_t element)
+{
+  if (list == NO_NODE)
+    return node_1(LIST, element);
+  return append_to_list_node(list, element);
+}
+
+// Parses a list of identifiers separated by commas
+static node_id_t parse_variable_list(parser_t* parser)
+{
+  node_id_t list = node_1(LIST, expect_identifier(parser));
+  while (parser->token == ',')
+  {
+    advance(parser);
+    append_to_list_node(list, expect_identifier(parser));
+  }
+  return list;
+}
+
+// Parses a function, after the FUNC token
+static node_id_t parse_function(parser_t* parser)
+{
+  node_id_t name = expect_identifier(parser);
+  expect(parser, '(');
+  node_id_t parameters = parser->token == ')' ? node_0(LIST) : parse_variable_list(parser);
+  expect(parser, ')');
+  parser->next = NEXT_STATEMENT;
+  node_id_t body = run_parser(parser);
+  return node_3(FUNCTION, name, parameters, body);
+}
+
+// Parses a global variable, which is either an identifier or an array with its size
+static node_id_t parse_global_variable(parser_t* parser)
+{
+  node_id_t variable = expect_identifier(parser);
+  if (parser->token != '[')
+    return variable;
+
+  advance(parser);
+  start_expression(parser, PRECEDENCE_NONE);
+  node_id_t size = run_parser(parser);
+  expect(parser, ']');
+  return node_2(ARRAY_INDEXING, variable, size);
+}
+
+// Parses a global declaration, after the VAR token
+static node_id_t parse_global_declaration(parser_t* parser)
+{
+  node_id_t list = node_1(LIST, parse_global_variable(parser));
+  while (parser->token == ',')
+  {
+    advance(parser);
+    append_to_list_node(list, parse_global_variable(parser));
+  }
+  return node_1(GLOBAL_DECLARATION, list);
+}
+
+// Parses every global of the program, of which there must be at least one
+static node_id_t parse_program(parser_t* parser)
+{
+  advance(parser);
+  node_id_t globals = NO_NODE;
+  do
+  {
+    int token = parser->token;
+    if (token != FUNC && token != VAR)
+      syntax_error(parser);
+    advance(parser);
+
+    node_id_t global
+        = token == FUNC ? parse_function(parser) : parse_global_declaration(parser);
+    globals = list_append(globals, global);
+  } while (parser->token != 0);
+
+  return globals;
+}
+
+// Pushes a frame, which is continued once the construct started after it is finished
+static frame_t* push_frame(parser_t* parser, continuation_t continuation)
+{
+  if (parser->n_frames == parser->capacity)
+  {
+    parser->capacity = parser->capacity * 2 + 64;
+    parser->frames = realloc(parser->frames, parser->capacity * sizeof(frame_t));
+  }
+  frame_t* frame = &parser->frames[parser->n_frames++];
+  *frame = (frame_t){.continuation = continuation};
+  return frame;
+}
+
+// Starts parsing an expression, whose operators must bind tighter than the given precedence
+static void start_expression(parser_t* parser, precedence_t precedence)
+{
+  push_frame(parser, AFTER_LEFT_OPERAND)->precedence = precedence;
+  parser->next = NEXT_OPERAND;
+}
+
+// Finishes the current construct, with the given node as its result
+static void finish(parser_t* parser, node_id_t result)
+{
+  parser->result = result;
+  parser->next = NEXT_CONTINUE;
+}
+
+// Parses the statement or expression that has been started, with everything nested inside it
+static node_id_t run_parser(parser_t* parser)
+{
+  while (true)
+  {
+    switch (parser->next)
+    {
+    case NEXT_STATEMENT:
+      start_statement(parser);
+      break;
+    case NEXT_OPERAND:
+      start_operand(parser);
+      break;
+    case NEXT_CONTINUE:
+      if (parser->n_frames == 0)
+        return parser->result;
+      continue_frame(parser);
+      break;
+    }
+  }
+}
+
+// Parses the arguments of a function call, after the opening parenthesis
+static void start_arguments(parser_t* parser, node_id_t function)
+{
+  if (parser->token == ')')
+  {
+    advance(parser);
+    finish(parser, node_2(FUNCTION_CALL, function, node_0(LIST)));
+    return;
+  }
+  push_frame(parser, AFTER_ARGUMENT)->first = function;
+  start_expression(parser, PRECEDENCE_NONE);
+}
+
+// Adds the item to the list of a print statement, and parses the items after it.
+// Strings are taken right away, while expressions are started
+static void continue_print(parser_t* parser, node_id_t list, node_id_t item)
+{
+  while (true)
+  {
+    list = list_append(list, item);
+    if (parser->token != ',')
+    {
+      finish(parser, node_1(PRINT_STATEMENT, list));
+      return;
+    }
+    advance(parser);
+
+    if (parser->token != STRING_TOKEN)
+    {
+      push_frame(parser, AFTER_PRINT_ITEM)->first = list;
+      start_expression(parser, PRECEDENCE_NONE);
+      return;
+    }
+    item = parser->value;
+    advance(parser);
+  }
+}
+
+// Parses the declarations at the start of a block, after the opening brace, and starts its
+// first statement
+static void start_block(parser_t* parser)
+{
+  node_id_t declarations = NO_NODE;
+  while (parser->token == VAR)
+  {
+    advance(parser);
+    declarations = list_append(declarations, parse_variable_list(parser));
+  }
+  push_frame(parser, AFTER_BLOCK_STATEMENT)->first = declarations;
+  parser->next = NEXT_STATEMENT;
+}
+
+// Starts parsing a statement, or parses all of it when nothing is nested inside it
+static void start_statement(parser_t* parser)
+{
+  node_id_t value = parser->value;
+  switch (parser->token)
+  {
+  case IDENTIFIER_TOKEN:
+    advance(parser);
+    if (parser->token == '(')
+    {
+      advance(parser);
+      start_arguments(parser, value);
+      return;
+    }
+    if (parser->token == '[')
+    {
+      advance(parser);
+      push_frame(parser, AFTER_ASSIGNED_INDEX)->first = value;
+      start_expression(parser, PRECEDENCE_NONE);
+      return;
+    }
+    expect(parser, '=');
+    push_frame(parser, AFTER_ASSIGNED_VALUE)->first = value;
+    start_expression(parser, PRECEDENCE_NONE);
+    return;
+
+  case RETURN:
+    advance(parser);
+    push_frame(parser, AFTER_RETURN_VALUE);
+    start_expression(parser, PRECEDENCE_NONE);
+    return;
+
+  case PRINT:
+    advance(parser);
+    if (parser->token == STRING_TOKEN)
+    {
+      node_id_t string = parser->value;
+      advance(parser);
+      continue_print(parser, NO_NODE, string);
+      return;
+    }
+    push_frame(parser, AFTER_PRINT_ITEM)->first = NO_NODE;
+    start_expression(parser, PRECEDENCE_NONE);
+    return;
+
+  case IF:
+    advance(parser);
+    push_frame(parser, AFTER_IF_CONDITION);
+    start_expression(parser, PRECEDENCE_NONE);
+    return;
+
+  case WHILE:
+    advance(parser);
+    push_frame(parser, AFTER_WHILE_CONDITION);
+    start_expression(parser, PRECEDENCE_NONE);
+    return;
+
+  case BREAK:
+    advance(parser);
+    finish(parser, node_0(BREAK_STATEMENT));
+    return;
+
+  case '{':
+    advance(parser);
+    start_block(parser);
+    return;
+
+  default:
+    syntax_error(parser);
+  }
+}
+
+// Starts parsing an operand, or parses all of it when nothing is nested inside it.
+// The operand of a unary operator is itself an operand, as unary operators bind the tightest
+static void start_operand(parser_t* parser)
+{
+  node_id_t value = parser->value;
+  switch (parser->token)
+  {
+  case NUMBER_TOKEN:
+    advance(parser);
+    finish(parser, value);
+    return;
+
+  case IDENTIFIER_TOKEN:
+    advance(parser);
+    if (parser->token == '(')
+    {
+      advance(parser);
+      start_arguments(parser, value);
+    }
+    else if (parser->token == '[')
+    {
+      advance(parser);
+      push_frame(parser, AFTER_INDEX)->first = value;
+      start_expression(parser, PRECEDENCE_NONE);
+    }
+    else
+      finish(parser, value);
+    return;
+
+  case '(':
+    advance(parser);
+    push_frame(parser, AFTER_PARENTHESES);
+    start_expression(parser, PRECEDENCE_NONE);
+    return;
+
+  case '-':
+  case '!':
+    push_frame(parser, AFTER_UNARY_OPERAND)->operator
+        = parser->token == '-' ? OPERATOR_NEGATE : OPERATOR_NOT;
+    advance(parser);
+    return;
+
+  default:
+    syntax_error(parser);
+  }
+}
+
+// Returns the precedence of the binary operator starting with the token, or PRECEDENCE_NONE if
+// no binary operator starts with it
+static precedence_t binary_precedence(int token)
+{
+  switch (token)
+  {
+  case '=':
+  case '!':
+    return PRECEDENCE_EQUALITY;
+  case '<':
+  case '>':
+    return PRECEDENCE_RELATIONAL;
+  case '+':
+  case '-':
+    return PRECEDENCE_ADDITIVE;
+  case '*':
+  case '/':
+    return PRECEDENCE_MULTIPLICATIVE;
+  default:
+    return PRECEDENCE_NONE;
+  }
+}
+
+// Reads past the one or two tokens of a binary operator, and returns the operator
+static operator_type_t read_binary_operator(parser_t* parser)
+{
+  int token = parser->token;
+  advance(parser);
+
+  switch (token)
+  {
+  case '=':
+    expect(parser, '=');
+    return OPERATOR_EQUAL;
+  case '!':
+    expect(parser, '=');
+    return OPERATOR_NOT_EQUAL;
+  case '<':
+    if (parser->token != '=')
+      return OPERATOR_LESS;
+    advance(parser);
+    return OPERATOR_LESS_EQUAL;
+  case '>':
+    if (parser->token != '=')
+      return OPERATOR_GREATER;
+    advance(parser);
+    return OPERATOR_GREATER_EQUAL;
+  case '+':
+    return OPERATOR_ADD;
+  case '-':
+    return OPERATOR_SUBTRACT;
+  case '*':
+    return OPERATOR_MULTIPLY;
+  default:
+    return OPERATOR_DIVIDE;
+  }
+}
+
+// Returns the precedence of the rule for the operator in parser.y. Bison gives a rule the
+// precedence of its last token, so operators ending with '=' have the precedence of '='
+static precedence_t rule_precedence(operator_type_t operator)
+{
+  switch (operator)
+  {
+  case OPERATOR_LESS:
+  case OPERATOR_GREATER:
+    return PRECEDENCE_RELATIONAL;
+  case OPERATOR_ADD:
+  case OPERATOR_SUBTRACT:
+    return PRECEDENCE_ADDITIVE;
+  case OPERATOR_MULTIPLY:
+  case OPERATOR_DIVIDE:
+    return PRECEDENCE_MULTIPLICATIVE;
+  default:
+    return PRECEDENCE_EQUALITY;
+  }
+}
+
+// Continues from the frame on top of the stack, now that the construct started after it is
+// finished with parser->result. The frame is popped, and may be pushed again
+static void continue_frame(parser_t* parser)
+{
+  frame_t frame = parser->frames[--parser->n_frames];
+  node_id_t result = parser->result;
+
+  switch ((continuation_t)frame.continuation)
+  {
+  case AFTER_ASSIGNED_VALUE:
+    finish(parser, node_2(ASSIGNMENT_STATEMENT, frame.first, result));
+    return;
+
+  case AFTER_ASSIGNED_INDEX:
+    expect(parser, ']');
+    expect(parser, '=');
+    push_frame(parser, AFTER_ASSIGNED_VALUE)->first = node_2(ARRAY_INDEXING, frame.first, result);
+    start_expression(parser, PRECEDENCE_NONE);
+    return;
+
+  case AFTER_RETURN_VALUE:
+    finish(parser, node_1(RETURN_STATEMENT, result));
+    return;
+
+  case AFTER_PRINT_ITEM:
+    continue_print(parser, frame.first, result);
+    return;
+
+  case AFTER_IF_CONDITION:
+    expect(parser, THEN);
+    push_frame(parser, AFTER_IF_THEN)->first = result;
+    parser->next = NEXT_STATEMENT;
+    return;
+
+  case AFTER_IF_THEN:
+    // An else always belongs to the closest if
+    if (parser->token == ELSE)
+    {
+      advance(parser);
+      frame_t* else_frame = push_frame(parser, AFTER_IF_ELSE);
+      else_frame->first = frame.first;
+      else_frame->second = result;
+      parser->next = NEXT_STATEMENT;
+      return;
+    }
+    finish(parser, node_2(IF_STATEMENT, frame.first, result));
+    return;
+
+  case AFTER_IF_ELSE:
+    finish(parser, node_3(IF_STATEMENT, frame.first, frame.second, result));
+    return;
+
+  case AFTER_WHILE_CONDITION:
+    expect(parser, DO);
+    push_frame(parser, AFTER_WHILE_BODY)->first = result;
+    parser->next = NEXT_STATEMENT;
+    return;
+
+  case AFTER_WHILE_BODY:
+    finish(parser, node_2(WHILE_STATEMENT, frame.first, result));
+    return;
+
+  case AFTER_BLOCK_STATEMENT:
+  {
+    node_id_t statements = list_append(frame.second, result);
+    if (parser->token != '}')
+    {
+      frame_t* block_frame = push_frame(parser, AFTER_BLOCK_STATEMENT);
+      block_frame->first = frame.first;
+      block_frame->second = statements;
+      parser->next = NEXT_STATEMENT;
+      return;
+    }
+    advance(parser);
+    if (frame.first != NO_NODE)
+      finish(parser, node_2(BLOCK, frame.first, statements));
+    else
+      finish(parser, node_1(BLOCK, statements));
+    return;
+  }
+
+  case AFTER_ARGUMENT:
+  {
+    node_id_t arguments = list_append(frame.second, result);
+    if (parser->token == ',')
+    {
+      advance(parser);
+      frame_t* argument_frame = push_frame(parser, AFTER_ARGUMENT);
+      argument_frame->first = frame.first;
+      argument_frame->second = arguments;
+      start_expression(parser, PRECEDENCE_NONE);
+      return;
+    }
+    expect(parser, ')');
+    finish(parser, node_2(FUNCTION_CALL, frame.first, arguments));
+    return;
+  }
+
+  case AFTER_INDEX:
+    expect(parser, ']');
+    finish(parser, node_2(ARRAY_INDEXING, frame.first, result));
+    return;
+
+  case AFTER_PARENTHESES:
+    expect(parser, ')');
+    finish(parser, result);
+    return;
+
+  case AFTER_UNARY_OPERAND:
+  {
+    node_id_t operator = node_1(OPERATOR, result);
+    node_at(operator)->data.operator = frame.operator;
+    finish(parser, operator);
+    return;
+  }
+
+  case AFTER_LEFT_OPERAND:
+  {
+    // Operators binding no tighter than the operator to the left of the expression are left to
+    // it, which makes operators of the same precedence associate to the left
+    precedence_t precedence = binary_precedence(parser->token);
+    if (precedence <= frame.precedence)
+    {
+      finish(parser, result);
+      return;
+    }
+
+    // The result becomes the left operand of the operator, and the frame is kept, so that the
+    // binary operator is the left operand of the operator after it
+    push_frame(parser, AFTER_LEFT_OPERAND)->precedence = frame.precedence;
+    operator_type_t operator = read_binary_operator(parser);
+    frame_t* right_frame = push_frame(parser, AFTER_RIGHT_OPERAND);
+    right_frame->first = result;
+    right_frame->operator = operator;
+    start_expression(parser, rule_precedence(operator));
+    return;
+  }
+
+  case AFTER_RIGHT_OPERAND:
+  {
+    node_id_t operator = node_2(OPERATOR, frame.first, result);
+    node_at(operator)->data.operator = frame.operator;
+    finish(parser, operator);
+    return;
+  }
+  }
+}
@@ -0,0 +1,330 @@
+#include "vslc.h"
+
+// The tokens defined in parser.y
+#include "parser.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// A hand-written replacement for the flex scanner in scanner.l, used instead of it when vslc is
+// built with the CMake option VSLC_HANDWRITTEN_SCANNER. It has the same interface as the
+// reentrant flex scanner, and finds the same tokens, on the same lines, making the same nodes.
+// tests/scanner_differential_test.c checks this against the flex scanner.
+//
+// The whole input is scanned into an array of tokens the first time the parser asks for one,
+// and the parser then takes the tokens from the array. Like flex, every rule of scanner.l takes
+// the longest text it can, and the first rule wins when two rules take the same text.
+//
+// Newlines only appear in whitespace, so lines are counted while skipping it, 16 bytes at a time
+// with SSE2. Comments are skipped with memchr, which libc already vectorizes, and keywords are
+// told apart from other identifiers with a perfect hash.
+
+typedef struct token
+{
+  int kind;       // A token from parser.h, a single character, or 0 at the end of the input
+  int line;       // The line the token is on
+  node_id_t node; // The leaf node of NUMBER_TOKEN, IDENTIFIER_TOKEN and STRING_TOKEN tokens
+} token_t;
+
+// The state behind a yyscan_t
+typedef struct scanner
+{
+  char* buffer;       // The input, followed by two NUL bytes. NULL until a buffer is given
+  size_t length;      // The length of the input, not counting the NUL bytes
+  char* stdin_buffer; // Owned copy of stdin, read if no buffer is given
+
+  token_t* tokens; // The tokens of the whole input, ending with a token of kind 0
+  size_t n_tokens;
+  size_t capacity;
+  size_t next_token; // The next token to hand to the parser
+  int line;          // The line of the last token handed to the parser
+} scanner_t;
+
+typedef struct keyword
+{
+  const char* text;
+  size_t length;
+  int token;
+} keyword_t;
+
+// Sums the first and last character of a word. No two keywords have the same hash
+#define KEYWORD_HASH(first, last) (((unsigned char)(first) + (unsigned char)(last)) & 15)
+
+static const keyword_t KEYWORDS[16] = {
+    [KEYWORD_HASH('f', 'c')] = {"func", 4, FUNC},
+    [KEYWORD_HASH('p', 't')] = {"print", 5, PRINT},
+    [KEYWORD_HASH('r', 'n')] = {"return", 6, RETURN},
+    [KEYWORD_HASH('b', 'k')] = {"break", 5, BREAK},
+    [KEYWORD_HASH('i', 'f')] = {"if", 2, IF},
+    [KEYWORD_HASH('t', 'n')] = {"then", 4, THEN},
+    [KEYWORD_HASH('e', 'e')] = {"else", 4, ELSE},
+    [KEYWORD_HASH('w', 'e')] = {"while", 5, WHILE},
+    [KEYWORD_HASH('d', 'o')] = {"do", 2, DO},
+    [KEYWORD_HASH('v', 'r')] = {"var", 3, VAR},
+};
+
+static void scan_tokens(scanner_t* scanner);
+static void read_stdin(scanner_t* scanner);
+
+/* External interface */
+
+// Makes a scanner without input. Until a buffer is given, the input is read from stdin
+int yylex_init(yyscan_t* scanner)
+{
+  scanner_t* state = malloc(sizeof(scanner_t));
+  *state = (scanner_t){.buffer = NULL, .line = 1};
+  *scanner = state;
+  return 0;
+}
+
+// Frees the tokens, and the copy of stdin. The nodes belong to the syntax tree
+int yylex_destroy(yyscan_t scanner)
+{
+  scanner_t* state = scanner;
+  free(state->tokens);
+  free(state->stdin_buffer);
+  free(state);
+  return 0;
+}
+
+// The buffer is scanned in place, and is never written to. There is no buffer state like in flex,
+// so NULL is always returned
+struct yy_buffer_state* yy_scan_buffer(char* base, size_t size, yyscan_t scanner)
+{
+  scanner_t* state = scanner;
+  assert(size >= 2 && base[size - 2] == '\0' && base[size - 1] == '\0');
+  state->buffer = base;
+  state->length = size - 2;
+  return NULL;
+}
+
+// Like yylineno in flex, this is the line of the last token read by the parser
+int yyget_lineno(yyscan_t scanner)
+{
+  return ((scanner_t*)scanner)->line;
+}
+
+// Hands the next token to the parser. Once the end is reached, the end is returned again
+int yylex(YYSTYPE* yylval, yyscan_t scanner)
+{
+  scanner_t* state = scanner;
+  if (state->tokens == NULL)
+  {
+    if (state->buffer == NULL)
+      read_stdin(state);
+    scan_tokens(state);
+  }
+
+  token_t* token = &state->tokens[state->next_token];
+  if (token->kind != 0)
+    state->next_token++;
+  state->line = token->line;
+  *yylval = token->node;
+  return token->kind;
+}
+
+/* Internal matters */
+
+// Whitespace, as in the WHITESPACE definition of scanner.l
+static inline bool is_whitespace(char c)
+{
+  return c == ' ' || c == '\t' || c == '\v' || c == '\r' || c == '\n';
+}
+
+static inline bool is_digit(char c)
+{
+  return c >= '0' && c <= '9';
+}
+
+static inline bool is_identifier_start(char c)
+{
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+static inline bool is_identifier_character(char c)
+{
+  return is_identifier_start(c) || is_digit(c);
+}
+
+// Returns the end of the whitespace starting at position, and adds the newlines in it to line.
+// The input ends with a NUL byte, which is not whitespace, so the end is never passed
+static const char* skip_whitespace(const char* position, const char* end, int* line)
+{
+  // Most tokens are followed by a single space, or by none at all
+  if (!is_whitespace(position[0]))
+    return position;
+
+#ifdef __SSE2__
+  // Look at 16 bytes at a time, as long as all of them are inside the input.
+  // Each byte sets a bit in the masks, the first byte setting the lowest bit
+  while (end - position >= 16)
+  {
+    __m128i bytes = _mm_loadu_si128((const __m128i*)position);
+    __m128i newlines = _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\n'));
+    __m128i whitespace = _mm_or_si128(
+        _mm_or_si128(newlines, _mm_cmpeq_epi8(bytes, _mm_set1_epi8(' '))),
+        _mm_or_si128(
+            _mm_or_si128(
+                _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\t')),
+                _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\v'))),
+            _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\r'))));
+    unsigned whitespace_mask = _mm_movemask_epi8(whitespace);
+    unsigned newline_mask = _mm_movemask_epi8(newlines);
+
+    if (whitespace_mask != 0xffff)
+    {
+      unsigned n_whitespace = __builtin_ctz(~whitespace_mask);
+      *line += __builtin_popcount(newline_mask & ((1u << n_whitespace) - 1));
+      return position + n_whitespace;
+    }
+    *line += __builtin_popcount(newline_mask);
+    position += 16;
+  }
+#endif
+
+  while (is_whitespace(*position))
+  {
+    if (*position == '\n')
+      (*line)++;
+    position++;
+  }
+  return position;
+}
+
+// Returns the end of the QUOTED string starting at the quotation mark at position, or NULL if
+// there is none. The rule \"([^\"\n]|\\\")*\" lets a backslash followed by a quotation mark be
+// either the end of the string or a part of it, so the string may end at any quotation mark
+// before the end of the line, as long as every quotation mark before it follows a backslash
+static const char* match_string(const char* position, const char* end)
+{
+  const char* match = NULL;
+  for (const char* c = position + 1; c < end && *c != '\n'; c++)
+  {
+    if (*c != '"')
+      continue;
+    match = c + 1;
+    if (c[-1] != '\\')
+      break;
+  }
+  return match;
+}
+
+// Adds a token to the end of the token array
+static void add_token(scanner_t* scanner, int kind, int line, node_id_t node)
+{
+  if (scanner->n_tokens == scanner->capacity)
+  {
+    scanner->capacity = scanner->capacity * 2 + 1024;
+    scanner->tokens = realloc(scanner->tokens, scanner->capacity * sizeof(token_t));
+  }
+  scanner->tokens[scanner->n_tokens++] = (token_t){.kind = kind, .line = line, .node = node};
+}
+
+// Scans the whole input into the token array, making leaf nodes like the actions of scanner.l
+static void scan_tokens(scanner_t* scanner)
+{
+  const char* position = scanner->buffer;
+  const char* end = scanner->buffer + scanner->length;
+  int line = 1;
+
+  while (true)
+  {
+    position = skip_whitespace(position, end, &line);
+    const char* start = position;
+    char c = *position;
+
+    // The input ends at its end, or at a NUL byte, which flex hands to the parser as the end
+    if (position == end || c == '\0')
+    {
+      add_token(scanner, 0, line, NO_NODE);
+      return;
+    }
+
+    // A comment is // followed by at least one character that ends the line
+    if (c == '/' && position[1] == '/' && end - position > 2 && position[2] != '\n')
+    {
+      const char* newline = memchr(position, '\n', end - position);
+      position = newline != NULL ? newline : end;
+      continue;
+    }
+
+    if (is_digit(c))
+    {
+      while (is_digit(*position))
+        position++;
+      node_id_t number = node_create(NUMBER_LITERAL, 0);
+      node_at(number)->data.number_literal = strtol(start, NULL, 10);
+      add_token(scanner, NUMBER_TOKEN, line, number);
+      continue;
+    }
+
+    if (is_identifier_start(c))
+    {
+      while (is_identifier_character(*position))
+        position++;
+      size_t length = position - start;
+      const keyword_t* keyword = &KEYWORDS[KEYWORD_HASH(start[0], position[-1])];
+      if (keyword->length == length && memcmp(start, keyword->text, length) == 0)
+      {
+        add_token(scanner, keyword->token, line, NO_NODE);
+        continue;
+      }
+
+      node_id_t identifier = node_create(IDENTIFIER, 0);
+      node_at(identifier)->data.identifier = intern_identifier(start, length);
+      add_token(scanner, IDENTIFIER_TOKEN, line, identifier);
+      continue;
+    }
+
+    if (c == '"')
+    {
+      const char* string_end = match_string(position, end);
+      if (string_end != NULL)
+      {
+        size_t length = string_end - start;
+        char* text = arena_alloc(&compilation->tree_arena, length + 1);
+        memcpy(text, start, length);
+        text[length] = '\0';
+
+        node_id_t string = node_create(STRING_LITERAL, 0);
+        node_at(string)->data.string_literal = text;
+        add_token(scanner, STRING_TOKEN, line, string);
+        position = string_end;
+        continue;
+      }
+    }
+
+    // Any other character is a token of its own. Like yytext[0] in flex, it is a char,
+    // so bytes above 127 are negative, which the parser takes as the end of the input
+    add_token(scanner, c, line, NO_NODE);
+    position++;
+  }
+}
+
+// Reads all of stdin into a buffer ending with two NUL bytes, like the buffers given by
+// yy_scan_buffer
+static void read_stdin(scanner_t* scanner)
+{
+  size_t capacity = 64 * 1024;
+  size_t length = 0;
+  char* buffer = malloc(capacity);
+  while (true)
+  {
+    if (capacity - length < 4096)
+    {
+      capacity *= 2;
+      buffer = realloc(buffer, capacity);
+    }
+    size_t n_read = fread(buffer + length, 1, capacity - length - 2, stdin);
+    if (n_read == 0)
+      break;
+    length += n_read;
+  }
+  buffer[length] = '\0';
+  buffer[length + 1] = '\0';
+
+  scanner->stdin_buffer = buffer;
+  scanner->buffer = buffer;
+  scanner->length = length;
+}
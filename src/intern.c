@@ -0,0 +1,145 @@
+#include "intern.h"
+#include "arena.h"
+#include "compilation.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Each interned name is stored right after its hash, so the hash can be found from the name
+typedef struct interned_name
+{
+  uint64_t hash;
+  size_t length;
+  char name[];
+} interned_name_t;
+
+// A bucket holds 0 or 1 entries. The hash is repeated in the bucket, so probing past
+// other names never has to look at the entries themselves.
+typedef struct intern_bucket
+{
+  uint64_t hash;
+  interned_name_t* entry;
+} intern_bucket_t;
+
+// The multiplier used by FxHash, an odd constant with well spread bits
+#define HASH_MULTIPLIER 0x517cc1b727220a95ULL
+
+// Mixes one 64-bit word into the hash
+static uint64_t hash_word(uint64_t hash, uint64_t word)
+{
+  return (((hash << 5) | (hash >> 59)) ^ word) * HASH_MULTIPLIER;
+}
+
+// Calculates a 64-bit hash of the given characters.
+// The characters are consumed one 8-byte word at a time, in the style of FxHash.
+// FxHash alone leaves the low bits poorly mixed for names that differ in their last characters,
+// such as v0001, v0002, ..., so the result is finished with the avalanche step of MurmurHash3.
+// Afterwards, every bit of the hash is safe to use as a bucket index.
+uint64_t hash_string(const char* string, size_t length)
+{
+  uint64_t hash = hash_word(0, length);
+
+  for (; length >= sizeof(uint64_t); string += sizeof(uint64_t), length -= sizeof(uint64_t))
+  {
+    uint64_t word;
+    memcpy(&word, string, sizeof(uint64_t));
+    hash = hash_word(hash, word);
+  }
+
+  // The last 1 to 7 characters are zero-padded to a full word
+  if (length > 0)
+  {
+    uint64_t word = 0;
+    memcpy(&word, string, length);
+    hash = hash_word(hash, word);
+  }
+
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+// Finds the interned_name_t that holds the given name
+static interned_name_t* name_entry(const char* name)
+{
+  return (interned_name_t*)(name - offsetof(interned_name_t, name));
+}
+
+// Allocates a larger list of buckets, and places all entries in it again
+static void intern_table_resize(intern_table_t* table, size_t new_capacity)
+{
+  intern_bucket_t* old_buckets = table->buckets;
+  size_t old_capacity = table->n_buckets;
+
+  table->buckets = calloc(new_capacity, sizeof(intern_bucket_t));
+  table->n_buckets = new_capacity;
+
+  size_t mask = new_capacity - 1;
+  for (size_t i = 0; i < old_capacity; i++)
+  {
+    if (old_buckets[i].entry == NULL)
+      continue;
+    size_t bucket = old_buckets[i].hash & mask;
+    while (table->buckets[bucket].entry != NULL)
+      bucket = (bucket + 1) & mask;
+    table->buckets[bucket] = old_buckets[i];
+  }
+
+  free(old_buckets);
+}
+
+// Looks for the name in the table, and inserts a new copy of it if it is not found
+const char* intern_identifier(const char* name, size_t length)
+{
+  intern_table_t* table = &compilation->intern_table;
+
+  // Make sure that the fill ratio of the table never exceeds 1/2
+  if ((table->n_entries + 1) * 2 > table->n_buckets)
+    intern_table_resize(table, table->n_buckets == 0 ? 8 : table->n_buckets * 2);
+
+  uint64_t hash = hash_string(name, length);
+  size_t mask = table->n_buckets - 1;
+  size_t bucket = hash & mask;
+
+  // Iterate until we either find the name, or an empty bucket
+  while (table->buckets[bucket].entry != NULL)
+  {
+    interned_name_t* entry = table->buckets[bucket].entry;
+    if (table->buckets[bucket].hash == hash && entry->length == length
+        && memcmp(entry->name, name, length) == 0)
+      return entry->name;
+    bucket = (bucket + 1) & mask;
+  }
+
+  // This is the first time we see the name, so make the canonical copy
+  interned_name_t* entry = arena_alloc(&table->name_arena, sizeof(interned_name_t) + length + 1);
+  entry->hash = hash;
+  entry->length = length;
+  memcpy(entry->name, name, length);
+  entry->name[length] = '\0';
+
+  table->buckets[bucket] = (intern_bucket_t){.hash = hash, .entry = entry};
+  table->n_entries++;
+  return entry->name;
+}
+
+// Reads back the hash stored in front of an interned name
+uint64_t interned_hash(const char* name)
+{
+  assert(name != NULL);
+  return name_entry(name)->hash;
+}
+
+// Frees the buckets, and the arena holding all the names
+void destroy_intern_table(void)
+{
+  intern_table_t* table = &compilation->intern_table;
+  free(table->buckets);
+  table->buckets = NULL;
+  table->n_buckets = 0;
+  table->n_entries = 0;
+  arena_release(&table->name_arena);
+}
@@ -0,0 +1,37 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include "arena.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// The intern table gives every distinct identifier one canonical copy.
+// Two interned names are equal if and only if they are the same pointer,
+// and the hash of an interned name is computed once, when it is first interned.
+// Each compilation has its own intern table, see compilation.h.
+
+// The intern table is a hashmap using open addressing, with up to one entry per bucket.
+// The entries themselves are allocated from an arena, and never move.
+typedef struct intern_table
+{
+  struct intern_bucket* buckets;
+  size_t n_buckets; // Always 0 or a power of two
+  size_t n_entries;
+  arena_t name_arena;
+} intern_table_t;
+
+// Returns the canonical copy of the first length characters of name.
+// The returned string is NUL-terminated, and lives until destroy_intern_table is called.
+// Names are interned in the intern table of the active compilation.
+const char* intern_identifier(const char* name, size_t length);
+
+// Returns the hash of a name returned by intern_identifier, without hashing it again
+uint64_t interned_hash(const char* name);
+
+// Calculates a well mixed 64-bit hash of the first length characters of string
+uint64_t hash_string(const char* string, size_t length);
+
+// Frees the intern table of the active compilation, and all names interned in it
+void destroy_intern_table(void);
+
+#endif // INTERN_H
@@ -0,0 +1,1394 @@
+#include "vslc.h"
+
+// The name of each instruction in the printed IR
+static const char* const OPCODE_NAMES[IR_OPCODE_COUNT] = {
+    [IR_PARAMETER] = "parameter",
+    [IR_PHI] = "phi",
+    [IR_COPY] = "copy",
+    [IR_NEGATE] = "negate",
+    [IR_NOT] = "not",
+    [IR_ADD] = "add",
+    [IR_SUBTRACT] = "subtract",
+    [IR_MULTIPLY] = "multiply",
+    [IR_DIVIDE] = "divide",
+    [IR_EQUAL] = "equal",
+    [IR_NOT_EQUAL] = "not_equal",
+    [IR_LESS] = "less",
+    [IR_LESS_EQUAL] = "less_equal",
+    [IR_GREATER] = "greater",
+    [IR_GREATER_EQUAL] = "greater_equal",
+    [IR_LOAD_GLOBAL] = "load",
+    [IR_STORE_GLOBAL] = "store",
+    [IR_LOAD_ELEMENT] = "load",
+    [IR_STORE_ELEMENT] = "store",
+    [IR_CALL] = "call",
+    [IR_PRINT_STRING] = "print",
+    [IR_PRINT_NUMBER] = "print",
+    [IR_PRINT_NEWLINE] = "print_newline",
+    [IR_JUMP] = "jump",
+    [IR_BRANCH] = "branch",
+    [IR_RETURN] = "return",
+};
+
+// The number of registers that makes an expression evaluated before any other. Calls are, since
+// every value kept in a caller saved register is lost when they are made. An operator with calls
+// in both operands needs one more, like any other operator with operands needing as many
+#define CALL_REGISTERS (UINT8_MAX - 1)
+
+// Bits of the effects in an expression's label. Calls can change globals and array elements, so an expression reading
+// them can not be moved past a call, and neither can another call
+#define EFFECT_CALLS 1
+#define EFFECT_READS_MEMORY 2
+
+// The value of a statement's frame is free for the statement to use, while the value of an
+// expression's frame is true if its result is used. It is, except for calls made as statements
+#define RESULT_UNUSED 0
+#define RESULT_USED 1
+
+// The mark of a virtual register found to be used, while removing dead code
+#define VREG_USED UINT32_MAX
+
+static void emit_jump(uint32_t target);
+static void emit_branch(ir_value_t condition, uint32_t if_true, uint32_t if_false);
+static void count_registers(node_t* root);
+static ir_expression_label_t* label_of(const node_t* node);
+static void lower_statement(node_t* node);
+static void lower_body(node_t* body);
+static void finish_blocks(void);
+static void find_predecessors(void);
+static void print_function_ir(void);
+
+/* External interface */
+
+// Lowers the parameters, the local variables starting out as 0, and then the body of the function
+void ir_lower_function(symbol_t* function)
+{
+  ir_function_t* ir = &compilation->ir;
+  ir->symbol = function;
+  ir->n_variables = function->function_symtable->n_symbols;
+  ir->n_vregs = ir->n_variables;
+  ir->n_instructions = 0;
+  ir->n_blocks = 0;
+  ir->n_arguments = 0;
+  ir->n_values = 0;
+  ir->if_counter = 0;
+  ir->while_counter = 0;
+  ir->innermost_loop_end = IR_NO_BLOCK;
+  ir->current_block = IR_NO_BLOCK;
+
+  lower_body(node_child(function->node, 2));
+  finish_blocks();
+  find_predecessors();
+  // Phis are only placed for variables read before they are written in some block. Registers are
+  // allocated from the liveness of the IR out of SSA form
+  ir_number_global_vregs();
+  number_values();
+  ir_find_liveness();
+  compilation->statistics.n_ir_instructions += ir->n_instructions;
+}
+
+// Returns the number of blocks the instruction ending a block can jump to
+size_t ir_n_successors(const ir_instruction_t* terminator)
+{
+  switch (terminator->opcode)
+  {
+  case IR_JUMP:
+    return 1;
+  case IR_BRANCH:
+    return 2;
+  default:
+    return 0;
+  }
+}
+
+// Returns the position of the block among the predecessors of the successor. The block must be
+// one of them
+size_t ir_predecessor_index(uint32_t successor, uint32_t block)
+{
+  ir_function_t* ir = &compilation->ir;
+  const uint32_t* predecessors = &ir->predecessors[ir->blocks[successor].first_predecessor];
+  size_t i = 0;
+  while (predecessors[i] != block)
+    i++;
+  assert(i < ir->blocks[successor].n_predecessors);
+  return i;
+}
+
+// Frees the IR of the active compilation
+void destroy_ir(void)
+{
+  ir_function_t* ir = &compilation->ir;
+  free(ir->instructions);
+  free(ir->blocks);
+  free(ir->spare_blocks);
+  free(ir->arguments);
+  free(ir->predecessors);
+  free(ir->global_numbers);
+  free(ir->global_vregs);
+  free(ir->vreg_marks);
+  free(ir->sets);
+  free(ir->labels);
+  free(ir->values);
+  free(ir->block_marks);
+  free(ir->block_order);
+  free(ir->block_stack);
+  free(ir->next_definitions);
+  free(ir->instruction_work);
+  *ir = (ir_function_t){.instructions = NULL};
+}
+
+// Lowers the functions in the order they are defined, and prints them one by one
+void print_ir(void)
+{
+  symbol_table_t* global_symbols = compilation->global_symbols;
+  for (size_t i = 0; i < global_symbols->n_symbols; i++)
+  {
+    symbol_t* symbol = global_symbols->symbols[i];
+    if (symbol->type != SYMBOL_FUNCTION)
+      continue;
+    ir_lower_function(symbol);
+    print_function_ir();
+  }
+}
+
+/* Internal matters */
+
+// Returns the array, with room for at least n elements of the given size. The capacity of the
+// array is updated if it has to grow. The array is made even if it is empty
+static void* grow(void* array, size_t* capacity, size_t n, size_t element_size)
+{
+  if (array != NULL && n <= *capacity)
+    return array;
+  *capacity = n * 2 > 64 ? n * 2 : 64;
+  return realloc(array, *capacity * element_size);
+}
+
+// Returns a constant value
+static ir_value_t constant_value(int64_t constant)
+{
+  return (ir_value_t){.vreg = IR_NO_VREG, .constant = constant};
+}
+
+// Returns the value of a virtual register
+static ir_value_t vreg_value(ir_vreg_t vreg)
+{
+  return (ir_value_t){.vreg = vreg, .constant = 0};
+}
+
+// Returns a new virtual register for a temporary value
+static ir_vreg_t new_temporary(void)
+{
+  return compilation->ir.n_vregs++;
+}
+
+// Creates a block that has not started yet. Its instructions are added once it is started
+static uint32_t new_block(ir_block_kind_t kind, uint32_t number)
+{
+  ir_function_t* ir = &compilation->ir;
+  ir->blocks = grow(ir->blocks, &ir->blocks_capacity, ir->n_blocks + 1, sizeof(ir_block_t));
+  ir->blocks[ir->n_blocks] = (ir_block_t){.kind = kind, .number = number};
+  return ir->n_blocks++;
+}
+
+// Makes the block the one instructions are added to. If the block before it has not ended,
+// it ends by jumping to this one
+static void start_block(uint32_t block)
+{
+  ir_function_t* ir = &compilation->ir;
+  if (ir->current_block != IR_NO_BLOCK)
+    emit_jump(block);
+  ir->blocks[block].first_instruction = ir->n_instructions;
+  ir->current_block = block;
+}
+
+// Adds the instruction to the current block. Instructions after the end of a block, such as
+// statements after a return, start a block that can not be reached
+static void emit(ir_instruction_t instruction)
+{
+  ir_function_t* ir = &compilation->ir;
+  if (ir->current_block == IR_NO_BLOCK)
+    start_block(new_block(IR_BLOCK_UNREACHABLE, 0));
+
+  ir->instructions = grow(
+      ir->instructions, &ir->instructions_capacity, ir->n_instructions + 1,
+      sizeof(ir_instruction_t));
+  ir->instructions[ir->n_instructions++] = instruction;
+  ir->blocks[ir->current_block].n_instructions++;
+  if (ir_is_terminator(&instruction))
+    ir->current_block = IR_NO_BLOCK;
+}
+
+// Adds dest = a op b
+static void emit_operation(ir_opcode_t opcode, ir_vreg_t dest, ir_value_t a, ir_value_t b)
+{
+  emit((ir_instruction_t){.opcode = opcode, .dest = dest, .operands = {a, b}});
+}
+
+// Ends the current block by jumping to the target
+static void emit_jump(uint32_t target)
+{
+  emit((ir_instruction_t){.opcode = IR_JUMP, .dest = IR_NO_VREG, .targets = {target}});
+}
+
+// Ends the current block by branching on the condition. A condition computed by ! right before
+// is left out, by branching on its operand with the targets swapped instead
+static void emit_branch(ir_value_t condition, uint32_t if_true, uint32_t if_false)
+{
+  ir_function_t* ir = &compilation->ir;
+  while (condition.vreg != IR_NO_VREG && ir->current_block != IR_NO_BLOCK
+         && ir->blocks[ir->current_block].n_instructions > 0)
+  {
+    ir_instruction_t* last = &ir->instructions[ir->n_instructions - 1];
+    if (last->opcode != IR_NOT || last->dest != condition.vreg)
+      break;
+    condition = last->operands[0];
+    uint32_t target = if_true;
+    if_true = if_false;
+    if_false = target;
+    ir->n_instructions--;
+    ir->blocks[ir->current_block].n_instructions--;
+  }
+
+  emit((ir_instruction_t){
+      .opcode = IR_BRANCH,
+      .dest = IR_NO_VREG,
+      .operands = {condition},
+      .targets = {if_true, if_false}});
+}
+
+// Pushes the value of an expression that has been lowered
+static void push_value(ir_value_t value)
+{
+  ir_function_t* ir = &compilation->ir;
+  ir->values = grow(ir->values, &ir->values_capacity, ir->n_values + 1, sizeof(ir_value_t));
+  ir->values[ir->n_values++] = value;
+}
+
+// Pops the value of the expression lowered last
+static ir_value_t pop_value(void)
+{
+  ir_function_t* ir = &compilation->ir;
+  assert(ir->n_values > 0);
+  return ir->values[--ir->n_values];
+}
+
+// Makes the given statement the next to be lowered
+static void lower_statement(node_t* node)
+{
+  tree_walk_push(&compilation->tree_walk, node, 0);
+}
+
+// Makes the given expression the next to be lowered. Its value is pushed once it is done
+static void lower_expression(node_t* node)
+{
+  tree_walk_push(&compilation->tree_walk, node, RESULT_USED);
+}
+
+// Removes the node on top of the stack, once it has been lowered
+static void finish_node(void)
+{
+  tree_walk_pop(&compilation->tree_walk);
+}
+
+// Returns the symbol of the variable the identifier refers to, or reports why it is not one
+static symbol_t* variable_symbol(node_t* identifier)
+{
+  assert(identifier->type == IDENTIFIER);
+  symbol_t* symbol = identifier->symbol;
+  switch (symbol->type)
+  {
+  case SYMBOL_GLOBAL_VAR:
+  case SYMBOL_LOCAL_VAR:
+  case SYMBOL_PARAMETER:
+    return symbol;
+  case SYMBOL_FUNCTION:
+    compilation_error(
+        VSLC_ERROR_SEMANTIC, 0, "symbol '%s' is a function, not a variable", symbol->name);
+  case SYMBOL_GLOBAL_ARRAY:
+    compilation_error(
+        VSLC_ERROR_SEMANTIC, 0, "symbol '%s' is an array, not a variable", symbol->name);
+  default:
+    assert(false && "Unknown variable symbol type");
+  }
+}
+
+// Returns the symbol of the array indexed by the given ARRAY_INDEXING node, such as array[x]
+static symbol_t* array_symbol(node_t* node)
+{
+  assert(node->type == ARRAY_INDEXING);
+
+  symbol_t* symbol = node_child(node, 0)->symbol;
+  if (symbol->type != SYMBOL_GLOBAL_ARRAY)
+    compilation_error(VSLC_ERROR_SEMANTIC, 0, "symbol '%s' is not an array", symbol->name);
+  return symbol;
+}
+
+// Pushes the value of the variable. Parameters and local variables are read from their own
+// virtual registers, while global variables are loaded
+static void lower_variable(node_t* identifier)
+{
+  symbol_t* symbol = variable_symbol(identifier);
+  if (symbol->type != SYMBOL_GLOBAL_VAR)
+  {
+    push_value(vreg_value(symbol->sequence_number));
+    return;
+  }
+
+  ir_vreg_t dest = new_temporary();
+  emit((ir_instruction_t){.opcode = IR_LOAD_GLOBAL, .dest = dest, .symbol = symbol});
+  push_value(vreg_value(dest));
+}
+
+// Assigns the value to the variable. A temporary written by the instruction right before is
+// written straight to the variable instead
+static void assign_variable(node_t* identifier, ir_value_t value)
+{
+  ir_function_t* ir = &compilation->ir;
+  symbol_t* symbol = variable_symbol(identifier);
+  if (symbol->type == SYMBOL_GLOBAL_VAR)
+  {
+    emit((ir_instruction_t){
+        .opcode = IR_STORE_GLOBAL, .dest = IR_NO_VREG, .operands = {value}, .symbol = symbol});
+    return;
+  }
+
+  // The instruction computing an expression comes after those computing its operands
+  ir_vreg_t variable = symbol->sequence_number;
+  if (value.vreg != IR_NO_VREG && value.vreg >= ir->n_variables)
+  {
+    ir_instruction_t* last = &ir->instructions[ir->n_instructions - 1];
+    assert(last->dest == value.vreg && value.vreg == ir->n_vregs - 1);
+    last->dest = variable;
+    ir->n_vregs--;
+    return;
+  }
+  emit_operation(IR_COPY, variable, value, constant_value(0));
+}
+
+// Lowers a function call, which can either be a statement or an expression.
+// Step i lowers argument number i, counting from the right, like the order arguments were pushed
+// to the stack in before there was an IR
+static void lower_function_call(tree_walk_frame_t* frame)
+{
+  ir_function_t* ir = &compilation->ir;
+  node_t* call = frame->node;
+  symbol_t* symbol = node_child(call, 0)->symbol;
+  node_t* argument_list = node_child(call, 1);
+  size_t step = frame->step++;
+
+  if (step == 0)
+  {
+    if (symbol->type != SYMBOL_FUNCTION)
+      compilation_error(VSLC_ERROR_SEMANTIC, 0, "'%s' is not a function", symbol->name);
+
+    if (FUNC_PARAM_COUNT(symbol) != argument_list->n_children)
+      compilation_error(
+          VSLC_ERROR_SEMANTIC,
+          0,
+          "function '%s' expects '%zu' arguments, but '%zu' were given",
+          symbol->name,
+          (size_t)FUNC_PARAM_COUNT(symbol),
+          (size_t)argument_list->n_children);
+  }
+
+  size_t n_arguments = argument_list->n_children;
+  if (step < n_arguments)
+  {
+    lower_expression(node_child(argument_list, n_arguments - 1 - step));
+    return;
+  }
+
+  // The first argument was lowered last, and is on top of the value stack
+  size_t first_argument = ir->n_arguments;
+  ir->arguments = grow(
+      ir->arguments, &ir->arguments_capacity, ir->n_arguments + n_arguments, sizeof(ir_value_t));
+  for (size_t i = 0; i < n_arguments; i++)
+    ir->arguments[ir->n_arguments++] = pop_value();
+
+  bool result_used = frame->value == RESULT_USED;
+  ir_vreg_t dest = result_used ? new_temporary() : IR_NO_VREG;
+  emit((ir_instruction_t){
+      .opcode = IR_CALL,
+      .dest = dest,
+      .symbol = symbol,
+      .first_argument = first_argument,
+      .n_arguments = n_arguments});
+  finish_node();
+  if (result_used)
+    push_value(vreg_value(dest));
+}
+
+// Lowers array[x]. Step 0 lowers x
+static void lower_array_indexing(tree_walk_frame_t* frame)
+{
+  node_t* expression = frame->node;
+  if (frame->step++ == 0)
+  {
+    array_symbol(expression);
+    lower_expression(node_child(expression, 1));
+    return;
+  }
+
+  ir_vreg_t dest = new_temporary();
+  emit((ir_instruction_t){
+      .opcode = IR_LOAD_ELEMENT,
+      .dest = dest,
+      .operands = {pop_value()},
+      .symbol = array_symbol(expression)});
+  finish_node();
+  push_value(vreg_value(dest));
+}
+
+// Returns true if the rhs of the binary operator is lowered before the lhs. When neither operand
+// calls or reads memory, the order can not be seen, and the operand needing more registers goes
+// first: the fewer temporaries are alive at once, the fewer need to be spilled. Otherwise the
+// order is the one VSL programs have always seen: - and / evaluate their rhs first, and every
+// other operator its lhs
+static bool rhs_lowered_first(node_t* expression)
+{
+  ir_expression_label_t* lhs = label_of(node_child(expression, 0));
+  ir_expression_label_t* rhs = label_of(node_child(expression, 1));
+  if (lhs->effects != 0 || rhs->effects != 0)
+  {
+    operator_type_t op = expression->data.operator;
+    return op == OPERATOR_SUBTRACT || op == OPERATOR_DIVIDE;
+  }
+  return rhs->registers > lhs->registers;
+}
+
+// Lowers an operator with one or two operands. Each step lowers one operand, in the order picked
+// by rhs_lowered_first, and the last step applies the operator
+static void lower_operator(tree_walk_frame_t* frame)
+{
+  node_t* expression = frame->node;
+  operator_type_t op = expression->data.operator;
+  size_t step = frame->step++;
+
+  if (expression->n_children == 1)
+  {
+    if (step == 0)
+    {
+      lower_expression(node_child(expression, 0));
+      return;
+    }
+
+    ir_vreg_t dest = new_temporary();
+    ir_opcode_t opcode = op == OPERATOR_NEGATE ? IR_NEGATE : IR_NOT;
+    emit_operation(opcode, dest, pop_value(), constant_value(0));
+    finish_node();
+    push_value(vreg_value(dest));
+    return;
+  }
+
+  bool rhs_first = rhs_lowered_first(expression);
+  if (step < 2)
+  {
+    lower_expression(node_child(expression, rhs_first == (step == 0) ? 1 : 0));
+    return;
+  }
+
+  ir_value_t second = pop_value();
+  ir_value_t first = pop_value();
+  ir_vreg_t dest = new_temporary();
+  ir_opcode_t opcode = IR_ADD + (op - OPERATOR_ADD);
+  if (rhs_first)
+    emit_operation(opcode, dest, second, first);
+  else
+    emit_operation(opcode, dest, first, second);
+  finish_node();
+  push_value(vreg_value(dest));
+}
+
+// Step 0 lowers the right hand side. When assigning to an array element, step 1 lowers the index
+static void lower_assignment_statement(tree_walk_frame_t* frame)
+{
+  node_t* statement = frame->node;
+  node_t* dest = node_child(statement, 0);
+
+  switch (frame->step++)
+  {
+  case 0:
+    lower_expression(node_child(statement, 1));
+    return;
+  case 1:
+    if (dest->type == IDENTIFIER)
+    {
+      assign_variable(dest, pop_value());
+      finish_node();
+      return;
+    }
+    array_symbol(dest);
+    lower_expression(node_child(dest, 1));
+    return;
+  }
+
+  ir_value_t index = pop_value();
+  ir_value_t value = pop_value();
+  emit((ir_instruction_t){
+      .opcode = IR_STORE_ELEMENT,
+      .dest = IR_NO_VREG,
+      .operands = {index, value},
+      .symbol = array_symbol(dest)});
+  finish_node();
+}
+
+// Step 2i starts print item i, and step 2i + 1 prints it once its expression has been lowered
+static void lower_print_statement(tree_walk_frame_t* frame)
+{
+  node_t* print_items = node_child(frame->node, 0);
+  while (frame->step / 2 < print_items->n_children)
+  {
+    node_t* item = node_child(print_items, frame->step / 2);
+    if (item->type == STRING_LIST_REFERENCE)
+    {
+      emit((ir_instruction_t){
+          .opcode = IR_PRINT_STRING,
+          .dest = IR_NO_VREG,
+          .string = item->data.string_list_index});
+      frame->step += 2;
+    }
+    else if (frame->step % 2 == 0)
+    {
+      frame->step++;
+      lower_expression(item);
+      return;
+    }
+    else
+    {
+      emit((ir_instruction_t){
+          .opcode = IR_PRINT_NUMBER, .dest = IR_NO_VREG, .operands = {pop_value()}});
+      frame->step++;
+    }
+  }
+
+  emit((ir_instruction_t){.opcode = IR_PRINT_NEWLINE, .dest = IR_NO_VREG});
+  finish_node();
+}
+
+static void lower_return_statement(tree_walk_frame_t* frame)
+{
+  if (frame->step++ == 0)
+  {
+    lower_expression(node_child(frame->node, 0));
+    return;
+  }
+
+  emit((ir_instruction_t){.opcode = IR_RETURN, .dest = IR_NO_VREG, .operands = {pop_value()}});
+  finish_node();
+}
+
+// The blocks of an if statement are made together, so the value of the frame is the first of
+// them: THEN, followed by ELSE if there is an else statement, followed by ENDIF
+static void lower_if_statement(tree_walk_frame_t* frame)
+{
+  ir_function_t* ir = &compilation->ir;
+  node_t* statement = frame->node;
+  bool has_else = statement->n_children == 3;
+  uint32_t then_block = frame->value;
+  uint32_t end_block = then_block + (has_else ? 2 : 1);
+
+  switch (frame->step++)
+  {
+  case 0:
+    lower_expression(node_child(statement, 0));
+    return;
+  case 1:
+  {
+    uint32_t number = ir->if_counter++;
+    then_block = frame->value = new_block(IR_BLOCK_THEN, number);
+    if (has_else)
+      new_block(IR_BLOCK_ELSE, number);
+    end_block = new_block(IR_BLOCK_ENDIF, number);
+
+    emit_branch(pop_value(), then_block, then_block + 1);
+    start_block(then_block);
+    lower_statement(node_child(statement, 1));
+    return;
+  }
+  case 2:
+    if (has_else)
+    {
+      if (ir->current_block != IR_NO_BLOCK)
+        emit_jump(end_block);
+      start_block(then_block + 1);
+      lower_statement(node_child(statement, 2));
+      return;
+    }
+    break;
+  }
+
+  start_block(end_block);
+  finish_node();
+}
+
+// The blocks of a while loop are made together: WHILE, DO and ENDWHILE. The value of the frame
+// holds the first of them in its low 32 bits, and the end of the loop around it in the high bits
+static void lower_while_statement(tree_walk_frame_t* frame)
+{
+  ir_function_t* ir = &compilation->ir;
+  node_t* statement = frame->node;
+  uint32_t while_block = (uint32_t)frame->value;
+
+  switch (frame->step++)
+  {
+  case 0:
+  {
+    uint32_t number = ir->while_counter++;
+    while_block = new_block(IR_BLOCK_WHILE, number);
+    new_block(IR_BLOCK_DO, number);
+    new_block(IR_BLOCK_ENDWHILE, number);
+    frame->value = (size_t)ir->innermost_loop_end << 32 | while_block;
+
+    start_block(while_block);
+    lower_expression(node_child(statement, 0));
+    return;
+  }
+  case 1:
+    emit_branch(pop_value(), while_block + 1, while_block + 2);
+    start_block(while_block + 1);
+    ir->innermost_loop_end = while_block + 2;
+    lower_statement(node_child(statement, 1));
+    return;
+  }
+
+  if (ir->current_block != IR_NO_BLOCK)
+    emit_jump(while_block);
+  ir->innermost_loop_end = frame->value >> 32;
+  start_block(while_block + 2);
+  finish_node();
+}
+
+// Takes the next step of lowering the node on top of the tree walk stack
+static void lower_node_step(tree_walk_frame_t* frame)
+{
+  ir_function_t* ir = &compilation->ir;
+  node_t* node = frame->node;
+
+  // Statements removed by constant folding are left as NULL
+  if (node == NULL)
+  {
+    finish_node();
+    return;
+  }
+
+  switch (node->type)
+  {
+  case NUMBER_LITERAL:
+    finish_node();
+    push_value(constant_value(node->data.number_literal));
+    break;
+  case IDENTIFIER:
+    finish_node();
+    lower_variable(node);
+    break;
+  case ARRAY_INDEXING:
+    lower_array_indexing(frame);
+    break;
+  case OPERATOR:
+    lower_operator(frame);
+    break;
+  case FUNCTION_CALL:
+    lower_function_call(frame);
+    break;
+  case BLOCK:
+  {
+    // Declarations have already been bound, so only the statements are lowered
+    node_t* statement_list = node_child(node, node->n_children - 1);
+    if (frame->step < statement_list->n_children)
+    {
+      size_t i = frame->step++;
+      lower_statement(node_child(statement_list, i));
+    }
+    else
+      finish_node();
+    break;
+  }
+  case ASSIGNMENT_STATEMENT:
+    lower_assignment_statement(frame);
+    break;
+  case PRINT_STATEMENT:
+    lower_print_statement(frame);
+    break;
+  case RETURN_STATEMENT:
+    lower_return_statement(frame);
+    break;
+  case IF_STATEMENT:
+    lower_if_statement(frame);
+    break;
+  case WHILE_STATEMENT:
+    lower_while_statement(frame);
+    break;
+  case BREAK_STATEMENT:
+    // Leaves the innermost while loop
+    if (ir->innermost_loop_end == IR_NO_BLOCK)
+      compilation_error(VSLC_ERROR_SEMANTIC, 0, "break statement outside of a while loop");
+    emit_jump(ir->innermost_loop_end);
+    finish_node();
+    break;
+  default:
+    assert(false && "Unknown statement or expression type");
+  }
+}
+
+// Lowers the body of the function into its entry block, and the blocks after it. The entry block
+// starts by reading the parameters, and setting the local variables to 0
+static void lower_body(node_t* body)
+{
+  ir_function_t* ir = &compilation->ir;
+  symbol_t* function = ir->symbol;
+  start_block(new_block(IR_BLOCK_ENTRY, 0));
+
+  size_t n_parameters = FUNC_PARAM_COUNT(function);
+  for (size_t i = 0; i < ir->n_variables; i++)
+  {
+    if (i < n_parameters)
+      emit((ir_instruction_t){.opcode = IR_PARAMETER, .dest = i, .parameter = i});
+    else
+      emit_operation(IR_COPY, i, constant_value(0), constant_value(0));
+  }
+
+  count_registers(body);
+  tree_walk_stack_t* stack = &compilation->tree_walk;
+  size_t stack_base = stack->length;
+  lower_statement(body);
+  while (stack->length > stack_base)
+    lower_node_step(tree_walk_top(stack));
+
+  // Functions return 0 if they end without a return statement
+  if (ir->current_block != IR_NO_BLOCK)
+    emit((ir_instruction_t){
+        .opcode = IR_RETURN, .dest = IR_NO_VREG, .operands = {constant_value(0)}});
+}
+
+// Returns the number of registers needed to evaluate the expression without spilling, from the
+// numbers needed by its operands, as labeled by the Sethi-Ullman algorithm. Parameters, local
+// variables and constants are already in registers, or need none
+static uint8_t registers_needed(node_t* node)
+{
+  switch (node->type)
+  {
+  case NUMBER_LITERAL:
+    return 0;
+  case IDENTIFIER:
+    return node->symbol != NULL && node->symbol->type == SYMBOL_GLOBAL_VAR ? 1 : 0;
+  case ARRAY_INDEXING:
+  {
+    uint8_t index = label_of(node_child(node, 1))->registers;
+    return index > 1 ? index : 1;
+  }
+  case FUNCTION_CALL:
+    return CALL_REGISTERS;
+  case OPERATOR:
+  {
+    uint8_t first = label_of(node_child(node, 0))->registers;
+    if (node->n_children == 1)
+      return first > 1 ? first : 1;
+    uint8_t second = label_of(node_child(node, 1))->registers;
+    if (first != second)
+      return first > second ? first : second;
+    return first < UINT8_MAX ? first + 1 : first;
+  }
+  default:
+    return 0;
+  }
+}
+
+// Returns the effects of evaluating the expression, those of its operands included
+static uint8_t effects_of(node_t* node)
+{
+  uint8_t effects = 0;
+  if (node->type == FUNCTION_CALL)
+    effects |= EFFECT_CALLS;
+  else if (node->type == ARRAY_INDEXING)
+    effects |= EFFECT_READS_MEMORY;
+  else if (node->type == IDENTIFIER)
+    return node->symbol != NULL && node->symbol->type == SYMBOL_GLOBAL_VAR ? EFFECT_READS_MEMORY
+                                                                           : 0;
+
+  for (size_t i = 0; i < node->n_children; i++)
+  {
+    node_t* child = node_child(node, i);
+    if (child != NULL)
+      effects |= label_of(child)->effects;
+  }
+  return effects;
+}
+
+// Returns the label of the expression, as found by count_registers
+static ir_expression_label_t* label_of(const node_t* node)
+{
+  return &compilation->ir.labels[node_id(node)];
+}
+
+// Labels every expression in the given statement with the number of registers it needs and its
+// effects, children before their parents
+static void count_registers(node_t* root)
+{
+  ir_function_t* ir = &compilation->ir;
+  ir->labels = grow(
+      ir->labels, &ir->labels_capacity, compilation->n_nodes, sizeof(ir_expression_label_t));
+
+  tree_walk_stack_t* stack = &compilation->tree_walk;
+  size_t stack_base = stack->length;
+
+  tree_walk_push(stack, root, 0);
+  while (stack->length > stack_base)
+  {
+    tree_walk_frame_t* frame = tree_walk_top(stack);
+    node_t* node = frame->node;
+
+    // Statements removed by constant folding are left as NULL, and IDENTIFIER nodes use the space
+    // of their children for the symbol
+    size_t n_children = node == NULL || node->type == IDENTIFIER ? 0 : node->n_children;
+    if (frame->step < n_children)
+    {
+      size_t i = frame->step++;
+      tree_walk_push(stack, node_child(node, i), 0);
+      continue;
+    }
+
+    if (node != NULL)
+    {
+      label_of(node)->registers = registers_needed(node);
+      label_of(node)->effects = effects_of(node);
+    }
+    tree_walk_pop(stack);
+  }
+}
+
+// Returns the instruction ending the block
+static ir_instruction_t* block_terminator(const ir_block_t* block)
+{
+  return &compilation->ir.instructions[block->first_instruction + block->n_instructions - 1];
+}
+
+// Makes room for the scratch space of every block
+static void reserve_block_scratch(size_t n_blocks)
+{
+  ir_function_t* ir = &compilation->ir;
+  if (n_blocks <= ir->block_scratch_capacity)
+    return;
+  ir->block_scratch_capacity = n_blocks * 2;
+  ir->block_marks = realloc(ir->block_marks, ir->block_scratch_capacity * sizeof(uint32_t));
+  ir->block_order = realloc(ir->block_order, ir->block_scratch_capacity * sizeof(uint32_t));
+  ir->block_stack = realloc(ir->block_stack, ir->block_scratch_capacity * sizeof(uint32_t));
+}
+
+// Makes room for the scratch space of every virtual register
+static void reserve_vreg_scratch(size_t n_vregs)
+{
+  ir_function_t* ir = &compilation->ir;
+  if (ir->vreg_marks != NULL && n_vregs <= ir->vregs_capacity)
+    return;
+  ir->vregs_capacity = n_vregs * 2 + 16;
+  ir->vreg_marks = realloc(ir->vreg_marks, ir->vregs_capacity * sizeof(uint32_t));
+  ir->global_numbers = realloc(ir->global_numbers, ir->vregs_capacity * sizeof(uint32_t));
+  ir->global_vregs = realloc(ir->global_vregs, ir->vregs_capacity * sizeof(ir_vreg_t));
+}
+
+// Makes room for the scratch space of every instruction
+static void reserve_instruction_scratch(size_t n_instructions)
+{
+  ir_function_t* ir = &compilation->ir;
+  if (n_instructions <= ir->instruction_scratch_capacity)
+    return;
+  ir->instruction_scratch_capacity = n_instructions * 2;
+  ir->next_definitions =
+      realloc(ir->next_definitions, ir->instruction_scratch_capacity * sizeof(uint32_t));
+  ir->instruction_work =
+      realloc(ir->instruction_work, ir->instruction_scratch_capacity * sizeof(uint32_t));
+}
+
+// Orders block numbers by where the blocks start, for qsort
+static int compare_block_starts(const void* a, const void* b)
+{
+  const ir_block_t* blocks = compilation->ir.blocks;
+  uint32_t x = blocks[*(const uint32_t*)a].first_instruction;
+  uint32_t y = blocks[*(const uint32_t*)b].first_instruction;
+  return x < y ? -1 : x > y;
+}
+
+// Renumbers the blocks in the order their instructions were lowered, which is the order their code
+// is laid out in, and leaves out every block that can not be reached from the entry block
+static void finish_blocks(void)
+{
+  ir_function_t* ir = &compilation->ir;
+  reserve_block_scratch(ir->n_blocks);
+
+  // Blocks are marked once they are found to be reachable
+  uint32_t* reachable = ir->block_marks;
+  memset(reachable, 0, ir->n_blocks * sizeof(uint32_t));
+  size_t n_stack = 0;
+  reachable[0] = 1;
+  ir->block_stack[n_stack++] = 0;
+  while (n_stack > 0)
+  {
+    ir_instruction_t* terminator = block_terminator(&ir->blocks[ir->block_stack[--n_stack]]);
+    for (size_t i = 0; i < ir_n_successors(terminator); i++)
+    {
+      uint32_t successor = terminator->targets[i];
+      if (!reachable[successor])
+      {
+        reachable[successor] = 1;
+        ir->block_stack[n_stack++] = successor;
+      }
+    }
+  }
+
+  size_t n_reachable = 0;
+  for (uint32_t i = 0; i < ir->n_blocks; i++)
+    if (reachable[i])
+      ir->block_order[n_reachable++] = i;
+  qsort(ir->block_order, n_reachable, sizeof(uint32_t), compare_block_starts);
+
+  // The new number of each reachable block replaces its mark
+  uint32_t* new_numbers = ir->block_marks;
+  for (uint32_t i = 0; i < ir->n_blocks; i++)
+    new_numbers[i] = IR_NO_BLOCK;
+  for (uint32_t i = 0; i < n_reachable; i++)
+    new_numbers[ir->block_order[i]] = i;
+
+  ir->spare_blocks = grow(
+      ir->spare_blocks, &ir->spare_blocks_capacity, n_reachable, sizeof(ir_block_t));
+  for (size_t i = 0; i < n_reachable; i++)
+  {
+    ir_block_t* block = &ir->spare_blocks[i];
+    *block = ir->blocks[ir->block_order[i]];
+    ir_instruction_t* terminator = block_terminator(block);
+    for (size_t j = 0; j < ir_n_successors(terminator); j++)
+      terminator->targets[j] = new_numbers[terminator->targets[j]];
+  }
+
+  ir_block_t* blocks = ir->blocks;
+  ir->blocks = ir->spare_blocks;
+  ir->spare_blocks = blocks;
+  size_t capacity = ir->blocks_capacity;
+  ir->blocks_capacity = ir->spare_blocks_capacity;
+  ir->spare_blocks_capacity = capacity;
+  ir->n_blocks = n_reachable;
+}
+
+// Fills in the predecessors of every block
+static void find_predecessors(void)
+{
+  ir_function_t* ir = &compilation->ir;
+  for (size_t i = 0; i < ir->n_blocks; i++)
+    ir->blocks[i].n_predecessors = 0;
+
+  size_t n_edges = 0;
+  for (size_t i = 0; i < ir->n_blocks; i++)
+  {
+    ir_instruction_t* terminator = block_terminator(&ir->blocks[i]);
+    for (size_t j = 0; j < ir_n_successors(terminator); j++)
+    {
+      ir->blocks[terminator->targets[j]].n_predecessors++;
+      n_edges++;
+    }
+  }
+
+  ir->predecessors = grow(ir->predecessors, &ir->predecessors_capacity, n_edges, sizeof(uint32_t));
+  size_t position = 0;
+  for (size_t i = 0; i < ir->n_blocks; i++)
+  {
+    ir->blocks[i].first_predecessor = position;
+    position += ir->blocks[i].n_predecessors;
+    ir->blocks[i].n_predecessors = 0;
+  }
+
+  for (uint32_t i = 0; i < ir->n_blocks; i++)
+  {
+    ir_instruction_t* terminator = block_terminator(&ir->blocks[i]);
+    for (size_t j = 0; j < ir_n_successors(terminator); j++)
+    {
+      ir_block_t* successor = &ir->blocks[terminator->targets[j]];
+      ir->predecessors[successor->first_predecessor + successor->n_predecessors++] = i;
+    }
+  }
+}
+
+// Removed instructions are skipped until they are moved out
+static bool is_removed(const ir_instruction_t* instruction)
+{
+  return instruction->opcode == IR_REMOVED;
+}
+
+// Numbers the virtual registers read before they are written in some block, in the order they are
+// read. Arguments of phis count as read before anything in their block
+void ir_number_global_vregs(void)
+{
+  ir_function_t* ir = &compilation->ir;
+  reserve_vreg_scratch(ir->n_vregs);
+  memset(ir->vreg_marks, 0, ir->n_vregs * sizeof(uint32_t));
+  for (size_t i = 0; i < ir->n_vregs; i++)
+    ir->global_numbers[i] = IR_NO_VREG;
+  ir->n_global = 0;
+
+  // The mark of a virtual register is the number of the last block writing it, plus 1
+  for (uint32_t b = 0; b < ir->n_blocks; b++)
+  {
+    ir_block_t* block = &ir->blocks[b];
+    for (size_t i = block->first_instruction; i < block->first_instruction + block->n_instructions;
+         i++)
+    {
+      ir_instruction_t* instruction = &ir->instructions[i];
+      if (is_removed(instruction))
+        continue;
+      bool is_phi = instruction->opcode == IR_PHI;
+      for (size_t j = 0; j < ir_n_uses(instruction); j++)
+      {
+        ir_vreg_t vreg = ir_use(ir, instruction, j)->vreg;
+        if (vreg != IR_NO_VREG && (is_phi || ir->vreg_marks[vreg] != b + 1)
+            && ir->global_numbers[vreg] == IR_NO_VREG)
+        {
+          ir->global_numbers[vreg] = ir->n_global;
+          ir->global_vregs[ir->n_global++] = vreg;
+        }
+      }
+      if (instruction->dest != IR_NO_VREG)
+        ir->vreg_marks[instruction->dest] = b + 1;
+    }
+  }
+}
+
+// Finds the live_in and live_out sets of every block. Each block reads the virtual registers in its
+// gen set before writing them, and writes those in its kill set. The arguments of phis are read at
+// the end of the predecessors, rather than in the block of the phi
+void ir_find_liveness(void)
+{
+  ir_function_t* ir = &compilation->ir;
+  ir_number_global_vregs();
+
+  size_t words = (ir->n_global + 63) / 64;
+  size_t set_words = ir->n_blocks * words;
+  ir->words_per_set = words;
+  ir->sets = grow(ir->sets, &ir->sets_capacity, set_words * 4, sizeof(uint64_t));
+  memset(ir->sets, 0, set_words * 4 * sizeof(uint64_t));
+  ir->live_in = ir->sets;
+  ir->live_out = ir->sets + set_words;
+  uint64_t* gen = ir->sets + set_words * 2;
+  uint64_t* kill = ir->sets + set_words * 3;
+
+  // The marks of ir_number_global_vregs are all at most the number of blocks
+  for (uint32_t b = 0; b < ir->n_blocks; b++)
+  {
+    ir_block_t* block = &ir->blocks[b];
+    uint32_t mark = ir->n_blocks + b + 1;
+    for (size_t i = block->first_instruction; i < block->first_instruction + block->n_instructions;
+         i++)
+    {
+      ir_instruction_t* instruction = &ir->instructions[i];
+      if (is_removed(instruction))
+        continue;
+      for (size_t j = 0; j < ir_n_uses(instruction); j++)
+      {
+        ir_vreg_t vreg = ir_use(ir, instruction, j)->vreg;
+        if (vreg == IR_NO_VREG)
+          continue;
+        uint32_t number = ir->global_numbers[vreg];
+        if (instruction->opcode == IR_PHI)
+        {
+          // Live out of predecessor j. The live_out sets only ever grow from here
+          uint32_t predecessor = ir->predecessors[block->first_predecessor + j];
+          ir->live_out[predecessor * words + number / 64] |= (uint64_t)1 << (number % 64);
+        }
+        else if (ir->vreg_marks[vreg] != mark)
+          gen[b * words + number / 64] |= (uint64_t)1 << (number % 64);
+      }
+      ir_vreg_t dest = instruction->dest;
+      if (dest != IR_NO_VREG)
+      {
+        ir->vreg_marks[dest] = mark;
+        uint32_t number = ir->global_numbers[dest];
+        if (number != IR_NO_VREG)
+          kill[b * words + number / 64] |= (uint64_t)1 << (number % 64);
+      }
+    }
+  }
+
+  // Every block is visited once, from the last to the first, and then again whenever the live_in
+  // set of one of its successors grows. The mark of a block is 1 while it waits to be visited
+  reserve_block_scratch(ir->n_blocks);
+  size_t n_work = 0;
+  for (uint32_t b = 0; b < ir->n_blocks; b++)
+  {
+    ir->block_stack[n_work++] = b;
+    ir->block_marks[b] = 1;
+  }
+  while (n_work > 0)
+  {
+    uint32_t b = ir->block_stack[--n_work];
+    ir->block_marks[b] = 0;
+    ir_block_t* block = &ir->blocks[b];
+    uint64_t* in = &ir->live_in[b * words];
+    uint64_t* out = &ir->live_out[b * words];
+    ir_instruction_t* terminator = block_terminator(block);
+    for (size_t i = 0; i < ir_n_successors(terminator); i++)
+    {
+      uint64_t* successor_in = &ir->live_in[terminator->targets[i] * words];
+      for (size_t w = 0; w < words; w++)
+        out[w] |= successor_in[w];
+    }
+    bool changed = false;
+    for (size_t w = 0; w < words; w++)
+    {
+      uint64_t live = gen[b * words + w] | (out[w] & ~kill[b * words + w]);
+      if (live != in[w])
+      {
+        in[w] = live;
+        changed = true;
+      }
+    }
+    if (!changed)
+      continue;
+    for (size_t i = block->first_predecessor; i < block->first_predecessor + block->n_predecessors;
+         i++)
+    {
+      uint32_t predecessor = ir->predecessors[i];
+      if (ir->block_marks[predecessor] == 0)
+      {
+        ir->block_stack[n_work++] = predecessor;
+        ir->block_marks[predecessor] = 1;
+      }
+    }
+  }
+}
+
+// Returns true if the instruction does more than write its dest, and must be kept even if its
+// value is never used. Division is kept too, since dividing by zero stops the program
+static bool has_side_effects(const ir_instruction_t* instruction)
+{
+  switch (instruction->opcode)
+  {
+  case IR_DIVIDE:
+  case IR_STORE_GLOBAL:
+  case IR_STORE_ELEMENT:
+  case IR_CALL:
+  case IR_PRINT_STRING:
+  case IR_PRINT_NUMBER:
+  case IR_PRINT_NEWLINE:
+  case IR_JUMP:
+  case IR_BRANCH:
+  case IR_RETURN:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// Marks the virtual register as used, unless it already is, and adds the instructions writing it
+// to the work list. Instructions with side effects are kept anyway, and are never added
+static void mark_used(ir_vreg_t vreg, size_t* n_work)
+{
+  ir_function_t* ir = &compilation->ir;
+  if (vreg == IR_NO_VREG || ir->vreg_marks[vreg] == VREG_USED)
+    return;
+  for (uint32_t i = ir->vreg_marks[vreg]; i != 0; i = ir->next_definitions[i - 1])
+    if (!has_side_effects(&ir->instructions[i - 1]))
+      ir->instruction_work[(*n_work)++] = i - 1;
+  ir->vreg_marks[vreg] = VREG_USED;
+}
+
+// Removes the instructions whose values are never used. The instructions with side effects are
+// kept, and from them, a work list finds every instruction writing a virtual register read by a
+// kept instruction. Values only used by each other, such as a variable that is only ever
+// incremented, are removed as well. A call whose value is not used is kept without its dest.
+// At last, the instructions left are moved together, without those of unreachable blocks
+void ir_remove_dead_code(void)
+{
+  ir_function_t* ir = &compilation->ir;
+  reserve_vreg_scratch(ir->n_vregs);
+  reserve_instruction_scratch(ir->n_instructions);
+
+  // Until a virtual register is used, its mark is the position of the last instruction writing
+  // it, plus 1, and each instruction links to the one before it writing the same virtual register
+  memset(ir->vreg_marks, 0, ir->n_vregs * sizeof(uint32_t));
+  size_t n_work = 0;
+  for (uint32_t b = 0; b < ir->n_blocks; b++)
+  {
+    ir_block_t* block = &ir->blocks[b];
+    for (size_t i = block->first_instruction; i < block->first_instruction + block->n_instructions;
+         i++)
+    {
+      ir_instruction_t* instruction = &ir->instructions[i];
+      if (is_removed(instruction))
+        continue;
+      if (has_side_effects(instruction))
+        ir->instruction_work[n_work++] = i;
+      if (instruction->dest != IR_NO_VREG)
+      {
+        ir->next_definitions[i] = ir->vreg_marks[instruction->dest];
+        ir->vreg_marks[instruction->dest] = i + 1;
+      }
+    }
+  }
+
+  // Every instruction is added to the work list at most once
+  while (n_work > 0)
+  {
+    ir_instruction_t* instruction = &ir->instructions[ir->instruction_work[--n_work]];
+    for (size_t j = 0; j < ir_n_uses(instruction); j++)
+      mark_used(ir_use(ir, instruction, j)->vreg, &n_work);
+  }
+
+  for (uint32_t b = 0; b < ir->n_blocks; b++)
+  {
+    ir_block_t* block = &ir->blocks[b];
+    for (size_t i = block->first_instruction; i < block->first_instruction + block->n_instructions;
+         i++)
+    {
+      ir_instruction_t* instruction = &ir->instructions[i];
+      ir_vreg_t dest = instruction->dest;
+      if (is_removed(instruction) || dest == IR_NO_VREG || ir->vreg_marks[dest] == VREG_USED)
+        continue;
+      if (!has_side_effects(instruction))
+        instruction->opcode = IR_REMOVED;
+      else if (instruction->opcode == IR_CALL)
+        instruction->dest = IR_NO_VREG;
+    }
+  }
+
+  // The blocks are in the order of their instructions, so the instructions only move down
+  size_t n_instructions = 0;
+  for (size_t b = 0; b < ir->n_blocks; b++)
+  {
+    ir_block_t* block = &ir->blocks[b];
+    size_t first = n_instructions;
+    for (size_t i = block->first_instruction; i < block->first_instruction + block->n_instructions;
+         i++)
+      if (!is_removed(&ir->instructions[i]))
+        ir->instructions[n_instructions++] = ir->instructions[i];
+    block->first_instruction = first;
+    block->n_instructions = n_instructions - first;
+  }
+  ir->n_instructions = n_instructions;
+}
+
+// Prints the label of the block, such as THEN0
+static void print_block_label(const ir_block_t* block)
+{
+  sink_puts(&compilation->output, IR_BLOCK_NAMES[block->kind]);
+  if (block->kind != IR_BLOCK_ENTRY)
+    sink_uint(&compilation->output, block->number);
+}
+
+// Prints a virtual register as %number, or a constant as itself
+static void print_value(ir_value_t value)
+{
+  sink_t* output = &compilation->output;
+  if (value.vreg == IR_NO_VREG)
+    sink_int(output, value.constant);
+  else
+  {
+    sink_putc(output, '%');
+    sink_uint(output, value.vreg);
+  }
+}
+
+// Prints one instruction on a line of its own, such as "%4 = add %0, 1" or "store @a[%4], 0"
+static void print_instruction(ir_instruction_t* instruction)
+{
+  ir_function_t* ir = &compilation->ir;
+  sink_t* output = &compilation->output;
+  sink_puts(output, "  ");
+  if (instruction->dest != IR_NO_VREG)
+  {
+    print_value((ir_value_t){.vreg = instruction->dest});
+    sink_puts(output, " = ");
+  }
+  sink_puts(output, OPCODE_NAMES[instruction->opcode]);
+
+  switch (instruction->opcode)
+  {
+  case IR_PARAMETER:
+    sink_printf(output, " %zu", instruction->parameter);
+    break;
+  case IR_LOAD_GLOBAL:
+  case IR_STORE_GLOBAL:
+    sink_printf(output, " @%s", instruction->symbol->name);
+    if (instruction->opcode == IR_STORE_GLOBAL)
+    {
+      sink_puts(output, ", ");
+      print_value(instruction->operands[0]);
+    }
+    break;
+  case IR_LOAD_ELEMENT:
+  case IR_STORE_ELEMENT:
+    sink_printf(output, " @%s[", instruction->symbol->name);
+    print_value(instruction->operands[0]);
+    sink_putc(output, ']');
+    if (instruction->opcode == IR_STORE_ELEMENT)
+    {
+      sink_puts(output, ", ");
+      print_value(instruction->operands[1]);
+    }
+    break;
+  case IR_CALL:
+  case IR_PHI:
+    if (instruction->opcode == IR_CALL)
+      sink_printf(output, " @%s", instruction->symbol->name);
+    sink_putc(output, '(');
+    for (size_t i = 0; i < instruction->n_arguments; i++)
+    {
+      if (i > 0)
+        sink_puts(output, ", ");
+      print_value(*ir_use(ir, instruction, i));
+    }
+    sink_putc(output, ')');
+    break;
+  case IR_PRINT_STRING:
+    sink_printf(output, " %s", compilation->string_list[instruction->string]);
+    break;
+  case IR_JUMP:
+    sink_putc(output, ' ');
+    print_block_label(&ir->blocks[instruction->targets[0]]);
+    break;
+  case IR_BRANCH:
+    sink_putc(output, ' ');
+    print_value(instruction->operands[0]);
+    for (size_t i = 0; i < 2; i++)
+    {
+      sink_puts(output, ", ");
+      print_block_label(&ir->blocks[instruction->targets[i]]);
+    }
+    break;
+  default:
+    for (size_t i = 0; i < ir_n_uses(instruction); i++)
+    {
+      sink_puts(output, i == 0 ? " " : ", ");
+      print_value(instruction->operands[i]);
+    }
+    break;
+  }
+  sink_putc(output, '\n');
+}
+
+// Prints the IR of the function lowered last: its parameters with their virtual registers,
+// followed by its blocks, each labeled with the blocks jumping to it
+static void print_function_ir(void)
+{
+  ir_function_t* ir = &compilation->ir;
+  sink_t* output = &compilation->output;
+  symbol_table_t* symbols = ir->symbol->function_symtable;
+  size_t n_parameters = FUNC_PARAM_COUNT(ir->symbol);
+
+  sink_printf(output, "function %s(", ir->symbol->name);
+  for (size_t i = 0; i < n_parameters; i++)
+    sink_printf(output, "%s%%%zu %s", i > 0 ? ", " : "", i, symbols->symbols[i]->name);
+  sink_puts(output, ")\n");
+
+  for (size_t b = 0; b < ir->n_blocks; b++)
+  {
+    ir_block_t* block = &ir->blocks[b];
+    print_block_label(block);
+    sink_putc(output, ':');
+    for (size_t i = 0; i < block->n_predecessors; i++)
+    {
+      sink_puts(output, i == 0 ? " ; from " : ", ");
+      print_block_label(&ir->blocks[ir->predecessors[block->first_predecessor + i]]);
+    }
+    sink_putc(output, '\n');
+    for (size_t i = 0; i < block->n_instructions; i++)
+      print_instruction(&ir->instructions[block->first_instruction + i]);
+  }
+  sink_putc(output, '\n');
+}
@@ -0,0 +1,294 @@
+#ifndef IR_H
+#define IR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Before code is generated for a function, it is lowered from the bound syntax tree to a
+// three-address intermediate representation, which generator.c selects x86-64 instructions from.
+//
+// Every value is kept in a virtual register, and a function may have any number of them.
+// The first virtual registers are the parameters and local variables of the function, numbered
+// by their sequence number, and are written by every assignment to them. Every other virtual
+// register holds a temporary value, and is written by exactly one instruction.
+// An instruction writes at most one virtual register, and reads up to two operands, which are
+// virtual registers or constants. Calls also read a list of arguments.
+//
+// The instructions of a function are kept in basic blocks, which together form its control flow
+// graph. Each block ends with a jump, a branch or a return, and nothing else in the block jumps.
+// The blocks are kept in the order their code is laid out, starting with the entry block, and
+// every block can be reached from the entry block.
+//
+// Local variables start out as 0, which the entry block makes explicit. Values that are never
+// used are removed in SSA form, so that these assignments and unused parameters cost nothing.
+//
+// Once lowered, the function is put in SSA form, where every variable is split into one virtual
+// register for each value it is assigned, and values computed again are found and reused. The
+// function is then taken out of SSA form, see ssa.h, so a variable may be kept in several virtual
+// registers, and the first virtual registers are only left to the parameters.
+//
+// The IR of every function is printed with -ir, before registers are allocated.
+
+struct symbol;
+
+typedef uint32_t ir_vreg_t;
+
+// Marks an instruction that writes no virtual register, or an operand that is a constant
+#define IR_NO_VREG UINT32_MAX
+
+// Marks a missing block
+#define IR_NO_BLOCK UINT32_MAX
+
+typedef enum
+{
+  IR_PARAMETER, // dest = the parameter with the number in parameter
+  IR_PHI,       // dest = argument number i, when coming from predecessor number i. In SSA form only
+  IR_COPY,      // dest = a
+  IR_NEGATE,    // dest = -a
+  IR_NOT,       // dest = !a
+  // dest = a op b, in the order of the binary operators in operators.h.
+  // Comparisons give 1 if they hold, and 0 otherwise
+  IR_ADD,
+  IR_SUBTRACT,
+  IR_MULTIPLY,
+  IR_DIVIDE,
+  IR_EQUAL,
+  IR_NOT_EQUAL,
+  IR_LESS,
+  IR_LESS_EQUAL,
+  IR_GREATER,
+  IR_GREATER_EQUAL,
+  IR_LOAD_GLOBAL,   // dest = the global variable symbol
+  IR_STORE_GLOBAL,  // the global variable symbol = a
+  IR_LOAD_ELEMENT,  // dest = symbol[a]
+  IR_STORE_ELEMENT, // symbol[a] = b
+  IR_CALL,          // dest = symbol(arguments), or no dest if the result is not used
+  IR_PRINT_STRING,  // Prints the string with the number in string
+  IR_PRINT_NUMBER,  // Prints a
+  IR_PRINT_NEWLINE,
+  // Instructions ending a block
+  IR_JUMP,   // Jumps to targets[0]
+  IR_BRANCH, // Jumps to targets[0] if a is not 0, and to targets[1] otherwise
+  IR_RETURN, // Returns a from the function
+  IR_OPCODE_COUNT
+} ir_opcode_t;
+
+// Marks an instruction removed by an optimization, until the instructions are moved together
+#define IR_REMOVED IR_OPCODE_COUNT
+
+// A virtual register, or a constant if vreg is IR_NO_VREG
+typedef struct ir_value
+{
+  ir_vreg_t vreg;
+  int64_t constant;
+} ir_value_t;
+
+typedef struct ir_instruction
+{
+  uint8_t opcode; // An ir_opcode_t
+  ir_vreg_t dest; // The virtual register written, or IR_NO_VREG
+  ir_value_t operands[2];
+  union
+  {
+    struct symbol* symbol; // The variable, array or function of loads, stores and calls
+    size_t parameter;      // The position of the parameter read by IR_PARAMETER
+    size_t string;         // The position in the string list of the string printed
+    uint32_t targets[2];   // The blocks jumps and branches go to
+    ir_vreg_t variable;    // The variable whose values a phi merges
+  };
+  // The arguments of a call or phi are function->arguments[first_argument ... + n_arguments]
+  uint32_t first_argument;
+  uint32_t n_arguments;
+} ir_instruction_t;
+
+// What a block was lowered from, which its label is named after
+typedef enum
+{
+  IR_BLOCK_ENTRY,
+  IR_BLOCK_THEN,
+  IR_BLOCK_ELSE,
+  IR_BLOCK_ENDIF,
+  IR_BLOCK_WHILE,
+  IR_BLOCK_DO,
+  IR_BLOCK_ENDWHILE,
+  IR_BLOCK_UNREACHABLE, // Statements after a return or break, which are removed
+  IR_BLOCK_KIND_COUNT
+} ir_block_kind_t;
+
+// Use as a normal array, to get the label of a block kind: IR_BLOCK_NAMES[block->kind].
+// Labels other than ENTRY are followed by the number of the block
+#define IR_BLOCK_NAMES                               \
+  ((const char*[]){[IR_BLOCK_ENTRY] = "ENTRY",       \
+                   [IR_BLOCK_THEN] = "THEN",         \
+                   [IR_BLOCK_ELSE] = "ELSE",         \
+                   [IR_BLOCK_ENDIF] = "ENDIF",       \
+                   [IR_BLOCK_WHILE] = "WHILE",       \
+                   [IR_BLOCK_DO] = "DO",             \
+                   [IR_BLOCK_ENDWHILE] = "ENDWHILE", \
+                   [IR_BLOCK_UNREACHABLE] = "UNREACHABLE"})
+
+typedef struct ir_block
+{
+  uint32_t first_instruction; // The instructions of the block are next to each other,
+  uint32_t n_instructions;    // the last of them ending the block
+  uint8_t kind;               // An ir_block_kind_t
+  uint32_t number; // The number of the if or while statement the block belongs to
+  // The blocks jumping to this one are function->predecessors[first_predecessor ...]
+  uint32_t first_predecessor;
+  uint32_t n_predecessors;
+} ir_block_t;
+
+// What lowering needs to know about an expression of the syntax tree, found before it is lowered
+typedef struct ir_expression_label
+{
+  uint8_t registers; // Registers needed to evaluate it without spilling, by Sethi-Ullman numbering
+  uint8_t effects;   // What evaluating it does besides computing its value, see ir.c
+} ir_expression_label_t;
+
+// The IR of one function, and scratch space for lowering and analysing it. Each thread generating
+// functions has its own, which is reused for every function
+typedef struct ir_function
+{
+  struct symbol* symbol;
+  // Parameters and local variables, which are the first virtual registers. Only the parameters,
+  // once out of SSA form
+  uint32_t n_variables;
+  uint32_t n_vregs;
+
+  ir_instruction_t* instructions;
+  size_t n_instructions;
+  size_t instructions_capacity;
+  ir_block_t* blocks;
+  size_t n_blocks;
+  size_t blocks_capacity;
+  ir_value_t* arguments;
+  size_t n_arguments;
+  size_t arguments_capacity;
+  uint32_t* predecessors;
+  size_t predecessors_capacity;
+
+  // Liveness, found by ir_find_liveness. Only virtual registers read in a block before they are
+  // written in it can be live across blocks. They are numbered from 0 in global_numbers, and have
+  // a bit in the live_in and live_out sets of every block
+  uint32_t* global_numbers; // For every virtual register, or IR_NO_VREG if it is not numbered
+  ir_vreg_t* global_vregs;  // For every number, the virtual register
+  size_t n_global;
+  uint64_t* live_in; // words_per_set words for each block
+  uint64_t* live_out;
+  size_t words_per_set;
+  uint64_t* sets; // Holds live_in and live_out, followed by the sets used while finding them
+  size_t sets_capacity;
+
+  // Scratch space: labels and values of expressions while they are being lowered, blocks being
+  // visited, and marks on virtual registers. Labels are indexed by node_id_t, so the syntax tree
+  // itself only holds what the front end needs
+  ir_expression_label_t* labels;
+  size_t labels_capacity;
+  ir_value_t* values;
+  size_t n_values;
+  size_t values_capacity;
+  ir_block_t* spare_blocks;
+  size_t spare_blocks_capacity;
+  uint32_t* block_marks;
+  uint32_t* block_order;
+  uint32_t* block_stack;
+  size_t block_scratch_capacity;
+  uint32_t* vreg_marks;
+  size_t vregs_capacity; // Of vreg_marks, global_numbers and global_vregs
+  // For every instruction, the next instruction writing the same virtual register, and
+  // instructions waiting to be visited, while removing dead code
+  uint32_t* next_definitions;
+  uint32_t* instruction_work;
+  size_t instruction_scratch_capacity;
+  uint32_t current_block;      // The block lowered statements are added to, or IR_NO_BLOCK
+  uint32_t innermost_loop_end; // The block a break statement jumps to, or IR_NO_BLOCK
+  uint32_t if_counter;
+  uint32_t while_counter;
+} ir_function_t;
+
+// Returns true if the instruction ends its block
+static inline bool ir_is_terminator(const ir_instruction_t* instruction)
+{
+  return instruction->opcode >= IR_JUMP;
+}
+
+// Returns true if the instruction calls a function, and may change every caller saved register
+static inline bool ir_is_call(const ir_instruction_t* instruction)
+{
+  return instruction->opcode >= IR_CALL && instruction->opcode <= IR_PRINT_NEWLINE;
+}
+
+// Returns the number of values the instruction reads, which are its operands, or the arguments of
+// a call
+static inline size_t ir_n_uses(const ir_instruction_t* instruction)
+{
+  switch (instruction->opcode)
+  {
+  case IR_PARAMETER:
+  case IR_LOAD_GLOBAL:
+  case IR_PRINT_STRING:
+  case IR_PRINT_NEWLINE:
+  case IR_JUMP:
+    return 0;
+  case IR_COPY:
+  case IR_NEGATE:
+  case IR_NOT:
+  case IR_STORE_GLOBAL:
+  case IR_LOAD_ELEMENT:
+  case IR_PRINT_NUMBER:
+  case IR_BRANCH:
+  case IR_RETURN:
+    return 1;
+  case IR_PHI:
+  case IR_CALL:
+    return instruction->n_arguments;
+  default:
+    return 2;
+  }
+}
+
+// Returns value number i read by the instruction, which belongs to the function
+static inline ir_value_t* ir_use(ir_function_t* function, ir_instruction_t* instruction, size_t i)
+{
+  if (instruction->opcode == IR_CALL || instruction->opcode == IR_PHI)
+    return &function->arguments[instruction->first_argument + i];
+  return &instruction->operands[i];
+}
+
+// Returns true if the global number is live at the start or end of the block
+static inline bool ir_set_contains(const uint64_t* set, size_t number)
+{
+  return (set[number / 64] >> (number % 64)) & 1;
+}
+
+// Lowers the given function to compilation->ir, reuses values computed more than once, and removes
+// values that are never used. The liveness of the IR is found as well. Semantic errors in the
+// function, such as calling a variable, are reported here
+void ir_lower_function(struct symbol* function);
+
+// Numbers the virtual registers of compilation->ir read in some block before they are written in
+// it, which are the only ones that can be live across blocks, in global_numbers
+void ir_number_global_vregs(void);
+
+// Finds the virtual registers live at the start and end of every block of compilation->ir.
+// The arguments of phis are live at the end of the predecessors they come from
+void ir_find_liveness(void);
+
+// Removes the instructions of compilation->ir whose values are never used, and moves the rest
+// together. In SSA form, every value left is used by some instruction that is needed
+void ir_remove_dead_code(void);
+
+// Returns the number of blocks the instruction ending a block can jump to
+size_t ir_n_successors(const ir_instruction_t* terminator);
+
+// Returns the position of the block among the predecessors of the successor
+size_t ir_predecessor_index(uint32_t successor, uint32_t block);
+
+// Lowers every function of the program, and prints its IR to the output
+void print_ir(void);
+
+// Frees the IR of the active compilation
+void destroy_ir(void);
+
+#endif // IR_H
@@ -0,0 +1,56 @@
+#include "vslc.h"
+
+// Compiles the program in a compilation of its own, with all output kept in the memory of its sink.
+// Errors jump back here, where everything the compilation allocated is freed
+vslc_result_t vslc_compile(const char* source, size_t source_length, int outputs)
+{
+  vslc_result_t result = {.error = {.kind = VSLC_OK}, .output = NULL, .output_length = 0};
+
+  // Flex scans the buffer in place, and needs it to end with two NUL bytes
+  char* buffer = malloc(source_length + 2);
+  memcpy(buffer, source, source_length);
+  buffer[source_length] = '\0';
+  buffer[source_length + 1] = '\0';
+
+  // The caller may be in the middle of a compilation of its own, which is restored afterwards
+  compilation_t* outer_compilation = compilation;
+  compilation_t state = {0};
+  jmp_buf error_handler;
+  state.error_handler = &error_handler;
+  sink_init(&state.output, NULL);
+  compilation = &state;
+
+  yyscan_t scanner;
+  yylex_init(&scanner);
+  yy_scan_buffer(buffer, source_length + 2, scanner);
+
+  if (setjmp(error_handler) == 0)
+  {
+    if (is_binary_ast(source, source_length))
+      compile_binary_ast(source, source_length, outputs);
+    else
+      compile_program(scanner, outputs);
+  }
+
+  yylex_destroy(scanner);
+  free(buffer);
+  destroy_compilation();
+
+  // The output is only handed out if there was no error
+  if (state.error.kind == VSLC_OK)
+    result.output = sink_take_buffer(&state.output, &result.output_length);
+  else
+    result.error = state.error;
+  sink_destroy(&state.output);
+
+  compilation = outer_compilation;
+  return result;
+}
+
+// Frees the output buffer, and leaves the result without output
+void vslc_result_free(vslc_result_t* result)
+{
+  free(result->output);
+  result->output = NULL;
+  result->output_length = 0;
+}
@@ -0,0 +1,60 @@
+#ifndef LIBVSLC_H
+#define LIBVSLC_H
+
+#include <stddef.h>
+
+// The VSL compiler as a library.
+// A program is compiled from a buffer in memory, and everything the compiler would print
+// is returned in a buffer in memory. Errors are returned to the caller, and never end the process.
+// Different threads may compile different programs at the same time.
+
+// The outputs a compilation can produce. Several can be combined with |,
+// in which case they appear in the output buffer in the order listed here
+typedef enum
+{
+  VSLC_OUTPUT_AST = 1 << 0,            // The syntax tree, as produced by the parser
+  VSLC_OUTPUT_SIMPLIFIED_AST = 1 << 1, // The syntax tree after constant folding and removing
+                                       // unreachable code
+  VSLC_OUTPUT_SYMBOLS = 1 << 2,        // The symbol tables, string list and bound syntax tree
+  VSLC_OUTPUT_BINARY_AST = 1 << 4,     // The bound syntax tree, as a binary syntax tree
+  VSLC_OUTPUT_IR = 1 << 5,             // The intermediate representation of every function
+  VSLC_OUTPUT_ASSEMBLY = 1 << 3,       // The generated x86-64 assembly
+} vslc_output_t;
+
+typedef enum
+{
+  VSLC_OK = 0,
+  VSLC_ERROR_SYNTAX,     // The program could not be parsed
+  VSLC_ERROR_SYMBOL,     // A name is defined twice, or used without being defined
+  VSLC_ERROR_SEMANTIC,   // The program is not valid VSL, such as calling a variable
+  VSLC_ERROR_BINARY_AST, // The binary syntax tree is damaged, or written by another version
+} vslc_error_kind_t;
+
+typedef struct vslc_error
+{
+  vslc_error_kind_t kind;
+  int line;          // The line of the error, or 0 if it is not known
+  char message[256]; // Describes the error, without an "error: " prefix. Empty if there is none
+} vslc_error_t;
+
+typedef struct vslc_result
+{
+  vslc_error_t error; // error.kind is VSLC_OK if the compilation succeeded
+
+  // The requested outputs, NUL-terminated. NULL if the compilation failed
+  char* output;
+  size_t output_length;
+} vslc_result_t;
+
+// Compiles the VSL program in the first source_length bytes of source,
+// producing the given combination of vslc_output_t outputs.
+// The source may also be a binary syntax tree, written by an earlier compilation with
+// VSLC_OUTPUT_BINARY_AST. It is loaded instead of parsed, and can not produce VSLC_OUTPUT_AST.
+// All memory used by the compilation is freed before returning, also when the compilation fails,
+// except for the output buffer, which must be freed with vslc_result_free.
+vslc_result_t vslc_compile(const char* source, size_t source_length, int outputs);
+
+// Frees the output buffer of a result
+void vslc_result_free(vslc_result_t* result);
+
+#endif // LIBVSLC_H
@@ -22,9 +22,9 @@ NODE_TYPE(WHILE_STATEMENT),
 NODE_TYPE(BREAK_STATEMENT),
 NODE_TYPE(OPERATOR),              // uses the data field "operator"
 NODE_TYPE(FUNCTION_CALL),
-NODE_TYPE(IDENTIFIER),            // uses and owns the data field "identifer"
+NODE_TYPE(IDENTIFIER),            // uses the data field "identifer"
 NODE_TYPE(NUMBER_LITERAL),        // uses the data field "number_literal"
-NODE_TYPE(STRING_LITERAL),        // uses and owns the data field "string_literal"
+NODE_TYPE(STRING_LITERAL),        // uses the data field "string_literal"
 NODE_TYPE(STRING_LIST_REFERENCE), // uses the data field "string_list_index"
 
 #undef NODE_TYPE
@@ -0,0 +1,27 @@
+// This is a special file that is not intended to be #include-d normally.
+// Instead, it is included by "tree.h" and "tree.c" to provide both an enum of operators,
+// and an array of strings with the text of each operator, as written in VSL.
+
+// clang-format off
+
+#ifndef OPERATOR_TYPE
+#error The file operators.h should only be included after defining the OPERATOR_TYPE macro
+#endif
+
+// Binary operators
+OPERATOR_TYPE(OPERATOR_ADD, "+"),
+OPERATOR_TYPE(OPERATOR_SUBTRACT, "-"),
+OPERATOR_TYPE(OPERATOR_MULTIPLY, "*"),
+OPERATOR_TYPE(OPERATOR_DIVIDE, "/"),
+OPERATOR_TYPE(OPERATOR_EQUAL, "=="),
+OPERATOR_TYPE(OPERATOR_NOT_EQUAL, "!="),
+OPERATOR_TYPE(OPERATOR_LESS, "<"),
+OPERATOR_TYPE(OPERATOR_LESS_EQUAL, "<="),
+OPERATOR_TYPE(OPERATOR_GREATER, ">"),
+OPERATOR_TYPE(OPERATOR_GREATER_EQUAL, ">="),
+
+// Unary operators
+OPERATOR_TYPE(OPERATOR_NEGATE, "-"),
+OPERATOR_TYPE(OPERATOR_NOT, "!"),
+
+#undef OPERATOR_TYPE
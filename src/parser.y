@@ -1,18 +1,33 @@
 %{
 #include "vslc.h"
 
-// State variables from the flex generated scanner
-extern int yylineno;  // The line currently being read
-extern char yytext[]; // The text of the last consumed lexeme
+// The main flex driver function used by the parser.
+// The scanner places the node of NUMBER, IDENTIFIER and STRING tokens in *yylval
+int yylex(YYSTYPE *yylval, yyscan_t scanner);
 
-// The main flex driver function used by the parser
-int yylex(void);
+// Counts the tokens read by the parser for the time report, not including the end of input.
+// The macro wraps every call bison makes to yylex
+static int count_token(int token)
+{
+  if (token != 0)
+    compilation->statistics.n_tokens++;
+  return token;
+}
+#define yylex(yylval, scanner) count_token(yylex(yylval, scanner))
 
-// The function called by the parser when errors occur
-int yyerror(const char *error)
+// The parser stack grows on the heap as needed. Deeply nested statements and expressions,
+// such as long else-if chains, need a lot more of it than the default limit of 10000
+#define YYMAXDEPTH (64 * 1024 * 1024)
+
+// The function called by the parser when errors occur.
+// The error is only recorded here, and reported once yyparse has returned
+int yyerror(yyscan_t scanner, const char *error)
 {
-  fprintf(stderr, "%s on line %d\n", error, yylineno);
-  exit(EXIT_FAILURE);
+  int line = yyget_lineno(scanner);
+  compilation->error = (vslc_error_t){.kind = VSLC_ERROR_SYNTAX, .line = line};
+  snprintf(compilation->error.message, sizeof(compilation->error.message),
+           "%s on line %d", error, line);
+  return 0;
 }
 
 // Helper macros for creating nodes
@@ -26,6 +41,10 @@ int yyerror(const char *error)
   node_create( (type), 3, (child0), (child1), (child2) )
 %}
 
+// The parser is reentrant, and reads tokens from the given reentrant flex scanner
+%define api.pure full
+%param {yyscan_t scanner}
+
 %token FUNC PRINT RETURN BREAK IF THEN ELSE WHILE DO VAR
 %token NUMBER_TOKEN IDENTIFIER_TOKEN STRING_TOKEN
 
@@ -42,7 +61,7 @@ int yyerror(const char *error)
 
 %%
 program :
-      global_list { root = $1; }
+      global_list { compilation->root = $1; }
     ;
 global_list :
       global { $$ = N1C(LIST, $1); }
@@ -142,62 +161,62 @@ expression :
       expression '=' '=' expression
         {
           $$ = N2C(OPERATOR, $1, $4);
-          $$->data.operator = "==";
+          node_at($$)->data.operator = OPERATOR_EQUAL;
         }
     | expression '!' '=' expression
         {
           $$ = N2C(OPERATOR, $1, $4);
-          $$->data.operator = "!=";
+          node_at($$)->data.operator = OPERATOR_NOT_EQUAL;
         }
     | expression '<' expression
         {
           $$ = N2C(OPERATOR, $1, $3);
-          $$->data.operator = "<";
+          node_at($$)->data.operator = OPERATOR_LESS;
         }
     | expression '<' '=' expression
         {
           $$ = N2C(OPERATOR, $1, $4);
-          $$->data.operator = "<=";
+          node_at($$)->data.operator = OPERATOR_LESS_EQUAL;
         }
     | expression '>' expression
         {
           $$ = N2C(OPERATOR, $1, $3);
-          $$->data.operator = ">";
+          node_at($$)->data.operator = OPERATOR_GREATER;
         }
     | expression '>' '=' expression
         {
           $$ = N2C(OPERATOR, $1, $4);
-          $$->data.operator = ">=";
+          node_at($$)->data.operator = OPERATOR_GREATER_EQUAL;
         }
     | expression '+' expression
         {
           $$ = N2C(OPERATOR, $1, $3);
-          $$->data.operator = "+";
+          node_at($$)->data.operator = OPERATOR_ADD;
         }
     | expression '-' expression
         {
           $$ = N2C(OPERATOR, $1, $3);
-          $$->data.operator = "-";
+          node_at($$)->data.operator = OPERATOR_SUBTRACT;
         }
     | expression '*' expression
         {
           $$ = N2C(OPERATOR, $1, $3);
-          $$->data.operator = "*";
+          node_at($$)->data.operator = OPERATOR_MULTIPLY;
         }
     | expression '/' expression
         {
           $$ = N2C(OPERATOR, $1, $3);
-          $$->data.operator = "/";
+          node_at($$)->data.operator = OPERATOR_DIVIDE;
         }
     | '-' expression %prec UNARY_OPERATORS
         {
           $$ = N1C(OPERATOR, $2);
-          $$->data.operator = "-";
+          node_at($$)->data.operator = OPERATOR_NEGATE;
         }
     | '!' expression %prec UNARY_OPERATORS
         {
           $$ = N1C(OPERATOR, $2);
-          $$->data.operator = "!";
+          node_at($$)->data.operator = OPERATOR_NOT;
         }
     | '(' expression ')' { $$ = $2; }
     | number { $$ = $1; }
@@ -218,20 +237,19 @@ expression_list :
 identifier :
       IDENTIFIER_TOKEN
       {
-        $$ = N0C(IDENTIFIER);
-        // Allocate a copy of yytext to keep in the syntax tree as data
-        $$->data.identifier = strdup(yytext);
+        // The scanner has already made the IDENTIFIER node, holding the interned name
+        $$ = $1;
       }
 number :
       NUMBER_TOKEN
       {
-        $$ = N0C(NUMBER_LITERAL);
-        $$->data.number_literal = strtol(yytext, NULL, 10);
+        // The scanner has already made the NUMBER_LITERAL node
+        $$ = $1;
       }
 string :
       STRING_TOKEN
       {
-        $$ = N0C(STRING_LITERAL);
-        $$->data.string_literal = strdup(yytext);
+        // The scanner has already made the STRING_LITERAL node
+        $$ = $1;
       }
 %%
@@ -0,0 +1,510 @@
+#include "vslc.h"
+
+#include "emit.h"
+
+// What a line of collected code is
+typedef enum
+{
+  LINE_INSTRUCTION,
+  LINE_LABEL,   // Any line not starting with a tab, which code may jump to
+  LINE_REMOVED, // An instruction removed by a rule, which is not written out
+} peephole_line_kind_t;
+
+// A piece of the text of a line
+typedef struct span
+{
+  const char* chars;
+  size_t length;
+} span_t;
+
+// An instruction, split into its mnemonic and up to two operands
+typedef struct instruction
+{
+  size_t line;
+  span_t mnemonic;
+  span_t operands[2];
+  size_t n_operands;
+} instruction_t;
+
+// The most instructions a rule matches
+#define MAX_RULE_LENGTH 4
+
+// A rule matches instructions in a row whose mnemonics are the ones in its pattern. A pattern
+// ending in * matches every mnemonic starting with what comes before it. The rewrite checks the
+// operands, and returns true if it changed the instructions. It is given the line after them
+typedef struct rule
+{
+  size_t length;
+  const char* pattern[MAX_RULE_LENGTH];
+  bool (*rewrite)(instruction_t* instructions, size_t next);
+} rule_t;
+
+static void split_lines(void);
+static bool apply_rule(const rule_t* rule, size_t first);
+static size_t previous_instruction(size_t line);
+static size_t next_line(size_t line);
+static void parse_line(size_t line);
+static instruction_t instruction_at(size_t line);
+static bool span_is(span_t span, const char* text);
+static bool same_span(span_t a, span_t b);
+static bool is_register(span_t operand);
+static bool is_memory(span_t operand);
+static bool mentions(span_t operand, span_t register_name);
+static bool reads_flags(size_t line);
+static void remove_line(size_t line);
+static void replace_line(size_t line, span_t mnemonic, const span_t* operands, size_t n_operands);
+static bool merge_push_pop(instruction_t* instructions, size_t next);
+static bool zero_by_xor(instruction_t* instructions, size_t next);
+static bool remove_jump_to_next(instruction_t* instructions, size_t next);
+static bool branch_on_setcc(instruction_t* instructions, size_t next);
+static bool remove_reload(instruction_t* instructions, size_t next);
+
+// The rules, tried in this order at every instruction
+static const rule_t RULES[PEEPHOLE_RULE_COUNT] = {
+    // pushq x; popq y => movq x, y
+    [PEEPHOLE_PUSH_POP] = {2, {"pushq", "popq"}, merge_push_pop},
+    // movq $0, %reg => xorl %reg32, %reg32, which is shorter and breaks dependencies
+    [PEEPHOLE_ZERO_REGISTER] = {1, {"movq"}, zero_by_xor},
+    // A jump to the label right after it is removed
+    [PEEPHOLE_JUMP_TO_NEXT] = {1, {"j*"}, remove_jump_to_next},
+    // setcc b; movzbq b, r; cmpq $0, r; je/jne => setcc b; movzbq b, r; jcc with the same flags
+    [PEEPHOLE_BRANCH_ON_SETCC] = {4, {"set*", "movzbq", "cmpq", "j*"}, branch_on_setcc},
+    // movq x, y; movq y, z => movq x, y, and a move from x to z unless z is x
+    [PEEPHOLE_STORE_RELOAD] = {2, {"movq", "movq"}, remove_reload},
+};
+
+// The 32-bit registers written by xorl, for every 64-bit register a virtual register is kept in,
+// and the scratch registers
+static const char* const ZEROED_REGISTERS[][2] = {
+    {RAX, EAX},
+    {RBX, "%ebx"},
+    {RCX, "%ecx"},
+    {RDX, "%edx"},
+    {RSI, "%esi"},
+    {RDI, "%edi"},
+    {R8, "%r8d"},
+    {R9, "%r9d"},
+    {R10, "%r10d"},
+    {R11, "%r11d"},
+    {R12, "%r12d"},
+    {R13, "%r13d"},
+    {R14, "%r14d"},
+    {R15, "%r15d"},
+};
+
+// The condition codes of SETcc and Jcc, each followed by the condition that holds when it does not
+static const char* const CONDITIONS[][2] = {
+    {"e", "ne"}, {"ne", "e"}, {"l", "ge"}, {"ge", "l"}, {"g", "le"}, {"le", "g"}};
+
+/* External interface */
+
+// Collects the code, by swapping the output with the code sink of the peephole optimizer
+void peephole_begin(void)
+{
+  peephole_t* peephole = &compilation->peephole;
+  sink_t output = compilation->output;
+  compilation->output = peephole->code;
+  peephole->code = output;
+}
+
+// Applies every rule at every instruction, in one pass that steps back after each rewrite, so
+// that no rule matches afterwards. Removed lines are left in place, and skipped over by the rules
+void peephole_end(void)
+{
+  peephole_t* peephole = &compilation->peephole;
+  sink_t code = compilation->output;
+  compilation->output = peephole->code;
+  peephole->code = code;
+
+  split_lines();
+
+  // A rewrite can only make rules match from a few instructions before it, where the rules are
+  // tried again. Only a jump looks past labels, and rules look past removed lines
+  size_t* rewrites = compilation->statistics.n_peephole_rewrites;
+  size_t line = 0;
+  while (line < peephole->n_lines)
+  {
+    bool rewritten = false;
+    for (size_t rule = 0; rule < PEEPHOLE_RULE_COUNT && !rewritten; rule++)
+    {
+      if (peephole->lines[line].kind != LINE_INSTRUCTION)
+        break;
+      if (apply_rule(&RULES[rule], line))
+      {
+        rewrites[rule]++;
+        rewritten = true;
+      }
+    }
+    if (!rewritten)
+      line++;
+    for (size_t i = 0; rewritten && i < MAX_RULE_LENGTH; i++)
+      line = previous_instruction(line);
+  }
+
+  sink_t* output = &compilation->output;
+  for (size_t i = 0; i < peephole->n_lines; i++)
+  {
+    peephole_line_t* line = &peephole->lines[i];
+    if (line->kind == LINE_REMOVED)
+      continue;
+    if (line->kind == LINE_INSTRUCTION)
+      sink_putc(output, '\t');
+    sink_write(output, peephole->code.buffer + line->start, line->length);
+    sink_putc(output, '\n');
+  }
+  peephole->code.length = 0;
+}
+
+// Frees the collected code, the lines and the scratch space
+void destroy_peephole(void)
+{
+  peephole_t* peephole = &compilation->peephole;
+  sink_destroy(&peephole->code);
+  sink_destroy(&peephole->scratch);
+  free(peephole->lines);
+  peephole->lines = NULL;
+  peephole->n_lines = 0;
+  peephole->lines_capacity = 0;
+}
+
+/* Internal matters */
+
+// Finds the lines of the collected code. Every line ends with a newline
+static void split_lines(void)
+{
+  peephole_t* peephole = &compilation->peephole;
+  const char* text = peephole->code.buffer;
+  size_t length = peephole->code.length;
+  peephole->n_lines = 0;
+
+  for (size_t start = 0; start < length;)
+  {
+    const char* end = memchr(text + start, '\n', length - start);
+    size_t line_end = end != NULL ? (size_t)(end - text) : length;
+
+    if (peephole->n_lines == peephole->lines_capacity)
+    {
+      peephole->lines_capacity = peephole->lines_capacity * 2 + 64;
+      peephole->lines =
+          realloc(peephole->lines, peephole->lines_capacity * sizeof(peephole_line_t));
+    }
+    bool instruction = text[start] == '\t';
+    size_t line_start = instruction ? start + 1 : start;
+    peephole->lines[peephole->n_lines++] = (peephole_line_t){
+        .start = line_start,
+        .length = line_end - line_start,
+        .kind = instruction ? LINE_INSTRUCTION : LINE_LABEL};
+    if (instruction)
+      parse_line(peephole->n_lines - 1);
+    start = line_end + 1;
+  }
+}
+
+// Matches the pattern of the rule against the instructions starting at the given line, and
+// rewrites them if they match
+static bool apply_rule(const rule_t* rule, size_t first)
+{
+  peephole_t* peephole = &compilation->peephole;
+  size_t lines[MAX_RULE_LENGTH];
+  size_t line = first;
+  for (size_t i = 0; i < rule->length; i++)
+  {
+    if (line == peephole->n_lines || peephole->lines[line].kind != LINE_INSTRUCTION)
+      return false;
+
+    const char* pattern = rule->pattern[i];
+    size_t pattern_length = strlen(pattern);
+    const char* mnemonic = peephole->code.buffer + peephole->lines[line].start;
+    size_t mnemonic_length = peephole->lines[line].mnemonic_length;
+    if (pattern[pattern_length - 1] == '*')
+    {
+      if (mnemonic_length < pattern_length - 1
+          || memcmp(mnemonic, pattern, pattern_length - 1) != 0)
+        return false;
+    }
+    else if (mnemonic_length != pattern_length || memcmp(mnemonic, pattern, pattern_length) != 0)
+      return false;
+
+    lines[i] = line;
+    line = next_line(line);
+  }
+
+  instruction_t instructions[MAX_RULE_LENGTH];
+  for (size_t i = 0; i < rule->length; i++)
+    instructions[i] = instruction_at(lines[i]);
+  return rule->rewrite(instructions, line);
+}
+
+// Returns the line of the last instruction before the given line, or 0
+static size_t previous_instruction(size_t line)
+{
+  peephole_t* peephole = &compilation->peephole;
+  while (line > 0)
+  {
+    line--;
+    if (peephole->lines[line].kind == LINE_INSTRUCTION)
+      return line;
+  }
+  return 0;
+}
+
+// Returns the first line after the given one that is not removed, or the number of lines
+static size_t next_line(size_t line)
+{
+  peephole_t* peephole = &compilation->peephole;
+  line++;
+  while (line < peephole->n_lines && peephole->lines[line].kind == LINE_REMOVED)
+    line++;
+  return line;
+}
+
+// Splits the instruction at the line into its mnemonic and operands. The operands are separated
+// by ", ", which may also be found inside the parentheses of an operand in memory
+static void parse_line(size_t line)
+{
+  peephole_t* peephole = &compilation->peephole;
+  peephole_line_t* parsed = &peephole->lines[line];
+  const char* text = peephole->code.buffer + parsed->start;
+  size_t length = parsed->length;
+  parsed->n_operands = 0;
+
+  size_t position = 0;
+  while (position < length && text[position] != ' ')
+    position++;
+  parsed->mnemonic_length = position;
+
+  size_t start = position + 1;
+  int depth = 0;
+  for (position = start; position < length; position++)
+  {
+    if (text[position] == '(')
+      depth++;
+    else if (text[position] == ')')
+      depth--;
+    else if (depth == 0 && text[position] == ',' && parsed->n_operands == 0)
+    {
+      parsed->operand_starts[parsed->n_operands] = start;
+      parsed->operand_lengths[parsed->n_operands++] = position - start;
+      start = position + 2;
+      position++;
+    }
+  }
+  if (start < length)
+  {
+    parsed->operand_starts[parsed->n_operands] = start;
+    parsed->operand_lengths[parsed->n_operands++] = length - start;
+  }
+}
+
+// Returns the instruction at the line, as split by parse_line. Its spans are only valid until the
+// code grows
+static instruction_t instruction_at(size_t line)
+{
+  peephole_t* peephole = &compilation->peephole;
+  const peephole_line_t* parsed = &peephole->lines[line];
+  const char* text = peephole->code.buffer + parsed->start;
+  instruction_t instruction = {
+      .line = line, .mnemonic = {text, parsed->mnemonic_length}, .n_operands = parsed->n_operands};
+  for (size_t i = 0; i < parsed->n_operands; i++)
+    instruction.operands[i] =
+        (span_t){text + parsed->operand_starts[i], parsed->operand_lengths[i]};
+  return instruction;
+}
+
+// Returns true if the span is the given text
+static bool span_is(span_t span, const char* text)
+{
+  return strlen(text) == span.length && memcmp(span.chars, text, span.length) == 0;
+}
+
+// Returns true if the spans hold the same text
+static bool same_span(span_t a, span_t b)
+{
+  return a.length == b.length && memcmp(a.chars, b.chars, a.length) == 0;
+}
+
+// Returns true if the operand is a register
+static bool is_register(span_t operand)
+{
+  return operand.length > 0 && operand.chars[0] == '%';
+}
+
+// Returns true if the operand is in memory, and not a register or a constant
+static bool is_memory(span_t operand)
+{
+  return operand.length > 0 && operand.chars[0] != '%' && operand.chars[0] != '$';
+}
+
+// Returns true if the register is part of the operand, such as the address of an operand in memory
+static bool mentions(span_t operand, span_t register_name)
+{
+  for (size_t i = 0; i + register_name.length <= operand.length; i++)
+    if (memcmp(operand.chars + i, register_name.chars, register_name.length) == 0)
+      return true;
+  return false;
+}
+
+// Returns true if the instruction at the line reads the flags, which conditional jumps and SETcc
+// do. Flags are never live across a label in the code of generator.c
+static bool reads_flags(size_t line)
+{
+  peephole_t* peephole = &compilation->peephole;
+  if (line == peephole->n_lines || peephole->lines[line].kind != LINE_INSTRUCTION)
+    return false;
+  span_t mnemonic = instruction_at(line).mnemonic;
+  if (mnemonic.chars[0] == 'j')
+    return !span_is(mnemonic, "jmp");
+  return mnemonic.length > 3 && memcmp(mnemonic.chars, "set", 3) == 0;
+}
+
+// Removes the instruction at the line, which no longer counts as emitted
+static void remove_line(size_t line)
+{
+  compilation->peephole.lines[line].kind = LINE_REMOVED;
+  compilation->statistics.n_instructions--;
+}
+
+// Replaces the instruction at the line, and splits it again. Its new text is formatted in the
+// scratch sink first, since the given spans may be part of the code that grows
+static void replace_line(size_t line, span_t mnemonic, const span_t* operands, size_t n_operands)
+{
+  peephole_t* peephole = &compilation->peephole;
+  sink_t* scratch = &peephole->scratch;
+  scratch->length = 0;
+  sink_write(scratch, mnemonic.chars, mnemonic.length);
+  for (size_t i = 0; i < n_operands; i++)
+  {
+    sink_write(scratch, i == 0 ? " " : ", ", i == 0 ? 1 : 2);
+    sink_write(scratch, operands[i].chars, operands[i].length);
+  }
+
+  peephole->lines[line].start = peephole->code.length;
+  peephole->lines[line].length = scratch->length;
+  sink_write(&peephole->code, scratch->buffer, scratch->length);
+  parse_line(line);
+}
+
+// A value pushed and popped right away is moved instead, or left where it is. Operands relative
+// to %rsp are left alone, since the push and pop move it
+static bool merge_push_pop(instruction_t* instructions, size_t next)
+{
+  (void)next;
+  span_t source = instructions[0].operands[0];
+  span_t dest = instructions[1].operands[0];
+  span_t stack_pointer = {RSP, strlen(RSP)};
+  if (mentions(source, stack_pointer) || mentions(dest, stack_pointer))
+    return false;
+
+  if (same_span(source, dest))
+  {
+    remove_line(instructions[0].line);
+    remove_line(instructions[1].line);
+    return true;
+  }
+  if (is_memory(source) && is_memory(dest))
+    return false;
+
+  span_t operands[2] = {source, dest};
+  replace_line(instructions[1].line, (span_t){"movq", 4}, operands, 2);
+  remove_line(instructions[0].line);
+  return true;
+}
+
+// Zeroes a register with xorl, which also clears the upper half of the register. It changes the
+// flags, so it is not used right before an instruction reading them
+static bool zero_by_xor(instruction_t* instructions, size_t next)
+{
+  if (!span_is(instructions[0].operands[0], "$0") || reads_flags(next))
+    return false;
+
+  size_t n_registers = sizeof(ZEROED_REGISTERS) / sizeof(ZEROED_REGISTERS[0]);
+  for (size_t i = 0; i < n_registers; i++)
+  {
+    if (!span_is(instructions[0].operands[1], ZEROED_REGISTERS[i][0]))
+      continue;
+    span_t low_half = {ZEROED_REGISTERS[i][1], strlen(ZEROED_REGISTERS[i][1])};
+    span_t operands[2] = {low_half, low_half};
+    replace_line(instructions[0].line, (span_t){"xorl", 4}, operands, 2);
+    return true;
+  }
+  return false;
+}
+
+// Removes a jump to one of the labels right after it
+static bool remove_jump_to_next(instruction_t* instructions, size_t next)
+{
+  peephole_t* peephole = &compilation->peephole;
+  span_t target = instructions[0].operands[0];
+  for (size_t line = next; line < peephole->n_lines; line = next_line(line))
+  {
+    peephole_line_t* label = &peephole->lines[line];
+    if (label->kind != LINE_LABEL)
+      return false;
+    const char* text = peephole->code.buffer + label->start;
+    if (label->length == target.length + 1 && memcmp(text, target.chars, target.length) == 0
+        && text[target.length] == ':')
+    {
+      remove_line(instructions[0].line);
+      return true;
+    }
+  }
+  return false;
+}
+
+// The SETcc leaves the flags of the comparison before it, and so does the zero extension. Testing
+// its result against 0 is not needed, when the jump after it uses the condition itself
+static bool branch_on_setcc(instruction_t* instructions, size_t next)
+{
+  (void)next;
+  span_t byte_register = instructions[0].operands[0];
+  span_t result = instructions[1].operands[1];
+  if (!same_span(instructions[1].operands[0], byte_register)
+      || !span_is(instructions[2].operands[0], "$0")
+      || !same_span(instructions[2].operands[1], result))
+    return false;
+
+  span_t jump = instructions[3].mnemonic;
+  bool if_set = span_is(jump, "jne");
+  if (!if_set && !span_is(jump, "je"))
+    return false;
+
+  span_t condition = {instructions[0].mnemonic.chars + 3, instructions[0].mnemonic.length - 3};
+  size_t n_conditions = sizeof(CONDITIONS) / sizeof(CONDITIONS[0]);
+  for (size_t i = 0; i < n_conditions; i++)
+  {
+    if (!span_is(condition, CONDITIONS[i][0]))
+      continue;
+    char mnemonic[4] = "j";
+    strcat(mnemonic, CONDITIONS[i][if_set ? 0 : 1]);
+    replace_line(
+        instructions[3].line, (span_t){mnemonic, strlen(mnemonic)}, instructions[3].operands, 1);
+    remove_line(instructions[2].line);
+    return true;
+  }
+  return false;
+}
+
+// After a move from x to y, y is read again by the next move. A move back to x is not needed.
+// When y is in memory, the value is taken from x instead, and not loaded from memory again.
+// A register written by the first move may be part of the address of x, which then changes
+static bool remove_reload(instruction_t* instructions, size_t next)
+{
+  (void)next;
+  span_t x = instructions[0].operands[0];
+  span_t y = instructions[0].operands[1];
+  span_t z = instructions[1].operands[1];
+  if (!same_span(instructions[1].operands[0], y) || (is_register(y) && mentions(x, y)))
+    return false;
+
+  if (same_span(z, x))
+  {
+    remove_line(instructions[1].line);
+    return true;
+  }
+  if (!is_memory(y) || is_memory(x))
+    return false;
+
+  span_t operands[2] = {x, z};
+  replace_line(instructions[1].line, instructions[1].mnemonic, operands, 2);
+  return true;
+}
@@ -0,0 +1,71 @@
+#ifndef PEEPHOLE_H
+#define PEEPHOLE_H
+
+#include "sink.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// The code of each function is collected before it is written to the output, and the peephole
+// optimizer rewrites short sequences of instructions that do more than they need to. Each rule of
+// its table matches the mnemonics of a few instructions in a row, with no label between them, and
+// checks their operands before rewriting them. The rules are applied in one pass over the
+// function, which steps back a few instructions after each rewrite, until none of them match.
+// The times each rule rewrites code are counted, and shown with -ftime-report.
+
+// The rules, with their names in the text and JSON reports
+#define PEEPHOLE_RULES                                                          \
+  RULE(PEEPHOLE_PUSH_POP, "push then pop", "push_pop")                          \
+  RULE(PEEPHOLE_ZERO_REGISTER, "zeroing by xor", "zero_register")               \
+  RULE(PEEPHOLE_JUMP_TO_NEXT, "jump to next label", "jump_to_next")             \
+  RULE(PEEPHOLE_BRANCH_ON_SETCC, "branch on setcc", "branch_on_setcc")          \
+  RULE(PEEPHOLE_STORE_RELOAD, "store then reload", "store_reload")
+
+typedef enum
+{
+#define RULE(rule, name, key) rule,
+  PEEPHOLE_RULES
+#undef RULE
+  PEEPHOLE_RULE_COUNT
+} peephole_rule_t;
+
+// A line of collected code, kept as its text in peephole->code. Instructions are kept without
+// their leading tab, and no line keeps its newline. Instructions are split into their mnemonic and
+// operands once, when the line is found or rewritten, and the operands are kept as their positions
+// in the line, since the code moves as it grows
+typedef struct peephole_line
+{
+  size_t start;
+  uint32_t length;
+  uint8_t kind; // A peephole_line_kind_t, see peephole.c
+  uint8_t n_operands;
+  uint32_t mnemonic_length;
+  uint32_t operand_starts[2];
+  uint32_t operand_lengths[2];
+} peephole_line_t;
+
+// The code of the function being generated, while it is collected and rewritten, reused for
+// every function. Each thread generating functions has its own
+typedef struct peephole
+{
+  // While code is collected, it is written to the output of the compilation as usual, and the
+  // real output is kept here instead. Afterwards, it holds the collected code, followed by the
+  // text of rewritten lines
+  sink_t code;
+  peephole_line_t* lines;
+  size_t n_lines;
+  size_t lines_capacity;
+  sink_t scratch; // Where rewritten lines are formatted, before they are added to the code
+} peephole_t;
+
+// Starts collecting the code written to the output of the active compilation. Nothing may report
+// an error before peephole_end is called
+void peephole_begin(void);
+
+// Rewrites the code collected since peephole_begin, and writes it to the output
+void peephole_end(void);
+
+// Frees the buffers of the peephole optimizer of the active compilation
+void destroy_peephole(void);
+
+#endif // PEEPHOLE_H
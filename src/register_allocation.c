@@ -0,0 +1,364 @@
+#include "vslc.h"
+
+#include "emit.h"
+
+// Caller saved registers first, so virtual registers not live across calls take them before the
+// others. The registers left out are the scratch registers of generator.c
+#define NUM_CALLER_SAVED (NUM_ALLOCATABLE_REGISTERS - NUM_CALLEE_SAVED_REGISTERS)
+static const char* const ALLOCATABLE_REGISTERS[NUM_ALLOCATABLE_REGISTERS] = {
+    RCX, RSI, RDI, R8, R9, R10, RBX, R12, R13, R14, R15};
+static const char* const BYTE_REGISTERS[NUM_ALLOCATABLE_REGISTERS] = {
+    CL, SIL, DIL, R8B, R9B, R10B, BL, R12B, R13B, R14B, R15B};
+
+// Marks an interval that has not started, because its virtual register is never used
+#define NOT_STARTED SIZE_MAX
+
+// Marks a register that holds no virtual register
+#define NO_INTERVAL SIZE_MAX
+
+static void find_live_intervals(void);
+static void find_calls_in_intervals(size_t n_vregs);
+static size_t scan_intervals(size_t n_vregs);
+static void place_spilled_vregs(size_t n_intervals);
+
+/* External interface */
+
+// Finds the live interval of every virtual register, hands out registers in order of where the
+// intervals start, and places the rest of the virtual registers in the call frame
+void allocate_registers(void)
+{
+  ir_function_t* ir = &compilation->ir;
+  register_allocation_t* allocation = &compilation->register_allocation;
+  size_t n_vregs = ir->n_vregs;
+  if (allocation->locations == NULL || n_vregs > allocation->capacity)
+  {
+    allocation->capacity = n_vregs * 2 + 16;
+    allocation->locations =
+        realloc(allocation->locations, allocation->capacity * sizeof(vreg_location_t));
+    allocation->intervals =
+        realloc(allocation->intervals, allocation->capacity * sizeof(live_interval_t));
+  }
+
+  for (size_t i = 0; i < n_vregs; i++)
+  {
+    allocation->locations[i] = (vreg_location_t){.operand = NULL};
+    allocation->intervals[i] = (live_interval_t){.start = NOT_STARTED, .vreg = i};
+  }
+  allocation->n_calls = 0;
+
+  find_live_intervals();
+  find_calls_in_intervals(n_vregs);
+  size_t n_intervals = scan_intervals(n_vregs);
+  place_spilled_vregs(n_intervals);
+}
+
+// Frees the locations and scratch space of the active compilation
+void destroy_register_allocation(void)
+{
+  register_allocation_t* allocation = &compilation->register_allocation;
+  free(allocation->locations);
+  free(allocation->intervals);
+  free(allocation->frame_operands);
+  free(allocation->slot_ends);
+  free(allocation->slot_heap);
+  free(allocation->calls);
+  *allocation = (register_allocation_t){.locations = NULL};
+}
+
+/* Internal matters */
+
+// Makes the interval of the virtual register cover the position
+static void extend_interval(ir_vreg_t vreg, size_t position)
+{
+  live_interval_t* interval = &compilation->register_allocation.intervals[vreg];
+  if (interval->start == NOT_STARTED)
+  {
+    interval->start = interval->end = position;
+    return;
+  }
+  if (position < interval->start)
+    interval->start = position;
+  if (position > interval->end)
+    interval->end = position;
+}
+
+// Makes the interval of every virtual register in the liveness set cover the position
+static void extend_intervals_in_set(const uint64_t* set, size_t position)
+{
+  ir_function_t* ir = &compilation->ir;
+  for (size_t word = 0; word < ir->words_per_set; word++)
+    for (uint64_t bits = set[word]; bits != 0; bits &= bits - 1)
+      extend_interval(ir->global_vregs[word * 64 + __builtin_ctzll(bits)], position);
+}
+
+// Records that a function is called at the position
+static void record_call(size_t position)
+{
+  register_allocation_t* allocation = &compilation->register_allocation;
+  if (allocation->n_calls == allocation->calls_capacity)
+  {
+    allocation->calls_capacity = allocation->calls_capacity * 2 + 16;
+    allocation->calls = realloc(allocation->calls, allocation->calls_capacity * sizeof(size_t));
+  }
+  allocation->calls[allocation->n_calls++] = position;
+}
+
+// Goes through the instructions in the order they are laid out, and makes the interval of every
+// virtual register cover where it is read, written, and live at the start or end of a block
+static void find_live_intervals(void)
+{
+  ir_function_t* ir = &compilation->ir;
+  for (size_t b = 0; b < ir->n_blocks; b++)
+  {
+    ir_block_t* block = &ir->blocks[b];
+    size_t first = block->first_instruction;
+    size_t end = first + block->n_instructions;
+    extend_intervals_in_set(&ir->live_in[b * ir->words_per_set], first * 2);
+    extend_intervals_in_set(&ir->live_out[b * ir->words_per_set], end * 2 - 1);
+
+    for (size_t k = first; k < end; k++)
+    {
+      ir_instruction_t* instruction = &ir->instructions[k];
+      for (size_t i = 0; i < ir_n_uses(instruction); i++)
+      {
+        ir_vreg_t vreg = ir_use(ir, instruction, i)->vreg;
+        if (vreg != IR_NO_VREG)
+          extend_interval(vreg, k * 2);
+      }
+      if (instruction->dest != IR_NO_VREG)
+        extend_interval(instruction->dest, k * 2 + 1);
+      if (ir_is_call(instruction))
+        record_call(k * 2);
+    }
+  }
+}
+
+// Marks the intervals that are live across a call, from before it reads its arguments to after
+// it writes its result. The calls are in increasing order
+static void find_calls_in_intervals(size_t n_vregs)
+{
+  register_allocation_t* allocation = &compilation->register_allocation;
+  for (size_t i = 0; i < n_vregs; i++)
+  {
+    live_interval_t* interval = &allocation->intervals[i];
+    if (interval->start == NOT_STARTED)
+      continue;
+
+    // Find the first call at or after the start of the interval
+    size_t low = 0, high = allocation->n_calls;
+    while (low < high)
+    {
+      size_t middle = low + (high - low) / 2;
+      if (allocation->calls[middle] < interval->start)
+        low = middle + 1;
+      else
+        high = middle;
+    }
+    interval->crosses_call = low < allocation->n_calls && allocation->calls[low] < interval->end;
+  }
+}
+
+// Orders intervals by where they start, for qsort. Intervals starting at the same position are
+// ordered by their virtual registers, so the allocation never depends on how qsort orders them
+static int compare_interval_starts(const void* a, const void* b)
+{
+  const live_interval_t* x = a;
+  const live_interval_t* y = b;
+  if (x->start != y->start)
+    return x->start < y->start ? -1 : 1;
+  return x->vreg < y->vreg ? -1 : x->vreg > y->vreg;
+}
+
+// Gives the virtual register of the interval the register, and saves the register in the prologue
+// if it is callee saved, the first time it is used
+static void assign_register(live_interval_t* interval, size_t reg)
+{
+  register_allocation_t* allocation = &compilation->register_allocation;
+  allocation->locations[interval->vreg] = (vreg_location_t){
+      .operand = ALLOCATABLE_REGISTERS[reg], .byte_register = BYTE_REGISTERS[reg]};
+
+  if (reg < NUM_CALLER_SAVED)
+    return;
+  for (size_t i = 0; i < allocation->n_saved_registers; i++)
+    if (allocation->saved_registers[i] == ALLOCATABLE_REGISTERS[reg])
+      return;
+  allocation->saved_registers[allocation->n_saved_registers++] = ALLOCATABLE_REGISTERS[reg];
+}
+
+// Hands out registers to the intervals in order of where they start, freeing the registers of
+// intervals that have ended. When no register is free, the virtual register of whichever interval
+// ends last is left for the call frame. Returns the number of intervals, which are left sorted
+static size_t scan_intervals(size_t n_vregs)
+{
+  register_allocation_t* allocation = &compilation->register_allocation;
+  allocation->n_saved_registers = 0;
+
+  // Leave out the virtual registers that are never used, and sort the rest
+  live_interval_t* intervals = allocation->intervals;
+  size_t n_intervals = 0;
+  for (size_t i = 0; i < n_vregs; i++)
+    if (intervals[i].start != NOT_STARTED)
+      intervals[n_intervals++] = intervals[i];
+  qsort(intervals, n_intervals, sizeof(live_interval_t), compare_interval_starts);
+
+  // The interval holding each register
+  size_t holders[NUM_ALLOCATABLE_REGISTERS];
+  for (size_t reg = 0; reg < NUM_ALLOCATABLE_REGISTERS; reg++)
+    holders[reg] = NO_INTERVAL;
+
+  for (size_t i = 0; i < n_intervals; i++)
+  {
+    live_interval_t* interval = &intervals[i];
+    for (size_t reg = 0; reg < NUM_ALLOCATABLE_REGISTERS; reg++)
+      if (holders[reg] != NO_INTERVAL && intervals[holders[reg]].end < interval->start)
+        holders[reg] = NO_INTERVAL;
+
+    // Caller saved registers would be lost in calls
+    size_t first = interval->crosses_call ? NUM_CALLER_SAVED : 0;
+    size_t chosen = NO_INTERVAL;
+    size_t last_ending = NO_INTERVAL;
+    for (size_t reg = first; reg < NUM_ALLOCATABLE_REGISTERS && chosen == NO_INTERVAL; reg++)
+    {
+      if (holders[reg] == NO_INTERVAL)
+        chosen = reg;
+      else if (last_ending == NO_INTERVAL
+               || intervals[holders[reg]].end > intervals[holders[last_ending]].end)
+        last_ending = reg;
+    }
+
+    if (chosen == NO_INTERVAL)
+    {
+      // Take the register of the interval ending last, if it ends after this one
+      if (last_ending == NO_INTERVAL || intervals[holders[last_ending]].end <= interval->end)
+        continue;
+      chosen = last_ending;
+      allocation->locations[intervals[holders[chosen]].vreg] = (vreg_location_t){.operand = NULL};
+    }
+
+    holders[chosen] = i;
+    assign_register(interval, chosen);
+  }
+  return n_intervals;
+}
+
+// Writes the operand offset(%rbp), for a quadword in the call frame
+static void format_frame_operand(frame_operand_t* operand, int offset)
+{
+  char* text = operand->text;
+  text += format_int(text, offset);
+  memcpy(text, "(" RBP ")", sizeof("(" RBP ")"));
+}
+
+// Swaps two slots in the heap of slots
+static void swap_slots(size_t i, size_t j)
+{
+  size_t* heap = compilation->register_allocation.slot_heap;
+  size_t slot = heap[i];
+  heap[i] = heap[j];
+  heap[j] = slot;
+}
+
+// Moves the slot at position i of the heap of slots up, while it ends before its parent
+static void sift_slot_up(size_t i)
+{
+  register_allocation_t* allocation = &compilation->register_allocation;
+  size_t* heap = allocation->slot_heap;
+  while (i > 0 && allocation->slot_ends[heap[i]] < allocation->slot_ends[heap[(i - 1) / 2]])
+  {
+    swap_slots(i, (i - 1) / 2);
+    i = (i - 1) / 2;
+  }
+}
+
+// Moves the slot at position i of the heap of slots down, while one of its children ends before it
+static void sift_slot_down(size_t i)
+{
+  register_allocation_t* allocation = &compilation->register_allocation;
+  size_t* heap = allocation->slot_heap;
+  size_t n = allocation->n_frame_slots;
+  while (true)
+  {
+    size_t first = i;
+    for (size_t child = 2 * i + 1; child <= 2 * i + 2 && child < n; child++)
+      if (allocation->slot_ends[heap[child]] < allocation->slot_ends[heap[first]])
+        first = child;
+    if (first == i)
+      return;
+    swap_slots(i, first);
+    i = first;
+  }
+}
+
+// Places the virtual registers without registers in slots of the call frame, below the callee
+// saved registers. Virtual registers whose intervals do not overlap share a slot, like registers
+// are shared, and the slots are kept in a heap to find the one that ended first. Parameters
+// passed on the stack stay where the caller put them instead. The intervals are sorted by where
+// they start
+static void place_spilled_vregs(size_t n_intervals)
+{
+  ir_function_t* ir = &compilation->ir;
+  register_allocation_t* allocation = &compilation->register_allocation;
+  live_interval_t* intervals = allocation->intervals;
+  size_t n_parameters = FUNC_PARAM_COUNT(ir->symbol);
+  size_t n_stack_parameters =
+      n_parameters > NUM_REGISTER_PARAMS ? n_parameters - NUM_REGISTER_PARAMS : 0;
+
+  // There is at most one slot for each virtual register without a register, so the operands are
+  // made room for before any of them are used
+  size_t n_operands = n_stack_parameters;
+  for (size_t i = 0; i < n_intervals; i++)
+    if (allocation->locations[intervals[i].vreg].operand == NULL)
+      n_operands++;
+  if (n_operands > allocation->frame_operands_capacity)
+  {
+    allocation->frame_operands_capacity = n_operands * 2;
+    allocation->frame_operands = realloc(
+        allocation->frame_operands,
+        allocation->frame_operands_capacity * sizeof(frame_operand_t));
+    allocation->slot_ends =
+        realloc(allocation->slot_ends, allocation->frame_operands_capacity * sizeof(size_t));
+    allocation->slot_heap =
+        realloc(allocation->slot_heap, allocation->frame_operands_capacity * sizeof(size_t));
+  }
+
+  // Parameter 6 is at 16(%rbp), with further parameters moving up from there
+  for (size_t i = 0; i < n_stack_parameters; i++)
+    format_frame_operand(&allocation->frame_operands[i], 16 + i * 8);
+
+  frame_operand_t* slots = &allocation->frame_operands[n_stack_parameters];
+  allocation->n_frame_slots = 0;
+  for (size_t i = 0; i < n_intervals; i++)
+  {
+    live_interval_t* interval = &intervals[i];
+    vreg_location_t* location = &allocation->locations[interval->vreg];
+    if (location->operand != NULL)
+      continue;
+
+    if (interval->vreg >= NUM_REGISTER_PARAMS && interval->vreg < n_parameters)
+    {
+      location->operand = allocation->frame_operands[interval->vreg - NUM_REGISTER_PARAMS].text;
+      continue;
+    }
+
+    // Reuse the slot that ended first, if it has ended
+    size_t slot;
+    if (allocation->n_frame_slots > 0
+        && allocation->slot_ends[allocation->slot_heap[0]] < interval->start)
+    {
+      slot = allocation->slot_heap[0];
+      allocation->slot_ends[slot] = interval->end;
+      sift_slot_down(0);
+    }
+    else
+    {
+      // The stack grows down, in multiples of 8
+      slot = allocation->n_frame_slots++;
+      size_t offset = (allocation->n_saved_registers + slot + 1) * 8;
+      format_frame_operand(&slots[slot], -(int)offset);
+      allocation->slot_ends[slot] = interval->end;
+      allocation->slot_heap[slot] = slot;
+      sift_slot_up(slot);
+    }
+    location->operand = slots[slot].text;
+  }
+}
@@ -0,0 +1,85 @@
+#ifndef REGISTER_ALLOCATION_H
+#define REGISTER_ALLOCATION_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// The virtual registers of the IR, see ir.h, are kept in machine registers when there are enough
+// of them, and in the call frame otherwise. Registers are handed out by linear scan over the live
+// interval of each virtual register: instruction k reads its operands at position 2k, and writes
+// its dest at position 2k + 1. A virtual register is live from the first position it is written
+// or live at, to the last position it is read or live at. A virtual register live at the start or
+// end of a block is live there, which makes it live for all of a loop it flows around.
+//
+// Virtual registers live across a call are only given callee saved registers, which the function
+// saves in its prologue. Others are given caller saved registers first, which then never need
+// saving. When there are more live virtual registers than registers, the one whose interval ends
+// last is kept in the call frame for all of its interval. Virtual registers in the call frame
+// share slots, when their intervals do not overlap.
+//
+// %rax, %rdx and %r11 are never handed out. generator.c uses them as scratch registers, and for
+// division, which takes %rax and %rdx.
+
+// In the System V calling convention, the first 6 integer parameters are passed in registers
+#define NUM_REGISTER_PARAMS 6
+
+// The number of registers that can hold virtual registers, and how many of them are callee saved
+#define NUM_ALLOCATABLE_REGISTERS 11
+#define NUM_CALLEE_SAVED_REGISTERS 5
+
+// Where a virtual register of the function being generated is kept
+typedef struct vreg_location
+{
+  const char* operand;       // The register, such as %rbx, or a slot such as -8(%rbp)
+  const char* byte_register; // The lowest byte of the register, or NULL in the call frame
+} vreg_location_t;
+
+// A live interval, between two positions in the function
+typedef struct live_interval
+{
+  size_t start;
+  size_t end;
+  uint32_t vreg;
+  bool crosses_call; // True if a function is called while the virtual register is live
+} live_interval_t;
+
+// The operand of a slot in the call frame, such as -8(%rbp)
+typedef struct frame_operand
+{
+  char text[24];
+} frame_operand_t;
+
+// The locations of the virtual registers of the function being generated, and scratch space for
+// finding them, reused for every function. Each thread generating functions has its own
+typedef struct register_allocation
+{
+  vreg_location_t* locations; // Indexed by virtual register. The operand is NULL if unused
+  live_interval_t* intervals; // Indexed by virtual register while they are being found
+  size_t capacity;            // Of both of the above
+
+  // The callee saved registers the function uses, in the order they are saved in the prologue
+  const char* saved_registers[NUM_CALLEE_SAVED_REGISTERS];
+  size_t n_saved_registers;
+  // The operands of the parameters passed on the stack, which stay where the caller put them if
+  // they are not given registers, followed by those of the slots below the saved registers
+  frame_operand_t* frame_operands;
+  size_t n_frame_slots;
+  size_t* slot_ends; // Where the last interval placed in each slot ends
+  size_t* slot_heap; // The slots, as a binary heap with the one ending first at the top
+  size_t frame_operands_capacity; // Of the three above
+
+  // The positions where functions are called, in increasing order
+  size_t* calls;
+  size_t n_calls;
+  size_t calls_capacity;
+} register_allocation_t;
+
+// Decides where each virtual register of compilation->ir is kept, and fills in
+// compilation->register_allocation. Uses the liveness found when the IR was lowered
+void allocate_registers(void);
+
+// Frees the register allocation of the active compilation
+void destroy_register_allocation(void);
+
+#endif // REGISTER_ALLOCATION_H
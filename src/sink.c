@@ -0,0 +1,213 @@
+#include "sink.h"
+#include <stdarg.h>
+#include <stdlib.h>
+
+// The buffer of a sink without a file starts this small, and doubles in size when full
+#define SINK_INITIAL_CAPACITY 4096
+
+// Initializes the sink. The buffer is not allocated until the first write
+void sink_init(sink_t* sink, FILE* file)
+{
+  *sink = (sink_t){.buffer = NULL, .length = 0, .capacity = 0, .file = file, .failed = false};
+}
+
+// A sink with a file first writes out what it has, and only grows for writes
+// larger than its buffer. A sink without a file doubles its buffer until the write fits
+void sink_reserve(sink_t* sink, size_t n)
+{
+  if (sink->length + n <= sink->capacity)
+    return;
+
+  if (sink->file != NULL)
+    sink_flush(sink);
+
+  size_t capacity = sink->capacity;
+  if (capacity == 0)
+    capacity = sink->file != NULL ? SINK_FLUSH_SIZE : SINK_INITIAL_CAPACITY;
+  while (sink->length + n > capacity)
+    capacity *= 2;
+
+  if (capacity != sink->capacity)
+  {
+    sink->buffer = realloc(sink->buffer, capacity);
+    sink->capacity = capacity;
+  }
+}
+
+// Digits are produced from the back, into a temporary buffer, and then copied to the front
+size_t format_int(char* buffer, int64_t value)
+{
+  char digits[20];
+  size_t n_digits = 0;
+
+  // Work with the magnitude as unsigned, so that INT64_MIN can be negated
+  uint64_t magnitude = value < 0 ? -(uint64_t)value : (uint64_t)value;
+  do
+  {
+    digits[sizeof(digits) - ++n_digits] = '0' + magnitude % 10;
+    magnitude /= 10;
+  } while (magnitude != 0);
+
+  size_t length = 0;
+  if (value < 0)
+    buffer[length++] = '-';
+  memcpy(buffer + length, digits + sizeof(digits) - n_digits, n_digits);
+  return length + n_digits;
+}
+
+// Formats into a small buffer on the stack, which is then appended
+void sink_int(sink_t* sink, int64_t value)
+{
+  char buffer[21];
+  sink_write(sink, buffer, format_int(buffer, value));
+}
+
+// Like format_int, but for values that need all 64 bits
+void sink_uint(sink_t* sink, uint64_t value)
+{
+  char digits[20];
+  size_t n_digits = 0;
+  do
+  {
+    digits[sizeof(digits) - ++n_digits] = '0' + value % 10;
+    value /= 10;
+  } while (value != 0);
+  sink_write(sink, digits + sizeof(digits) - n_digits, n_digits);
+}
+
+// Pointers are written like glibc's %p: 0x followed by lowercase hexadecimal digits
+static void sink_pointer(sink_t* sink, const void* pointer)
+{
+  if (pointer == NULL)
+  {
+    sink_puts(sink, "(nil)");
+    return;
+  }
+
+  char digits[2 + 2 * sizeof(uintptr_t)];
+  size_t n_digits = 0;
+  uintptr_t value = (uintptr_t)pointer;
+  do
+  {
+    digits[sizeof(digits) - ++n_digits] = "0123456789abcdef"[value & 0xf];
+    value >>= 4;
+  } while (value != 0);
+  digits[sizeof(digits) - ++n_digits] = 'x';
+  digits[sizeof(digits) - ++n_digits] = '0';
+  sink_write(sink, digits + sizeof(digits) - n_digits, n_digits);
+}
+
+// Writes the pieces of the instruction one by one, without any format string
+void sink_instruction(
+    sink_t* sink, const char* mnemonic, const char* operand1, const char* operand2)
+{
+  sink_putc(sink, '\t');
+  sink_puts(sink, mnemonic);
+  if (operand1 != NULL)
+  {
+    sink_putc(sink, ' ');
+    sink_puts(sink, operand1);
+  }
+  if (operand2 != NULL)
+  {
+    sink_write(sink, ", ", 2);
+    sink_puts(sink, operand2);
+  }
+  sink_putc(sink, '\n');
+}
+
+// Copies text up to each %, and handles the conversion that follows it
+void sink_printf(sink_t* sink, const char* format, ...)
+{
+  va_list arguments;
+  va_start(arguments, format);
+
+  const char* c = format;
+  while (*c != '\0')
+  {
+    const char* percent = strchr(c, '%');
+    if (percent == NULL)
+    {
+      sink_puts(sink, c);
+      break;
+    }
+    sink_write(sink, c, percent - c);
+    c = percent + 1;
+
+    switch (*c++)
+    {
+    case '%':
+      sink_putc(sink, '%');
+      break;
+    case 's':
+      sink_puts(sink, va_arg(arguments, const char*));
+      break;
+    case '*':
+    {
+      // Only used as %*s, to pad a string on the left to the given width
+      int width = va_arg(arguments, int);
+      const char* string = va_arg(arguments, const char*);
+      size_t length = strlen(string);
+      for (size_t i = length; i < (size_t)(width > 0 ? width : 0); i++)
+        sink_putc(sink, ' ');
+      sink_write(sink, string, length);
+      c++; // Skip the s
+      break;
+    }
+    case 'c':
+      sink_putc(sink, (char)va_arg(arguments, int));
+      break;
+    case 'd':
+      sink_int(sink, va_arg(arguments, int));
+      break;
+    case 'l':
+      // %ld
+      c++;
+      sink_int(sink, va_arg(arguments, long));
+      break;
+    case 'z':
+      // %zu
+      c++;
+      sink_uint(sink, va_arg(arguments, size_t));
+      break;
+    case 'p':
+      sink_pointer(sink, va_arg(arguments, void*));
+      break;
+    default:
+      // Anything else is a conversion this function does not know
+      fprintf(stderr, "sink_printf: unsupported conversion in '%s'\n", format);
+      abort();
+    }
+  }
+
+  va_end(arguments);
+}
+
+// Writes the whole buffer with a single fwrite, and empties it
+bool sink_flush(sink_t* sink)
+{
+  if (sink->file != NULL && sink->length > 0)
+  {
+    if (fwrite(sink->buffer, 1, sink->length, sink->file) != sink->length)
+      sink->failed = true;
+    sink->length = 0;
+  }
+  return !sink->failed;
+}
+
+// Adds the NUL-terminator, and leaves the sink empty
+char* sink_take_buffer(sink_t* sink, size_t* length)
+{
+  sink_putc(sink, '\0');
+  char* buffer = sink->buffer;
+  *length = sink->length - 1;
+  sink_init(sink, sink->file);
+  return buffer;
+}
+
+// Frees the buffer, and leaves the sink empty
+void sink_destroy(sink_t* sink)
+{
+  free(sink->buffer);
+  sink_init(sink, sink->file);
+}
@@ -0,0 +1,82 @@
+#ifndef SINK_H
+#define SINK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// An output sink collects text in one large, growable buffer.
+// A sink with a file writes the buffer to the file in big chunks, whenever it fills up.
+// A sink without a file keeps all of its output in memory, where it can be taken out at the end.
+// Integers and pointers are formatted by hand, so most output never goes through printf.
+typedef struct sink
+{
+  char* buffer;
+  size_t length;
+  size_t capacity;
+  FILE* file;  // NULL if the output is kept in memory
+  bool failed; // Set if a write to the file has failed
+} sink_t;
+
+// How much output a sink with a file collects before writing it out
+#define SINK_FLUSH_SIZE (1024 * 1024)
+
+// Initializes an empty sink, writing to the given file, or keeping everything in memory if NULL
+void sink_init(sink_t* sink, FILE* file);
+
+// Makes room for at least n more characters in the buffer, flushing or growing it
+void sink_reserve(sink_t* sink, size_t n);
+
+// Appends length characters to the sink
+static inline void sink_write(sink_t* sink, const char* data, size_t length)
+{
+  if (sink->length + length > sink->capacity)
+    sink_reserve(sink, length);
+  memcpy(sink->buffer + sink->length, data, length);
+  sink->length += length;
+}
+
+// Appends a NUL-terminated string to the sink
+static inline void sink_puts(sink_t* sink, const char* string)
+{
+  sink_write(sink, string, strlen(string));
+}
+
+// Appends a single character to the sink
+static inline void sink_putc(sink_t* sink, char c)
+{
+  sink_write(sink, &c, 1);
+}
+
+// Appends a signed integer in decimal
+void sink_int(sink_t* sink, int64_t value);
+
+// Appends an unsigned integer in decimal
+void sink_uint(sink_t* sink, uint64_t value);
+
+// Appends "\t<mnemonic> <operand1>, <operand2>\n". Operands that are NULL are left out
+void sink_instruction(
+    sink_t* sink, const char* mnemonic, const char* operand1, const char* operand2);
+
+// Appends text formatted like printf, but only understands a few conversions:
+// %s, %*s, %c, %d, %ld, %zu and %p, as well as %%.
+void sink_printf(sink_t* sink, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+// Writes everything in the buffer to the file, if the sink has one.
+// Returns false if any write to the file has failed, now or earlier
+bool sink_flush(sink_t* sink);
+
+// Takes the buffer out of a sink without a file. The buffer is NUL-terminated,
+// its length is stored in *length, and it must be freed by the caller
+char* sink_take_buffer(sink_t* sink, size_t* length);
+
+// Frees the buffer of the sink. Does not flush or close the file
+void sink_destroy(sink_t* sink);
+
+// Writes the decimal digits of value into buffer, which must have room for 21 characters.
+// Returns the number of characters written. The result is not NUL-terminated
+size_t format_int(char* buffer, int64_t value);
+
+#endif // SINK_H
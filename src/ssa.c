@@ -0,0 +1,1452 @@
+#include "vslc.h"
+
+// An expression whose value is known, and the slot of the table of values it is in. Loads have the
+// time the memory they read was last changed as their version, while other expressions have 0
+typedef struct value_entry
+{
+  uint8_t opcode;
+  uint32_t slot;
+  ir_value_t operands[2];
+  symbol_t* symbol;
+  size_t version;
+  ir_value_t value;
+} value_entry_t;
+
+// The definition a variable had before a block of the walk assigned it
+typedef struct definition_change
+{
+  ir_vreg_t variable;
+  ir_value_t previous;
+} definition_change_t;
+
+// Marks the entries of the walk stack that leave a block, rather than enter it
+#define LEAVING_BLOCK ((uint32_t)1 << 31)
+
+// The most pairs of virtual registers checked for interference before merging the classes of a
+// phi. Phis needing more are isolated instead, which keeps leaving SSA form fast in functions with
+// long chains of phis
+#define MAX_INTERFERENCE_CHECKS 256
+
+// The most classes merged by one phi. Phis with more are isolated instead
+#define MAX_PHI_CLASSES 16
+
+static void find_dominators(void);
+static void find_dominance_frontiers(void);
+static void place_phis(void);
+static void walk_dominator_tree(void);
+static void remove_trivial_phis(void);
+static void replace_uses(void);
+static void copy_constant_arguments(void);
+static void count_phis(void);
+static void leave_ssa(void);
+
+/* External interface */
+
+// Puts the IR in SSA form and numbers its values in one walk of the dominator tree, then takes it
+// out of SSA form. Phis whose arguments are all the same value, and values never used, are
+// removed on the way
+void number_values(void)
+{
+  find_dominators();
+  find_dominance_frontiers();
+  place_phis();
+  walk_dominator_tree();
+  remove_trivial_phis();
+  replace_uses();
+  copy_constant_arguments();
+  // Values reused or folded leave the instructions computing them again unused. Removing them
+  // before leaving SSA form keeps them from being merged with the values that are used
+  ir_remove_dead_code();
+  count_phis();
+  leave_ssa();
+}
+
+// Frees the scratch space of the active compilation
+void destroy_ssa(void)
+{
+  ssa_t* ssa = &compilation->ssa;
+  free(ssa->order);
+  free(ssa->reverse_postorder);
+  free(ssa->dominators);
+  free(ssa->first_children);
+  free(ssa->next_siblings);
+  free(ssa->entered);
+  free(ssa->left);
+  free(ssa->first_frontiers);
+  free(ssa->n_frontiers);
+  free(ssa->n_phis);
+  free(ssa->marks);
+  free(ssa->queued);
+  free(ssa->work);
+  free(ssa->entry_scopes);
+  free(ssa->definition_scopes);
+  free(ssa->frontiers);
+  free(ssa->placed_phis);
+  free(ssa->first_assignments);
+  free(ssa->assignments);
+  free(ssa->definitions);
+  free(ssa->values);
+  free(ssa->writing_blocks);
+  free(ssa->writing_instructions);
+  free(ssa->classes);
+  free(ssa->class_members);
+  free(ssa->class_vregs);
+  free(ssa->slots);
+  free(ssa->entries);
+  free(ssa->definition_log);
+  free(ssa->stored_at);
+  free(ssa->phi_copies);
+  free(ssa->spare_instructions);
+  *ssa = (ssa_t){.order = NULL};
+}
+
+/* Internal matters */
+
+// Returns the array, with room for at least n elements of the given size. The capacity of the
+// array is updated if it has to grow. The array is made even if it is empty
+static void* grow(void* array, size_t* capacity, size_t n, size_t element_size)
+{
+  if (array != NULL && n <= *capacity)
+    return array;
+  *capacity = n * 2 > 64 ? n * 2 : 64;
+  return realloc(array, *capacity * element_size);
+}
+
+// Makes room for the scratch space of every block. The walk stack holds each block twice
+static void reserve_blocks(size_t n_blocks)
+{
+  ssa_t* ssa = &compilation->ssa;
+  if (ssa->order != NULL && n_blocks <= ssa->blocks_capacity)
+    return;
+  size_t capacity = ssa->blocks_capacity = n_blocks * 2 + 16;
+  ssa->order = realloc(ssa->order, capacity * sizeof(uint32_t));
+  ssa->reverse_postorder = realloc(ssa->reverse_postorder, capacity * sizeof(uint32_t));
+  ssa->dominators = realloc(ssa->dominators, capacity * sizeof(uint32_t));
+  ssa->first_children = realloc(ssa->first_children, capacity * sizeof(uint32_t));
+  ssa->next_siblings = realloc(ssa->next_siblings, capacity * sizeof(uint32_t));
+  ssa->entered = realloc(ssa->entered, capacity * sizeof(uint32_t));
+  ssa->left = realloc(ssa->left, capacity * sizeof(uint32_t));
+  ssa->first_frontiers = realloc(ssa->first_frontiers, capacity * sizeof(uint32_t));
+  ssa->n_frontiers = realloc(ssa->n_frontiers, capacity * sizeof(uint32_t));
+  ssa->n_phis = realloc(ssa->n_phis, capacity * sizeof(uint32_t));
+  ssa->marks = realloc(ssa->marks, capacity * sizeof(uint32_t));
+  ssa->queued = realloc(ssa->queued, capacity * sizeof(uint32_t));
+  ssa->work = realloc(ssa->work, capacity * 2 * sizeof(uint32_t));
+  ssa->entry_scopes = realloc(ssa->entry_scopes, capacity * sizeof(size_t));
+  ssa->definition_scopes = realloc(ssa->definition_scopes, capacity * sizeof(size_t));
+}
+
+// Makes room for the scratch space of every virtual register
+static void reserve_vregs(size_t n_vregs)
+{
+  ssa_t* ssa = &compilation->ssa;
+  if (ssa->values != NULL && n_vregs <= ssa->vregs_capacity)
+    return;
+  size_t capacity = ssa->vregs_capacity = n_vregs * 2 + 16;
+  ssa->values = realloc(ssa->values, capacity * sizeof(ir_value_t));
+  ssa->writing_blocks = realloc(ssa->writing_blocks, capacity * sizeof(uint32_t));
+  ssa->writing_instructions = realloc(ssa->writing_instructions, capacity * sizeof(uint32_t));
+  ssa->classes = realloc(ssa->classes, capacity * sizeof(uint32_t));
+  ssa->class_members = realloc(ssa->class_members, capacity * sizeof(uint32_t));
+  ssa->class_vregs = realloc(ssa->class_vregs, capacity * sizeof(ir_vreg_t));
+}
+
+// Swaps the instructions of the IR with the spare instructions, once they have been moved there
+static void swap_instructions(size_t n_instructions)
+{
+  ir_function_t* ir = &compilation->ir;
+  ssa_t* ssa = &compilation->ssa;
+  ir_instruction_t* instructions = ir->instructions;
+  ir->instructions = ssa->spare_instructions;
+  ssa->spare_instructions = instructions;
+  size_t capacity = ir->instructions_capacity;
+  ir->instructions_capacity = ssa->spare_instructions_capacity;
+  ssa->spare_instructions_capacity = capacity;
+  ir->n_instructions = n_instructions;
+}
+
+// Returns a constant value
+static ir_value_t constant_value(int64_t constant)
+{
+  return (ir_value_t){.vreg = IR_NO_VREG, .constant = constant};
+}
+
+// Returns the value of a virtual register
+static ir_value_t vreg_value(ir_vreg_t vreg)
+{
+  return (ir_value_t){.vreg = vreg, .constant = 0};
+}
+
+// Returns true if the two values are the same virtual register, or the same constant
+static bool same_value(ir_value_t a, ir_value_t b)
+{
+  return a.vreg == b.vreg && (a.vreg != IR_NO_VREG || a.constant == b.constant);
+}
+
+// Returns a new virtual register, which is not replaced by any other value
+static ir_vreg_t new_vreg(void)
+{
+  ssa_t* ssa = &compilation->ssa;
+  ir_vreg_t vreg = compilation->ir.n_vregs++;
+  assert(vreg < ssa->vregs_capacity);
+  ssa->values[vreg] = vreg_value(vreg);
+  return vreg;
+}
+
+// Returns the instruction ending the block
+static ir_instruction_t* block_terminator(uint32_t block)
+{
+  ir_function_t* ir = &compilation->ir;
+  ir_block_t* b = &ir->blocks[block];
+  return &ir->instructions[b->first_instruction + b->n_instructions - 1];
+}
+
+// Returns the block both blocks are dominated by, found by walking up the dominator tree from
+// the one later in reverse postorder
+static uint32_t common_dominator(uint32_t a, uint32_t b)
+{
+  ssa_t* ssa = &compilation->ssa;
+  while (a != b)
+  {
+    while (ssa->reverse_postorder[a] > ssa->reverse_postorder[b])
+      a = ssa->dominators[a];
+    while (ssa->reverse_postorder[b] > ssa->reverse_postorder[a])
+      b = ssa->dominators[b];
+  }
+  return a;
+}
+
+// Finds the immediate dominator of every block, by the iterative algorithm of Cooper, Harvey and
+// Kennedy over the blocks in reverse postorder, and makes the dominator tree from them. The entry
+// block has no predecessors
+static void find_dominators(void)
+{
+  ir_function_t* ir = &compilation->ir;
+  ssa_t* ssa = &compilation->ssa;
+  size_t n_blocks = ir->n_blocks;
+  reserve_blocks(n_blocks);
+  assert(ir->blocks[0].n_predecessors == 0);
+
+  // Depth first search, where the mark of a block is 1 plus the number of successors visited
+  memset(ssa->marks, 0, n_blocks * sizeof(uint32_t));
+  size_t n_work = 0;
+  size_t n_unordered = n_blocks;
+  ssa->work[n_work++] = 0;
+  ssa->marks[0] = 1;
+  while (n_work > 0)
+  {
+    uint32_t block = ssa->work[n_work - 1];
+    ir_instruction_t* terminator = block_terminator(block);
+    size_t next = ssa->marks[block] - 1;
+    if (next < ir_n_successors(terminator))
+    {
+      ssa->marks[block]++;
+      uint32_t successor = terminator->targets[next];
+      if (ssa->marks[successor] == 0)
+      {
+        ssa->marks[successor] = 1;
+        ssa->work[n_work++] = successor;
+      }
+      continue;
+    }
+    n_work--;
+    ssa->order[--n_unordered] = block;
+  }
+  assert(n_unordered == 0);
+  for (uint32_t i = 0; i < n_blocks; i++)
+    ssa->reverse_postorder[ssa->order[i]] = i;
+
+  for (size_t i = 0; i < n_blocks; i++)
+    ssa->dominators[i] = IR_NO_BLOCK;
+  ssa->dominators[0] = 0;
+  bool changed = true;
+  while (changed)
+  {
+    changed = false;
+    for (size_t i = 1; i < n_blocks; i++)
+    {
+      uint32_t block = ssa->order[i];
+      ir_block_t* b = &ir->blocks[block];
+      uint32_t dominator = IR_NO_BLOCK;
+      for (size_t j = 0; j < b->n_predecessors; j++)
+      {
+        uint32_t predecessor = ir->predecessors[b->first_predecessor + j];
+        if (ssa->dominators[predecessor] == IR_NO_BLOCK)
+          continue;
+        dominator =
+            dominator == IR_NO_BLOCK ? predecessor : common_dominator(predecessor, dominator);
+      }
+      if (ssa->dominators[block] != dominator)
+      {
+        ssa->dominators[block] = dominator;
+        changed = true;
+      }
+    }
+  }
+
+  // Children are added from the last in reverse postorder, so each list ends up in that order
+  for (size_t i = 0; i < n_blocks; i++)
+    ssa->first_children[i] = IR_NO_BLOCK;
+  for (size_t i = n_blocks; i > 1; i--)
+  {
+    uint32_t block = ssa->order[i - 1];
+    uint32_t dominator = ssa->dominators[block];
+    ssa->next_siblings[block] = ssa->first_children[dominator];
+    ssa->first_children[dominator] = block;
+  }
+}
+
+// Walks up the dominator tree from each predecessor of every block where paths meet, up to the
+// dominator of the block, which leaves the block in the frontier of the blocks passed. If fill is
+// false the frontiers are only counted, otherwise they are filled in
+static void walk_to_frontiers(bool fill)
+{
+  ir_function_t* ir = &compilation->ir;
+  ssa_t* ssa = &compilation->ssa;
+
+  // The mark of a block is the last block added to its frontier
+  for (size_t i = 0; i < ir->n_blocks; i++)
+  {
+    ssa->marks[i] = IR_NO_BLOCK;
+    ssa->n_frontiers[i] = 0;
+  }
+
+  for (uint32_t block = 0; block < ir->n_blocks; block++)
+  {
+    ir_block_t* b = &ir->blocks[block];
+    if (b->n_predecessors < 2)
+      continue;
+    for (size_t j = 0; j < b->n_predecessors; j++)
+    {
+      uint32_t runner = ir->predecessors[b->first_predecessor + j];
+      while (runner != ssa->dominators[block])
+      {
+        if (ssa->marks[runner] != block)
+        {
+          ssa->marks[runner] = block;
+          if (fill)
+            ssa->frontiers[ssa->first_frontiers[runner] + ssa->n_frontiers[runner]] = block;
+          ssa->n_frontiers[runner]++;
+        }
+        runner = ssa->dominators[runner];
+      }
+    }
+  }
+}
+
+// Finds the dominance frontier of every block: the blocks where paths from it meet paths that do
+// not go through it
+static void find_dominance_frontiers(void)
+{
+  ir_function_t* ir = &compilation->ir;
+  ssa_t* ssa = &compilation->ssa;
+
+  walk_to_frontiers(false);
+  size_t length = 0;
+  for (size_t i = 0; i < ir->n_blocks; i++)
+  {
+    ssa->first_frontiers[i] = length;
+    length += ssa->n_frontiers[i];
+  }
+  ssa->frontiers = grow(ssa->frontiers, &ssa->frontiers_capacity, length, sizeof(uint32_t));
+  walk_to_frontiers(true);
+}
+
+// Orders placed phis by block, and by variable within each block, for qsort
+static int compare_phis(const void* a, const void* b)
+{
+  uint64_t x = *(const uint64_t*)a;
+  uint64_t y = *(const uint64_t*)b;
+  return x < y ? -1 : x > y;
+}
+
+// Finds the blocks assigning each variable that is live across blocks, by counting sort
+static void find_assignments(void)
+{
+  ir_function_t* ir = &compilation->ir;
+  ssa_t* ssa = &compilation->ssa;
+  size_t n_variables = ir->n_variables;
+  ssa->first_assignments = grow(
+      ssa->first_assignments, &ssa->variables_capacity, n_variables + 1, sizeof(uint32_t));
+  ssa->definitions = realloc(ssa->definitions, ssa->variables_capacity * sizeof(ir_value_t));
+  memset(ssa->first_assignments, 0, (n_variables + 1) * sizeof(uint32_t));
+
+  // Counted at the position after each variable, which becomes the start of the next
+  for (int pass = 0; pass < 2; pass++)
+  {
+    for (uint32_t block = 0; block < ir->n_blocks; block++)
+    {
+      ir_block_t* b = &ir->blocks[block];
+      for (size_t i = b->first_instruction; i < b->first_instruction + b->n_instructions; i++)
+      {
+        ir_vreg_t dest = ir->instructions[i].dest;
+        if (dest >= n_variables || ir->global_numbers[dest] == IR_NO_VREG)
+          continue;
+        if (pass == 0)
+          ssa->first_assignments[dest + 1]++;
+        else
+          ssa->assignments[ssa->first_assignments[dest]++] = block;
+      }
+    }
+
+    if (pass == 0)
+    {
+      for (size_t v = 0; v < n_variables; v++)
+        ssa->first_assignments[v + 1] += ssa->first_assignments[v];
+      ssa->assignments = grow(
+          ssa->assignments,
+          &ssa->assignments_capacity,
+          ssa->first_assignments[n_variables],
+          sizeof(uint32_t));
+    }
+  }
+
+  // Filling moved the start of each variable to the start of the next
+  for (size_t v = n_variables; v > 0; v--)
+    ssa->first_assignments[v] = ssa->first_assignments[v - 1];
+  ssa->first_assignments[0] = 0;
+}
+
+// Adds a phi for the variable to the start of the block, unless it has one
+static void add_phi(uint32_t block, ir_vreg_t variable)
+{
+  ssa_t* ssa = &compilation->ssa;
+  if (ssa->marks[block] == variable + 1)
+    return;
+  ssa->marks[block] = variable + 1;
+  ssa->placed_phis =
+      grow(ssa->placed_phis, &ssa->placed_phis_capacity, ssa->n_placed_phis + 1, sizeof(uint64_t));
+  ssa->placed_phis[ssa->n_placed_phis++] = (uint64_t)block << 32 | variable;
+}
+
+// Places a phi for a variable in every block in the iterated dominance frontier of the blocks
+// assigning it. Only variables live across blocks can need them, and phis placed where the
+// variable is not live are removed as dead code later. The phis are then added to the start of
+// their blocks, with room for their arguments
+static void place_phis(void)
+{
+  ir_function_t* ir = &compilation->ir;
+  ssa_t* ssa = &compilation->ssa;
+  find_assignments();
+  ssa->placed_phis = grow(ssa->placed_phis, &ssa->placed_phis_capacity, 1, sizeof(uint64_t));
+
+  // A block is marked with 1 plus the last variable given a phi there, and queued with 1 plus the
+  // last variable it was added to the work list for
+  memset(ssa->marks, 0, ir->n_blocks * sizeof(uint32_t));
+  memset(ssa->queued, 0, ir->n_blocks * sizeof(uint32_t));
+  ssa->n_placed_phis = 0;
+  for (ir_vreg_t variable = 0; variable < ir->n_variables; variable++)
+  {
+    if (ir->global_numbers[variable] == IR_NO_VREG)
+      continue;
+
+    size_t n_work = 0;
+    for (size_t i = ssa->first_assignments[variable]; i < ssa->first_assignments[variable + 1];
+         i++)
+    {
+      uint32_t block = ssa->assignments[i];
+      if (ssa->queued[block] != variable + 1)
+      {
+        ssa->queued[block] = variable + 1;
+        ssa->work[n_work++] = block;
+      }
+    }
+
+    while (n_work > 0)
+    {
+      uint32_t block = ssa->work[--n_work];
+      for (size_t i = 0; i < ssa->n_frontiers[block]; i++)
+      {
+        uint32_t frontier = ssa->frontiers[ssa->first_frontiers[block] + i];
+        add_phi(frontier, variable);
+        if (ssa->queued[frontier] != variable + 1)
+        {
+          ssa->queued[frontier] = variable + 1;
+          ssa->work[n_work++] = frontier;
+        }
+      }
+    }
+  }
+
+  qsort(ssa->placed_phis, ssa->n_placed_phis, sizeof(uint64_t), compare_phis);
+  ssa->spare_instructions = grow(
+      ssa->spare_instructions,
+      &ssa->spare_instructions_capacity,
+      ir->n_instructions + ssa->n_placed_phis,
+      sizeof(ir_instruction_t));
+
+  size_t n_instructions = 0;
+  size_t next_phi = 0;
+  for (uint32_t block = 0; block < ir->n_blocks; block++)
+  {
+    ir_block_t* b = &ir->blocks[block];
+    size_t first = n_instructions;
+    ssa->n_phis[block] = 0;
+    for (; next_phi < ssa->n_placed_phis && ssa->placed_phis[next_phi] >> 32 == block; next_phi++)
+    {
+      ir_vreg_t variable = (uint32_t)ssa->placed_phis[next_phi];
+      ssa->n_phis[block]++;
+      uint32_t first_argument = ir->n_arguments;
+      ir->arguments = grow(
+          ir->arguments,
+          &ir->arguments_capacity,
+          ir->n_arguments + b->n_predecessors,
+          sizeof(ir_value_t));
+      for (size_t i = 0; i < b->n_predecessors; i++)
+        ir->arguments[ir->n_arguments++] = constant_value(0);
+      ssa->spare_instructions[n_instructions++] = (ir_instruction_t){
+          .opcode = IR_PHI,
+          .dest = variable,
+          .variable = variable,
+          .first_argument = first_argument,
+          .n_arguments = b->n_predecessors};
+    }
+    memcpy(
+        &ssa->spare_instructions[n_instructions],
+        &ir->instructions[b->first_instruction],
+        b->n_instructions * sizeof(ir_instruction_t));
+    n_instructions += b->n_instructions;
+    b->first_instruction = first;
+    b->n_instructions = n_instructions - first;
+  }
+  swap_instructions(n_instructions);
+}
+
+// Returns the value the virtual register is replaced by, following replacements of replacements.
+// Each virtual register passed is then replaced by the last one directly
+static ir_value_t resolve(ir_value_t value)
+{
+  ir_value_t* values = compilation->ssa.values;
+  ir_value_t result = value;
+  while (result.vreg != IR_NO_VREG && values[result.vreg].vreg != result.vreg)
+    result = values[result.vreg];
+  while (value.vreg != IR_NO_VREG && values[value.vreg].vreg != value.vreg)
+  {
+    ir_value_t next = values[value.vreg];
+    values[value.vreg] = result;
+    value = next;
+  }
+  return result;
+}
+
+// Returns the value an operand has at this point of the walk. Until the walk reaches an
+// instruction, its operands refer to variables by their first virtual registers
+static ir_value_t current_value(ir_value_t operand)
+{
+  if (operand.vreg != IR_NO_VREG && operand.vreg < compilation->ir.n_variables)
+    return compilation->ssa.definitions[operand.vreg];
+  return resolve(operand);
+}
+
+// Gives the variable a new value, until the walk leaves the block
+static void define(ir_vreg_t variable, ir_value_t value)
+{
+  ssa_t* ssa = &compilation->ssa;
+  ssa->definition_log[ssa->definition_log_length++] =
+      (definition_change_t){.variable = variable, .previous = ssa->definitions[variable]};
+  ssa->definitions[variable] = value;
+}
+
+// Returns true if the value of the instruction can be computed from its operands alone
+static bool is_pure(ir_opcode_t opcode)
+{
+  return opcode == IR_NEGATE || opcode == IR_NOT
+      || (opcode >= IR_ADD && opcode <= IR_GREATER_EQUAL);
+}
+
+// Computes the operation on constants into result. Returns false if the operation would stop the
+// program, which is left for when it runs. Arithmetic wraps around, like the machine's
+static bool fold_constants(ir_opcode_t opcode, int64_t a, int64_t b, int64_t* result)
+{
+  uint64_t x = a;
+  uint64_t y = b;
+  switch (opcode)
+  {
+  case IR_NEGATE:
+    *result = (int64_t)(0 - x);
+    return true;
+  case IR_NOT:
+    *result = a == 0;
+    return true;
+  case IR_ADD:
+    *result = (int64_t)(x + y);
+    return true;
+  case IR_SUBTRACT:
+    *result = (int64_t)(x - y);
+    return true;
+  case IR_MULTIPLY:
+    *result = (int64_t)(x * y);
+    return true;
+  case IR_DIVIDE:
+    if (b == 0 || (a == INT64_MIN && b == -1))
+      return false;
+    *result = a / b;
+    return true;
+  case IR_EQUAL:
+    *result = a == b;
+    return true;
+  case IR_NOT_EQUAL:
+    *result = a != b;
+    return true;
+  case IR_LESS:
+    *result = a < b;
+    return true;
+  case IR_LESS_EQUAL:
+    *result = a <= b;
+    return true;
+  case IR_GREATER:
+    *result = a > b;
+    return true;
+  case IR_GREATER_EQUAL:
+    *result = a >= b;
+    return true;
+  default:
+    assert(false && "Not an operation on constants");
+    return false;
+  }
+}
+
+// Returns true if the order of the operands of the operation does not matter
+static bool is_commutative(ir_opcode_t opcode)
+{
+  return opcode == IR_ADD || opcode == IR_MULTIPLY || opcode == IR_EQUAL
+      || opcode == IR_NOT_EQUAL;
+}
+
+// Orders values for the operands of commutative operations: virtual registers by number, then
+// constants by value
+static bool value_before(ir_value_t a, ir_value_t b)
+{
+  if (a.vreg != b.vreg)
+    return a.vreg < b.vreg;
+  return a.constant < b.constant;
+}
+
+// Returns the hash of an expression in the table of values
+static uint64_t hash_entry(const value_entry_t* entry)
+{
+  uint64_t words[] = {
+      entry->opcode,
+      entry->operands[0].vreg,
+      (uint64_t)entry->operands[0].constant,
+      entry->operands[1].vreg,
+      (uint64_t)entry->operands[1].constant,
+      (uint64_t)(uintptr_t)entry->symbol,
+      entry->version};
+  uint64_t hash = 0;
+  for (size_t i = 0; i < sizeof(words) / sizeof(words[0]); i++)
+  {
+    hash = (hash ^ words[i]) * 0x9E3779B97F4A7C15ull;
+    hash ^= hash >> 29;
+  }
+  return hash;
+}
+
+// Returns true if the two entries are the same expression
+static bool same_expression(const value_entry_t* a, const value_entry_t* b)
+{
+  return a->opcode == b->opcode && same_value(a->operands[0], b->operands[0])
+      && same_value(a->operands[1], b->operands[1]) && a->symbol == b->symbol
+      && a->version == b->version;
+}
+
+// Returns the slot of the expression in the table of values, or the empty slot it would be put in
+static uint32_t find_slot(const value_entry_t* key)
+{
+  ssa_t* ssa = &compilation->ssa;
+  size_t mask = ssa->n_slots - 1;
+  size_t slot = hash_entry(key) & mask;
+  while (ssa->slots[slot] != 0 && !same_expression(&ssa->entries[ssa->slots[slot] - 1], key))
+    slot = (slot + 1) & mask;
+  return slot;
+}
+
+// Puts the expression in the table of values, until the walk leaves the block. Entries are only
+// removed in the opposite order they were added in, so no other entry is ever cut off from its slot
+static void add_value(value_entry_t key, ir_value_t value)
+{
+  ssa_t* ssa = &compilation->ssa;
+  key.slot = find_slot(&key);
+  key.value = value;
+  assert(ssa->slots[key.slot] == 0);
+  ssa->entries[ssa->n_entries++] = key;
+  ssa->slots[key.slot] = ssa->n_entries;
+}
+
+// Returns the time the memory read by loads of the global variable or array last changed
+static size_t memory_version(symbol_t* symbol)
+{
+  ssa_t* ssa = &compilation->ssa;
+  size_t version = ssa->stored_at[symbol->sequence_number];
+  if (ssa->called_at > version)
+    version = ssa->called_at;
+  if (ssa->entered_at > version)
+    version = ssa->entered_at;
+  return version;
+}
+
+// Records that the global variable or array is stored to
+static size_t store_to(symbol_t* symbol)
+{
+  ssa_t* ssa = &compilation->ssa;
+  ssa->stored_at[symbol->sequence_number] = ++ssa->clock;
+  return ssa->clock;
+}
+
+// Makes the result of the instruction the value of its dest. The dest of an instruction assigning a
+// variable is replaced by a new virtual register, which becomes the definition of the variable
+static void keep_result(ir_instruction_t* instruction)
+{
+  ir_vreg_t dest = instruction->dest;
+  if (dest != IR_NO_VREG && dest < compilation->ir.n_variables)
+  {
+    instruction->dest = new_vreg();
+    define(dest, vreg_value(instruction->dest));
+  }
+}
+
+// Removes the instruction, whose dest is replaced by the given value
+static void replace_result(ir_instruction_t* instruction, ir_value_t value)
+{
+  ir_vreg_t dest = instruction->dest;
+  instruction->opcode = IR_REMOVED;
+  instruction->n_arguments = 0;
+  if (dest < compilation->ir.n_variables)
+    define(dest, value);
+  else
+    compilation->ssa.values[dest] = value;
+}
+
+// Returns the expression computed by the instruction, as an entry of the table of values
+static value_entry_t expression_of(ir_instruction_t* instruction)
+{
+  value_entry_t key = {
+      .opcode = instruction->opcode,
+      .operands = {constant_value(0), constant_value(0)},
+      .symbol = NULL,
+      .version = 0};
+  switch (instruction->opcode)
+  {
+  case IR_LOAD_GLOBAL:
+    key.symbol = instruction->symbol;
+    key.version = memory_version(instruction->symbol);
+    break;
+  case IR_LOAD_ELEMENT:
+    key.operands[0] = instruction->operands[0];
+    key.symbol = instruction->symbol;
+    key.version = memory_version(instruction->symbol);
+    break;
+  default:
+    key.operands[0] = instruction->operands[0];
+    if (instruction->opcode != IR_NEGATE && instruction->opcode != IR_NOT)
+      key.operands[1] = instruction->operands[1];
+    if (is_commutative(instruction->opcode) && value_before(key.operands[1], key.operands[0]))
+    {
+      key.operands[0] = instruction->operands[1];
+      key.operands[1] = instruction->operands[0];
+    }
+    break;
+  }
+  return key;
+}
+
+// Numbers the value of one instruction, whose operands have their current values. Instructions
+// computing a value already known, or an operation on constants, are removed
+static void number_instruction(ir_instruction_t* instruction)
+{
+  ssa_t* ssa = &compilation->ssa;
+  ir_opcode_t opcode = instruction->opcode;
+  ir_value_t* operands = instruction->operands;
+
+  switch (opcode)
+  {
+  case IR_PARAMETER:
+    // Parameters keep the virtual registers they are lowered to, which are their first values
+    define(instruction->dest, vreg_value(instruction->dest));
+    return;
+  case IR_COPY:
+    replace_result(instruction, operands[0]);
+    return;
+  case IR_STORE_GLOBAL:
+  {
+    // The next load takes the value stored
+    value_entry_t key = {
+        .opcode = IR_LOAD_GLOBAL,
+        .operands = {constant_value(0), constant_value(0)},
+        .symbol = instruction->symbol,
+        .version = store_to(instruction->symbol)};
+    add_value(key, operands[0]);
+    return;
+  }
+  case IR_STORE_ELEMENT:
+  {
+    value_entry_t key = {
+        .opcode = IR_LOAD_ELEMENT,
+        .operands = {operands[0], constant_value(0)},
+        .symbol = instruction->symbol,
+        .version = store_to(instruction->symbol)};
+    add_value(key, operands[1]);
+    return;
+  }
+  case IR_CALL:
+    ssa->called_at = ++ssa->clock;
+    keep_result(instruction);
+    return;
+  case IR_LOAD_GLOBAL:
+  case IR_LOAD_ELEMENT:
+    break;
+  default:
+    if (is_pure(opcode))
+      break;
+    return;
+  }
+
+  int64_t folded;
+  bool constant_operands = operands[0].vreg == IR_NO_VREG
+                        && (ir_n_uses(instruction) == 1 || operands[1].vreg == IR_NO_VREG);
+  if (is_pure(opcode) && constant_operands
+      && fold_constants(opcode, operands[0].constant, operands[1].constant, &folded))
+  {
+    compilation->statistics.n_values_reused++;
+    replace_result(instruction, constant_value(folded));
+    return;
+  }
+
+  value_entry_t key = expression_of(instruction);
+  uint32_t found = ssa->slots[find_slot(&key)];
+  if (found != 0)
+  {
+    compilation->statistics.n_values_reused++;
+    replace_result(instruction, ssa->entries[found - 1].value);
+    return;
+  }
+  keep_result(instruction);
+  add_value(key, vreg_value(instruction->dest));
+}
+
+// Renames the values of the block and numbers them, then gives the phis of its successors the
+// values the variables have at its end. Loads are not reused from before a block where paths meet
+static void number_block(uint32_t block)
+{
+  ir_function_t* ir = &compilation->ir;
+  ssa_t* ssa = &compilation->ssa;
+  ir_block_t* b = &ir->blocks[block];
+  if (b->n_predecessors != 1)
+    ssa->entered_at = ++ssa->clock;
+
+  for (size_t i = b->first_instruction; i < b->first_instruction + b->n_instructions; i++)
+  {
+    ir_instruction_t* instruction = &ir->instructions[i];
+    if (instruction->opcode == IR_PHI)
+    {
+      instruction->dest = new_vreg();
+      define(instruction->variable, vreg_value(instruction->dest));
+      continue;
+    }
+    for (size_t j = 0; j < ir_n_uses(instruction); j++)
+    {
+      ir_value_t* use = ir_use(ir, instruction, j);
+      *use = current_value(*use);
+    }
+    number_instruction(instruction);
+  }
+
+  // A block branching to the same successor twice is among its predecessors twice
+  ir_instruction_t* terminator = block_terminator(block);
+  for (size_t i = 0; i < ir_n_successors(terminator); i++)
+  {
+    uint32_t successor = terminator->targets[i];
+    ir_block_t* s = &ir->blocks[successor];
+    for (size_t j = 0; j < s->n_predecessors; j++)
+    {
+      if (ir->predecessors[s->first_predecessor + j] != block)
+        continue;
+      for (size_t k = s->first_instruction; k < s->first_instruction + ssa->n_phis[successor]; k++)
+      {
+        ir_instruction_t* phi = &ir->instructions[k];
+        ir->arguments[phi->first_argument + j] = ssa->definitions[phi->variable];
+      }
+    }
+  }
+}
+
+// Makes room for the walk: the new virtual registers, the table of values and its log, and the
+// times memory was stored to
+static void prepare_walk(void)
+{
+  ir_function_t* ir = &compilation->ir;
+  ssa_t* ssa = &compilation->ssa;
+
+  // Each instruction makes at most one new virtual register, one entry and one definition change.
+  // Leaving SSA form makes at most one for each argument of a phi, and one for each phi
+  reserve_vregs(ir->n_vregs + ir->n_instructions * 2 + ir->n_arguments);
+  for (size_t i = 0; i < ir->n_vregs; i++)
+    ssa->values[i] = vreg_value(i);
+  for (size_t v = 0; v < ir->n_variables; v++)
+    ssa->definitions[v] = constant_value(0);
+
+  // The table is at most half full
+  size_t n_slots = 64;
+  while (n_slots < ir->n_instructions * 2)
+    n_slots *= 2;
+  ssa->slots = grow(ssa->slots, &ssa->slots_capacity, n_slots, sizeof(uint32_t));
+  ssa->n_slots = n_slots;
+  memset(ssa->slots, 0, n_slots * sizeof(uint32_t));
+  ssa->entries =
+      grow(ssa->entries, &ssa->entries_capacity, ir->n_instructions, sizeof(value_entry_t));
+  ssa->definition_log = grow(
+      ssa->definition_log,
+      &ssa->definition_log_capacity,
+      ir->n_instructions,
+      sizeof(definition_change_t));
+  ssa->n_entries = 0;
+  ssa->definition_log_length = 0;
+
+  // The clock keeps running from function to function, so the times of earlier functions are all
+  // before the entry block is entered, and only the room made for new global symbols is cleared
+  size_t n_globals = compilation->global_symbols->n_symbols;
+  size_t n_cleared = ssa->stored_at == NULL ? 0 : ssa->stored_at_capacity;
+  ssa->stored_at = grow(ssa->stored_at, &ssa->stored_at_capacity, n_globals, sizeof(size_t));
+  memset(
+      ssa->stored_at + n_cleared, 0, (ssa->stored_at_capacity - n_cleared) * sizeof(size_t));
+  ssa->called_at = 0;
+  ssa->entered_at = 0;
+}
+
+// Walks the dominator tree from the entry block, numbering the values of each block once the blocks
+// dominating it are numbered. The values found in a block are forgotten when the walk leaves it.
+// The walk also numbers the blocks as they are entered and left, for telling dominance
+static void walk_dominator_tree(void)
+{
+  ssa_t* ssa = &compilation->ssa;
+  prepare_walk();
+
+  uint32_t time = 0;
+  size_t n_work = 0;
+  ssa->work[n_work++] = 0;
+  while (n_work > 0)
+  {
+    uint32_t entry = ssa->work[--n_work];
+    if (entry & LEAVING_BLOCK)
+    {
+      uint32_t block = entry & ~LEAVING_BLOCK;
+      ssa->left[block] = time++;
+      while (ssa->n_entries > ssa->entry_scopes[block])
+        ssa->slots[ssa->entries[--ssa->n_entries].slot] = 0;
+      while (ssa->definition_log_length > ssa->definition_scopes[block])
+      {
+        definition_change_t* change = &ssa->definition_log[--ssa->definition_log_length];
+        ssa->definitions[change->variable] = change->previous;
+      }
+      continue;
+    }
+
+    ssa->entered[entry] = time++;
+    ssa->entry_scopes[entry] = ssa->n_entries;
+    ssa->definition_scopes[entry] = ssa->definition_log_length;
+    number_block(entry);
+    ssa->work[n_work++] = entry | LEAVING_BLOCK;
+    for (uint32_t child = ssa->first_children[entry]; child != IR_NO_BLOCK;
+         child = ssa->next_siblings[child])
+      ssa->work[n_work++] = child;
+  }
+}
+
+// Removes the phis whose arguments are all the same value, or the phi itself, and replaces them by
+// that value. Removing one phi can make others trivial, so this is repeated until none are left
+static void remove_trivial_phis(void)
+{
+  ir_function_t* ir = &compilation->ir;
+  ssa_t* ssa = &compilation->ssa;
+  bool changed = true;
+  while (changed)
+  {
+    changed = false;
+    for (uint32_t block = 0; block < ir->n_blocks; block++)
+    {
+      size_t first = ir->blocks[block].first_instruction;
+      for (size_t i = first; i < first + ssa->n_phis[block]; i++)
+      {
+        ir_instruction_t* phi = &ir->instructions[i];
+        if (phi->opcode != IR_PHI)
+          continue;
+
+        bool has_value = false;
+        bool trivial = true;
+        ir_value_t value = constant_value(0);
+        for (size_t j = 0; j < phi->n_arguments && trivial; j++)
+        {
+          ir_value_t argument = resolve(ir->arguments[phi->first_argument + j]);
+          if (argument.vreg == phi->dest)
+            continue;
+          trivial = !has_value || same_value(argument, value);
+          has_value = true;
+          value = argument;
+        }
+        if (trivial && has_value)
+        {
+          phi->opcode = IR_REMOVED;
+          ssa->values[phi->dest] = value;
+          changed = true;
+        }
+      }
+    }
+  }
+}
+
+// Replaces every value read by what it is replaced by
+static void replace_uses(void)
+{
+  ir_function_t* ir = &compilation->ir;
+  for (size_t i = 0; i < ir->n_instructions; i++)
+  {
+    ir_instruction_t* instruction = &ir->instructions[i];
+    if (instruction->opcode == IR_REMOVED)
+      continue;
+    for (size_t j = 0; j < ir_n_uses(instruction); j++)
+    {
+      ir_value_t* use = ir_use(ir, instruction, j);
+      *use = resolve(*use);
+    }
+  }
+}
+
+// Marks every block with where it starts, so its phis can be found while the blocks are moved
+static void save_block_starts(void)
+{
+  ir_function_t* ir = &compilation->ir;
+  for (size_t i = 0; i < ir->n_blocks; i++)
+    compilation->ssa.marks[i] = ir->blocks[i].first_instruction;
+}
+
+// Copies the constant arguments of phis to new virtual registers at the end of the predecessors
+// they come from, so they can be merged with the phis like any other argument. The copies that
+// are not needed are removed when leaving SSA form
+static void copy_constant_arguments(void)
+{
+  ir_function_t* ir = &compilation->ir;
+  ssa_t* ssa = &compilation->ssa;
+  ssa->spare_instructions = grow(
+      ssa->spare_instructions,
+      &ssa->spare_instructions_capacity,
+      ir->n_instructions + ir->n_arguments,
+      sizeof(ir_instruction_t));
+  ir_instruction_t* moved = ssa->spare_instructions;
+  save_block_starts();
+
+  // Removed instructions are left out, so the phis of each block are counted again
+  size_t n_instructions = 0;
+  for (uint32_t block = 0; block < ir->n_blocks; block++)
+  {
+    ir_block_t* b = &ir->blocks[block];
+    size_t first = n_instructions;
+    size_t end = b->first_instruction + b->n_instructions;
+    for (size_t i = b->first_instruction; i < end - 1; i++)
+      if (ir->instructions[i].opcode != IR_REMOVED)
+        moved[n_instructions++] = ir->instructions[i];
+
+    ir_instruction_t* terminator = &ir->instructions[end - 1];
+    for (size_t i = 0; i < ir_n_successors(terminator); i++)
+    {
+      uint32_t successor = terminator->targets[i];
+      if (i == 1 && successor == terminator->targets[0])
+        break;
+      ir_block_t* s = &ir->blocks[successor];
+      for (size_t j = 0; j < s->n_predecessors; j++)
+      {
+        if (ir->predecessors[s->first_predecessor + j] != block)
+          continue;
+        size_t first_phi = ssa->marks[successor];
+        for (size_t k = first_phi; k < first_phi + ssa->n_phis[successor]; k++)
+        {
+          ir_instruction_t* phi = &ir->instructions[k];
+          ir_value_t* argument = &ir->arguments[phi->first_argument + j];
+          if (phi->opcode != IR_PHI || argument->vreg != IR_NO_VREG)
+            continue;
+          ir_vreg_t copy = new_vreg();
+          moved[n_instructions++] = (ir_instruction_t){
+              .opcode = IR_COPY,
+              .dest = copy,
+              .operands = {*argument, constant_value(0)}};
+          *argument = vreg_value(copy);
+        }
+      }
+    }
+    moved[n_instructions++] = *terminator;
+    b->first_instruction = first;
+    b->n_instructions = n_instructions - first;
+  }
+
+  swap_instructions(n_instructions);
+  count_phis();
+}
+
+// Counts the phis each block starts with again, after instructions are moved
+static void count_phis(void)
+{
+  ir_function_t* ir = &compilation->ir;
+  ssa_t* ssa = &compilation->ssa;
+  for (uint32_t block = 0; block < ir->n_blocks; block++)
+  {
+    ir_block_t* b = &ir->blocks[block];
+    ssa->n_phis[block] = 0;
+    while (ir->instructions[b->first_instruction + ssa->n_phis[block]].opcode == IR_PHI)
+      ssa->n_phis[block]++;
+  }
+}
+
+// Returns the member of the class that represents it, which is its smallest virtual register.
+// The members passed on the way are moved closer to it
+static ir_vreg_t find_class(ir_vreg_t vreg)
+{
+  uint32_t* classes = compilation->ssa.classes;
+  while (classes[vreg] != vreg)
+  {
+    classes[vreg] = classes[classes[vreg]];
+    vreg = classes[vreg];
+  }
+  return vreg;
+}
+
+// Merges the classes represented by a and b
+static void merge_classes(ir_vreg_t a, ir_vreg_t b)
+{
+  ssa_t* ssa = &compilation->ssa;
+  if (a > b)
+  {
+    ir_vreg_t swap = a;
+    a = b;
+    b = swap;
+  }
+  ssa->classes[b] = a;
+  // Swapping the next members of two cycles joins them into one
+  uint32_t next = ssa->class_members[a];
+  ssa->class_members[a] = ssa->class_members[b];
+  ssa->class_members[b] = next;
+}
+
+// Returns true if block a dominates block b
+static bool dominates(uint32_t a, uint32_t b)
+{
+  ssa_t* ssa = &compilation->ssa;
+  return a == b || (ssa->entered[a] < ssa->entered[b] && ssa->left[b] < ssa->left[a]);
+}
+
+// Returns true if the two virtual registers can not be kept in the same place, since one is live
+// where the other is written. In SSA form, that is only possible if the write of one dominates the
+// write of the other
+static bool interfere(ir_vreg_t a, ir_vreg_t b)
+{
+  ir_function_t* ir = &compilation->ir;
+  ssa_t* ssa = &compilation->ssa;
+  // The parameters are read at once, each into the virtual register with its number
+  size_t n_parameters = FUNC_PARAM_COUNT(ir->symbol);
+  if (a < n_parameters && b < n_parameters)
+    return true;
+
+  uint32_t block_a = ssa->writing_blocks[a];
+  uint32_t block_b = ssa->writing_blocks[b];
+  bool a_first = block_a == block_b
+                   ? ssa->writing_instructions[a] < ssa->writing_instructions[b]
+                   : dominates(block_a, block_b);
+  if (!a_first)
+  {
+    if (block_a != block_b && !dominates(block_b, block_a))
+      return false;
+    ir_vreg_t swap = a;
+    a = b;
+    b = swap;
+    block_b = block_a;
+  }
+
+  // Whether a is live after b is written
+  uint32_t number = ir->global_numbers[a];
+  if (number != IR_NO_VREG && ir_set_contains(&ir->live_out[block_b * ir->words_per_set], number))
+    return true;
+  ir_block_t* block = &ir->blocks[block_b];
+  for (size_t i = ssa->writing_instructions[b] + 1;
+       i < block->first_instruction + block->n_instructions;
+       i++)
+  {
+    ir_instruction_t* instruction = &ir->instructions[i];
+    if (instruction->opcode == IR_PHI)
+      continue;
+    for (size_t j = 0; j < ir_n_uses(instruction); j++)
+      if (ir_use(ir, instruction, j)->vreg == a)
+        return true;
+  }
+  return false;
+}
+
+// Returns true if no member of one of the classes interferes with a member of another, within the
+// limit of checks
+static bool classes_can_merge(const ir_vreg_t* classes, size_t n_classes)
+{
+  uint32_t* members = compilation->ssa.class_members;
+  size_t n_checks = 0;
+  for (size_t i = 0; i < n_classes; i++)
+    for (size_t j = i + 1; j < n_classes; j++)
+    {
+      ir_vreg_t a = classes[i];
+      do
+      {
+        ir_vreg_t b = classes[j];
+        do
+        {
+          if (++n_checks > MAX_INTERFERENCE_CHECKS || interfere(a, b))
+            return false;
+          b = members[b];
+        } while (b != classes[j]);
+        a = members[a];
+      } while (a != classes[i]);
+    }
+  return true;
+}
+
+// Merges the dest and arguments of the phi into one class, if none of them interfere, so they
+// can all be kept in the same place, and returns true. Otherwise, the arguments that do not
+// interfere with the dest are merged with it one by one, and false is returned
+static bool merge_phi(ir_instruction_t* phi)
+{
+  ir_function_t* ir = &compilation->ir;
+  ir_vreg_t classes[MAX_PHI_CLASSES];
+  size_t n_classes = 0;
+  bool too_many = false;
+  for (size_t i = 0; i <= phi->n_arguments && !too_many; i++)
+  {
+    ir_vreg_t vreg = i == 0 ? phi->dest : ir->arguments[phi->first_argument + i - 1].vreg;
+    ir_vreg_t class = find_class(vreg);
+    size_t j = 0;
+    while (j < n_classes && classes[j] != class)
+      j++;
+    if (j < n_classes)
+      continue;
+    too_many = n_classes == MAX_PHI_CLASSES;
+    if (!too_many)
+      classes[n_classes++] = class;
+  }
+
+  if (!too_many && classes_can_merge(classes, n_classes))
+  {
+    for (size_t i = 1; i < n_classes; i++)
+      merge_classes(find_class(classes[0]), find_class(classes[i]));
+    return true;
+  }
+
+  for (size_t i = 0; i < phi->n_arguments; i++)
+  {
+    ir_vreg_t pair[] = {
+        find_class(phi->dest), find_class(ir->arguments[phi->first_argument + i].vreg)};
+    if (pair[0] != pair[1] && classes_can_merge(pair, 2))
+      merge_classes(pair[0], pair[1]);
+  }
+  return false;
+}
+
+// Returns true if the arguments of the isolated phi can be copied straight to the class of its
+// dest, which holds them until the phi. That is, if no member of the class is live at the end of a
+// predecessor whose argument is not in the class already. Each class can only be copied to for one
+// phi, so the copies of two phis at the end of a predecessor never write the same place
+static bool can_copy_to_class(uint32_t block, ir_instruction_t* phi, ir_vreg_t first_copy)
+{
+  ir_function_t* ir = &compilation->ir;
+  ssa_t* ssa = &compilation->ssa;
+  ir_vreg_t class = find_class(phi->dest);
+  ir_block_t* b = &ir->blocks[block];
+  size_t n_checks = 0;
+  for (size_t i = 0; i < phi->n_arguments; i++)
+  {
+    if (find_class(ir->arguments[phi->first_argument + i].vreg) == class)
+      continue;
+    uint32_t predecessor = ir->predecessors[b->first_predecessor + i];
+    const uint64_t* live_out = &ir->live_out[predecessor * ir->words_per_set];
+    ir_instruction_t* terminator = block_terminator(predecessor);
+    for (size_t j = 0; j < ir_n_uses(terminator); j++)
+    {
+      ir_vreg_t vreg = terminator->operands[j].vreg;
+      if (vreg != IR_NO_VREG && find_class(vreg) == class)
+        return false;
+    }
+
+    ir_vreg_t member = class;
+    do
+    {
+      uint32_t number = ir->global_numbers[member];
+      if (++n_checks > MAX_INTERFERENCE_CHECKS || member >= first_copy
+          || (number != IR_NO_VREG && ir_set_contains(live_out, number)))
+        return false;
+      member = ssa->class_members[member];
+    } while (member != class);
+  }
+  return true;
+}
+
+// Returns the virtual register the class of the given one is kept in out of SSA form. The classes
+// are numbered in the order they are met, after the parameters, which keep their numbers
+static ir_vreg_t class_vreg(ir_vreg_t vreg)
+{
+  ssa_t* ssa = &compilation->ssa;
+  ir_vreg_t class = find_class(vreg);
+  if (ssa->class_vregs[class] == IR_NO_VREG)
+    ssa->class_vregs[class] = ssa->n_class_vregs++;
+  return ssa->class_vregs[class];
+}
+
+// Adds the instruction to the spare instructions, with every virtual register replaced by the one
+// its class is kept in. Copies to the same place are left out
+static void move_renamed(ir_instruction_t instruction, size_t* n_instructions)
+{
+  ir_function_t* ir = &compilation->ir;
+  ssa_t* ssa = &compilation->ssa;
+  if (instruction.dest != IR_NO_VREG)
+    instruction.dest = class_vreg(instruction.dest);
+  for (size_t i = 0; i < ir_n_uses(&instruction); i++)
+  {
+    ir_value_t* use = ir_use(ir, &instruction, i);
+    if (use->vreg != IR_NO_VREG)
+      use->vreg = class_vreg(use->vreg);
+  }
+  if (instruction.opcode == IR_COPY && instruction.operands[0].vreg == instruction.dest)
+    return;
+  ssa->spare_instructions[(*n_instructions)++] = instruction;
+}
+
+// Takes the IR out of SSA form. Every phi whose dest and arguments do not interfere is merged
+// into one class, which is kept in one virtual register. The other phis are isolated: their
+// arguments are copied to a new virtual register at the end of each predecessor, which is copied
+// to the dest of the phi at the start of its block. Copies of constant arguments are not needed
+// then, and the constants are copied instead. The classes are numbered again, from the parameters
+static void leave_ssa(void)
+{
+  ir_function_t* ir = &compilation->ir;
+  ssa_t* ssa = &compilation->ssa;
+  for (uint32_t block = 0; block < ir->n_blocks; block++)
+  {
+    ir_block_t* b = &ir->blocks[block];
+    for (size_t i = b->first_instruction; i < b->first_instruction + b->n_instructions; i++)
+    {
+      ir_vreg_t dest = ir->instructions[i].dest;
+      if (dest == IR_NO_VREG)
+        continue;
+      ssa->writing_blocks[dest] = block;
+      ssa->writing_instructions[dest] = i;
+    }
+  }
+  ir_find_liveness();
+
+  for (ir_vreg_t v = 0; v < ir->n_vregs; v++)
+    ssa->classes[v] = ssa->class_members[v] = v;
+  ssa->phi_copies =
+      grow(ssa->phi_copies, &ssa->phi_copies_capacity, ir->n_instructions, sizeof(uint32_t));
+  ir_vreg_t first_copy = ir->n_vregs;
+  size_t n_copies = 0;
+  for (uint32_t block = 0; block < ir->n_blocks; block++)
+  {
+    ir_block_t* b = &ir->blocks[block];
+    for (size_t i = b->first_instruction; i < b->first_instruction + ssa->n_phis[block]; i++)
+    {
+      ir_instruction_t* phi = &ir->instructions[i];
+      ssa->phi_copies[i] = IR_NO_VREG;
+      if (merge_phi(phi))
+        continue;
+      ir_vreg_t copy = ssa->phi_copies[i] = new_vreg();
+      ssa->classes[copy] = ssa->class_members[copy] = copy;
+      n_copies += phi->n_arguments + 1;
+    }
+  }
+
+  // Once every phi is merged or isolated, since the copies are not part of the liveness
+  for (uint32_t block = 0; block < ir->n_blocks; block++)
+  {
+    ir_block_t* b = &ir->blocks[block];
+    for (size_t i = b->first_instruction; i < b->first_instruction + ssa->n_phis[block]; i++)
+    {
+      ir_instruction_t* phi = &ir->instructions[i];
+      if (ssa->phi_copies[i] != IR_NO_VREG && can_copy_to_class(block, phi, first_copy))
+        merge_classes(find_class(phi->dest), ssa->phi_copies[i]);
+    }
+  }
+
+  // The only copies left in SSA form are those of constant arguments. Isolated phis copy the
+  // constants themselves, so the copies of their arguments are not needed
+  for (uint32_t block = 0; block < ir->n_blocks; block++)
+  {
+    ir_block_t* b = &ir->blocks[block];
+    for (size_t i = b->first_instruction; i < b->first_instruction + ssa->n_phis[block]; i++)
+    {
+      ir_instruction_t* phi = &ir->instructions[i];
+      if (ssa->phi_copies[i] == IR_NO_VREG)
+        continue;
+      for (size_t j = 0; j < phi->n_arguments; j++)
+      {
+        ir_value_t* argument = &ir->arguments[phi->first_argument + j];
+        ir_instruction_t* writer = &ir->instructions[ssa->writing_instructions[argument->vreg]];
+        if (writer->opcode != IR_COPY)
+          continue;
+        *argument = writer->operands[0];
+        writer->opcode = IR_REMOVED;
+      }
+    }
+  }
+
+  ssa->spare_instructions = grow(
+      ssa->spare_instructions,
+      &ssa->spare_instructions_capacity,
+      ir->n_instructions + n_copies,
+      sizeof(ir_instruction_t));
+  save_block_starts();
+  size_t n_parameters = FUNC_PARAM_COUNT(ir->symbol);
+  for (ir_vreg_t v = 0; v < ir->n_vregs; v++)
+    ssa->class_vregs[v] = v < n_parameters ? v : IR_NO_VREG;
+  ssa->n_class_vregs = n_parameters;
+  size_t n_instructions = 0;
+  for (uint32_t block = 0; block < ir->n_blocks; block++)
+  {
+    ir_block_t* b = &ir->blocks[block];
+    size_t first = n_instructions;
+    size_t end = b->first_instruction + b->n_instructions;
+    for (size_t i = b->first_instruction; i < end - 1; i++)
+    {
+      ir_instruction_t* instruction = &ir->instructions[i];
+      if (instruction->opcode == IR_REMOVED)
+        continue;
+      if (instruction->opcode != IR_PHI)
+        move_renamed(*instruction, &n_instructions);
+      else if (ssa->phi_copies[i] != IR_NO_VREG)
+        move_renamed(
+            (ir_instruction_t){
+                .opcode = IR_COPY,
+                .dest = instruction->dest,
+                .operands = {vreg_value(ssa->phi_copies[i]), constant_value(0)}},
+            &n_instructions);
+    }
+
+    ir_instruction_t* terminator = &ir->instructions[end - 1];
+    for (size_t i = 0; i < ir_n_successors(terminator); i++)
+    {
+      uint32_t successor = terminator->targets[i];
+      if (i == 1 && successor == terminator->targets[0])
+        break;
+      size_t index = ir_predecessor_index(successor, block);
+      size_t first_phi = ssa->marks[successor];
+      for (size_t k = first_phi; k < first_phi + ssa->n_phis[successor]; k++)
+      {
+        if (ssa->phi_copies[k] == IR_NO_VREG)
+          continue;
+        ir_value_t argument = ir->arguments[ir->instructions[k].first_argument + index];
+        move_renamed(
+            (ir_instruction_t){
+                .opcode = IR_COPY,
+                .dest = ssa->phi_copies[k],
+                .operands = {argument, constant_value(0)}},
+            &n_instructions);
+      }
+    }
+    move_renamed(*terminator, &n_instructions);
+    b->first_instruction = first;
+    b->n_instructions = n_instructions - first;
+  }
+  swap_instructions(n_instructions);
+  ir->n_vregs = ssa->n_class_vregs;
+  ir->n_variables = n_parameters;
+}
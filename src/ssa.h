@@ -0,0 +1,119 @@
+#ifndef SSA_H
+#define SSA_H
+
+#include "ir.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Values computed more than once in a function are found by global value numbering, with the IR
+// of the function in SSA form. There, every virtual register is written by one instruction, and
+// the values of a variable that reach a block along different edges are merged by a phi at the
+// start of the block. Phis are placed at the dominance frontiers of the blocks assigning a
+// variable, if the variable is read in some block before it is assigned there.
+//
+// The blocks are then visited in a walk of the dominator tree, and every instruction computing the
+// same value as an instruction dominating it is removed, with its value taken from the first one.
+// That covers arithmetic, comparisons, copies, and the indices of array elements. Operations on
+// constants are folded, as long as they can not stop the program.
+// Loads are reused until a store or call may change what they read. A store to a global variable
+// or an element is remembered as the value of the next load from it. Stores to an array change
+// every element as far as loads are concerned, and calls change every global variable and array.
+// Loads are not reused past blocks with more than one predecessor, where other paths meet.
+//
+// Last, the function is taken out of SSA form. The arguments of each phi are given the virtual
+// register of the phi, when none of them are live at the same time, so the phi costs nothing.
+// Otherwise, each argument is copied into a virtual register of its own at the end of the
+// predecessor it comes from, which is copied to the phi at the start of its block.
+
+// Scratch space for numbering values, reused for every function. Each thread generating functions
+// has its own
+typedef struct ssa
+{
+  // For every block: its position in reverse postorder, its immediate dominator, its children in
+  // the dominator tree, the times it is entered and left in the walk of the dominator tree, where
+  // its dominance frontier is kept in frontiers, and the number of phis it starts with
+  uint32_t* reverse_postorder;
+  uint32_t* dominators;
+  uint32_t* first_children;
+  uint32_t* next_siblings;
+  uint32_t* entered;
+  uint32_t* left;
+  uint32_t* first_frontiers;
+  uint32_t* n_frontiers;
+  uint32_t* n_phis;
+  uint32_t* order;  // The blocks in reverse postorder
+  uint32_t* marks;  // Marks blocks while they are ordered, their frontiers found, and phis placed,
+                    // and holds where they started while they are moved
+  uint32_t* queued; // Marks blocks added to the work list while phis are placed
+  uint32_t* work;   // Blocks waiting to be visited, with room for each of them twice
+  // The numbers of entries and definition changes when the walk entered the block
+  size_t* entry_scopes;
+  size_t* definition_scopes;
+  size_t blocks_capacity;
+  uint32_t* frontiers;
+  size_t frontiers_capacity;
+
+  // The blocks assigning every variable live across blocks: assignments[first_assignments[v] ...]
+  uint32_t* first_assignments;
+  uint32_t* assignments;
+  size_t assignments_capacity;
+  // The value each variable has at the point of the walk
+  ir_value_t* definitions;
+  size_t variables_capacity; // Of first_assignments and definitions
+  // The phis placed, as the block in the high 32 bits and the variable in the low 32 bits
+  uint64_t* placed_phis;
+  size_t n_placed_phis;
+  size_t placed_phis_capacity;
+
+  // For every virtual register: the value it is replaced by, which is itself if it is not, the
+  // block and instruction writing it, and the congruence class it is merged into when leaving SSA
+  ir_value_t* values;
+  uint32_t* writing_blocks;
+  uint32_t* writing_instructions;
+  uint32_t* classes;       // A member closer to the smallest member of the class, or itself
+  uint32_t* class_members; // The next member of the class, in a cycle
+  ir_vreg_t* class_vregs;  // For a class, the virtual register it is kept in, or IR_NO_VREG
+  ir_vreg_t n_class_vregs;
+  size_t vregs_capacity;
+
+  // Values computed, found by the expression computing them in a table with open addressing. Each
+  // slot holds 1 plus the position of an entry, or 0. The entries are kept in the order they were
+  // found, and removed from the end when the walk leaves the block that found them
+  uint32_t* slots;
+  size_t n_slots; // A power of two
+  size_t slots_capacity;
+  struct value_entry* entries;
+  size_t n_entries;
+  size_t entries_capacity;
+  // The changes made to the definitions of variables in the blocks of the walk, which are undone
+  // when the walk leaves the blocks
+  struct definition_change* definition_log;
+  size_t definition_log_length;
+  size_t definition_log_capacity;
+
+  // The times each global variable and array was last stored to, a function was last called, and
+  // the walk last entered a block where paths meet. Loads are only reused at the time they were
+  // made, which is the last of these
+  size_t* stored_at;
+  size_t stored_at_capacity;
+  size_t called_at;
+  size_t entered_at;
+  size_t clock;
+
+  // The virtual register the arguments of each isolated phi are copied to, by instruction
+  uint32_t* phi_copies;
+  size_t phi_copies_capacity;
+  // Instructions are moved here when phis or copies are added, and swapped with those of the IR
+  ir_instruction_t* spare_instructions;
+  size_t spare_instructions_capacity;
+} ssa_t;
+
+// Reuses the values computed more than once in compilation->ir, which has just been lowered, and
+// leaves it out of SSA form again. The instructions no longer needed are left to be removed as
+// dead code
+void number_values(void);
+
+// Frees the scratch space of the active compilation
+void destroy_ssa(void);
+
+#endif // SSA_H
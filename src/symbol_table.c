@@ -1,4 +1,6 @@
 #include "assert.h"
+#include "compilation.h"
+#include "intern.h"
 #include "symbol_table.h"
 #include "symbols.h"
 #include <stdlib.h>
@@ -25,6 +27,13 @@ insert_result_t symbol_table_insert(symbol_table_t* table, struct symbol* symbol
   if (symbol_hashmap_insert(table->hashmap, symbol) == INSERT_COLLISION)
     return INSERT_COLLISION;
 
+  symbol_table_append(table, symbol);
+  return INSERT_OK;
+}
+
+// Adds a symbol to the list of symbols in the table, but not to its hashmap
+void symbol_table_append(symbol_table_t* table, struct symbol* symbol)
+{
   // If the table is full, resize the list
   if (table->n_symbols + 1 >= table->capacity)
   {
@@ -35,8 +44,7 @@ insert_result_t symbol_table_insert(symbol_table_t* table, struct symbol* symbol
   table->symbols[table->n_symbols] = symbol;
   symbol->sequence_number = table->n_symbols;
   table->n_symbols++;
-
-  return INSERT_OK;
+  compilation->statistics.n_symbols++;
 }
 
 // Destroys the given symbol table, its hashmap, and all the symbols it owns
@@ -51,6 +59,15 @@ void symbol_table_destroy(symbol_table_t* table)
 
 // ==================== Hashmap code ====================
 
+// Adds one insert or lookup that looked at probe_length buckets to the statistics
+static void record_probe_length(size_t probe_length)
+{
+  symbol_hashmap_statistics_t* statistics = &compilation->hashmap_statistics;
+  statistics->n_probes += probe_length;
+  if (probe_length > statistics->max_probe_length)
+    statistics->max_probe_length = probe_length;
+}
+
 // Initializes a hashmap with 0 buckets. Will be resized upon first insertion
 symbol_hashmap_t* symbol_hashmap_init()
 {
@@ -59,77 +76,98 @@ symbol_hashmap_t* symbol_hashmap_init()
   return result;
 }
 
-// Calculates a naive 64-bit hash of the given string
-static uint64_t hash_string(const char* string)
-{
-  assert(string != NULL);
-  uint64_t hash = 31;
-  for (const char* c = string; *c != '\0'; c++)
-    hash = hash * 257 + *c;
-  return hash;
-}
-
-// Allocates a larger list of buckets, and inserts all hashmap entries again
+// Allocates a larger list of buckets, and moves all hashmap entries over.
+// Entries are placed using the hashes stored in the old buckets.
 static void symbol_hashmap_resize(symbol_hashmap_t* hashmap, size_t new_capacity)
 {
-  symbol_t** old_buckets = hashmap->buckets;
+  symbol_bucket_t* old_buckets = hashmap->buckets;
   size_t old_capacity = hashmap->n_buckets;
 
   // Use calloc, since it initalizes the memory to 0, aka NULL entries
-  hashmap->buckets = calloc(new_capacity, sizeof(symbol_t*));
+  hashmap->buckets = calloc(new_capacity, sizeof(symbol_bucket_t));
   hashmap->n_buckets = new_capacity;
-  hashmap->n_entries = 0;
 
-  // Now re-insert all entries from the old buckets
-  for (int i = 0; i < old_capacity; i++)
+  size_t mask = new_capacity - 1;
+  for (size_t i = 0; i < old_capacity; i++)
   {
-    if (old_buckets[i] != NULL)
-      symbol_hashmap_insert(hashmap, old_buckets[i]);
+    if (old_buckets[i].name == NULL)
+      continue;
+
+    // All names are already unique, so we only need to find an empty bucket
+    size_t bucket = old_buckets[i].hash & mask;
+    while (hashmap->buckets[bucket].name != NULL)
+      bucket = (bucket + 1) & mask;
+    hashmap->buckets[bucket] = old_buckets[i];
   }
 
   free(old_buckets);
 }
 
-// Performs insertion into the hashmap.
+// Finds the bucket holding the given name, or the empty bucket where it belongs.
 // The hashmap uses open addressing, with up to one entry per bucket.
-// If our first choice of bucket is full, we look at the next bucket, until we find room.
-static insert_result_t symbol_hashmap_insert(symbol_hashmap_t* hashmap, symbol_t* symbol)
+// If our first choice of bucket is taken by another name, we look at the next bucket.
+// Since names are interned, their hashes are already known, and equal names are equal pointers.
+static symbol_bucket_t* symbol_hashmap_find_bucket(symbol_hashmap_t* hashmap, const char* name)
 {
-  // Make sure that the fill ratio of the hashmap never exeeds 1/2
-  int new_size = hashmap->n_entries + 1;
-  if (new_size * 2 > hashmap->n_buckets)
-    symbol_hashmap_resize(hashmap, hashmap->n_buckets * 2 + 8);
+  // Make sure that the fill ratio of the hashmap never exeeds 1/2, even after adding the name
+  if ((hashmap->n_entries + 1) * 2 > hashmap->n_buckets)
+    symbol_hashmap_resize(hashmap, hashmap->n_buckets == 0 ? 8 : hashmap->n_buckets * 2);
 
-  // Now calculate the position of the new entry
-  uint64_t hash = hash_string(symbol->name);
-  size_t bucket = hash % hashmap->n_buckets;
+  uint64_t hash = interned_hash(name);
+  size_t mask = hashmap->n_buckets - 1;
+  size_t bucket = hash & mask;
+  size_t probe_length = 1;
 
-  // Iterate until we find an empty bucket
-  while (hashmap->buckets[bucket] != NULL)
+  // Iterate until we find the name, or an empty bucket
+  while (hashmap->buckets[bucket].name != NULL && hashmap->buckets[bucket].name != name)
   {
-    // Check if the existing entry is a name collision
-    if (strcmp(hashmap->buckets[bucket]->name, symbol->name) == 0)
-      return INSERT_COLLISION; // An entry with the same name already exists
-    // Go to the next bucket
-    bucket = (bucket + 1) % hashmap->n_buckets;
+    bucket = (bucket + 1) & mask;
+    probe_length++;
   }
 
-  // We found an emoty bucket, insert the symbol here
-  hashmap->buckets[bucket] = symbol;
-  hashmap->n_entries++;
+  // If the bucket is empty, claim it for the name. Only new entries count as inserts, so
+  // rebinding a name already in the hashmap is not counted
+  if (hashmap->buckets[bucket].name == NULL)
+  {
+    hashmap->buckets[bucket] = (symbol_bucket_t){.hash = hash, .name = name, .symbol = NULL};
+    hashmap->n_entries++;
+    compilation->hashmap_statistics.n_inserts++;
+    record_probe_length(probe_length);
+  }
+  return &hashmap->buckets[bucket];
+}
+
+// Performs insertion into the hashmap.
+// Fails if the name is already bound to a symbol in this hashmap
+static insert_result_t symbol_hashmap_insert(symbol_hashmap_t* hashmap, symbol_t* symbol)
+{
+  symbol_bucket_t* bucket = symbol_hashmap_find_bucket(hashmap, symbol->name);
+  if (bucket->symbol != NULL)
+    return INSERT_COLLISION; // An entry with the same name already exists
+
+  bucket->symbol = symbol;
   return INSERT_OK; // We successfully inserted a new symbol
 }
 
+// Binds the name to the given symbol, and returns the symbol it was bound to before
+symbol_t* symbol_hashmap_rebind(symbol_hashmap_t* hashmap, const char* name, symbol_t* symbol)
+{
+  symbol_bucket_t* bucket = symbol_hashmap_find_bucket(hashmap, name);
+  symbol_t* previous = bucket->symbol;
+  bucket->symbol = symbol;
+  return previous;
+}
+
 // Performs lookup in the hashmap.
-// Hashes the given string, and checks if the resulting bucket contains the item.
+// Takes the precomputed hash of the interned name, and checks if the resulting bucket contains it.
 // Since the hashmap uses open addressing, the entry can also be in the next bucket,
 // so we iterate until we either find the item, or find an empty bucket.
 //
-// If the key isn't found in this hashmap, but we have a backup, lookup continues there.
+// If the key isn't bound to a symbol in this hashmap, but we have a backup, lookup continues there.
 // Otherwise, NULL is returned.
 symbol_t* symbol_hashmap_lookup(symbol_hashmap_t* hashmap, const char* name)
 {
-  uint64_t hash = hash_string(name);
+  uint64_t hash = interned_hash(name);
 
   // Loop through the linked list of hashmaps and backup hashmaps
   while (hashmap != NULL)
@@ -141,16 +179,29 @@ symbol_t* symbol_hashmap_lookup(symbol_hashmap_t* hashmap, const char* name)
       continue;
     }
 
-    size_t bucket = hash % hashmap->n_buckets;
-    while (hashmap->buckets[bucket] != NULL)
+    compilation->hashmap_statistics.n_lookups++;
+
+    size_t mask = hashmap->n_buckets - 1;
+    size_t bucket = hash & mask;
+    size_t probe_length = 1;
+    while (hashmap->buckets[bucket].name != NULL)
     {
-      // Check if the entry in the bucket has a matching name
-      if (strcmp(hashmap->buckets[bucket]->name, name) == 0)
-        return hashmap->buckets[bucket];
+      // Check if the entry in the bucket has a matching name.
+      // A name that is bound to no symbol is treated as missing from this hashmap
+      symbol_bucket_t* entry = &hashmap->buckets[bucket];
+      if (entry->name == name)
+      {
+        if (entry->symbol == NULL)
+          break;
+        record_probe_length(probe_length);
+        return entry->symbol;
+      }
 
       // Otherwise keep iterating until we find a hit, or an empty bucket
-      bucket = (bucket + 1) % hashmap->n_buckets;
+      bucket = (bucket + 1) & mask;
+      probe_length++;
     }
+    record_probe_length(probe_length);
 
     // No entry with the required name existed in the hashmap, so go to the backup
     hashmap = hashmap->backup;
@@ -165,3 +216,18 @@ void symbol_hashmap_destroy(symbol_hashmap_t* hashmap)
   free(hashmap->buckets);
   free(hashmap);
 }
+
+// Outputs the hashmap statistics, including the average probe length
+void print_symbol_hashmap_statistics(FILE* output)
+{
+  symbol_hashmap_statistics_t* statistics = &compilation->hashmap_statistics;
+  size_t n_operations = statistics->n_inserts + statistics->n_lookups;
+  double average = n_operations ? (double)statistics->n_probes / n_operations : 0;
+
+  fprintf(output, " == SYMBOL HASHMAP STATISTICS == \n");
+  fprintf(output, "inserts: %zu\n", statistics->n_inserts);
+  fprintf(output, "lookups: %zu\n", statistics->n_lookups);
+  fprintf(output, "probes: %zu\n", statistics->n_probes);
+  fprintf(output, "average probe length: %.3f\n", average);
+  fprintf(output, "max probe length: %zu\n", statistics->max_probe_length);
+}
@@ -5,15 +5,29 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
 
 // We use hashmaps to make lookups quick.
 // The entries are symbols, using the name of the symbol as the key.
+// All names must be interned, see intern.h, so keys can be compared as pointers.
 // The hashmap logic is already implemented in symbol_table.c
-// NOTE that this hashmap does not support removing entries.
+// NOTE that this hashmap does not support removing entries,
+// but a name can be rebound to a different symbol, or to no symbol at all.
+
+// A bucket may contain 0 or 1 entries. An empty bucket has name = NULL.
+// The name and its hash are kept in the bucket, so probing past other entries,
+// and moving entries when resizing, never has to look at the symbols themselves.
+typedef struct symbol_bucket
+{
+  uint64_t hash;
+  const char* name;      // The interned key
+  struct symbol* symbol; // NULL if the name is currently not bound to any symbol
+} symbol_bucket_t;
+
 typedef struct symbol_hashmap
 {
-  struct symbol** buckets; // A bucket may contain 0 or 1 entries
-  size_t n_buckets;
+  symbol_bucket_t* buckets;
+  size_t n_buckets; // Always 0 or a power of two, so buckets can be picked with a bitmask
   size_t n_entries;
 
   // If a key is not found, the lookup function will consult this as a backup
@@ -47,18 +61,43 @@ symbol_table_t* symbol_table_init(void);
 // DO NOT change the symbol's name after insertion.
 insert_result_t symbol_table_insert(symbol_table_t* table, struct symbol* symbol);
 
+// Adds the given symbol to the symbol table, without touching the table's hashmap.
+// The symbol table takes ownership of the symbol, and assigns it a sequence number.
+void symbol_table_append(symbol_table_t* table, struct symbol* symbol);
+
 // Destroys the given symbol table, its hashmap, and all the symbols it owns
 void symbol_table_destroy(symbol_table_t* table);
 
 // Initalizes a new, empty hashmap
 symbol_hashmap_t* symbol_hashmap_init(void);
 
-// Looks for a symbol in the symbol hashmap, matching the given name.
+// Looks for a symbol in the symbol hashmap, matching the given interned name.
 // If no symbol is found, the hashmap's backup hashmap is checked.
 // If the name can't be found in the backup chain either, NULL is returned.
 struct symbol* symbol_hashmap_lookup(symbol_hashmap_t* hashmap, const char* name);
 
+// Binds the interned name to the given symbol in this hashmap, replacing any earlier binding.
+// The symbol may be NULL, in which case lookups of the name go straight to the backup hashmap.
+// Returns the symbol the name was bound to in this hashmap before the call, or NULL.
+struct symbol* symbol_hashmap_rebind(
+    symbol_hashmap_t* hashmap, const char* name, struct symbol* symbol);
+
 // Frees the memory used by the hashmap
 void symbol_hashmap_destroy(symbol_hashmap_t* hashmap);
 
+// Counters for how much work the hashmaps are doing, added up across all hashmaps
+// of the active compilation.
+// A probe is one bucket being looked at. A lookup that walks the backup chain is
+// counted as one lookup in every hashmap it visits.
+typedef struct symbol_hashmap_statistics
+{
+  size_t n_inserts;
+  size_t n_lookups;
+  size_t n_probes;
+  size_t max_probe_length; // The most buckets looked at by a single insert or lookup
+} symbol_hashmap_statistics_t;
+
+// Outputs the hashmap statistics, including the average probe length
+void print_symbol_hashmap_statistics(FILE* output);
+
 #endif // SYMBOL_TABLE_H
@@ -1,13 +1,13 @@
 #include <vslc.h>
 
-// Declaration of global symbol table
-symbol_table_t* global_symbols;
+// The global symbol table, string list and scope log all belong to the active compilation
 
 // Declarations of helper functions defined further down in this file
 static void find_globals(void);
 static void bind_names(symbol_table_t* local_symbols, node_t* root);
 static void print_symbol_table(symbol_table_t* table, int nesting);
 static void destroy_symbol_tables(void);
+static void destroy_scope_log(void);
 
 static size_t add_string(char* string);
 static void print_string_list(void);
@@ -17,7 +17,7 @@ static void destroy_string_list(void);
 
 // Creates a global symbol table, and local symbol tables for each function.
 // All usages of symbols are bound to their symbol table entries.
-// All strings are entered into the string_list
+// All strings are entered into the string list
 void create_tables(void)
 {
   // Create a global symbol table, and make symbols for all globals
@@ -25,11 +25,11 @@ void create_tables(void)
 
   // For all functions, we want to fill their local symbol tables,
   // and bind all names found in the function body
-  for (size_t i = 0; i < global_symbols->n_symbols; i++)
+  for (size_t i = 0; i < compilation->global_symbols->n_symbols; i++)
   {
-    symbol_t* symbol = global_symbols->symbols[i];
+    symbol_t* symbol = compilation->global_symbols->symbols[i];
     if (symbol->type == SYMBOL_FUNCTION)
-      bind_names(symbol->function_symtable, symbol->node->children[2]);
+      bind_names(symbol->function_symtable, node_child(symbol->node, 2));
   }
 }
 
@@ -38,10 +38,10 @@ void create_tables(void)
 // Finally prints out the AST again, with bound symbols.
 void print_tables(void)
 {
-  print_symbol_table(global_symbols, 0);
-  printf("\n == STRING LIST == \n");
+  print_symbol_table(compilation->global_symbols, 0);
+  sink_puts(&compilation->output, "\n == STRING LIST == \n");
   print_string_list();
-  printf("\n == BOUND SYNTAX TREE == \n");
+  sink_puts(&compilation->output, "\n == BOUND SYNTAX TREE == \n");
   print_syntax_tree();
 }
 
@@ -50,44 +50,47 @@ void destroy_tables(void)
 {
   destroy_symbol_tables();
   destroy_string_list();
+  destroy_scope_log();
 }
 
 /* Internal matters */
 
-#define CREATE_AND_INSERT_SYMBOL(table, ...)                                 \
-  do                                                                         \
-  {                                                                          \
-    symbol_t* symbol = malloc(sizeof(symbol_t));                             \
-    *symbol = (symbol_t){__VA_ARGS__};                                       \
-    if (symbol_table_insert((table), symbol) == INSERT_COLLISION)            \
-    {                                                                        \
-      fprintf(stderr, "error: symbol '%s' already defined\n", symbol->name); \
-      exit(EXIT_FAILURE);                                                    \
-    }                                                                        \
+#define CREATE_AND_INSERT_SYMBOL(table, ...)                                        \
+  do                                                                                \
+  {                                                                                 \
+    symbol_t* symbol = malloc(sizeof(symbol_t));                                    \
+    *symbol = (symbol_t){__VA_ARGS__};                                              \
+    if (symbol_table_insert((table), symbol) == INSERT_COLLISION)                   \
+    {                                                                               \
+      const char* name = symbol->name;                                              \
+      free(symbol);                                                                 \
+      compilation_error(VSLC_ERROR_SYMBOL, 0, "symbol '%s' already defined", name); \
+    }                                                                               \
   } while (false)
 
 // Goes through all global declarations, adding them to the global symbol table.
 // When adding functions, a local symbol table with symbols for its parameters are created.
 static void find_globals(void)
 {
-  global_symbols = symbol_table_init();
+  compilation->global_symbols = symbol_table_init();
 
+  node_t* root = node_at(compilation->root);
   for (size_t i = 0; i < root->n_children; i++)
   {
-    node_t* node = root->children[i];
+    node_t* node = node_child(root, i);
     if (node->type == GLOBAL_DECLARATION)
     {
-      node_t* global_variable_list = node->children[0];
+      node_t* global_variable_list = node_child(node, 0);
       for (size_t j = 0; j < global_variable_list->n_children; j++)
       {
-        node_t* var = global_variable_list->children[j];
-        char* name;
+        node_t* var = node_child(global_variable_list, j);
+        const char* name;
         symtype_t symtype;
 
         // The global variable list can both contain arrays and normal variables.
         if (var->type == ARRAY_INDEXING)
         {
-          name = var->children[0]->data.identifier;
+          name = node_child(var, 0)->data.identifier;
           symtype = SYMBOL_GLOBAL_ARRAY;
         }
         else
@@ -98,7 +101,7 @@ static void find_globals(void)
         }
 
         CREATE_AND_INSERT_SYMBOL(
-            global_symbols,
+            compilation->global_symbols,
             .name = name,
             .type = symtype,
             .node = var,
@@ -107,29 +110,34 @@ static void find_globals(void)
     }
     else if (node->type == FUNCTION)
     {
+      CREATE_AND_INSERT_SYMBOL(
+          compilation->global_symbols,
+          .name = node_child(node, 0)->data.identifier,
+          .type = SYMBOL_FUNCTION,
+          .node = node,
+          .function_symtable = NULL);
+
       // Functions have their own local symbol table. We make it now, and add the function
-      // parameters
+      // parameters. The function symbol owns the table from the start,
+      // so it is freed by destroy_tables even if a parameter name is used twice
+      symbol_table_t* global_symbols = compilation->global_symbols;
+      symbol_t* function = global_symbols->symbols[global_symbols->n_symbols - 1];
       symbol_table_t* function_symtable = symbol_table_init();
+      function->function_symtable = function_symtable;
       // We let the global hashmap be the backup of the local scope
-      function_symtable->hashmap->backup = global_symbols->hashmap;
+      function_symtable->hashmap->backup = compilation->global_symbols->hashmap;
 
-      node_t* parameters = node->children[1];
+      node_t* parameters = node_child(node, 1);
       for (int j = 0; j < parameters->n_children; j++)
       {
+        node_t* parameter = node_child(parameters, j);
         CREATE_AND_INSERT_SYMBOL(
             function_symtable,
-            .name = parameters->children[j]->data.identifier,
+            .name = parameter->data.identifier,
             .type = SYMBOL_PARAMETER,
-            .node = parameters->children[j],
+            .node = parameter,
             .function_symtable = NULL);
       }
-
-      CREATE_AND_INSERT_SYMBOL(
-          global_symbols,
-          .name = node->children[0]->data.identifier,
-          .type = SYMBOL_FUNCTION,
-          .node = node,
-          .function_symtable = function_symtable);
     }
     else
     {
@@ -138,97 +146,162 @@ static void find_globals(void)
   }
 }
 
-// Creates a new empty hashmap for the symbol table, using the outer scope's hashmap as backup
-static void push_local_scope(symbol_table_t* table)
+// Name resolution inside a function uses a single hashmap: the function's own symbol table hashmap.
+// It starts out containing the parameters, with the global hashmap as its backup.
+// When a block declares a local variable, the name is rebound to the new symbol,
+// and the symbol it shadowed is pushed to the scope log.
+// When the block ends, the log is unwound, restoring every shadowed binding.
+// This way, lookups cost the same no matter how deeply blocks are nested,
+// and entering or leaving a scope does not allocate anything.
+typedef struct shadowed_binding
+{
+  const char* name;
+  symbol_t* shadowed; // The symbol the name was bound to before the declaration, or NULL
+} shadowed_binding_t;
+
+// Creates a symbol for the local variable declared by the given IDENTIFIER node,
+// and binds its name in the function's hashmap, remembering the binding it shadows.
+// Locals with sequence numbers from scope_first_symbol and up belong to the current scope,
+// and it is an error to declare the same name twice in one scope.
+static void declare_local_variable(
+    symbol_table_t* local_symbols, node_t* declaration, size_t scope_first_symbol)
 {
-  symbol_hashmap_t* hashmap = symbol_hashmap_init();
-  hashmap->backup = table->hashmap;
-  table->hashmap = hashmap;
+  symbol_t* symbol = malloc(sizeof(symbol_t));
+  *symbol = (symbol_t){
+      .name = declaration->data.identifier,
+      .type = SYMBOL_LOCAL_VAR,
+      .node = declaration,
+      .function_symtable = local_symbols};
+  symbol_table_append(local_symbols, symbol);
+
+  symbol_t* shadowed = symbol_hashmap_rebind(local_symbols->hashmap, symbol->name, symbol);
+  if (shadowed != NULL && shadowed->type == SYMBOL_LOCAL_VAR
+      && shadowed->sequence_number >= scope_first_symbol)
+    compilation_error(VSLC_ERROR_SYMBOL, 0, "symbol '%s' already defined", symbol->name);
+
+  compilation_t* c = compilation;
+  if (c->scope_log_length + 1 >= c->scope_log_capacity)
+  {
+    c->scope_log_capacity = c->scope_log_capacity * 2 + 8;
+    c->scope_log = realloc(c->scope_log, c->scope_log_capacity * sizeof(shadowed_binding_t));
+  }
+  c->scope_log[c->scope_log_length++] =
+      (shadowed_binding_t){.name = symbol->name, .shadowed = shadowed};
 }
 
-// Destroys the hashmap, and replaces it with the outer scope's hashmap
-static void pop_local_scope(symbol_table_t* table)
+// Restores all bindings shadowed by declarations made since the scope log had the given length
+static void pop_local_scope(symbol_table_t* local_symbols, size_t scope_log_start)
 {
-  symbol_hashmap_t* hashmap = table->hashmap;
-  table->hashmap = hashmap->backup;
-  symbol_hashmap_destroy(hashmap);
+  while (compilation->scope_log_length > scope_log_start)
+  {
+    shadowed_binding_t* binding = &compilation->scope_log[--compilation->scope_log_length];
+    symbol_hashmap_rebind(local_symbols->hashmap, binding->name, binding->shadowed);
+  }
 }
 
-// A recursive function that traverses the body of a function, and:
+// Frees the scope log, which is reused for every block in every function
+static void destroy_scope_log(void)
+{
+  free(compilation->scope_log);
+  compilation->scope_log = NULL;
+  compilation->scope_log_length = 0;
+  compilation->scope_log_capacity = 0;
+}
+
+// Traverses the body of a function, and:
 //  - Adds variable declarations to the function's local symbol table.
-//  - Pushes and pops local variable scopes when entering and leaving blocks.
+//  - Binds declared names when entering blocks, and restores shadowed names when leaving them.
 //  - Binds all IDENTIFIER nodes that are not declarations, to the symbol it references.
-//  - Moves STRING_LITERAL nodes' data into the global string list,
+//  - Moves STRING_LITERAL nodes' data into the global string list, unless it is already there,
 //    and replaces the node with a STRING_LIST_REFERENCE node.
 //    Overwrites the node's data.string_list_index field with with string list index
-static void bind_names(symbol_table_t* local_symbols, node_t* node)
+// Nodes are visited in the order they appear in the program, using the tree walk stack.
+static void bind_names(symbol_table_t* local_symbols, node_t* root)
 {
-  if (node == NULL)
-    return;
+  tree_walk_stack_t* stack = &compilation->tree_walk;
+  size_t stack_base = stack->length;
 
-  switch (node->type)
+  tree_walk_push(stack, root, 0);
+  while (stack->length > stack_base)
   {
-  // Can either be a variable in an expression, or the name of a function in a function call
-  // Either way, we wish to associate it with its symbol
-  case IDENTIFIER:
-  {
-    symbol_t* symbol = symbol_hashmap_lookup(local_symbols->hashmap, node->data.identifier);
-    if (symbol == NULL)
+    tree_walk_frame_t* frame = tree_walk_top(stack);
+    node_t* node = frame->node;
+    if (node == NULL)
     {
-      fprintf(stderr, "error: unrecognized symbol '%s'\n", (char*)node->data.identifier);
-      exit(EXIT_FAILURE);
+      tree_walk_pop(stack);
+      continue;
     }
-    node->symbol = symbol;
-    break;
-  }
 
-  // Blocks may contain a list of declarations. In such cases, a scope gets pushed, the declarations
-  // get added, and the name binding continues in the body
-  case BLOCK:
-    if (node->n_children == 2)
+    switch (node->type)
+    {
+    // Can either be a variable in an expression, or the name of a function in a function call
+    // Either way, we wish to associate it with its symbol
+    case IDENTIFIER:
     {
-      push_local_scope(local_symbols);
-      // Iterate through all declarations in the delcaration list
-      node_t* decl_list = node->children[0];
-      for (int i = 0; i < decl_list->n_children; i++)
+      tree_walk_pop(stack);
+      symbol_t* symbol = symbol_hashmap_lookup(local_symbols->hashmap, node->data.identifier);
+      if (symbol == NULL)
+        compilation_error(
+            VSLC_ERROR_SYMBOL, 0, "unrecognized symbol '%s'", node->data.identifier);
+      node->symbol = symbol;
+      break;
+    }
+
+    // Blocks may contain a list of declarations. In such cases, a scope gets pushed, the
+    // declarations get added, and the name binding continues in the body.
+    // The block stays on the stack while its body is bound, and its scope is popped at step 1.
+    // The value of the frame is the length of the scope log before the block
+    case BLOCK:
+      if (node->n_children == 2 && frame->step == 0)
       {
-        // Each declaration can have one or more IDENTIFIER nodes
-        node_t* declaration = decl_list->children[i];
-        for (int j = 0; j < declaration->n_children; j++)
+        frame->step = 1;
+        frame->value = compilation->scope_log_length;
+        size_t scope_first_symbol = local_symbols->n_symbols;
+
+        // Iterate through all declarations in the delcaration list
+        node_t* decl_list = node_child(node, 0);
+        for (int i = 0; i < decl_list->n_children; i++)
         {
-          CREATE_AND_INSERT_SYMBOL(
-              local_symbols,
-              .name = declaration->children[j]->data.identifier,
-              .type = SYMBOL_LOCAL_VAR,
-              .node = declaration->children[j],
-              .function_symtable = local_symbols);
+          // Each declaration can have one or more IDENTIFIER nodes
+          node_t* declaration = node_child(decl_list, i);
+          for (int j = 0; j < declaration->n_children; j++)
+            declare_local_variable(local_symbols, node_child(declaration, j), scope_first_symbol);
         }
+        tree_walk_push(stack, node_child(node, 1), 0);
       }
-      bind_names(local_symbols, node->children[1]);
-      pop_local_scope(local_symbols);
-    }
-    else
+      else if (node->n_children == 2)
+      {
+        pop_local_scope(local_symbols, frame->value);
+        tree_walk_pop(stack);
+      }
+      else
+      {
+        // If the block only contains statements, and no declaration list, no need to push a scope
+        tree_walk_pop(stack);
+        tree_walk_push(stack, node_child(node, 0), 0);
+      }
+      break;
+
+    // Strings get inserted into the global string list
+    // The STRING_LITERAL node gets replaced by a STRING_LIST_REFERENCE node
+    case STRING_LITERAL:
     {
-      // If the block only contains statements, and no declaration list, no need to push a scope
-      bind_names(local_symbols, node->children[0]);
+      tree_walk_pop(stack);
+      size_t position = add_string(node->data.string_literal);
+      node->type = STRING_LIST_REFERENCE;
+      node->data.string_list_index = position;
+      break;
     }
-    break;
 
-  // Strings get inserted into the global string list
-  // The STRING_LITERAL node gets replaced by a STRING_LIST_REFERENCE node
-  case STRING_LITERAL:
-  {
-    size_t position = add_string(node->data.string_literal);
-    node->type = STRING_LIST_REFERENCE;
-    node->data.string_list_index = position;
-    break;
-  }
-
-  // For all other nodes, recurse through its children
-  default:
-    for (int i = 0; i < node->n_children; i++)
-      bind_names(local_symbols, node->children[i]);
-    break;
+    // For all other nodes, visit its children.
+    // They are pushed in reverse, so the first child is visited first
+    default:
+      tree_walk_pop(stack);
+      node_id_t* children = node_children(node);
+      for (size_t i = node->n_children; i > 0; i--)
+        tree_walk_push(stack, node_at(children[i - 1]), 0);
+      break;
+    }
   }
 }
 
@@ -240,7 +313,8 @@ static void print_symbol_table(symbol_table_t* table, int nesting)
   {
     symbol_t* symbol = table->symbols[i];
 
-    printf(
+    sink_printf(
+        &compilation->output,
         "%*s%ld: %s(%s)\n",
         nesting * 4,
         "",
@@ -257,45 +331,103 @@ static void print_symbol_table(symbol_table_t* table, int nesting)
 // Frees up the memory used by the global symbol table, all local symbol tables, and their symbols
 static void destroy_symbol_tables(void)
 {
+  // After an error, the tables may never have been made
+  symbol_table_t* global_symbols = compilation->global_symbols;
+  if (global_symbols == NULL)
+    return;
+
   // First destory all local symbol tables, by looking for functions among the globals
   for (int i = 0; i < global_symbols->n_symbols; i++)
   {
-    if (global_symbols->symbols[i]->type == SYMBOL_FUNCTION)
-      symbol_table_destroy(global_symbols->symbols[i]->function_symtable);
+    symbol_t* symbol = global_symbols->symbols[i];
+    if (symbol->type == SYMBOL_FUNCTION && symbol->function_symtable != NULL)
+      symbol_table_destroy(symbol->function_symtable);
   }
   // Then destroy the global symbol table
   symbol_table_destroy(global_symbols);
+  compilation->global_symbols = NULL;
 }
 
-// Declaration of global string list
-char** string_list;
-size_t string_list_len;
-static size_t string_list_capacity;
+// The string pool is a hashmap from every string in the string list to its position in the list,
+// using open addressing with linear probing. It is grown to keep it at most half full
+typedef struct string_pool_bucket
+{
+  uint64_t hash;
+  size_t position; // SIZE_MAX if the bucket is empty
+} string_pool_bucket_t;
+
+// Doubles the number of buckets, and moves every string to its bucket in the new array
+static void grow_string_pool(void)
+{
+  compilation_t* c = compilation;
+  string_pool_bucket_t* old_buckets = c->string_pool;
+  size_t old_n_buckets = c->string_pool_n_buckets;
+
+  c->string_pool_n_buckets = old_n_buckets == 0 ? 64 : old_n_buckets * 2;
+  c->string_pool = malloc(c->string_pool_n_buckets * sizeof(string_pool_bucket_t));
+  for (size_t i = 0; i < c->string_pool_n_buckets; i++)
+    c->string_pool[i].position = SIZE_MAX;
+
+  size_t mask = c->string_pool_n_buckets - 1;
+  for (size_t i = 0; i < old_n_buckets; i++)
+  {
+    if (old_buckets[i].position == SIZE_MAX)
+      continue;
+    size_t bucket = old_buckets[i].hash & mask;
+    while (c->string_pool[bucket].position != SIZE_MAX)
+      bucket = (bucket + 1) & mask;
+    c->string_pool[bucket] = old_buckets[i];
+  }
+  free(old_buckets);
+}
 
 // Adds the given string to the global string list, resizing if needed.
-// Takes ownership of the string, and returns its position in the string list.
+// Equal strings are only added once, so printing the same text in many places
+// only puts it in the program once.
+// Returns the string's position in the string list.
 static size_t add_string(char* string)
 {
-  if (string_list_len + 1 >= string_list_capacity)
+  compilation_t* c = compilation;
+  if ((c->string_list_len + 1) * 2 > c->string_pool_n_buckets)
+    grow_string_pool();
+
+  uint64_t hash = hash_string(string, strlen(string));
+  size_t mask = c->string_pool_n_buckets - 1;
+  size_t bucket = hash & mask;
+  for (; c->string_pool[bucket].position != SIZE_MAX; bucket = (bucket + 1) & mask)
+  {
+    string_pool_bucket_t* existing = &c->string_pool[bucket];
+    if (existing->hash == hash && strcmp(c->string_list[existing->position], string) == 0)
+      return existing->position;
+  }
+
+  if (c->string_list_len + 1 >= c->string_list_capacity)
   {
-    string_list_capacity = string_list_capacity * 2 + 8;
-    string_list = realloc(string_list, string_list_capacity * sizeof(char*));
+    c->string_list_capacity = c->string_list_capacity * 2 + 8;
+    c->string_list = realloc(c->string_list, c->string_list_capacity * sizeof(char*));
   }
-  string_list[string_list_len] = string;
-  return string_list_len++;
+  c->string_list[c->string_list_len] = string;
+  c->string_pool[bucket] = (string_pool_bucket_t){.hash = hash, .position = c->string_list_len};
+  return c->string_list_len++;
 }
 
 // Prints all strings added to the global string list
 static void print_string_list(void)
 {
-  for (size_t i = 0; i < string_list_len; i++)
-    printf("%ld: %s\n", i, string_list[i]);
+  for (size_t i = 0; i < compilation->string_list_len; i++)
+    sink_printf(&compilation->output, "%ld: %s\n", i, compilation->string_list[i]);
 }
 
-// Frees all strings in the global string list, and the string list itself
+// Frees the global string list and string pool.
+// The strings themselves are freed along with the syntax tree
 static void destroy_string_list(void)
 {
-  for (int i = 0; i < string_list_len; i++)
-    free(string_list[i]);
-  free(string_list);
+  free(compilation->string_list);
+  compilation->string_list = NULL;
+  compilation->string_list_len = 0;
+  compilation->string_list_capacity = 0;
+
+  free(compilation->string_pool);
+  compilation->string_pool = NULL;
+  compilation->string_pool_n_buckets = 0;
 }
@@ -24,7 +24,7 @@ typedef enum
 // Struct representing the definition of a symbol
 typedef struct symbol
 {
-  char* name;             // Symbol name ( not owned )
+  const char* name;       // Interned symbol name ( not owned )
   symtype_t type;         // Symbol type
   node_t* node;           // The AST node that defined this symbol ( not owned )
   size_t sequence_number; // Sequence number in the symbol table this symbol belongs to
@@ -35,13 +35,15 @@ typedef struct symbol
   struct symbol_table* function_symtable;
 } symbol_t;
 
-// Global symbol table, which contains and owns all global symbols.
-// All function symbols in the global symbol table have pointers to their own local symbol table.
-extern symbol_table_t* global_symbols;
+// Takes in a symbol of type SYMBOL_FUNCTION, and returns how many parameters the function takes
+#define FUNC_PARAM_COUNT(func) (node_child((func)->node, 1)->n_children)
 
-// Global string list, owns all contained strings
-extern char** string_list;
-extern size_t string_list_len;
+// The global symbol table, compilation->global_symbols, contains and owns all global symbols.
+// All function symbols in the global symbol table have pointers to their own local symbol table.
+//
+// The global string list, compilation->string_list, has compilation->string_list_len strings.
+// Every string is only in the list once, no matter how many times it appears in the program.
+// The strings themselves are owned by the syntax tree.
 
 // Traverses the abstract syntax tree and creates symbol tables, both global and local.
 // Places strings in the string_list, and turns STRING_LITERAL nodes into STRING_LIST_REFERENCEs.
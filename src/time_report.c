@@ -0,0 +1,166 @@
+#include "time_report.h"
+#include "compilation.h"
+#include <sys/resource.h>
+
+static const char* PHASE_NAMES[PHASE_COUNT] = {
+#define PHASE(phase, name, key) [phase] = name,
+    COMPILER_PHASES
+#undef PHASE
+};
+
+static const char* PHASE_KEYS[PHASE_COUNT] = {
+#define PHASE(phase, name, key) [phase] = key,
+    COMPILER_PHASES
+#undef PHASE
+};
+
+static const char* PEEPHOLE_RULE_NAMES[PEEPHOLE_RULE_COUNT] = {
+#define RULE(rule, name, key) [rule] = "peephole: " name,
+    PEEPHOLE_RULES
+#undef RULE
+};
+
+static const char* PEEPHOLE_RULE_KEYS[PEEPHOLE_RULE_COUNT] = {
+#define RULE(rule, name, key) [rule] = "peephole_" key,
+    PEEPHOLE_RULES
+#undef RULE
+};
+
+// Returns the number of seconds from start to end
+static double seconds_between(struct timespec start, struct timespec end)
+{
+  return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+}
+
+// Reads both clocks. The CPU clock only counts this thread, so batch compilations running
+// on other threads are not included
+phase_timer_t phase_start(compiler_phase_t phase)
+{
+  phase_timer_t timer = {.phase = phase};
+  clock_gettime(CLOCK_MONOTONIC, &timer.wall_start);
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &timer.cpu_start);
+  return timer;
+}
+
+// Reads both clocks again, and adds the differences to the phase
+void phase_stop(const phase_timer_t* timer)
+{
+  struct timespec wall_end, cpu_end;
+  clock_gettime(CLOCK_MONOTONIC, &wall_end);
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_end);
+
+  phase_time_t* time = &compilation->statistics.phases[timer->phase];
+  time->wall += seconds_between(timer->wall_start, wall_end);
+  time->cpu += seconds_between(timer->cpu_start, cpu_end);
+}
+
+// Prints a string as a JSON string literal
+static void print_json_string(FILE* output, const char* string)
+{
+  fputc('"', output);
+  for (const char* c = string; *c != '\0'; c++)
+  {
+    if (*c == '"' || *c == '\\')
+      fprintf(output, "\\%c", *c);
+    else if ((unsigned char)*c < 0x20)
+      fprintf(output, "\\u%04x", *c);
+    else
+      fputc(*c, output);
+  }
+  fputc('"', output);
+}
+
+// A counter of the report, with its key in the JSON report, and its name in the text report
+typedef struct report_counter
+{
+  const char* key;
+  const char* description;
+  size_t value;
+} report_counter_t;
+
+// Gathers the statistics of the active compilation, and prints them as text or a line of JSON.
+// stdio locks the output for the whole report, so reports from batch threads are not mixed up
+void print_time_report(FILE* output, const char* input_name, bool json)
+{
+  compilation_statistics_t* statistics = &compilation->statistics;
+  symbol_hashmap_statistics_t* hashmap = &compilation->hashmap_statistics;
+
+  phase_time_t total = {0, 0};
+  for (int i = 0; i < PHASE_COUNT; i++)
+  {
+    total.wall += statistics->phases[i].wall;
+    total.cpu += statistics->phases[i].cpu;
+  }
+
+  // ru_maxrss is the peak of the whole process, in kilobytes
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  long peak_rss = usage.ru_maxrss;
+
+  report_counter_t counters[] = {
+      {"tokens", "tokens", statistics->n_tokens},
+      {"nodes_created", "nodes created", statistics->n_nodes_created},
+      {"nodes_detached", "nodes detached", statistics->n_nodes_detached},
+      {"symbols", "symbols", statistics->n_symbols},
+      {"hashmap_inserts", "hashmap inserts", hashmap->n_inserts},
+      {"hashmap_lookups", "hashmap lookups", hashmap->n_lookups},
+      {"hashmap_probes", "hashmap probes", hashmap->n_probes},
+      {"ir_instructions", "IR instructions", statistics->n_ir_instructions},
+      {"values_reused", "values reused", statistics->n_values_reused},
+      {"instructions", "instructions emitted", statistics->n_instructions},
+      {"cache_hits", "function cache hits", statistics->n_cache_hits},
+      {"cache_misses", "function cache misses", statistics->n_cache_misses},
+  };
+  size_t n_counters = sizeof(counters) / sizeof(counters[0]);
+  size_t* rewrites = statistics->n_peephole_rewrites;
+
+  flockfile(output);
+  if (json)
+  {
+    fprintf(output, "{\"input\": ");
+    print_json_string(output, input_name);
+    fprintf(output, ", \"phases\": {");
+    for (int i = 0; i < PHASE_COUNT; i++)
+    {
+      fprintf(
+          output,
+          "%s\"%s\": {\"wall_ms\": %.3f, \"cpu_ms\": %.3f}",
+          i == 0 ? "" : ", ",
+          PHASE_KEYS[i],
+          statistics->phases[i].wall * 1e3,
+          statistics->phases[i].cpu * 1e3);
+    }
+    fprintf(
+        output,
+        "}, \"total\": {\"wall_ms\": %.3f, \"cpu_ms\": %.3f}, \"peak_rss_kb\": %ld",
+        total.wall * 1e3,
+        total.cpu * 1e3,
+        peak_rss);
+    for (size_t i = 0; i < n_counters; i++)
+      fprintf(output, ", \"%s\": %zu", counters[i].key, counters[i].value);
+    for (int i = 0; i < PEEPHOLE_RULE_COUNT; i++)
+      fprintf(output, ", \"%s\": %zu", PEEPHOLE_RULE_KEYS[i], rewrites[i]);
+    fprintf(output, "}\n");
+  }
+  else
+  {
+    fprintf(output, " == TIME REPORT: %s == \n", input_name);
+    fprintf(output, "%-28s %12s %12s\n", "phase", "wall (ms)", "cpu (ms)");
+    for (int i = 0; i < PHASE_COUNT; i++)
+    {
+      fprintf(
+          output,
+          "%-28s %12.3f %12.3f\n",
+          PHASE_NAMES[i],
+          statistics->phases[i].wall * 1e3,
+          statistics->phases[i].cpu * 1e3);
+    }
+    fprintf(output, "%-28s %12.3f %12.3f\n", "total", total.wall * 1e3, total.cpu * 1e3);
+    fprintf(output, "%-28s %12ld kB\n", "peak RSS", peak_rss);
+    for (size_t i = 0; i < n_counters; i++)
+      fprintf(output, "%-28s %12zu\n", counters[i].description, counters[i].value);
+    for (int i = 0; i < PEEPHOLE_RULE_COUNT; i++)
+      fprintf(output, "%-28s %12zu\n", PEEPHOLE_RULE_NAMES[i], rewrites[i]);
+  }
+  funlockfile(output);
+}
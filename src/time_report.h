@@ -0,0 +1,73 @@
+#ifndef TIME_REPORT_H
+#define TIME_REPORT_H
+
+#include "peephole.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <time.h>
+
+// Every compilation keeps track of how long each of its phases took, and counts the work done.
+// The report is printed with -ftime-report, as text, or as JSON with -ftime-report=json.
+
+// The phases of the compiler, with their names in the text and JSON reports
+#define COMPILER_PHASES                                                         \
+  PHASE(PHASE_PARSE, "parse", "parse")                                          \
+  PHASE(PHASE_LOAD_BINARY_AST, "binary syntax tree loading", "load_binary_ast") \
+  PHASE(PHASE_CONSTANT_FOLDING, "constant folding", "constant_folding")         \
+  PHASE(PHASE_UNREACHABLE_CODE, "unreachable code removal", "unreachable_code") \
+  PHASE(PHASE_SYMBOL_TABLES, "symbol tables", "symbol_tables")                  \
+  PHASE(PHASE_CODE_GENERATION, "code generation", "code_generation")            \
+  PHASE(PHASE_PRINT, "printing trees and tables", "print")
+
+typedef enum
+{
+#define PHASE(phase, name, key) phase,
+  COMPILER_PHASES
+#undef PHASE
+  PHASE_COUNT
+} compiler_phase_t;
+
+// The time spent in one phase, in seconds. Phases that run several times are added up
+typedef struct phase_time
+{
+  double wall;
+  double cpu; // CPU time of the thread running the compilation
+} phase_time_t;
+
+typedef struct compilation_statistics
+{
+  phase_time_t phases[PHASE_COUNT];
+  size_t n_tokens;          // Tokens read by the parser
+  size_t n_nodes_created;   // Nodes made with node_create
+  // Nodes removed from the tree by constant folding and unreachable code. Nodes are kept in one
+  // pool, which is freed all at once, so these are the nodes destroyed before the end
+  size_t n_nodes_detached;
+  size_t n_symbols;         // Symbols in all symbol tables
+  size_t n_ir_instructions; // IR instructions, once values never used are removed
+  size_t n_values_reused;   // IR instructions replaced by a value already computed, or a constant
+  size_t n_instructions;    // Assembly instructions emitted, not counting labels and directives
+  size_t n_cache_hits;      // Functions whose code was taken from the function cache
+  size_t n_cache_misses;    // Functions generated and added to the function cache
+  size_t n_peephole_rewrites[PEEPHOLE_RULE_COUNT]; // Times each rule rewrote code, see peephole.h
+} compilation_statistics_t;
+
+// A running measurement of one phase
+typedef struct phase_timer
+{
+  compiler_phase_t phase;
+  struct timespec wall_start;
+  struct timespec cpu_start;
+} phase_timer_t;
+
+// Starts measuring the given phase of the active compilation
+phase_timer_t phase_start(compiler_phase_t phase);
+
+// Stops the measurement, and adds the time to the statistics of the active compilation
+void phase_stop(const phase_timer_t* timer);
+
+// Prints the times, counters and peak memory use of the active compilation.
+// The input name is only used to label the report
+void print_time_report(FILE* output, const char* input_name, bool json);
+
+#endif // TIME_REPORT_H
@@ -1,60 +1,148 @@
 #include "vslc.h"
 
-// Global root for abstract syntax tree
-node_t* root;
+// The root of the syntax tree is compilation->root.
+// All nodes are kept in compilation->nodes, and the children of LIST nodes in
+// compilation->list_children. Strings in the syntax tree are allocated from compilation->tree_arena
 
 // Declarations of helper functions defined further down in this file
-static void node_print(node_t* node, int nesting);
-static node_t* constant_fold_subtree(node_t* node);
-static bool remove_unreachable_code(node_t* node);
-static void destroy_subtree(node_t* discard);
+static void node_print(node_t* root);
+static node_t* constant_fold_subtree(node_t* root);
+static bool remove_unreachable_code(node_t* root);
+static void record_detached_subtree(node_t* root);
+static void simplify_functions(compiler_phase_t phase, bool (*simplify)(node_t* function),
+                               bool* results);
+static bool constant_fold_function(node_t* function);
+static bool remove_unreachable_code_function(node_t* function);
+
+_Static_assert(sizeof(node_t) == 32, "nodes should stay small, to keep tree walks in cache");
+
+// LIST nodes always have room for a power of two number of children.
+// Returns the capacity of a new LIST node with n_children children.
+static size_t list_capacity(size_t n_children)
+{
+  size_t capacity = 1;
+  while (capacity < n_children)
+    capacity *= 2;
+  return capacity;
+}
 
-// Initialize a node with the given type and children
-node_t* node_create(node_type_t type, size_t n_children, ...)
+// Takes room for n children from the end of the list pool, and returns the position of the room
+static uint32_t list_children_alloc(size_t n)
+{
+  compilation_t* c = compilation;
+  if (c->list_children_length + n > c->list_children_capacity)
+  {
+    while (c->list_children_length + n > c->list_children_capacity)
+      c->list_children_capacity = c->list_children_capacity * 2 + 1024;
+    c->list_children = realloc(c->list_children, c->list_children_capacity * sizeof(node_id_t));
+  }
+  assert(c->list_children_length + n <= UINT32_MAX);
+
+  uint32_t start = c->list_children_length;
+  c->list_children_length += n;
+  return start;
+}
+
+// Takes the next node from the node pool, and gives it the type and number of children.
+// Returns the room for its children, which the caller must fill in
+static node_id_t* node_alloc(node_type_t type, size_t n_children, node_id_t* id)
 {
-  node_t* result = malloc(sizeof(node_t));
+  compilation_t* c = compilation;
+
+  // Position 0 is never used, so the first node goes at position 1
+  if (c->n_nodes == 0)
+    c->n_nodes = 1;
+  if (c->n_nodes >= c->nodes_capacity)
+  {
+    c->nodes_capacity = c->nodes_capacity * 2 + 1024;
+    c->nodes = realloc(c->nodes, c->nodes_capacity * sizeof(node_t));
+  }
+  assert(c->n_nodes < UINT32_MAX);
+
+  *id = c->n_nodes++;
+  c->statistics.n_nodes_created++;
 
   // Initialize every field in the struct
-  *result = (node_t){
-      .type = type,
-      .n_children = n_children,
-      .children = malloc(n_children * sizeof(node_t*)),
-      .symbol = NULL,
-  };
+  node_t* result = &c->nodes[*id];
+  *result = (node_t){.type = type, .n_children = n_children};
+
+  // LIST nodes get extra room, so appending to them does not need to move them every time
+  if (type == LIST)
+  {
+    result->list.capacity = list_capacity(n_children);
+    result->list.start = list_children_alloc(result->list.capacity);
+    return &c->list_children[result->list.start];
+  }
+  assert(n_children <= NODE_INLINE_CHILDREN);
+  return result->inline_children;
+}
+
+// Initialize a node with the given type and children
+node_id_t node_create(node_type_t type, size_t n_children, ...)
+{
+  node_id_t id;
+  node_id_t* children = node_alloc(type, n_children, &id);
 
   // Read each child node from the va_list
   va_list child_list;
   va_start(child_list, n_children);
   for (size_t i = 0; i < n_children; i++)
   {
-    result->children[i] = va_arg(child_list, node_t*);
+    children[i] = va_arg(child_list, node_id_t);
   }
   va_end(child_list);
 
-  return result;
+  return id;
+}
+
+// Initialize a node with the given type, and the children in the given array
+node_id_t node_create_from(node_type_t type, size_t n_children, const node_id_t* children)
+{
+  node_id_t id;
+  node_id_t* room = node_alloc(type, n_children, &id);
+  for (size_t i = 0; i < n_children; i++)
+    room[i] = children[i];
+  return id;
 }
 
 // Append an element to the given LIST node, returns the list node
-node_t* append_to_list_node(node_t* list_node, node_t* element)
+node_id_t append_to_list_node(node_id_t list_id, node_id_t element)
 {
+  compilation_t* c = compilation;
+  node_t* list_node = node_at(list_id);
   assert(list_node->type == LIST);
 
-  // Calculate the minimum size of the new allocation
-  size_t min_allocation_size = list_node->n_children + 1;
-
-  // Round up to the next power of two
-  size_t new_allocation_size = 1;
-  while (new_allocation_size < min_allocation_size)
-    new_allocation_size *= 2;
-
-  // Resize the allocation
-  list_node->children = realloc(list_node->children, new_allocation_size * sizeof(node_t*));
+  // If the list is full, its capacity is doubled. If its children are at the end of the list
+  // pool, the room right after them is taken. Otherwise they are moved to the end of the pool,
+  // and the old room is left unused until the whole tree is destroyed
+  uint32_t capacity = list_node->list.capacity;
+  if (list_node->n_children == capacity)
+  {
+    if (list_node->list.start + capacity == c->list_children_length)
+      list_children_alloc(capacity);
+    else
+    {
+      uint32_t start = list_children_alloc(capacity * 2);
+      memcpy(
+          &c->list_children[start],
+          &c->list_children[list_node->list.start],
+          list_node->n_children * sizeof(node_id_t));
+      list_node->list.start = start;
+    }
+    list_node->list.capacity = capacity * 2;
+  }
 
   // Insert the new element and increase child count by 1
-  list_node->children[list_node->n_children] = element;
+  c->list_children[list_node->list.start + list_node->n_children] = element;
   list_node->n_children++;
 
-  return list_node;
+  return list_id;
+}
+
+// Copies the given string into memory owned by the syntax tree
+char* tree_strdup(const char* string)
+{
+  return arena_strdup(&compilation->tree_arena, string);
 }
 
 // Outputs the entire syntax tree to the terminal
@@ -62,104 +150,154 @@ void print_syntax_tree(void)
 {
   // If the environment variable GRAPHVIZ_OUTPUT is set, print a GraphViz graph in the dot format
   if (getenv("GRAPHVIZ_OUTPUT") != NULL)
-    graphviz_node_print(root);
+    graphviz_node_print(node_at(compilation->root));
   else
-    node_print(root, 0);
+    node_print(node_at(compilation->root));
 }
 
-// Performs constant folding and removes unconditional conditional branches
+// Performs constant folding and removes unconditional conditional branches.
+// Functions are folded on their own, perhaps on several threads, and then the global declarations
 void constant_fold_syntax_tree(void)
 {
-  root = constant_fold_subtree(root);
+  simplify_functions(PHASE_CONSTANT_FOLDING, constant_fold_function, NULL);
+
+  node_t* root = node_at(compilation->root);
+  for (size_t i = 0; i < root->n_children; i++)
+  {
+    node_t* declaration = node_child(root, i);
+    if (declaration != NULL && declaration->type != FUNCTION)
+      node_set_child(root, i, constant_fold_subtree(declaration));
+  }
 }
 
 // Removes code that is never reached due to return and break statements.
 // Also ensures execution never reaches the end of a function without reaching a return statement.
 void remove_unreachable_code_syntax_tree(void)
 {
-  for (size_t i = 0; i < root->n_children; i++)
+  // Functions may be simplified on several threads, which must not create nodes. Whether each
+  // function returns is kept, and the returns it lacks are added afterwards, on this thread
+  node_id_t root = compilation->root;
+  bool* has_return = malloc(node_at(root)->n_children * sizeof(bool));
+  simplify_functions(PHASE_UNREACHABLE_CODE, remove_unreachable_code_function, has_return);
+
+  // Nodes are created below, and may move when that happens. So they are kept by id here
+  size_t n_functions = 0;
+  for (size_t i = 0; i < node_at(root)->n_children; i++)
   {
-    node_t* child = root->children[i];
-    if (child->type != FUNCTION)
+    node_id_t function = node_children(node_at(root))[i];
+    if (node_at(function)->type != FUNCTION)
       continue;
 
-    node_t* function_body = child->children[2];
-
-    bool has_return = remove_unreachable_code(function_body);
+    node_id_t function_body = node_at(function)->inline_children[2];
 
     // If the function body is not guaranteed to call return, we wrap it in a BLOCK like so:
     // {
     //   original_function_body
     //   return 0
     // }
-    if (!has_return)
+    if (!has_return[n_functions++])
     {
-      node_t* zero_node = node_create(NUMBER_LITERAL, 0);
-      zero_node->data.number_literal = 0;
-      node_t* return_node = node_create(RETURN_STATEMENT, 1, zero_node);
-      node_t* statement_list = node_create(LIST, 2, function_body, return_node);
-      node_t* new_function_body = node_create(BLOCK, 1, statement_list);
-      child->children[2] = new_function_body;
+      node_id_t zero_node = node_create(NUMBER_LITERAL, 0);
+      node_at(zero_node)->data.number_literal = 0;
+      node_id_t return_node = node_create(RETURN_STATEMENT, 1, zero_node);
+      node_id_t statement_list = node_create(LIST, 2, function_body, return_node);
+      node_id_t new_function_body = node_create(BLOCK, 1, statement_list);
+      node_at(function)->inline_children[2] = new_function_body;
     }
   }
+  free(has_return);
 }
 
-// Frees all memory held by the syntax tree
+// Frees all memory held by the syntax tree, including nodes that have been detached from it.
+// Also frees the tree walk stack, which may still hold frames if a pass was stopped by an error
 void destroy_syntax_tree(void)
 {
-  destroy_subtree(root);
-  root = NULL;
+  compilation_t* c = compilation;
+  free(c->nodes);
+  free(c->list_children);
+  arena_release(&c->tree_arena);
+  c->root = NO_NODE;
+  c->nodes = NULL;
+  c->n_nodes = c->nodes_capacity = 0;
+  c->list_children = NULL;
+  c->list_children_length = c->list_children_capacity = 0;
+
+  free(compilation->tree_walk.frames);
+  compilation->tree_walk = (tree_walk_stack_t){.frames = NULL, .length = 0, .capacity = 0};
+}
+
+// Doubles the room for frames in the tree walk stack
+void tree_walk_grow(tree_walk_stack_t* stack)
+{
+  stack->capacity = stack->capacity * 2 + 64;
+  stack->frames = realloc(stack->frames, stack->capacity * sizeof(tree_walk_frame_t));
 }
 
 // The rest of this file contains private helper functions used by the above functions
 
-// Prints out the given node and all its children recursively
-static void node_print(node_t* node, int nesting)
+// Prints out the given node and all its children, each child indented one more than its parent
+static void node_print(node_t* root)
 {
-  // Indent the line based on how deep the node is in the syntax tree
-  printf("%*s", nesting, "");
+  sink_t* output = &compilation->output;
+  tree_walk_stack_t* stack = &compilation->tree_walk;
+  size_t stack_base = stack->length;
 
-  if (node == NULL)
+  // Nodes are printed as they are popped. The value of a frame is the nesting of its node
+  tree_walk_push(stack, root, 0);
+  while (stack->length > stack_base)
   {
-    printf("(NULL)\n");
-    return;
-  }
+    node_t* node = tree_walk_top(stack)->node;
+    int nesting = tree_walk_top(stack)->value;
+    tree_walk_pop(stack);
 
-  printf("%s", NODE_TYPE_NAMES[node->type]);
+    // Indent the line based on how deep the node is in the syntax tree
+    sink_printf(output, "%*s", nesting, "");
 
-  // For nodes with extra data, include it in the printout
-  switch (node->type)
-  {
-  case OPERATOR:
-    printf(" (%s)", node->data.operator);
-    break;
-  case IDENTIFIER:
-    printf(" (%s)", node->data.identifier);
-    break;
-  case NUMBER_LITERAL:
-    printf(" (%ld)", node->data.number_literal);
-    break;
-  case STRING_LITERAL:
-    printf(" (%s)", node->data.string_literal);
-    break;
-  case STRING_LIST_REFERENCE:
-    printf(" (%zu)", node->data.string_list_index);
-    break;
-  default:
-    break;
-  }
+    if (node == NULL)
+    {
+      sink_puts(output, "(NULL)\n");
+      continue;
+    }
 
-  // If the node is a reference to a symbol, print its type and number
-  if (node->symbol)
-  {
-    printf(" %s(%zu)", SYMBOL_TYPE_NAMES[node->symbol->type], node->symbol->sequence_number);
-  }
+    sink_puts(output, NODE_TYPE_NAMES[node->type]);
 
-  putchar('\n');
+    // For nodes with extra data, include it in the printout
+    switch (node->type)
+    {
+    case OPERATOR:
+      sink_printf(output, " (%s)", OPERATOR_NAMES[node->data.operator]);
+      break;
+    case IDENTIFIER:
+      sink_printf(output, " (%s)", node->data.identifier);
+      break;
+    case NUMBER_LITERAL:
+      sink_printf(output, " (%ld)", node->data.number_literal);
+      break;
+    case STRING_LITERAL:
+      sink_printf(output, " (%s)", node->data.string_literal);
+      break;
+    case STRING_LIST_REFERENCE:
+      sink_printf(output, " (%zu)", node->data.string_list_index);
+      break;
+    default:
+      break;
+    }
 
-  // Recursively print children, with some more indentation
-  for (size_t i = 0; i < node->n_children; i++)
-    node_print(node->children[i], nesting + 1);
+    // If the node is a reference to a symbol, print its type and number
+    if (node->type == IDENTIFIER && node->symbol)
+    {
+      symbol_t* symbol = node->symbol;
+      sink_printf(output, " %s(%zu)", SYMBOL_TYPE_NAMES[symbol->type], symbol->sequence_number);
+    }
+
+    sink_putc(output, '\n');
+
+    // Print the children afterwards, with some more indentation.
+    // They are pushed in reverse, so the first child is printed first
+    node_id_t* children = node_children(node);
+    for (size_t i = node->n_children; i > 0; i--)
+      tree_walk_push(stack, node_at(children[i - 1]), nesting + 1);
+  }
 }
 
 // Constant folds the given OPERATOR node, if all children are NUMBER_LITERAL
@@ -169,56 +307,60 @@ static node_t* constant_fold_operator(node_t* node)
 
   // Check that all operands are NUMBER_LITERALs
   for (size_t i = 0; i < node->n_children; i++)
-    if (node->children[i]->type != NUMBER_LITERAL)
+    if (node_child(node, i)->type != NUMBER_LITERAL)
       return node;
 
-  const char* op = node->data.operator;
+  // Unary operators only use lhs
+  int64_t lhs = node_child(node, 0)->data.number_literal;
+  int64_t rhs = node->n_children == 2 ? node_child(node, 1)->data.number_literal : 0;
 
   // This is where we store the result of the constant fold
-  int64_t result;
-
-  if (node->n_children == 1)
-  {
-    int64_t operand = node->children[0]->data.number_literal;
-    if (strcmp(op, "-") == 0)
-      result = -operand;
-    else if (strcmp(op, "!") == 0)
-      result = !operand;
-    else
-      assert(false && "Unknown unary operator");
-  }
-  else if (node->n_children == 2)
+  int64_t result = 0;
+  switch (node->data.operator)
   {
-    int64_t lhs = node->children[0]->data.number_literal;
-    int64_t rhs = node->children[1]->data.number_literal;
-    if (strcmp(op, "==") == 0)
-      result = lhs == rhs;
-    else if (strcmp(op, "!=") == 0)
-      result = lhs != rhs;
-    else if (strcmp(op, "<") == 0)
-      result = lhs < rhs;
-    else if (strcmp(op, "<=") == 0)
-      result = lhs <= rhs;
-    else if (strcmp(op, ">") == 0)
-      result = lhs > rhs;
-    else if (strcmp(op, ">=") == 0)
-      result = lhs >= rhs;
-    else if (strcmp(op, "+") == 0)
-      result = lhs + rhs;
-    else if (strcmp(op, "-") == 0)
-      result = lhs - rhs;
-    else if (strcmp(op, "*") == 0)
-      result = lhs * rhs;
-    else if (strcmp(op, "/") == 0)
-      result = lhs / rhs;
-    else
-      assert(false && "Unknown unary operator");
+  case OPERATOR_ADD:
+    result = lhs + rhs;
+    break;
+  case OPERATOR_SUBTRACT:
+    result = lhs - rhs;
+    break;
+  case OPERATOR_MULTIPLY:
+    result = lhs * rhs;
+    break;
+  case OPERATOR_DIVIDE:
+    result = lhs / rhs;
+    break;
+  case OPERATOR_EQUAL:
+    result = lhs == rhs;
+    break;
+  case OPERATOR_NOT_EQUAL:
+    result = lhs != rhs;
+    break;
+  case OPERATOR_LESS:
+    result = lhs < rhs;
+    break;
+  case OPERATOR_LESS_EQUAL:
+    result = lhs <= rhs;
+    break;
+  case OPERATOR_GREATER:
+    result = lhs > rhs;
+    break;
+  case OPERATOR_GREATER_EQUAL:
+    result = lhs >= rhs;
+    break;
+  case OPERATOR_NEGATE:
+    result = -lhs;
+    break;
+  case OPERATOR_NOT:
+    result = !lhs;
+    break;
+  default:
+    assert(false && "Unknown operator");
   }
 
-  // Free all children, turn the node into a NUMBER_LITERAL
+  // Detach all children, turn the node into a NUMBER_LITERAL
   for (size_t i = 0; i < node->n_children; i++)
-    destroy_subtree(node->children[i]);
-
+    record_detached_subtree(node_child(node, i));
   node->type = NUMBER_LITERAL;
   node->data.number_literal = result;
   node->n_children = 0;
@@ -231,27 +373,26 @@ static node_t* constant_fold_if(node_t* node)
 {
   assert(node->type == IF_STATEMENT);
 
-  if (node->children[0]->type != NUMBER_LITERAL)
+  if (node_child(node, 0)->type != NUMBER_LITERAL)
     return node;
-  bool condition = node->children[0]->data.number_literal;
+  bool condition = node_child(node, 0)->data.number_literal;
 
   // Detatch the node we want to return from the IF_STATEMENT-node
   node_t* result = NULL;
 
   if (condition)
   {
-    result = node->children[1];
-    node->children[1] = NULL;
+    result = node_child(node, 1);
+    node_set_child(node, 1, NULL);
   }
   else if (node->n_children == 3)
   {
-    result = node->children[2];
-    node->children[2] = NULL;
+    result = node_child(node, 2);
+    node_set_child(node, 2, NULL);
   }
   // If condition is false and the if has no else-body, we just let result be NULL
-
-  // Destory everything that is still attached to the IF_STATEMENT-node
-  destroy_subtree(node);
+  // Everything still attached to the IF_STATEMENT-node is left behind in the arena
+  record_detached_subtree(node);
   return result;
 }
 
@@ -262,144 +403,295 @@ static node_t* constant_fold_while(node_t* node)
 {
   assert(node->type == WHILE_STATEMENT);
 
-  if (node->children[0]->type != NUMBER_LITERAL)
+  if (node_child(node, 0)->type != NUMBER_LITERAL)
     return node;
 
-  bool condition = node->children[0]->data.number_literal;
+  bool condition = node_child(node, 0)->data.number_literal;
   if (condition)
     return node;
 
-  destroy_subtree(node);
+  record_detached_subtree(node);
   return NULL;
 }
 
 // Does constant folding on the subtreee rooted at the given node.
 // Returns the root of the new subtree.
-// Any node that is detached from the tree by this operation must be freed, to avoid memory leaks.
-static node_t* constant_fold_subtree(node_t* node)
+// Nodes detached from the tree by this operation are freed along with the rest of the tree.
+static node_t* constant_fold_subtree(node_t* root)
 {
-  if (node == NULL)
-    return node;
+  tree_walk_stack_t* stack = &compilation->tree_walk;
+  size_t stack_base = stack->length;
 
-  // First do constant folding on all child nodes
-  for (size_t i = 0; i < node->n_children; i++)
-    node->children[i] = constant_fold_subtree(node->children[i]);
+  // The new root of the subtree that was folded last
+  node_t* folded = NULL;
 
-  switch (node->type)
+  tree_walk_push(stack, root, 0);
+  while (stack->length > stack_base)
   {
-  case OPERATOR:
-    return constant_fold_operator(node);
-  case IF_STATEMENT:
-    return constant_fold_if(node);
-  case WHILE_STATEMENT:
-    return constant_fold_while(node);
-  default:
-    return node;
+    tree_walk_frame_t* frame = tree_walk_top(stack);
+    node_t* node = frame->node;
+    if (node == NULL)
+    {
+      folded = NULL;
+      tree_walk_pop(stack);
+      continue;
+    }
+
+    // First do constant folding on all child nodes. At step i, the first i children are done,
+    // and the folded subtree of the last of them is put in its place
+    if (frame->step > 0)
+      node_set_child(node, frame->step - 1, folded);
+    if (frame->step < node->n_children)
+    {
+      size_t i = frame->step++;
+      tree_walk_push(stack, node_child(node, i), 0);
+      continue;
+    }
+
+    tree_walk_pop(stack);
+    switch (node->type)
+    {
+    case OPERATOR:
+      folded = constant_fold_operator(node);
+      break;
+    case IF_STATEMENT:
+      folded = constant_fold_if(node);
+      break;
+    case WHILE_STATEMENT:
+      folded = constant_fold_while(node);
+      break;
+    default:
+      folded = node;
+      break;
+    }
   }
+
+  return folded;
 }
 
 // Operates on the statement given as node, and any sub-statements it may have.
 // Returns true if execution of the given statement is guaranteed to interrupt execution
 // through either a return statement or a break statement.
 // When node is a BLOCK, any statements that come after such an interrupting statement are removed.
-static bool remove_unreachable_code(node_t* node)
+static bool remove_unreachable_code(node_t* root)
 {
-  if (node == NULL)
-    return false;
+  tree_walk_stack_t* stack = &compilation->tree_walk;
+  size_t stack_base = stack->length;
 
-  switch (node->type)
-  {
-  case RETURN_STATEMENT:
-  case BREAK_STATEMENT:
-    return true;
-  case IF_STATEMENT:
+  // Whether the statement that was finished last interrupts execution
+  bool interrupts = false;
+
+  tree_walk_push(stack, root, 0);
+  while (stack->length > stack_base)
   {
-    if (node->n_children == 2)
+    tree_walk_frame_t* frame = tree_walk_top(stack);
+    node_t* node = frame->node;
+    size_t step = frame->step++;
+
+    if (node == NULL)
     {
-      // If the if only has a then-statement, it can not terminate execution
-      remove_unreachable_code(node->children[1]);
-      return false;
+      interrupts = false;
+      tree_walk_pop(stack);
+      continue;
     }
-    else
+
+    switch (node->type)
+    {
+    case RETURN_STATEMENT:
+    case BREAK_STATEMENT:
+      interrupts = true;
+      tree_walk_pop(stack);
+      break;
+    case IF_STATEMENT:
     {
-      // If both the then-statement and the else-statement are interrupted
-      // we know that the if itself is interrupting as well
-      bool then_interrupts = remove_unreachable_code(node->children[1]);
-      bool else_interrupts = remove_unreachable_code(node->children[2]);
-      return then_interrupts && else_interrupts;
+      // Step 0 visits the then-statement, and step 1 the else-statement, if there is one.
+      // The value of the frame remembers if the then-statement interrupts
+      if (step == 0)
+        tree_walk_push(stack, node_child(node, 1), 0);
+      else if (step == 1 && node->n_children == 3)
+      {
+        frame->value = interrupts;
+        tree_walk_push(stack, node_child(node, 2), 0);
+      }
+      else
+      {
+        // If the if only has a then-statement, it can not terminate execution.
+        // If both the then-statement and the else-statement are interrupted
+        // we know that the if itself is interrupting as well
+        interrupts = node->n_children == 3 && frame->value && interrupts;
+        tree_walk_pop(stack);
+      }
+      break;
     }
-  }
-  case WHILE_STATEMENT:
-  {
-    // Even if the body of the while contains interrupting statements,
-    // that is not a guarantee that the code after the while is unreachable.
-    // The while may never be entered, for example, or the interrupting statement may be BREAK.
-    remove_unreachable_code(node->children[1]);
-    return false;
-  }
-  case BLOCK:
-  {
-    // The list of statements in a BLOCK is always the last child node
-    node_t* statement_list = node->children[node->n_children - 1];
-
-    for (size_t i = 0; i < statement_list->n_children; i++)
+    case WHILE_STATEMENT:
     {
-      node_t* child_statement = statement_list->children[i];
-      bool interrupting = remove_unreachable_code(child_statement);
-
-      // If we have an interrupting statement, the rest of the statement list should be freed
-      if (interrupting)
+      // Even if the body of the while contains interrupting statements,
+      // that is not a guarantee that the code after the while is unreachable.
+      // The while may never be entered, for example, or the interrupting statement may be BREAK.
+      if (step == 0)
+        tree_walk_push(stack, node_child(node, 1), 0);
+      else
       {
+        interrupts = false;
+        tree_walk_pop(stack);
+      }
+      break;
+    }
+    case BLOCK:
+    {
+      // The list of statements in a BLOCK is always the last child node.
+      // Step i visits statement i, after checking if statement i - 1 interrupts
+      node_t* statement_list = node_child(node, node->n_children - 1);
 
-        // free all statements that come after i
-        for (size_t j = i + 1; j < statement_list->n_children; j++)
-          destroy_subtree(statement_list->children[j]);
+      // If we have an interrupting statement, the rest of the statement list should be removed
+      if (step > 0 && interrupts)
+      {
+        tree_walk_pop(stack);
 
         // Truncate the list of statements
-        statement_list->n_children = i + 1;
-        return true;
+        for (size_t j = step; j < statement_list->n_children; j++)
+          record_detached_subtree(node_child(statement_list, j));
+        statement_list->n_children = step;
+      }
+      else if (step < statement_list->n_children)
+        tree_walk_push(stack, node_child(statement_list, step), 0);
+      else
+      {
+        // If we get here, none of the statements in the block are interrupting.
+        interrupts = false;
+        tree_walk_pop(stack);
       }
+      break;
+    }
+    default:
+      interrupts = false;
+      tree_walk_pop(stack);
+      break;
     }
-
-    // If we get here, none of the statements in the block are interrupting.
-    return false;
-  }
-  default:
-    return false;
   }
+
+  return interrupts;
+}
+
+// Folds the constants of the function. The FUNCTION node itself stays in place
+static bool constant_fold_function(node_t* function)
+{
+  constant_fold_subtree(function);
+  return false;
+}
+
+// Removes the code of the function that is never reached. Returns true if its body always returns
+static bool remove_unreachable_code_function(node_t* function)
+{
+  return remove_unreachable_code(node_child(function, 2));
 }
 
-// Frees the memory owned by the given node, but does not touch its children
-static void node_finalize(node_t* discard)
+// Functions are simplified on several threads at once, if the compilation has more than one.
+// Each worker activates a compilation of its own, which shares the syntax tree, but has its own
+// tree walk stack and statistics. A pass on a function only changes the nodes of that function,
+// and creates none, since that could move the node pool while other threads use it
+typedef struct simplify_tasks
+{
+  compilation_t* program;
+  compiler_phase_t phase;
+  bool (*simplify)(node_t* function);
+  node_id_t* functions;
+  bool* results;                               // Returned by simplify, for each function
+  compilation_statistics_t* worker_statistics; // One for each worker
+} simplify_tasks_t;
+
+// Takes tasks from the pool, and simplifies their functions, until there are none left
+static void simplify_function_tasks(work_pool_t* pool, size_t worker_index, void* argument)
 {
-  if (discard == NULL)
+  simplify_tasks_t* shared = argument;
+  compilation_t state = *shared->program;
+  state.tree_walk = (tree_walk_stack_t){.frames = NULL, .length = 0, .capacity = 0};
+  state.statistics = (compilation_statistics_t){0};
+
+  // Worker 0 runs on the thread of the program, whose compilation is active again afterwards
+  compilation_t* outer_compilation = compilation;
+  compilation = &state;
+  phase_timer_t timer = phase_start(shared->phase);
+
+  size_t index;
+  while (work_pool_next(pool, worker_index, &index))
+    shared->results[index] = shared->simplify(node_at(shared->functions[index]));
+
+  phase_stop(&timer);
+  shared->worker_statistics[worker_index] = state.statistics;
+  free(state.tree_walk.frames);
+  compilation = outer_compilation;
+}
+
+// Runs the pass on every function of the program, in order, on up to compilation->n_threads
+// threads. What it returns for function i is kept in results[i], unless results is NULL
+static void simplify_functions(compiler_phase_t phase, bool (*simplify)(node_t* function),
+                               bool* results)
+{
+  node_t* root = node_at(compilation->root);
+  node_id_t* functions = malloc(root->n_children * sizeof(node_id_t));
+  size_t n_functions = 0;
+  for (size_t i = 0; i < root->n_children; i++)
+    if (node_child(root, i)->type == FUNCTION)
+      functions[n_functions++] = node_children(root)[i];
+
+  size_t n_workers = compilation->n_threads < n_functions ? compilation->n_threads : n_functions;
+  if (n_workers <= 1)
+  {
+    for (size_t i = 0; i < n_functions; i++)
+    {
+      bool result = simplify(node_at(functions[i]));
+      if (results != NULL)
+        results[i] = result;
+    }
+    free(functions);
     return;
+  }
 
-  // Only free data if the data field is owned by the node
-  switch (discard->type)
+  simplify_tasks_t shared = {
+      .program = compilation,
+      .phase = phase,
+      .simplify = simplify,
+      .functions = functions,
+      .results = results != NULL ? results : malloc(n_functions * sizeof(bool)),
+      .worker_statistics = calloc(n_workers, sizeof(compilation_statistics_t))};
+  work_pool_run(n_functions, n_workers, simplify_function_tasks, &shared);
+
+  // The time of worker 0 is already part of the phase, since it ran on this thread
+  compilation_statistics_t* statistics = &compilation->statistics;
+  for (size_t i = 0; i < n_workers; i++)
   {
-  case IDENTIFIER:
-    free(discard->data.identifier);
-    break;
-  case STRING_LITERAL:
-    free(discard->data.string_literal);
-    break;
-  default:
-    break;
+    statistics->n_nodes_detached += shared.worker_statistics[i].n_nodes_detached;
+    if (i > 0)
+      statistics->phases[phase].cpu += shared.worker_statistics[i].phases[phase].cpu;
   }
-  free(discard->children);
-  free(discard);
+
+  if (results == NULL)
+    free(shared.results);
+  free(shared.worker_statistics);
+  free(functions);
 }
 
-// Recursively frees the memory owned by the given node, and all its children
-static void destroy_subtree(node_t* discard)
+// Counts the nodes of a subtree that has been removed from the syntax tree, for the time report.
+// May be called in the middle of another pass, and leaves its frames alone
+static void record_detached_subtree(node_t* root)
 {
-  if (discard == NULL)
-    return;
+  tree_walk_stack_t* stack = &compilation->tree_walk;
+  size_t stack_base = stack->length;
 
-  for (size_t i = 0; i < discard->n_children; i++)
-    destroy_subtree(discard->children[i]);
-  node_finalize(discard);
+  tree_walk_push(stack, root, 0);
+  while (stack->length > stack_base)
+  {
+    node_t* node = tree_walk_top(stack)->node;
+    tree_walk_pop(stack);
+    if (node == NULL)
+      continue;
+
+    compilation->statistics.n_nodes_detached++;
+    node_id_t* children = node_children(node);
+    for (size_t i = 0; i < node->n_children; i++)
+      tree_walk_push(stack, node_at(children[i]), 0);
+  }
 }
 
 // Definition of the global string array NODE_TYPE_NAMES
@@ -407,3 +699,9 @@ const char* NODE_TYPE_NAMES[NODE_TYPE_COUNT] = {
 #define NODE_TYPE(node_type) #node_type
 #include "nodetypes.h"
 };
+
+// Definition of the global string array OPERATOR_NAMES
+const char* OPERATOR_NAMES[OPERATOR_TYPE_COUNT] = {
+#define OPERATOR_TYPE(operator_type, text) [operator_type] = text
+#include "operators.h"
+};
@@ -16,37 +16,124 @@ typedef enum
 // Array containing human-readable names for all node types
 extern const char* NODE_TYPE_NAMES[NODE_TYPE_COUNT];
 
-// This is the tree node structure for the abstract syntax tree
+// Create the operator_type_t enum containing all operators defined in operators.h
+typedef enum
+{
+
+#define OPERATOR_TYPE(operator_type, text) operator_type
+#include "operators.h"
+  OPERATOR_TYPE_COUNT
+} operator_type_t;
+
+// Array containing the text of all operators, as written in VSL
+extern const char* OPERATOR_NAMES[OPERATOR_TYPE_COUNT];
+
+// Nodes refer to each other by their position in the node pool of the compilation.
+// Position 0 is never used, so NO_NODE can stand for a missing node.
+// See node_at and friends in compilation.h, for going between ids and nodes
+typedef uint32_t node_id_t;
+#define NO_NODE ((node_id_t)0)
+
+// Every node type except LIST has at most this many children, kept inside the node itself
+#define NODE_INLINE_CHILDREN 3
+
+// This is the tree node structure for the abstract syntax tree. It takes up 32 bytes
 typedef struct node
 {
-  node_type_t type;
-  struct node** children; // An owned list of pointers to child nodes
-  size_t n_children;      // The length of the list of child nodes
+  uint8_t type;        // A node_type_t
+  uint32_t n_children; // The length of the list of child nodes
+
+  // Where the children are kept depends on the type of the node.
+  // Use node_children or node_child to get them, no matter the type
+  union
+  {
+    // The children of nodes that are not LIST nodes
+    node_id_t inline_children[NODE_INLINE_CHILDREN];
+
+    // LIST nodes can grow, so their children are kept in the list pool of the compilation,
+    // which has room for capacity children from position start
+    struct
+    {
+      uint32_t start;
+      uint32_t capacity;
+    } list;
+
+    // IDENTIFIER nodes never have children. Instead, this is a pointer to the symbol the node
+    // references. Only used by IDENTIFIER nodes that reference symbols defined elsewhere.
+    // Not owned
+    struct symbol* symbol;
+  };
 
   // At most one of the data fields can be used at once.
   // The node's type decides which field is active, if any
   union
   {
-    const char* operator;     // pointer to constant string, such as "+". Not owned
-    char* identifier;         // owned heap allocation. The identifier as a string
+    operator_type_t operator; // which operator, such as OPERATOR_ADD
+    const char* identifier;   // interned, see intern.h. The identifier as a string
     int64_t number_literal;   // the literal integer value
-    char* string_literal;     // owned heap allocation. Includes the surrounding "quotation marks"
+    char* string_literal;     // allocated with the tree. Includes the surrounding "quotation marks"
     size_t string_list_index; // position in global string list
   } data;
-
-  // A pointer to the symbol this node references. Not owned.
-  // Only used by IDENTIFIER nodes that reference symbols defined elsewhere.
-  struct symbol* symbol;
 } node_t;
 
-// Global root for parse tree and abstract syntax tree
-extern node_t* root;
+// Passes over the syntax tree do not recurse. Instead, they keep the nodes they are working on
+// in an explicit stack of frames, so the nesting depth of a program is only limited by memory.
+// A pass may start a walk of its own while another is running, by remembering the length of
+// the stack when it starts, and stopping once the stack is back to that length.
+typedef struct tree_walk_frame
+{
+  node_t* node;
+  size_t step;  // How far the pass has come with the node, such as the number of children done
+  size_t value; // Anything else the pass needs to remember about the node
+} tree_walk_frame_t;
+
+typedef struct tree_walk_stack
+{
+  tree_walk_frame_t* frames;
+  size_t length;
+  size_t capacity;
+} tree_walk_stack_t;
+
+// Makes room for more frames. The frames move, so pointers to them are no longer valid
+void tree_walk_grow(tree_walk_stack_t* stack);
+
+// Pushes a frame for the given node at step 0.
+// Frames may move when a frame is pushed, so earlier pointers to frames must not be used after
+static inline void tree_walk_push(tree_walk_stack_t* stack, node_t* node, size_t value)
+{
+  if (stack->length == stack->capacity)
+    tree_walk_grow(stack);
+  stack->frames[stack->length++] = (tree_walk_frame_t){.node = node, .step = 0, .value = value};
+}
+
+// Returns the frame on top of the stack
+static inline tree_walk_frame_t* tree_walk_top(tree_walk_stack_t* stack)
+{
+  return &stack->frames[stack->length - 1];
+}
+
+// Removes the frame on top of the stack
+static inline void tree_walk_pop(tree_walk_stack_t* stack)
+{
+  stack->length--;
+}
 
-// The node creation function, used by the parser
-node_t* node_create(node_type_t type, size_t n_children, ...);
+// The functions below all work on the syntax tree of the active compilation, see compilation.h.
+// Its root is compilation->root, and its tree walk stack is compilation->tree_walk
+
+// The node creation function, used by the parser. The children are given as node_id_t.
+// The nodes may move when a node is created, so earlier pointers to nodes must not be used after
+node_id_t node_create(node_type_t type, size_t n_children, ...);
+
+// Like node_create, but the children are taken from an array instead of a va_list
+node_id_t node_create_from(node_type_t type, size_t n_children, const node_id_t* children);
 
 // Append an element to the given LIST node, returns the list node
-node_t* append_to_list_node(node_t* list_node, node_t* element);
+node_id_t append_to_list_node(node_id_t list_node, node_id_t element);
+
+// Copies the given string into memory owned by the syntax tree.
+// The copy is freed by destroy_syntax_tree
+char* tree_strdup(const char* string);
 
 // Outputs the entire syntax tree to the terminal
 void print_syntax_tree(void);
@@ -58,7 +145,7 @@ void constant_fold_syntax_tree(void);
 // Also ensures all functions return
 void remove_unreachable_code_syntax_tree(void);
 
-// Cleans up the entire syntax tree
+// Cleans up the entire syntax tree, and every node ever created with node_create
 void destroy_syntax_tree(void);
 
 // Special function used when syntax trees are output as graphviz graphs.
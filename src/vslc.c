@@ -1,21 +1,82 @@
 #include "vslc.h"
 
+#include <errno.h>
+#include <fcntl.h>
 #include <getopt.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 static bool print_full_tree = false;
 static bool print_simplified_tree = false;
 static bool print_symbol_table_contents = false;
+static bool print_binary_ast = false;
+static bool print_ir_contents = false;
 static bool print_generated_assembly = false;
 
-static const char* usage = "Compiler for VSL. The input program is read from stdin."
+static const char* input_file = NULL;  // If NULL, the input is read from stdin
+static const char* output_file = NULL; // If NULL, the output is written to stdout
+
+// In batch mode, every input file is compiled on its own, into an output file next to it
+static bool batch_mode = false;
+static char** batch_files = NULL;
+static size_t n_batch_files = 0;
+// The number of compilations to run at once in batch mode, or the number of functions to simplify
+// and generate at once otherwise. 0 means it was not given, which is one per processor in batch
+// mode, and 1 otherwise
+static long n_threads = 0;
+
+// With -ftime-report, the time and work of each phase is reported on stderr, as text or JSON
+static bool print_time_report_text = false;
+static bool print_time_report_json = false;
+
+// With --cache-dir, the code of every function is kept in the directory, and reused by later
+// compilations for as long as the function does not change. See function_cache.h
+static const char* cache_directory = NULL;
+
+static const char* usage = "Compiler for VSL. The input program is read from the given file,"
+                           "\n"
+                           "or from stdin if no file is given. A binary syntax tree written"
+                           "\n"
+                           "with -a is loaded instead of parsed, and can be given instead."
                            "\n"
+                           "Usage: vslc [options] [file.vsl]\n"
+                           "       vslc [options] --batch [-j <n>] file.vsl...\n"
                            "Options:\n"
                            "\t -h \t Output this text and exit\n"
                            "\t -t \t Output the abstract syntax tree\n"
                            "\t -T \t Output the abstract syntax tree after constant folding\n"
                            "\t    \t and removing unreachable code\n"
                            "\t -s \t Output the symbol table contents\n"
-                           "\t -c \t Compile and print assembly output\n";
+                           "\t -a \t Output the bound syntax tree as a binary syntax tree\n"
+                           "\t -ir \t Output the intermediate representation of every function\n"
+                           "\t -c \t Compile and print assembly output\n"
+                           "\t -o <file> \t Write the output to the given file instead of stdout\n"
+                           "\t --batch \t Compile every given file on its own, in parallel.\n"
+                           "\t         \t The output of file.vsl is written to file.S with -c,\n"
+                           "\t         \t file.ir with -ir, file.symbols with -s,\n"
+                           "\t         \t file.vast with -a,\n"
+                           "\t         \t and file.ast otherwise. Files with errors are\n"
+                           "\t         \t reported and left out, and the exit status is 1\n"
+                           "\t -j <n> \t Run at most n compilations at once in batch mode,\n"
+                           "\t        \t which defaults to the number of processors.\n"
+                           "\t        \t Otherwise, simplify and generate code for up to\n"
+                           "\t        \t n functions at once, which defaults to 1\n"
+                           "\t -ftime-report \t Report the time and work of each phase on stderr\n"
+                           "\t -ftime-report=json \t The same report, as one line of JSON\n"
+                           "\t --cache-dir <dir> \t Keep the code of each function in dir,\n"
+                           "\t                   \t and reuse it while the function is unchanged\n";
+
+// Long options may be given with either - or --
+static const struct option long_options[] = {
+    {"batch", no_argument, NULL, 'b'},
+    {"ir", no_argument, NULL, 'i'},
+    {"ftime-report", optional_argument, NULL, 'f'},
+    {"cache-dir", required_argument, NULL, 'd'},
+    {NULL, 0, NULL, 0},
+};
 
 // Command line option parsing
 static void options(int argc, char** argv)
@@ -28,7 +89,7 @@ static void options(int argc, char** argv)
 
   while (true)
   {
-    switch (getopt(argc, argv, "htTsc"))
+    switch (getopt_long_only(argc, argv, "htTsaco:j:", long_options, NULL))
     {
     default: // Unrecognized option
       fprintf(stderr, "%s: See -h for help\n", argv[0]);
@@ -45,42 +106,338 @@ static void options(int argc, char** argv)
     case 's':
       print_symbol_table_contents = true;
       break;
+    case 'a':
+      print_binary_ast = true;
+      break;
+    case 'i':
+      print_ir_contents = true;
+      break;
     case 'c':
       print_generated_assembly = true;
       break;
+    case 'o':
+      output_file = optarg;
+      break;
+    case 'b':
+      batch_mode = true;
+      break;
+    case 'f':
+      if (optarg == NULL)
+        print_time_report_text = true;
+      else if (strcmp(optarg, "json") == 0)
+        print_time_report_json = true;
+      else
+      {
+        fprintf(
+            stderr, "%s: unknown -ftime-report format '%s'. See -h for help\n", argv[0], optarg);
+        exit(EXIT_FAILURE);
+      }
+      break;
+    case 'd':
+      cache_directory = optarg;
+      break;
+    case 'j':
+      n_threads = strtol(optarg, NULL, 10);
+      if (n_threads < 1)
+      {
+        fprintf(stderr, "%s: -j expects a positive number. See -h for help\n", argv[0]);
+        exit(EXIT_FAILURE);
+      }
+      break;
     case -1:
-      return; // Done parsing options
+      // Done parsing options. In batch mode, all remaining arguments are input files
+      if (batch_mode)
+      {
+        if (output_file != NULL || optind == argc)
+        {
+          fprintf(stderr, "%s: --batch takes input files, and no -o. See -h for help\n", argv[0]);
+          exit(EXIT_FAILURE);
+        }
+        batch_files = &argv[optind];
+        n_batch_files = argc - optind;
+        return;
+      }
+
+      // Otherwise, at most one input file may follow
+      if (optind < argc)
+        input_file = argv[optind++];
+      if (optind < argc)
+      {
+        fprintf(stderr, "%s: expected at most one input file. See -h for help\n", argv[0]);
+        exit(EXIT_FAILURE);
+      }
+      return;
     }
   }
 }
 
-// Entry point
-int main(int argc, char** argv)
+// An input file, as given to flex. When the file is memory mapped, size is the size
+// of the mapping, otherwise the buffer is a heap allocation
+typedef struct input_buffer
 {
-  options(argc, argv);
+  char* buffer;
+  size_t size;
+  bool is_mapped;
+} input_buffer_t;
+
+// Reads the input file for the scanner, without copying it through stdio.
+// Flex scans a buffer in place as long as the last two bytes are NUL, so the file is memory mapped
+// with two extra bytes. Bytes past the end of the file, up to the end of its last page, read as 0.
+// The mapping is private and writable, since flex temporarily writes NUL bytes into the buffer.
+// Returns false if the file could not be read, after saying so on stderr
+static bool open_input_file(input_buffer_t* input, const char* path)
+{
+  int fd = open(path, O_RDONLY);
+  struct stat file_stat;
+  if (fd < 0 || fstat(fd, &file_stat) != 0)
+  {
+    fprintf(stderr, "error: could not open input file '%s'\n", path);
+    if (fd >= 0)
+      close(fd);
+    return false;
+  }
 
-  yyparse();       // Generated from grammar/bison, constructs syntax tree
-  yylex_destroy(); // Free buffers used by flex
+  size_t file_size = file_stat.st_size;
+  size_t page_size = sysconf(_SC_PAGESIZE);
+  size_t tail = file_size % page_size;
+  *input = (input_buffer_t){.buffer = NULL, .size = file_size + 2, .is_mapped = false};
 
-  // Operations in tree.c
-  if (print_full_tree)
-    print_syntax_tree();
+  // The two NUL bytes fit in the last page, unless the file ends less than two bytes before
+  // a page boundary
+  if (tail != 0 && tail <= page_size - 2)
+  {
+    input->buffer = mmap(NULL, input->size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    input->is_mapped = input->buffer != MAP_FAILED;
+  }
+
+  // Otherwise, or if mapping failed, read the file into a buffer with the NUL bytes added
+  if (!input->is_mapped)
+  {
+    input->buffer = malloc(input->size);
+    size_t position = 0;
+    while (position < file_size)
+    {
+      ssize_t n_read = read(fd, input->buffer + position, file_size - position);
+      if (n_read <= 0)
+      {
+        fprintf(stderr, "error: could not read input file '%s'\n", path);
+        free(input->buffer);
+        close(fd);
+        return false;
+      }
+      position += n_read;
+    }
+    input->buffer[file_size] = '\0';
+    input->buffer[file_size + 1] = '\0';
+  }
+
+  close(fd);
+  return true;
+}
+
+// Releases the input file mapping or buffer
+static void close_input_file(input_buffer_t* input)
+{
+  if (input->is_mapped)
+    munmap(input->buffer, input->size);
+  else
+    free(input->buffer);
+  input->buffer = NULL;
+}
 
-  constant_fold_syntax_tree();
-  remove_unreachable_code_syntax_tree();
+// Opens the output file, or uses stdout if the path is NULL.
+// The output sink of the compilation collects the output, and writes it in large chunks.
+// Returns NULL if the file could not be opened, after saying so on stderr
+static FILE* open_output_file(const char* path)
+{
+  FILE* output = path == NULL ? stdout : fopen(path, "w");
+  if (output == NULL)
+    fprintf(stderr, "error: could not open output file '%s'\n", path);
+  return output;
+}
 
-  if (print_simplified_tree)
-    print_syntax_tree();
+// Compiles one program, from the input path to the output path, on the current thread.
+// If the input path is NULL, the program is read from stdin.
+// If the output path is NULL, the output is written to stdout.
+// Errors in the program are printed to stderr, and end the process, except in batch mode, where
+// they are printed as file:line: message. Returns false if the program could not be compiled,
+// or its output could not be written
+static bool compile_file(const char* input_path, const char* output_path)
+{
+  input_buffer_t input;
+  if (input_path != NULL && !open_input_file(&input, input_path))
+    return false;
+  FILE* output = open_output_file(output_path);
+  if (output == NULL)
+  {
+    if (input_path != NULL)
+      close_input_file(&input);
+    return false;
+  }
 
-  // Operations in symbols.c
-  create_tables();
-  if (print_symbol_table_contents)
-    print_tables();
+  compilation_t state = {0};
+  compilation = &state;
+  state.function_cache.directory = cache_directory;
+  state.n_threads = batch_mode ? 1 : n_threads; // Batch compilations already use every thread
+  sink_init(&state.output, output);
 
-  // Operations in generator.c
-  if (print_generated_assembly)
-    generate_program();
+  // In batch mode, errors jump back here, so one bad file does not stop the others
+  jmp_buf error_handler;
+  if (batch_mode)
+    state.error_handler = &error_handler;
+
+  yyscan_t scanner;
+  yylex_init(&scanner);
+  if (input_path != NULL)
+    yy_scan_buffer(input.buffer, input.size, scanner);
+
+  int outputs = (print_full_tree ? VSLC_OUTPUT_AST : 0)
+                | (print_simplified_tree ? VSLC_OUTPUT_SIMPLIFIED_AST : 0)
+                | (print_symbol_table_contents ? VSLC_OUTPUT_SYMBOLS : 0)
+                | (print_binary_ast ? VSLC_OUTPUT_BINARY_AST : 0)
+                | (print_ir_contents ? VSLC_OUTPUT_IR : 0)
+                | (print_generated_assembly ? VSLC_OUTPUT_ASSEMBLY : 0);
+
+  // In compilation.c. The mapped file is loaded in place if it is a binary syntax tree
+  if (setjmp(error_handler) == 0)
+  {
+    if (input_path != NULL && is_binary_ast(input.buffer, input.size - 2))
+      compile_binary_ast(input.buffer, input.size - 2, outputs);
+    else
+      compile_program(scanner, outputs);
+  }
+
+  yylex_destroy(scanner); // Free buffers used by flex
+  if (input_path != NULL)
+    close_input_file(&input);
+
+  const char* input_name = input_path != NULL ? input_path : "stdin";
+  bool compiled = state.error.kind == VSLC_OK;
+  if (!compiled && state.error.line > 0)
+    fprintf(stderr, "%s:%d: %s\n", input_name, state.error.line, state.error.message);
+  else if (!compiled)
+    fprintf(stderr, "%s: %s\n", input_name, state.error.message);
+
+  // If the environment variable HASHMAP_STATISTICS is set, report how the symbol hashmaps did
+  if (compiled && getenv("HASHMAP_STATISTICS") != NULL)
+    print_symbol_hashmap_statistics(stderr);
+
+  if (compiled && print_time_report_text)
+    print_time_report(stderr, input_name, false);
+  if (compiled && print_time_report_json)
+    print_time_report(stderr, input_name, true);
+
+  destroy_compilation(); // In compilation.c
+
+  bool written = sink_flush(&state.output);
+  sink_destroy(&state.output);
+  if (fclose(output) != 0 || !written)
+  {
+    fprintf(stderr, "error: could not write output '%s'\n", output_path ? output_path : "stdout");
+    compiled = false;
+  }
+  compilation = NULL;
+  return compiled;
+}
+
+// Makes the output path for an input file in batch mode, by replacing its .vsl extension
+static char* batch_output_path(const char* input_path)
+{
+  const char* extension = print_generated_assembly      ? ".S"
+                          : print_ir_contents           ? ".ir"
+                          : print_symbol_table_contents ? ".symbols"
+                          : print_binary_ast            ? ".vast"
+                                                        : ".ast";
+  size_t length = strlen(input_path);
+  if (length >= 4 && strcmp(input_path + length - 4, ".vsl") == 0)
+    length -= 4;
+
+  char* output_path = malloc(length + strlen(extension) + 1);
+  memcpy(output_path, input_path, length);
+  strcpy(output_path + length, extension);
+  return output_path;
+}
+
+// The index of the next batch file that no thread has started compiling
+static atomic_size_t next_batch_file = 0;
+// The number of batch files that could not be compiled
+static atomic_size_t n_failed_batch_files = 0;
+
+// Each batch worker thread keeps taking the next file, until all files are taken.
+// The output is written to a temporary file next to the output file, which only replaces the
+// output file once the whole program is compiled, so no file is left half written
+static void* batch_worker(void* unused)
+{
+  (void)unused;
+  size_t index;
+  while ((index = atomic_fetch_add(&next_batch_file, 1)) < n_batch_files)
+  {
+    char* output_path = batch_output_path(batch_files[index]);
+    size_t length = strlen(output_path) + 64;
+    char* temporary_path = malloc(length);
+    snprintf(temporary_path, length, "%s.%ld.%zu.tmp", output_path, (long)getpid(), index);
+
+    bool compiled = compile_file(batch_files[index], temporary_path);
+    if (compiled && rename(temporary_path, output_path) != 0)
+    {
+      fprintf(stderr, "error: could not write output '%s'\n", output_path);
+      compiled = false;
+    }
+    if (!compiled)
+    {
+      remove(temporary_path);
+      atomic_fetch_add(&n_failed_batch_files, 1);
+    }
+    free(temporary_path);
+    free(output_path);
+  }
+  return NULL;
+}
+
+// Compiles all batch files, using up to n_threads threads.
+// Files with errors are reported, and do not stop the others.
+// Returns false if any of the files could not be compiled
+static bool compile_batch(void)
+{
+  if ((size_t)n_threads > n_batch_files)
+    n_threads = n_batch_files;
+
+  // The main thread is one of the workers
+  pthread_t* threads = malloc(n_threads * sizeof(pthread_t));
+  for (long i = 1; i < n_threads; i++)
+  {
+    if (pthread_create(&threads[i], NULL, batch_worker, NULL) != 0)
+    {
+      fprintf(stderr, "error: could not start compilation thread\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  batch_worker(NULL);
+  for (long i = 1; i < n_threads; i++)
+    pthread_join(threads[i], NULL);
+  free(threads);
+  return atomic_load(&n_failed_batch_files) == 0;
+}
+
+// Entry point
+int main(int argc, char** argv)
+{
+  options(argc, argv);
+
+  // By default, batch mode has one thread for each processor, and a single file is compiled on
+  // one thread. Functions are never given more threads than there are functions
+  if (n_threads == 0 && batch_mode)
+    n_threads = sysconf(_SC_NPROCESSORS_ONLN);
+  if (n_threads < 1)
+    n_threads = 1;
+
+  // The cache directory is made if it does not exist yet
+  if (cache_directory != NULL && mkdir(cache_directory, 0777) != 0 && errno != EEXIST)
+  {
+    fprintf(stderr, "error: could not make cache directory '%s'\n", cache_directory);
+    exit(EXIT_FAILURE);
+  }
 
-  destroy_tables();      // In symbols.c
-  destroy_syntax_tree(); // In tree.c
+  bool compiled = batch_mode ? compile_batch() : compile_file(input_file, output_file);
+  return compiled ? EXIT_SUCCESS : EXIT_FAILURE;
 }
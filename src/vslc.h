@@ -11,16 +11,38 @@
 // Definition of the tree node type, and functions for handling the parse tree
 #include "tree.h"
 
+// The intern table, giving every identifier one canonical copy
+#include "intern.h"
+
+// All state of one compilation, and the compilation active on the current thread
+#include "compilation.h"
+
 // Definition of the symbol table, and functions for building it
 #include "symbols.h"
 
-// Function for generating machine code, in generator.c
+// Writing and loading the bound syntax tree in a binary format, instead of parsing again
+#include "binary_ast.h"
+
+// Threads taking turns at independent tasks, used for simplifying and generating functions in
+// parallel
+#include "work_pool.h"
+
+// Function for generating machine code, in generator.c.
+// Functions are generated on up to compilation->n_threads threads
 void generate_program(void);
 
-// The main driver function of the parser generated by bison
-int yyparse();
+// The main driver function of the parser, generated by bison or hand-written, reading tokens from
+// the scanner
+int yyparse(yyscan_t scanner);
+
+// Creation and cleanup functions of the flex scanner
+int yylex_init(yyscan_t* scanner);
+int yylex_destroy(yyscan_t scanner);
+
+// Makes flex scan the given buffer in place. The last two bytes of the buffer must be NUL
+struct yy_buffer_state* yy_scan_buffer(char* base, size_t size, yyscan_t scanner);
 
-// A "hidden" cleanup function in flex
-int yylex_destroy();
+// The line the scanner is currently reading
+int yyget_lineno(yyscan_t scanner);
 
 #endif // VSLC_H
@@ -0,0 +1,110 @@
+#include "work_pool.h"
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Helpers for the two halves of a range
+#define RANGE(begin, end) (((uint64_t)(end) << 32) | (uint32_t)(begin))
+#define RANGE_BEGIN(range) ((size_t)(uint32_t)(range))
+#define RANGE_END(range) ((size_t)((range) >> 32))
+
+// The arguments of a worker thread
+typedef struct worker_thread
+{
+  pthread_t thread;
+  work_pool_t* pool;
+  size_t worker_index;
+} worker_thread_t;
+
+static void* run_worker_thread(void* argument);
+static bool steal_tasks(work_pool_t* pool, size_t worker_index, size_t* task);
+
+/* External interface */
+
+// Worker i starts with tasks i * n / w up to (i + 1) * n / w
+void work_pool_run(size_t n_tasks, size_t n_workers, work_pool_worker_t worker, void* argument)
+{
+  assert(n_tasks <= UINT32_MAX && n_workers > 0);
+
+  work_pool_t pool = {
+      .ranges = aligned_alloc(alignof(work_range_t), n_workers * sizeof(work_range_t)),
+      .n_workers = n_workers,
+      .worker = worker,
+      .argument = argument};
+  for (size_t i = 0; i < n_workers; i++)
+  {
+    uint64_t range = RANGE(i * n_tasks / n_workers, (i + 1) * n_tasks / n_workers);
+    atomic_init(&pool.ranges[i].range, range);
+  }
+
+  worker_thread_t* threads = malloc(n_workers * sizeof(worker_thread_t));
+  for (size_t i = 1; i < n_workers; i++)
+  {
+    threads[i] = (worker_thread_t){.pool = &pool, .worker_index = i};
+    if (pthread_create(&threads[i].thread, NULL, run_worker_thread, &threads[i]) != 0)
+    {
+      fprintf(stderr, "error: could not start worker thread\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  worker(&pool, 0, argument);
+  for (size_t i = 1; i < n_workers; i++)
+    pthread_join(threads[i].thread, NULL);
+
+  free(threads);
+  free(pool.ranges);
+}
+
+// Only the worker itself moves the front of its range, while thieves move the end.
+// When they meet over the last task, compare-and-swap decides who gets it
+bool work_pool_next(work_pool_t* pool, size_t worker_index, size_t* task)
+{
+  _Atomic uint64_t* own = &pool->ranges[worker_index].range;
+  uint64_t range = atomic_load(own);
+  while (RANGE_BEGIN(range) < RANGE_END(range))
+  {
+    uint64_t taken = RANGE(RANGE_BEGIN(range) + 1, RANGE_END(range));
+    if (atomic_compare_exchange_weak(own, &range, taken))
+    {
+      *task = RANGE_BEGIN(range);
+      return true;
+    }
+  }
+  return steal_tasks(pool, worker_index, task);
+}
+
+/* Internal matters */
+
+static void* run_worker_thread(void* argument)
+{
+  worker_thread_t* thread = argument;
+  work_pool_t* pool = thread->pool;
+  pool->worker(pool, thread->worker_index, pool->argument);
+  return NULL;
+}
+
+// Looks through the other workers, starting with the next one, and steals the back half of the
+// first range that is not empty. The first stolen task is returned, and the rest become the range
+// of the thief. Its own range is empty, so no other worker changes it in the meantime
+static bool steal_tasks(work_pool_t* pool, size_t worker_index, size_t* task)
+{
+  for (size_t i = 1; i < pool->n_workers; i++)
+  {
+    _Atomic uint64_t* victim = &pool->ranges[(worker_index + i) % pool->n_workers].range;
+    uint64_t range = atomic_load(victim);
+    while (RANGE_BEGIN(range) < RANGE_END(range))
+    {
+      size_t begin = RANGE_BEGIN(range), end = RANGE_END(range);
+      size_t middle = end - (end - begin + 1) / 2;
+      if (atomic_compare_exchange_weak(victim, &range, RANGE(begin, middle)))
+      {
+        *task = middle;
+        atomic_store(&pool->ranges[worker_index].range, RANGE(middle + 1, end));
+        return true;
+      }
+    }
+  }
+  return false;
+}
@@ -0,0 +1,42 @@
+#ifndef WORK_POOL_H
+#define WORK_POOL_H
+
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// A work pool runs a number of independent tasks, numbered from 0, on several threads at once.
+// Every worker starts out owning an equal share of the tasks, as a range of task numbers, and
+// takes tasks from the front of its own range. A worker that runs out steals the back half of
+// the range of another worker, so tasks of very uneven size still keep every worker busy.
+
+// The tasks a worker has left, kept in one word so it can be changed with compare-and-swap.
+// The first task is in the low 32 bits, and the end of the range in the high 32 bits.
+// Each range is on a cache line of its own, so workers taking tasks do not slow each other down
+typedef struct work_range
+{
+  alignas(64) _Atomic uint64_t range;
+} work_range_t;
+
+typedef struct work_pool
+{
+  work_range_t* ranges; // One per worker
+  size_t n_workers;
+  void (*worker)(struct work_pool* pool, size_t worker_index, void* argument);
+  void* argument;
+} work_pool_t;
+
+// The function run by every worker. It should take tasks with work_pool_next until there are none
+typedef void (*work_pool_worker_t)(work_pool_t* pool, size_t worker_index, void* argument);
+
+// Runs the worker function on n_workers threads, and returns once all of them are done.
+// The calling thread is worker 0, so n_workers - 1 threads are started
+void work_pool_run(size_t n_tasks, size_t n_workers, work_pool_worker_t worker, void* argument);
+
+// Takes the next task of the given worker, stealing one from another worker if it has none left.
+// Returns false once no worker has tasks left
+bool work_pool_next(work_pool_t* pool, size_t worker_index, size_t* task);
+
+#endif // WORK_POOL_H
@@ -0,0 +1,32 @@
+# Writes the input as a binary syntax tree with vslc -a, loads it again with the given option, and
+# fails unless the output is exactly what the same option gives for the input itself.
+# Usage:
+# cmake -DVSLC=<vslc> -DOPTION=<option> -DINPUT=<in.vsl> -DBINARY_AST=<out.vast>
+#       -P binary_ast_round_trip.cmake
+
+execute_process(COMMAND "${VSLC}" -a
+                INPUT_FILE "${INPUT}"
+                OUTPUT_FILE "${BINARY_AST}"
+                RESULT_VARIABLE RESULT)
+if (NOT RESULT EQUAL 0)
+  message(FATAL_ERROR "vslc -a failed on ${INPUT}")
+endif()
+
+execute_process(COMMAND "${VSLC}" ${OPTION}
+                INPUT_FILE "${INPUT}"
+                OUTPUT_VARIABLE EXPECTED_OUTPUT
+                RESULT_VARIABLE RESULT)
+if (NOT RESULT EQUAL 0)
+  message(FATAL_ERROR "vslc ${OPTION} failed on ${INPUT}")
+endif()
+
+execute_process(COMMAND "${VSLC}" ${OPTION} "${BINARY_AST}"
+                OUTPUT_VARIABLE OUTPUT
+                RESULT_VARIABLE RESULT)
+if (NOT RESULT EQUAL 0)
+  message(FATAL_ERROR "vslc ${OPTION} failed to load ${BINARY_AST}")
+endif()
+
+if (NOT OUTPUT STREQUAL EXPECTED_OUTPUT)
+  message(FATAL_ERROR "The output of vslc ${OPTION} on ${BINARY_AST} differs from that on ${INPUT}")
+endif()
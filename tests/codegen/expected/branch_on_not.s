@@ -0,0 +1,90 @@
+.section .rodata
+intout: .asciz "%ld"
+strout: .asciz "%s"
+errout: .asciz "Wrong number of arguments"
+.section .bss
+.align 8
+.text
+.main:
+	pushq %rbp
+	movq %rsp, %rbp
+	movq %rdi, %rcx
+	cmpq %rsi, %rcx
+	jl .main.ELSE0
+.main.THEN0:
+	movq $10, %rdi
+	jmp .main.ENDIF0
+.main.ELSE0:
+	movq $20, %rdi
+.main.ENDIF0:
+.main.WHILE0:
+	cmpq %rcx, %rdi
+	jge .main.ENDWHILE0
+.main.DO0:
+	addq $1, %rdi
+	jmp .main.WHILE0
+.main.ENDWHILE0:
+	cmpq %rsi, %rcx
+	je .main.ENDIF1
+.main.THEN1:
+	movq %rdi, %rax
+	jmp .main.epilogue
+.main.ENDIF1:
+	cmpq %rsi, %rcx
+	setg %cl
+	movzbq %cl, %rcx
+	cmpq $0, %rcx
+	sete %cl
+	movzbq %cl, %rcx
+	movq %rcx, %rax
+.main.epilogue:
+	movq %rbp, %rsp
+	popq %rbp
+	ret
+main:
+	pushq %rbp
+	movq %rsp, %rbp
+	subq $1, %rdi
+	cmpq $2, %rdi
+	jne ABORT
+	addq $16, %rsi
+	movq %rdi, %rcx
+PARSE_ARGV:
+	pushq %rsi
+	pushq %rcx
+	movq (%rsi), %rdi
+	movq $0, %rsi
+	movq $10, %rdx
+	call strtol
+	popq %rcx
+	popq %rsi
+	pushq %rax
+	subq $8, %rsi
+	loop PARSE_ARGV
+	popq %rdi
+	popq %rsi
+	call .main
+	movq %rax, %rdi
+	call exit
+ABORT:
+	leaq errout(%rip), %rdi
+	call puts
+	movq $1, %rdi
+	call exit
+safe_printf:
+	pushq %rbp
+	movq %rsp, %rbp
+	andq $-16, %rsp
+	call printf
+	movq %rbp, %rsp
+	popq %rbp
+	ret
+safe_putchar:
+	pushq %rbp
+	movq %rsp, %rbp
+	andq $-16, %rsp
+	call putchar
+	movq %rbp, %rsp
+	popq %rbp
+	ret
+.global main
@@ -0,0 +1,114 @@
+.section .rodata
+intout: .asciz "%ld"
+strout: .asciz "%s"
+errout: .asciz "Wrong number of arguments"
+.section .bss
+.align 8
+.text
+.main:
+	pushq %rbp
+	movq %rsp, %rbp
+	pushq %rbx
+	pushq %r12
+	pushq %r13
+	pushq %r14
+	pushq %r15
+	subq $16, %rsp
+	movq %rdi, %rcx
+	movq %rcx, %rbx
+	addq $1, %rbx
+	movq %rcx, %r12
+	addq $2, %r12
+	movq %rcx, %r13
+	addq $3, %r13
+	movq %rcx, %r14
+	addq $4, %r14
+	movq %rcx, %r15
+	addq $5, %r15
+	movq %rcx, %rax
+	addq $6, %rax
+	movq %rax, -48(%rbp)
+	movq %rcx, %rax
+	addq $7, %rax
+	movq %rax, -56(%rbp)
+	movq %rcx, %rdi
+	call .next
+	movq %rax, %rcx
+	movq %rcx, %rsi
+	leaq intout(%rip), %rdi
+	call safe_printf
+	movq $'\n', %rdi
+	call safe_putchar
+	movq %rbx, %rcx
+	addq %r12, %rcx
+	addq %r13, %rcx
+	addq %r14, %rcx
+	addq %r15, %rcx
+	addq -48(%rbp), %rcx
+	addq -56(%rbp), %rcx
+	movq %rcx, %rax
+.main.epilogue:
+	leaq -40(%rbp), %rsp
+	popq %r15
+	popq %r14
+	popq %r13
+	popq %r12
+	popq %rbx
+	popq %rbp
+	ret
+.next:
+	pushq %rbp
+	movq %rsp, %rbp
+	movq %rdi, %rcx
+	addq $1, %rcx
+	movq %rcx, %rax
+.next.epilogue:
+	movq %rbp, %rsp
+	popq %rbp
+	ret
+main:
+	pushq %rbp
+	movq %rsp, %rbp
+	subq $1, %rdi
+	cmpq $1, %rdi
+	jne ABORT
+	addq $8, %rsi
+	movq %rdi, %rcx
+PARSE_ARGV:
+	pushq %rsi
+	pushq %rcx
+	movq (%rsi), %rdi
+	movq $0, %rsi
+	movq $10, %rdx
+	call strtol
+	popq %rcx
+	popq %rsi
+	pushq %rax
+	subq $8, %rsi
+	loop PARSE_ARGV
+	popq %rdi
+	call .main
+	movq %rax, %rdi
+	call exit
+ABORT:
+	leaq errout(%rip), %rdi
+	call puts
+	movq $1, %rdi
+	call exit
+safe_printf:
+	pushq %rbp
+	movq %rsp, %rbp
+	andq $-16, %rsp
+	call printf
+	movq %rbp, %rsp
+	popq %rbp
+	ret
+safe_putchar:
+	pushq %rbp
+	movq %rsp, %rbp
+	andq $-16, %rsp
+	call putchar
+	movq %rbp, %rsp
+	popq %rbp
+	ret
+.global main
@@ -0,0 +1,60 @@
+.section .rodata
+intout: .asciz "%ld"
+strout: .asciz "%s"
+errout: .asciz "Wrong number of arguments"
+.string1:
+	.asciz "+G4;<=Zjt1WY30#-shared"
+.string0:
+	.asciz "collidestringsA-shared"
+.section .bss
+.align 8
+.text
+.main:
+	pushq %rbp
+	movq %rsp, %rbp
+	leaq strout(%rip), %rdi
+	leaq .string0(%rip), %rsi
+	call safe_printf
+	movq $'\n', %rdi
+	call safe_putchar
+	leaq strout(%rip), %rdi
+	leaq .string1(%rip), %rsi
+	call safe_printf
+	movq $'\n', %rdi
+	call safe_putchar
+	xorl %eax, %eax
+.main.epilogue:
+	movq %rbp, %rsp
+	popq %rbp
+	ret
+main:
+	pushq %rbp
+	movq %rsp, %rbp
+	subq $1, %rdi
+	cmpq $0, %rdi
+	jne ABORT
+	call .main
+	movq %rax, %rdi
+	call exit
+ABORT:
+	leaq errout(%rip), %rdi
+	call puts
+	movq $1, %rdi
+	call exit
+safe_printf:
+	pushq %rbp
+	movq %rsp, %rbp
+	andq $-16, %rsp
+	call printf
+	movq %rbp, %rsp
+	popq %rbp
+	ret
+safe_putchar:
+	pushq %rbp
+	movq %rsp, %rbp
+	andq $-16, %rsp
+	call putchar
+	movq %rbp, %rsp
+	popq %rbp
+	ret
+.global main
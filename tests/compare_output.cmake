@@ -0,0 +1,17 @@
+# Runs vslc with the given option on the input, and fails unless the output is exactly as expected.
+# VSLC may also be a test program reading its input the same way, which may need no option.
+# Usage:
+# cmake -DVSLC=<vslc> [-DOPTION=<option>] -DINPUT=<in.vsl> -DEXPECTED=<file> -P compare_output.cmake
+
+execute_process(COMMAND "${VSLC}" ${OPTION}
+                INPUT_FILE "${INPUT}"
+                OUTPUT_VARIABLE OUTPUT
+                RESULT_VARIABLE RESULT)
+if (NOT RESULT EQUAL 0)
+  message(FATAL_ERROR "vslc ${OPTION} failed on ${INPUT}")
+endif()
+
+file(READ "${EXPECTED}" EXPECTED_OUTPUT)
+if (NOT OUTPUT STREQUAL EXPECTED_OUTPUT)
+  message(FATAL_ERROR "The output of vslc ${OPTION} on ${INPUT} differs from ${EXPECTED}")
+endif()
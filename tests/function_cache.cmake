@@ -0,0 +1,59 @@
+# Compiles the programs in tests/function_cache one after the other, sharing a function cache, and
+# fails unless each function hits or misses the cache as it should, and the code is the same as
+# without the cache.
+# Usage:
+# cmake -DVSLC=<vslc> -DPROGRAMS=<dir> -DCACHE=<dir> -P function_cache.cmake
+
+file(REMOVE_RECURSE "${CACHE}")
+
+# Compiles the program with the cache, and checks the hits and misses in the time report
+function(compile_cached NAME HITS MISSES)
+  set(INPUT "${PROGRAMS}/${NAME}.vsl")
+  execute_process(COMMAND "${VSLC}" -c
+                  INPUT_FILE "${INPUT}"
+                  OUTPUT_VARIABLE EXPECTED_OUTPUT
+                  RESULT_VARIABLE RESULT)
+  if (NOT RESULT EQUAL 0)
+    message(FATAL_ERROR "vslc -c failed on ${INPUT}")
+  endif()
+
+  execute_process(COMMAND "${VSLC}" -c --cache-dir "${CACHE}" -ftime-report=json
+                  INPUT_FILE "${INPUT}"
+                  OUTPUT_VARIABLE OUTPUT
+                  ERROR_VARIABLE REPORT
+                  RESULT_VARIABLE RESULT)
+  if (NOT RESULT EQUAL 0)
+    message(FATAL_ERROR "vslc -c --cache-dir failed on ${INPUT}")
+  endif()
+  if (NOT OUTPUT STREQUAL EXPECTED_OUTPUT)
+    message(FATAL_ERROR "The code of ${INPUT} differs when taken from the cache")
+  endif()
+
+  string(REGEX MATCH "\"cache_hits\": ([0-9]+)" MATCH "${REPORT}")
+  set(FOUND_HITS "${CMAKE_MATCH_1}")
+  string(REGEX MATCH "\"cache_misses\": ([0-9]+)" MATCH "${REPORT}")
+  set(FOUND_MISSES "${CMAKE_MATCH_1}")
+  if (NOT FOUND_HITS STREQUAL HITS OR NOT FOUND_MISSES STREQUAL MISSES)
+    message(FATAL_ERROR "${INPUT} had ${FOUND_HITS} hits and ${FOUND_MISSES} misses, "
+                        "instead of ${HITS} hits and ${MISSES} misses")
+  endif()
+endfunction()
+
+# Every function misses at first, and hits the next time
+compile_cached(original 0 3)
+compile_cached(original 3 0)
+
+# Only the edited function misses. The entry of the function before the edit is still there
+compile_cached(edited 2 1)
+compile_cached(original 3 0)
+
+# scale takes a third parameter, but main still calls it with two. main must miss the cache,
+# otherwise its cached code would hide the error
+execute_process(COMMAND "${VSLC}" -c --cache-dir "${CACHE}"
+                INPUT_FILE "${PROGRAMS}/parameters.vsl"
+                OUTPUT_QUIET
+                ERROR_VARIABLE ERROR
+                RESULT_VARIABLE RESULT)
+if (RESULT EQUAL 0 OR NOT ERROR MATCHES "function 'scale' expects '3' arguments")
+  message(FATAL_ERROR "The call of scale in parameters.vsl was taken from the cache")
+endif()
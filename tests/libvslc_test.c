@@ -0,0 +1,208 @@
+// Test of the library interface in libvslc.h.
+//
+// Programs are compiled with vslc_compile, and every result is checked against what it should
+// be: the kind of error, its line and message, and whether there is output. Errors must leave no
+// output behind, and compilations after an error must work as before. A binary syntax tree
+// written by the library is loaded by it again, and a damaged one is reported. Finally, the same
+// programs are compiled on several threads at once, which must give the same results.
+//
+// Usage: libvslc_test
+
+#include "libvslc.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A program, and the result of compiling it into assembly
+typedef struct test_case
+{
+  const char* name;
+  const char* source;
+  vslc_error_kind_t kind;
+  int line;
+  const char* message; // The whole message, or NULL if there is no error
+} test_case_t;
+
+static const test_case_t CASES[] = {
+    {"valid program",
+     "func main() {\n  print \"hi\", 1 + 2\n  return 0\n}\n",
+     VSLC_OK,
+     0,
+     NULL},
+    {"syntax error",
+     "func main() {\n  print 1 +\n}\n",
+     VSLC_ERROR_SYNTAX,
+     3,
+     "syntax error on line 3"},
+    {"parameter defined twice",
+     "func main(a, a) {\n  return 0\n}\n",
+     VSLC_ERROR_SYMBOL,
+     0,
+     "symbol 'a' already defined"},
+    {"undefined name",
+     "func main() {\n  return x\n}\n",
+     VSLC_ERROR_SYMBOL,
+     0,
+     "unrecognized symbol 'x'"},
+    {"no functions", "var x\n", VSLC_ERROR_SEMANTIC, 0, "program contained no functions"},
+    {"wrong number of arguments",
+     "func f(a) {\n  return 0\n}\nfunc main() {\n  return f(1, 2)\n}\n",
+     VSLC_ERROR_SEMANTIC,
+     0,
+     "function 'f' expects '1' arguments, but '2' were given"},
+    {"calling a variable",
+     "var x\nfunc main() {\n  return x(1)\n}\n",
+     VSLC_ERROR_SEMANTIC,
+     0,
+     "'x' is not a function"},
+    {"break outside of a loop",
+     "func main() {\n  break\n}\n",
+     VSLC_ERROR_SEMANTIC,
+     0,
+     "break statement outside of a while loop"},
+};
+
+#define N_CASES (sizeof(CASES) / sizeof(CASES[0]))
+
+static size_t n_failures = 0;
+
+// Reports a failed check
+static void fail(const char* name, const char* what)
+{
+  fprintf(stderr, "%s: %s\n", name, what);
+  n_failures++;
+}
+
+// Returns true if the result is what the case should give, and says what is wrong otherwise
+static bool check_result(const test_case_t* test, const vslc_result_t* result)
+{
+  size_t n_failures_before = n_failures;
+  if (result->error.kind != test->kind)
+    fail(test->name, "wrong kind of error");
+  if (result->error.line != test->line)
+    fail(test->name, "wrong line");
+  if (strcmp(result->error.message, test->message != NULL ? test->message : "") != 0)
+    fail(test->name, "wrong message");
+
+  if (test->kind == VSLC_OK
+      && (result->output == NULL || result->output_length == 0
+          || result->output[result->output_length] != '\0'
+          || strlen(result->output) != result->output_length))
+    fail(test->name, "no NUL-terminated output");
+  if (test->kind != VSLC_OK && (result->output != NULL || result->output_length != 0))
+    fail(test->name, "output left after an error");
+  return n_failures == n_failures_before;
+}
+
+// Compiles the source, and returns its assembly, or NULL if it could not be compiled
+static char* compile_to_assembly(const char* source, size_t length)
+{
+  vslc_result_t result = vslc_compile(source, length, VSLC_OUTPUT_ASSEMBLY);
+  return result.output;
+}
+
+// Writes the valid program as a binary syntax tree, loads it again, and damages it
+static void check_binary_ast(void)
+{
+  const test_case_t* test = &CASES[0];
+  const char* name = "binary syntax tree";
+  vslc_result_t written =
+      vslc_compile(test->source, strlen(test->source), VSLC_OUTPUT_BINARY_AST);
+  if (written.error.kind != VSLC_OK || written.output == NULL)
+  {
+    fail(name, "could not be written");
+    vslc_result_free(&written);
+    return;
+  }
+
+  char* expected = compile_to_assembly(test->source, strlen(test->source));
+  char* loaded = compile_to_assembly(written.output, written.output_length);
+  if (expected == NULL || loaded == NULL || strcmp(expected, loaded) != 0)
+    fail(name, "generates different code once loaded");
+  free(expected);
+  free(loaded);
+
+  // Syntax trees can only be printed as they were parsed
+  vslc_result_t tree = vslc_compile(written.output, written.output_length, VSLC_OUTPUT_AST);
+  if (tree.error.kind != VSLC_ERROR_BINARY_AST || tree.output != NULL)
+    fail(name, "printed as parsed");
+  vslc_result_free(&tree);
+
+  // Every shorter file is damaged
+  for (size_t length = 0; length < written.output_length; length++)
+  {
+    vslc_result_t damaged = vslc_compile(written.output, length, VSLC_OUTPUT_ASSEMBLY);
+    if (damaged.error.kind == VSLC_OK || damaged.output != NULL)
+    {
+      fail(name, "cut short, but loaded");
+      vslc_result_free(&damaged);
+      break;
+    }
+    vslc_result_free(&damaged);
+  }
+
+  vslc_result_free(&written);
+  if (written.output != NULL || written.output_length != 0)
+    fail(name, "output left after vslc_result_free");
+}
+
+// Compiles every case a number of times, and counts the results that differ from what they
+// should be. Runs on several threads at once
+static void* compile_cases(void* n_wrong)
+{
+  for (size_t round = 0; round < 50; round++)
+  {
+    for (size_t i = 0; i < N_CASES; i++)
+    {
+      vslc_result_t result =
+          vslc_compile(CASES[i].source, strlen(CASES[i].source), VSLC_OUTPUT_ASSEMBLY);
+      if (result.error.kind != CASES[i].kind
+          || (CASES[i].kind == VSLC_OK) != (result.output != NULL))
+        (*(size_t*)n_wrong)++;
+      vslc_result_free(&result);
+    }
+  }
+  return NULL;
+}
+
+int main(void)
+{
+  // Every case twice, so that compiling after an error is checked too
+  for (size_t round = 0; round < 2; round++)
+  {
+    for (size_t i = 0; i < N_CASES; i++)
+    {
+      const test_case_t* test = &CASES[i];
+      vslc_result_t result =
+          vslc_compile(test->source, strlen(test->source), VSLC_OUTPUT_ASSEMBLY);
+      if (!check_result(test, &result))
+        fprintf(stderr, "%s: got %d on line %d: '%s'\n", test->name, result.error.kind,
+                result.error.line, result.error.message);
+      vslc_result_free(&result);
+    }
+  }
+
+  check_binary_ast();
+
+  pthread_t threads[4];
+  size_t n_wrong[4] = {0};
+  for (size_t i = 0; i < 4; i++)
+    pthread_create(&threads[i], NULL, compile_cases, &n_wrong[i]);
+  for (size_t i = 0; i < 4; i++)
+  {
+    pthread_join(threads[i], NULL);
+    if (n_wrong[i] > 0)
+      fail("threads", "wrong results while compiling at the same time");
+  }
+
+  if (n_failures > 0)
+  {
+    fprintf(stderr, "%zu checks failed\n", n_failures);
+    return EXIT_FAILURE;
+  }
+  printf("Every compilation gave the expected result\n");
+  return EXIT_SUCCESS;
+}
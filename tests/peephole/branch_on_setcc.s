@@ -0,0 +1,24 @@
+	cmpq %rdi, %rsi
+	setl %al
+	movzbq %al, %rax
+	cmpq $0, %rax
+	jne .L0
+	cmpq %rdi, %rsi
+	setge %al
+	movzbq %al, %rax
+	cmpq $0, %rax
+	je .L0
+	cmpq %rdi, %rsi
+	sete %al
+	movzbq %al, %rax
+	cmpq $0, %rcx
+	jne .L0
+	cmpq %rdi, %rsi
+	setne %al
+	movzbq %al, %rax
+	cmpq $1, %rax
+	jne .L1
+.L0:
+	ret
+.L1:
+	ret
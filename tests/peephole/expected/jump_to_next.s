@@ -0,0 +1,9 @@
+.L0:
+.L1:
+.L2:
+	jmp .L3
+	movq %rax, %rcx
+.L3:
+.L4:
+.L5:
+	ret
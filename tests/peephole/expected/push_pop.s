@@ -0,0 +1,10 @@
+	movq %rax, %rcx
+	movq -8(%rbp), %rsi
+	pushq -8(%rbp)
+	popq -16(%rbp)
+	pushq 8(%rsp)
+	popq %rdi
+.L0:
+	pushq %r8
+.L1:
+	popq %r9
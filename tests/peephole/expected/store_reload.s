@@ -0,0 +1,11 @@
+	movq %rax, -8(%rbp)
+	movq %rax, %rcx
+	movq %rdx, %rsi
+	movq -8(%rbp), %rdi
+	movq %rdi, -16(%rbp)
+	movq 8(%rcx), %rcx
+	movq %rcx, %rdx
+.L0:
+	movq %r8, -24(%rbp)
+	movq %r8, %r9
+	movq -24(%rbp), %r10
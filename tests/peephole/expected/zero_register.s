@@ -0,0 +1,17 @@
+	xorl %eax, %eax
+	xorl %r12d, %r12d
+	movq $0, -8(%rbp)
+	movq $1, %rcx
+	cmpq %rdi, %rsi
+	movq $0, %rdx
+	setl %dl
+	cmpq %rdi, %rsi
+	movq $0, %rcx
+	jge .L0
+	cmpq %rdi, %rsi
+	xorl %ecx, %ecx
+	jmp .L1
+.L0:
+	xorl %esi, %esi
+.L1:
+	ret
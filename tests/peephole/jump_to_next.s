@@ -0,0 +1,13 @@
+	jmp .L0
+.L0:
+	jne .L2
+.L1:
+.L2:
+	jmp .L3
+	movq %rax, %rcx
+.L3:
+	jmp .L5
+.L4:
+	jmp .L5
+.L5:
+	ret
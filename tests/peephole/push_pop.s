@@ -0,0 +1,14 @@
+	pushq %rax
+	popq %rcx
+	pushq %rdx
+	popq %rdx
+	pushq -8(%rbp)
+	popq %rsi
+	pushq -8(%rbp)
+	popq -16(%rbp)
+	pushq 8(%rsp)
+	popq %rdi
+.L0:
+	pushq %r8
+.L1:
+	popq %r9
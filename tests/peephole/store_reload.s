@@ -0,0 +1,12 @@
+	movq %rax, -8(%rbp)
+	movq -8(%rbp), %rcx
+	movq %rdx, %rsi
+	movq %rsi, %rdx
+	movq -8(%rbp), %rdi
+	movq %rdi, -16(%rbp)
+	movq 8(%rcx), %rcx
+	movq %rcx, %rdx
+.L0:
+	movq %r8, -24(%rbp)
+	movq -24(%rbp), %r9
+	movq -24(%rbp), %r10
@@ -0,0 +1,17 @@
+	movq $0, %rax
+	movq $0, %r12
+	movq $0, -8(%rbp)
+	movq $1, %rcx
+	cmpq %rdi, %rsi
+	movq $0, %rdx
+	setl %dl
+	cmpq %rdi, %rsi
+	movq $0, %rcx
+	jge .L0
+	cmpq %rdi, %rsi
+	movq $0, %rcx
+	jmp .L1
+.L0:
+	movq $0, %rsi
+.L1:
+	ret
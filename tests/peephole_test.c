@@ -0,0 +1,29 @@
+// Runs the peephole optimizer on the code of one function, and prints what is left of it.
+//
+// The code is read from stdin, with its lines written the way generator.c writes them:
+// instructions start with a tab, and labels do not. With compare_output.cmake, each rule is
+// tested on small pieces of code, against the code expected after it.
+//
+// Usage: peephole_test < code.s
+
+#include "vslc.h"
+
+int main(void)
+{
+  compilation_t state = {0};
+  sink_init(&state.output, stdout);
+  compilation = &state;
+
+  peephole_begin();
+  char buffer[4096];
+  size_t length;
+  while ((length = fread(buffer, 1, sizeof(buffer), stdin)) > 0)
+    sink_write(&compilation->output, buffer, length);
+  peephole_end();
+
+  bool failed = !sink_flush(&compilation->output);
+  sink_destroy(&compilation->output);
+  destroy_peephole();
+  compilation = NULL;
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
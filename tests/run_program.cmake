@@ -0,0 +1,32 @@
+# Compiles the program with vslc, assembles it, and checks the output of every //TESTCASE: in it
+# with vsl_programs/codegen-tester.py. The tester looks for the executable next to the program,
+# so the program is copied into its own directory in the build tree first.
+# Usage:
+# cmake -DVSLC=<vslc> -DCC=<cc> -DPYTHON=<python3> -DTESTER=<codegen-tester.py>
+#       -DINPUT=<in.vsl> -DDIRECTORY=<dir> -P run_program.cmake
+
+get_filename_component(NAME "${INPUT}" NAME_WE)
+file(MAKE_DIRECTORY "${DIRECTORY}")
+file(COPY "${INPUT}" DESTINATION "${DIRECTORY}")
+
+execute_process(COMMAND "${VSLC}" -c
+                INPUT_FILE "${INPUT}"
+                OUTPUT_FILE "${DIRECTORY}/${NAME}.S"
+                RESULT_VARIABLE RESULT)
+if (NOT RESULT EQUAL 0)
+  message(FATAL_ERROR "vslc -c failed on ${INPUT}")
+endif()
+
+execute_process(COMMAND "${CC}" "${DIRECTORY}/${NAME}.S" -o "${DIRECTORY}/${NAME}.out"
+                RESULT_VARIABLE RESULT
+                ERROR_VARIABLE ERRORS)
+if (NOT RESULT EQUAL 0)
+  message(FATAL_ERROR "The code generated for ${INPUT} could not be assembled:\n${ERRORS}")
+endif()
+
+execute_process(COMMAND "${PYTHON}" "${TESTER}" "${DIRECTORY}/${NAME}.vsl"
+                OUTPUT_VARIABLE OUTPUT
+                RESULT_VARIABLE RESULT)
+if (NOT RESULT EQUAL 0)
+  message(FATAL_ERROR "${OUTPUT}")
+endif()
@@ -0,0 +1,232 @@
+// Differential test of the hand-written scanner against the flex scanner.
+//
+// Both scanners read the same input, and every token they hand to the parser is compared:
+// its kind, the line it is on, and the leaf node made for it. The inputs are the files given on
+// the command line, a set of inputs made to trip up a hand-written scanner, and random inputs
+// put together from pieces of VSL.
+//
+// The flex scanner is built from scanner.l with the prefix reference_yy, while the hand-written
+// scanner is the one in libvslc.
+//
+// Usage: scanner_differential_test [file.vsl]...
+
+#include "vslc.h"
+
+// The tokens defined in parser.y
+#include "parser.h"
+
+// The flex scanner, with its functions renamed
+int reference_yylex_init(yyscan_t* scanner);
+int reference_yylex_destroy(yyscan_t scanner);
+struct yy_buffer_state* reference_yy_scan_buffer(char* base, size_t size, yyscan_t scanner);
+int reference_yyget_lineno(yyscan_t scanner);
+int reference_yylex(YYSTYPE* yylval, yyscan_t scanner);
+
+// An input, which may have NUL bytes inside it
+typedef struct test_input
+{
+  const char* text;
+  size_t length;
+} test_input_t;
+
+#define INPUT(text) {(text), sizeof(text) - 1}
+
+// Inputs where the rules of scanner.l are easy to get wrong
+static const test_input_t TRICKY_INPUTS[] = {
+    INPUT(""),
+    INPUT("\n\n\n"),
+    INPUT("//"),
+    INPUT("// comment"),
+    INPUT("//\nx"),
+    INPUT("a//b\nc"),
+    INPUT("a/ /b / /"),
+    INPUT("\"\""),
+    INPUT("\"a\\\"b\""),
+    INPUT("\"a\\\" + \"b\""),
+    INPUT("\"a\\\""),
+    INPUT("\"\\\\\" \"\\\\\\\"\""),
+    INPUT("\"unterminated\nx"),
+    INPUT("\"unterminated at the end"),
+    INPUT("\"\\\""),
+    INPUT("123abc 0099 99999999999999999999999"),
+    INPUT("func funcs funC _func func_ f if i iff do done doo var vars"),
+    INPUT("print return break then else while printer returns breaks thence elsewhere whiles"),
+    INPUT("x\f y"),
+    INPUT("\t\v\r x \r\n y"),
+    INPUT("#$@%^&~`|?:;."),
+    INPUT("\xc3\xa6\xc3\xb8 x"),
+    INPUT("a\0b"),
+    INPUT("// comment with \0 inside\nx"),
+    INPUT("\"string with \0 inside\" x"),
+    INPUT("                                   x\n                                   y"),
+    INPUT("\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\nz"),
+    INPUT("x                "),
+    INPUT("x\n"),
+};
+
+// Pieces that random inputs are put together from
+static const char* PIECES[] = {
+    " ", "  ", "\n", "\t", "\r\n", "                    ", "\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n",
+    "//", "// text", "/", "\"", "\\", "\\\"", "\"text\"", "func", "print", "return", "break",
+    "if", "then", "else", "while", "do", "var", "x", "_y1", "z", "0", "42", "(", ")", "{",
+    "}", "[", "]", ",", "+", "-", "*", "=", "<", ">", "!", "\xff", "\f", "\v",
+};
+
+static size_t n_failures = 0;
+
+// Returns true if the leaf nodes made by the two scanners are the same
+static bool same_leaf(node_id_t a, node_id_t b)
+{
+  if (a == NO_NODE || b == NO_NODE)
+    return a == b;
+
+  node_t* x = node_at(a);
+  node_t* y = node_at(b);
+  if (x->type != y->type)
+    return false;
+  switch (x->type)
+  {
+  case NUMBER_LITERAL:
+    return x->data.number_literal == y->data.number_literal;
+  case IDENTIFIER:
+    return x->data.identifier == y->data.identifier; // Both are interned
+  case STRING_LITERAL:
+    return strcmp(x->data.string_literal, y->data.string_literal) == 0;
+  default:
+    return false;
+  }
+}
+
+// Makes a copy of the input ending with two NUL bytes, as both scanners want it
+static char* scan_buffer(const char* input, size_t length)
+{
+  char* buffer = malloc(length + 2);
+  memcpy(buffer, input, length);
+  buffer[length] = '\0';
+  buffer[length + 1] = '\0';
+  return buffer;
+}
+
+// Scans the input with both scanners, and reports the first token where they differ
+static void compare_scanners(const char* name, const char* input, size_t length)
+{
+  compilation_t state = {0};
+  sink_init(&state.output, NULL);
+  compilation = &state;
+
+  char* handwritten_buffer = scan_buffer(input, length);
+  char* reference_buffer = scan_buffer(input, length);
+  yyscan_t handwritten, reference;
+  yylex_init(&handwritten);
+  yy_scan_buffer(handwritten_buffer, length + 2, handwritten);
+  reference_yylex_init(&reference);
+  reference_yy_scan_buffer(reference_buffer, length + 2, reference);
+
+  for (size_t i = 0;; i++)
+  {
+    YYSTYPE handwritten_value = NO_NODE, reference_value = NO_NODE;
+    int handwritten_token = yylex(&handwritten_value, handwritten);
+    int reference_token = reference_yylex(&reference_value, reference);
+    int handwritten_line = yyget_lineno(handwritten);
+    int reference_line = reference_yyget_lineno(reference);
+
+    if (handwritten_token != reference_token || handwritten_line != reference_line
+        || !same_leaf(handwritten_value, reference_value))
+    {
+      fprintf(
+          stderr,
+          "%s: token %zu differs. Hand-written: %d on line %d, flex: %d on line %d\n",
+          name,
+          i,
+          handwritten_token,
+          handwritten_line,
+          reference_token,
+          reference_line);
+      n_failures++;
+      break;
+    }
+
+    // The parser never reads past the end of the input
+    if (reference_token == 0)
+      break;
+  }
+
+  yylex_destroy(handwritten);
+  reference_yylex_destroy(reference);
+  free(handwritten_buffer);
+  free(reference_buffer);
+  destroy_compilation();
+  sink_destroy(&state.output);
+  compilation = NULL;
+}
+
+// Reads a whole file, or exits if it can not be read
+static char* read_file(const char* path, size_t* length)
+{
+  FILE* file = fopen(path, "rb");
+  if (file == NULL)
+  {
+    fprintf(stderr, "error: could not open '%s'\n", path);
+    exit(EXIT_FAILURE);
+  }
+  fseek(file, 0, SEEK_END);
+  *length = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  char* contents = malloc(*length + 1);
+  if (fread(contents, 1, *length, file) != *length)
+  {
+    fprintf(stderr, "error: could not read '%s'\n", path);
+    exit(EXIT_FAILURE);
+  }
+  fclose(file);
+  return contents;
+}
+
+int main(int argc, char** argv)
+{
+  for (int i = 1; i < argc; i++)
+  {
+    size_t length;
+    char* contents = read_file(argv[i], &length);
+    compare_scanners(argv[i], contents, length);
+    free(contents);
+  }
+
+  size_t n_tricky = sizeof(TRICKY_INPUTS) / sizeof(TRICKY_INPUTS[0]);
+  for (size_t i = 0; i < n_tricky; i++)
+  {
+    char name[32];
+    snprintf(name, sizeof(name), "tricky input %zu", i);
+    compare_scanners(name, TRICKY_INPUTS[i].text, TRICKY_INPUTS[i].length);
+  }
+
+  // Random inputs, from a fixed seed so that failures can be repeated
+  size_t n_pieces = sizeof(PIECES) / sizeof(PIECES[0]);
+  uint64_t random_state = 0x9e3779b97f4a7c15ULL;
+  char input[4096];
+  for (size_t i = 0; i < 10000; i++)
+  {
+    size_t length = 0;
+    size_t n_input_pieces = i % 64 + 1;
+    for (size_t j = 0; j < n_input_pieces; j++)
+    {
+      random_state = random_state * 6364136223846793005ULL + 1442695040888963407ULL;
+      const char* piece = PIECES[(random_state >> 33) % n_pieces];
+      size_t piece_length = strlen(piece);
+      memcpy(input + length, piece, piece_length);
+      length += piece_length;
+    }
+
+    char name[32];
+    snprintf(name, sizeof(name), "random input %zu", i);
+    compare_scanners(name, input, length);
+  }
+
+  if (n_failures > 0)
+  {
+    fprintf(stderr, "%zu inputs were scanned differently\n", n_failures);
+    return EXIT_FAILURE;
+  }
+  printf("The scanners agree on every input\n");
+  return EXIT_SUCCESS;
+}